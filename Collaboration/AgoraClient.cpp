@@ -63,11 +63,11 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Collaboration {
 
-/***********************************************************
-Methods of class AgoraClient::RemoteClientState::ALDataItem:
-***********************************************************/
+/*********************************************************
+Methods of class AgoraClientRemoteClientState::ALDataItem:
+*********************************************************/
 
-AgoraClient::RemoteClientState::ALDataItem::ALDataItem(size_t sSpeexFrameSize,Threads::DropoutBuffer<char>& sSpeexPacketQueue)
+AgoraClientRemoteClientState::ALDataItem::ALDataItem(size_t sSpeexFrameSize,Threads::DropoutBuffer<char>& sSpeexPacketQueue)
 	#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
 	:speexDecoder(sSpeexFrameSize,sSpeexPacketQueue),
 	 source(0),buffers(0)
@@ -90,7 +90,7 @@ AgoraClient::RemoteClientState::ALDataItem::ALDataItem(size_t sSpeexFrameSize,Th
 	#endif
 	}
 
-AgoraClient::RemoteClientState::ALDataItem::~ALDataItem(void)
+AgoraClientRemoteClientState::ALDataItem::~ALDataItem(void)
 	{
 	#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
 	/* Destroy the source and buffers: */
@@ -103,13 +103,13 @@ AgoraClient::RemoteClientState::ALDataItem::~ALDataItem(void)
 	#endif
 	}
 
-/***********************************************
-Methods of class AgoraClient::RemoteClientState:
-***********************************************/
+/*********************************************
+Methods of class AgoraClientRemoteClientState:
+*********************************************/
 
 #if VIDEO_CONFIG_HAVE_THEORA
 
-void* AgoraClient::RemoteClientState::videoDecodingThreadMethod(void)
+void* AgoraClientRemoteClientState::videoDecodingThreadMethod(void)
 	{
 	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
 	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
@@ -148,7 +148,7 @@ void* AgoraClient::RemoteClientState::videoDecodingThreadMethod(void)
 
 #endif
 
-AgoraClient::RemoteClientState::RemoteClientState(void)
+AgoraClientRemoteClientState::AgoraClientRemoteClientState(void)
 	:remoteSpeexFrameSize(0),
 	 rolloffFactor(1.0f),
 	 speexPacketQueue(0,0),
@@ -161,7 +161,7 @@ AgoraClient::RemoteClientState::RemoteClientState(void)
 		videoSize[i]=Scalar(0);
 	}
 
-AgoraClient::RemoteClientState::~RemoteClientState(void)
+AgoraClientRemoteClientState::~AgoraClientRemoteClientState(void)
 	{
 	#if VIDEO_CONFIG_HAVE_THEORA
 	if(theoraDecoder.isValid())
@@ -175,13 +175,13 @@ AgoraClient::RemoteClientState::~RemoteClientState(void)
 	#endif
 	}
 
-void AgoraClient::RemoteClientState::initContext(ALContextData& contextData) const
+void AgoraClientRemoteClientState::initContext(ALContextData& contextData) const
 	{
 	#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
 	if(remoteSpeexFrameSize>0)
 		{
 		#ifdef VERBOSE
-		std::cout<<"AgoraClient::RemoteClientState::initContext: Initializing audio playback"<<std::endl;
+		std::cout<<"AgoraClientRemoteClientState::initContext: Initializing audio playback"<<std::endl;
 		#endif
 		
 		/* Create and store a data item: */
@@ -197,7 +197,7 @@ void AgoraClient::RemoteClientState::initContext(ALContextData& contextData) con
 	#endif
 	}
 
-void AgoraClient::RemoteClientState::glRenderAction(GLContextData& contextData) const
+void AgoraClientRemoteClientState::glRenderAction(GLContextData& contextData) const
 	{
 	glPushMatrix();
 	glMultMatrix(localVideoTransform);
@@ -247,7 +247,7 @@ void AgoraClient::RemoteClientState::glRenderAction(GLContextData& contextData)
 	glPopMatrix();
 	}
 
-void AgoraClient::RemoteClientState::alRenderAction(ALContextData& contextData) const
+void AgoraClientRemoteClientState::alRenderAction(ALContextData& contextData) const
 	{
 	#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
 	/* Get the data item: */
@@ -874,7 +874,7 @@ void AgoraClient::receiveConnectReject(Comm::NetPipe& pipe)
 	haveVideo=false;
 	}
 
-AgoraClient::RemoteClientState* AgoraClient::receiveClientConnect(Comm::NetPipe& pipe)
+ProtocolClient::RemoteClientState* AgoraClient::receiveClientConnect(Comm::NetPipe& pipe)
 	{
 	/* Create a new remote client state object: */
 	RemoteClientState* newClientState=new RemoteClientState;
@@ -945,7 +945,7 @@ AgoraClient::RemoteClientState* AgoraClient::receiveClientConnect(Comm::NetPipe&
 			}
 			
 			/* Start the video decoding thread: */
-			newClientState->videoDecodingThread.start(newClientState,&AgoraClient::RemoteClientState::videoDecodingThreadMethod);
+			newClientState->videoDecodingThread.start(newClientState,&AgoraClientRemoteClientState::videoDecodingThreadMethod);
 			
 			#else
 			
@@ -974,31 +974,26 @@ AgoraClient::RemoteClientState* AgoraClient::receiveClientConnect(Comm::NetPipe&
 	return newClientState;
 	}
 
-bool AgoraClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe)
+bool AgoraClient::receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe)
 	{
 	bool result=false;
 	
-	/* Get a handle on the Agora state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("AgoraClient::receiveServerUpdate: Remote client state object has mismatching type");
-	
-	if(myRcs->remoteSpeexFrameSize>0)
+	if(rcs->remoteSpeexFrameSize>0)
 		{
 		/* Receive a number of SPEEX audio packets from the server and shove them into the remote client's decoding queue: */
 		size_t numSpeexPackets=pipe.read<Misc::UInt16>();
 		for(size_t i=0;i<numSpeexPackets;++i)
 			{
-			char* speexPacket=myRcs->speexPacketQueue.getWriteSegment();
-			pipe.read(speexPacket,myRcs->speexPacketQueue.getSegmentSize());
-			myRcs->speexPacketQueue.pushSegment();
+			char* speexPacket=rcs->speexPacketQueue.getWriteSegment();
+			pipe.read(speexPacket,rcs->speexPacketQueue.getSegmentSize());
+			rcs->speexPacketQueue.pushSegment();
 			}
 		
 		result=true;
 		}
 	
 	/* Check if the server sent a video state update: */
-	if(myRcs->hasTheora)
+	if(rcs->hasTheora)
 		{
 		/* Check for a new Theora packet from the server: */
 		if(pipe.read<Byte>()!=0)
@@ -1006,11 +1001,11 @@ bool AgoraClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Com
 			#if VIDEO_CONFIG_HAVE_THEORA
 			
 			/* Push a new Theora packet onto the decoder queue: */
-			myRcs->theoraPacketBuffer.startNewValue().read(pipe);
-			myRcs->theoraPacketBuffer.postNewValue();
+			rcs->theoraPacketBuffer.startNewValue().read(pipe);
+			rcs->theoraPacketBuffer.postNewValue();
 			
 			/* Wake up the video decoding thread, just in case: */
-			myRcs->newPacketCond.signal();
+			rcs->newPacketCond.signal();
 			
 			#else
 			
@@ -1107,32 +1102,27 @@ void AgoraClient::frame(void)
 	#endif
 	}
 
-void AgoraClient::frame(ProtocolClient::RemoteClientState* rcs)
+void AgoraClient::frame(RemoteClientState* rcs)
 	{
-	/* Get a handle on the Agora state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("AgoraClient::frame: Remote client state object has mismatching type");
-	
 	/* Get the remote client's current client state: */
 	const CollaborationProtocol::ClientState& cs=client->getClientState(rcs).getLockedValue();
 	
-	if(myRcs->remoteSpeexFrameSize!=0)
+	if(rcs->remoteSpeexFrameSize!=0)
 		{
 		/* Update the remote client's local mouth position: */
 		Vrui::Point mouthPos=Vrui::Point(cs.navTransform.inverseTransform(cs.viewerStates[0].transform(mouthPosition)));
-		myRcs->localMouthPosition=Point(Vrui::getNavigationTransformation().transform(mouthPos));
+		rcs->localMouthPosition=Point(Vrui::getNavigationTransformation().transform(mouthPos));
 		}
 	
-	if(myRcs->hasTheora)
+	if(rcs->hasTheora)
 		{
 		#if VIDEO_CONFIG_HAVE_THEORA
 		
 		/* Lock any new frames from the video decoding thread: */
-		if(myRcs->theoraFrameBuffer.lockNewValue())
+		if(rcs->theoraFrameBuffer.lockNewValue())
 			{
 			/* Send the new frame to the frame texture: */
-			const Video::TheoraFrame& frame=myRcs->theoraFrameBuffer.getLockedValue();
+			const Video::TheoraFrame& frame=rcs->theoraFrameBuffer.getLockedValue();
 			const void* planes[3];
 			unsigned int strides[3];
 			for(int i=0;i<3;++i)
@@ -1140,39 +1130,29 @@ void AgoraClient::frame(ProtocolClient::RemoteClientState* rcs)
 				planes[i]=frame.planes[i].data+frame.offsets[i];
 				strides[i]=frame.planes[i].stride;
 				}
-			myRcs->frameTexture->setFrame(planes[0],strides[0],planes[1],strides[1],planes[2],strides[2]);
+			rcs->frameTexture->setFrame(planes[0],strides[0],planes[1],strides[1],planes[2],strides[2]);
 			}
 		
 		#endif
 		
 		/* Update the remote client's local video transformation: */
-		myRcs->localVideoTransform=cs.navTransform;
-		myRcs->localVideoTransform.doInvert();
-		myRcs->localVideoTransform*=OGTransform(myRcs->videoTransform);
+		rcs->localVideoTransform=cs.navTransform;
+		rcs->localVideoTransform.doInvert();
+		rcs->localVideoTransform*=OGTransform(rcs->videoTransform);
 		}
 	}
 
-void AgoraClient::glRenderAction(const ProtocolClient::RemoteClientState* rcs,GLContextData& contextData) const
+void AgoraClient::glRenderAction(const RemoteClientState* rcs,GLContextData& contextData) const
 	{
-	/* Get a handle on the Agora state object: */
-	const RemoteClientState* myRcs=dynamic_cast<const RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("AgoraClient::glRenderAction: Remote client state object has mismatching type");
-	
-	if(myRcs->hasTheora)
-		myRcs->glRenderAction(contextData);
+	if(rcs->hasTheora)
+		rcs->glRenderAction(contextData);
 	}
 
-void AgoraClient::alRenderAction(const ProtocolClient::RemoteClientState* rcs,ALContextData& contextData) const
+void AgoraClient::alRenderAction(const RemoteClientState* rcs,ALContextData& contextData) const
 	{
 	#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
-	/* Get a handle on the Agora state object: */
-	const RemoteClientState* myRcs=dynamic_cast<const RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("AgoraClient::alRenderAction: Remote client state object has mismatching type");
-	
-	if(myRcs->remoteSpeexFrameSize!=0)
-		myRcs->alRenderAction(contextData);
+	if(rcs->remoteSpeexFrameSize!=0)
+		rcs->alRenderAction(contextData);
 	#endif
 	}
 
@@ -39,7 +39,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #endif
 #include <AL/Config.h>
 #include <AL/ALObject.h>
-#include <Collaboration/ProtocolClient.h>
+#include <Collaboration/TypedProtocolClient.h>
 #include <Collaboration/AgoraProtocol.h>
 #if SOUND_CONFIG_HAVE_SPEEX
 #include <Collaboration/SpeexDecoder.h>
@@ -69,74 +69,17 @@ namespace Collaboration {
 class SpeexEncoder;
 }
 #endif
+namespace Collaboration {
+class AgoraClientRemoteClientState;
+}
 
 namespace Collaboration {
 
-class AgoraClient:public ProtocolClient,private AgoraProtocol
+class AgoraClient:public TypedProtocolClient<AgoraClientRemoteClientState>,private AgoraProtocol
 	{
 	/* Embedded classes: */
 	protected:
-	class RemoteClientState:public ProtocolClient::RemoteClientState,public ALObject
-		{
-		/* Embedded classes: */
-		private:
-		struct ALDataItem:public ALObject::DataItem
-			{
-			/* Elements: */
-			public:
-			#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
-			SpeexDecoder speexDecoder; // SPEEX decoder object
-			ALuint source; // Source to play back the remote client's audio transmission
-			ALuint* buffers; // Buffers to stream the remote client's audio transmission into the source
-			ALuint* freeBuffers; // Stack of free buffers
-			size_t numFreeBuffers; // Number of free buffers on the stack
-			#endif
-			
-			/* Constructors and destructors: */
-			ALDataItem(size_t sSpeexFrameSize,Threads::DropoutBuffer<char>& sSpeexPacketQueue);
-			virtual ~ALDataItem(void);
-			};
-		
-		/* Elements: */
-		public:
-		
-		/* Audio decoding state: */
-		size_t remoteSpeexFrameSize; // Frame size of incoming SPEEX packets
-		Point mouthPosition; // Position of remote client's mouth in viewer's device space
-		float rolloffFactor; // Roll-off factor for attenuation of remote audio sources; 0.0 disables attenuation
-		mutable Threads::DropoutBuffer<char> speexPacketQueue; // Queue for incoming encoded SPEEX packets
-		Point localMouthPosition; // Position of remote client's mouth in local client's physical space
-		
-		/* Video decoding state: */
-		bool hasTheora; // Flag if the server will send video data for this client
-		ONTransform videoTransform; // The remote client's transformation from its video space into its physical space
-		Scalar videoSize[2]; // Width and height of remote video image in remote client's physical space
-		#if VIDEO_CONFIG_HAVE_THEORA
-		Threads::TripleBuffer<Video::TheoraPacket> theoraPacketBuffer; // Buffer for incoming Theora video stream packets
-		Threads::MutexCond newPacketCond; // Condition variable to signal arrival of a new Theora packet from the server
-		Video::TheoraDecoder theoraDecoder; // Theora decoder object
-		Threads::Thread videoDecodingThread; // Thread receiving compressed video data from the source
-		Threads::TripleBuffer<Video::TheoraFrame> theoraFrameBuffer; // Triple buffer for decompressed video frames
-		Video::YpCbCr420Texture* frameTexture; // Texture to render the remote client's video stream
-		#endif
-		OGTransform localVideoTransform; // Transformation from remote client's video space into local client's navigational space
-		
-		/* Private methods: */
-		#if VIDEO_CONFIG_HAVE_THEORA
-		void* videoDecodingThreadMethod(void); // Thread to decode a Theora video stream
-		#endif
-		
-		/* Constructors and destructors: */
-		RemoteClientState(void);
-		virtual ~RemoteClientState(void);
-		
-		/* Methods from ALObject: */
-		virtual void initContext(ALContextData& contextData) const;
-		
-		/* New methods: */
-		void glRenderAction(GLContextData& contextData) const; // Displays the remote client's state
-		void alRenderAction(ALContextData& contextData) const; // Displays the remote client's sound state
-		};
+	typedef AgoraClientRemoteClientState RemoteClientState; // Client-side state of a remote client sharing the Agora protocol
 	
 	/* Elements: */
 	private:
@@ -197,13 +140,77 @@ class AgoraClient:public ProtocolClient,private AgoraProtocol
 	virtual void sendConnectRequest(Comm::NetPipe& pipe);
 	virtual void receiveConnectReply(Comm::NetPipe& pipe);
 	virtual void receiveConnectReject(Comm::NetPipe& pipe);
-	virtual RemoteClientState* receiveClientConnect(Comm::NetPipe& pipe);
-	virtual bool receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe);
+	virtual ProtocolClient::RemoteClientState* receiveClientConnect(Comm::NetPipe& pipe);
 	virtual void sendClientUpdate(Comm::NetPipe& pipe);
 	virtual void frame(void);
-	virtual void frame(ProtocolClient::RemoteClientState* rcs);
-	virtual void glRenderAction(const ProtocolClient::RemoteClientState* rcs,GLContextData& contextData) const;
-	virtual void alRenderAction(const ProtocolClient::RemoteClientState* rcs,ALContextData& contextData) const;
+	
+	/* Methods from TypedProtocolClient: */
+	virtual bool receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe);
+	virtual void frame(RemoteClientState* rcs);
+	virtual void glRenderAction(const RemoteClientState* rcs,GLContextData& contextData) const;
+	virtual void alRenderAction(const RemoteClientState* rcs,ALContextData& contextData) const;
+	};
+
+class AgoraClientRemoteClientState:public ProtocolClient::RemoteClientState,public ALObject,private AgoraProtocol // Class representing client-side state of a remote client sharing the Agora protocol
+	{
+	/* Embedded classes: */
+	private:
+	struct ALDataItem:public ALObject::DataItem
+		{
+		/* Elements: */
+		public:
+		#if ALSUPPORT_CONFIG_HAVE_OPENAL && SOUND_CONFIG_HAVE_SPEEX
+		SpeexDecoder speexDecoder; // SPEEX decoder object
+		ALuint source; // Source to play back the remote client's audio transmission
+		ALuint* buffers; // Buffers to stream the remote client's audio transmission into the source
+		ALuint* freeBuffers; // Stack of free buffers
+		size_t numFreeBuffers; // Number of free buffers on the stack
+		#endif
+		
+		/* Constructors and destructors: */
+		ALDataItem(size_t sSpeexFrameSize,Threads::DropoutBuffer<char>& sSpeexPacketQueue);
+		virtual ~ALDataItem(void);
+		};
+	
+	/* Elements: */
+	public:
+	
+	/* Audio decoding state: */
+	size_t remoteSpeexFrameSize; // Frame size of incoming SPEEX packets
+	Point mouthPosition; // Position of remote client's mouth in viewer's device space
+	float rolloffFactor; // Roll-off factor for attenuation of remote audio sources; 0.0 disables attenuation
+	mutable Threads::DropoutBuffer<char> speexPacketQueue; // Queue for incoming encoded SPEEX packets
+	Point localMouthPosition; // Position of remote client's mouth in local client's physical space
+	
+	/* Video decoding state: */
+	bool hasTheora; // Flag if the server will send video data for this client
+	ONTransform videoTransform; // The remote client's transformation from its video space into its physical space
+	Scalar videoSize[2]; // Width and height of remote video image in remote client's physical space
+	#if VIDEO_CONFIG_HAVE_THEORA
+	Threads::TripleBuffer<Video::TheoraPacket> theoraPacketBuffer; // Buffer for incoming Theora video stream packets
+	Threads::MutexCond newPacketCond; // Condition variable to signal arrival of a new Theora packet from the server
+	Video::TheoraDecoder theoraDecoder; // Theora decoder object
+	Threads::Thread videoDecodingThread; // Thread receiving compressed video data from the source
+	Threads::TripleBuffer<Video::TheoraFrame> theoraFrameBuffer; // Triple buffer for decompressed video frames
+	Video::YpCbCr420Texture* frameTexture; // Texture to render the remote client's video stream
+	#endif
+	OGTransform localVideoTransform; // Transformation from remote client's video space into local client's navigational space
+	
+	/* Private methods: */
+	#if VIDEO_CONFIG_HAVE_THEORA
+	void* videoDecodingThreadMethod(void); // Thread to decode a Theora video stream
+	#endif
+	
+	/* Constructors and destructors: */
+	AgoraClientRemoteClientState(void);
+	virtual ~AgoraClientRemoteClientState(void);
+	
+	/* Methods from ALObject: */
+	virtual void initContext(ALContextData& contextData) const;
+	
+	/* New methods: */
+	void glRenderAction(GLContextData& contextData) const; // Displays the remote client's state
+	void alRenderAction(ALContextData& contextData) const; // Displays the remote client's sound state
 	};
 
 }
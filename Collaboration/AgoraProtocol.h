@@ -70,11 +70,14 @@ class AgoraProtocol:public Protocol
 			/* Read the data size: */
 			dataSize=source.read<Card>();
 			
-			/* Reallocate the data buffer if necessary: */
+			/* Reallocate the data buffer if necessary, growing it geometrically so that slowly growing packets do not reallocate every time: */
 			if(allocSize<dataSize)
 				{
 				delete[] data;
-				allocSize=dataSize;
+				if(allocSize<4096)
+					allocSize=4096;
+				while(allocSize<dataSize)
+					allocSize*=2;
 				data=new Misc::UInt8[allocSize];
 				}
 			
@@ -94,6 +97,11 @@ class AgoraProtocol:public Protocol
 			/* Write the packet data: */
 			sink.write(data,dataSize);
 			}
+		bool isKeyframe(void) const // Returns true if the packet holds a Theora intra frame, from which a decoder can resume after skipped packets
+			{
+			/* Theora data packets have a clear header bit, and intra frames have a clear frame type bit: */
+			return dataSize>0&&(data[0]&0xc0U)==0x00U;
+			}
 		};
 	
 	/* Elements: */
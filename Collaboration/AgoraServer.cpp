@@ -29,18 +29,19 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Collaboration {
 
-/*****************************************
-Methods of class AgoraServer::ClientState:
-*****************************************/
+/***************************************
+Methods of class AgoraServerClientState:
+***************************************/
 
-AgoraServer::ClientState::ClientState(void)
+AgoraServerClientState::AgoraServerClientState(void)
 	:speexFrameSize(0),
 	 speexPacketSize(0),speexPacketBuffer(0,0),
-	 theoraHeaders(0)
+	 theoraHeaders(0),
+	 resyncSources(17)
 	{
 	}
 
-AgoraServer::ClientState::~ClientState(void)
+AgoraServerClientState::~AgoraServerClientState(void)
 	{
 	delete[] theoraHeaders;
 	}
@@ -62,6 +63,24 @@ const char* AgoraServer::getName(void) const
 	return protocolName;
 	}
 
+bool AgoraServer::hasDestinationIndependentConnect(void) const
+	{
+	/* Connect messages only carry the source client's audio and video setup: */
+	return true;
+	}
+
+bool AgoraServer::hasThreadSafeClientHooks(void) const
+	{
+	/* Packet buffers are locked and unlocked per client, server updates only read them, and resynchronization state is locked per destination client: */
+	return true;
+	}
+
+bool AgoraServer::hasBatchedServerUpdates(void) const
+	{
+	/* Audio and video packets are written once per endianness and shared by all destination clients: */
+	return true;
+	}
+
 ProtocolServer::ClientState* AgoraServer::receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe)
 	{
 	size_t readMessageLength=0;
@@ -120,125 +139,161 @@ ProtocolServer::ClientState* AgoraServer::receiveConnectRequest(unsigned int pro
 	return newClientState;
 	}
 
-void AgoraServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+void AgoraServer::receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe)
 	{
-	/* Get a handle on the Agora state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("AgoraServer::receiveClientUpdate: Client state object has mismatching type");
-	
-	if(myCs->speexFrameSize>0)
+	if(cs->speexFrameSize>0)
 		{
 		/* Read all SPEEX frames sent by the client: */
 		size_t numSpeexFrames=pipe.read<Misc::UInt16>();
 		for(size_t i=0;i<numSpeexFrames;++i)
 			{
-			Byte* speexPacket=myCs->speexPacketBuffer.getWriteSegment();
-			pipe.read(speexPacket,myCs->speexPacketSize);
-			myCs->speexPacketBuffer.pushSegment();
+			Byte* speexPacket=cs->speexPacketBuffer.getWriteSegment();
+			pipe.read(speexPacket,cs->speexPacketSize);
+			cs->speexPacketBuffer.pushSegment();
 			}
 		}
 	
-	if(myCs->hasTheora)
+	if(cs->hasTheora)
 		{
 		/* Check if the client sent a new video packet: */
 		if(pipe.read<Byte>()!=0)
 			{
 			/* Read a Theora packet from the client: */
-			VideoPacket& theoraPacket=myCs->theoraPacketBuffer.startNewValue();
+			VideoPacket& theoraPacket=cs->theoraPacketBuffer.startNewValue();
 			theoraPacket.read(pipe);
-			myCs->theoraPacketBuffer.postNewValue();
+			cs->theoraPacketBuffer.postNewValue();
 			}
 		}
 	}
 
-void AgoraServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void AgoraServer::sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get a handle on the Agora state object: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	if(mySourceCs==0)
-		Misc::throwStdErr("AgoraServer::sendClientConnect: Client state object has mismatching type");
-	
 	/* Send the client's mouth position: */
-	write(mySourceCs->mouthPosition,pipe);
+	write(sourceCs->mouthPosition,pipe);
 	
 	/* Send the client's SPEEX frame size and packet size: */
-	pipe.write<Card>(mySourceCs->speexFrameSize);
-	pipe.write<Card>(mySourceCs->speexPacketSize);
+	pipe.write<Card>(sourceCs->speexFrameSize);
+	pipe.write<Card>(sourceCs->speexPacketSize);
 	
-	if(mySourceCs->hasTheora)
+	if(sourceCs->hasTheora)
 		{
 		pipe.write<Byte>(1);
 		
 		/* Write the client's virtual video transformation: */
-		write(mySourceCs->videoTransform,pipe);
-		pipe.write(mySourceCs->videoSize,2);
+		write(sourceCs->videoTransform,pipe);
+		pipe.write(sourceCs->videoSize,2);
 		
 		/* Write the source client's Theora stream headers: */
-		pipe.write<Card>(mySourceCs->theoraHeadersSize);
-		pipe.write(mySourceCs->theoraHeaders,mySourceCs->theoraHeadersSize);
+		pipe.write<Card>(sourceCs->theoraHeadersSize);
+		pipe.write(sourceCs->theoraHeaders,sourceCs->theoraHeadersSize);
 		}
 	else
 		pipe.write<Byte>(0);
 	}
 
-void AgoraServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void AgoraServer::writeServerUpdate(AgoraServer::ClientState* sourceCs,bool sendVideo,IO::File& pipe)
 	{
-	/* Get a handle on the Agora state object: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	if(mySourceCs==0)
-		Misc::throwStdErr("AgoraServer::sendServerUpdate: Client state object has mismatching type");
-	
-	if(mySourceCs->speexFrameSize>0)
+	if(sourceCs->speexFrameSize>0)
 		{
 		/* Send all SPEEX packets from the source client's packet buffer to the destination client: */
-		pipe.write<Misc::UInt16>(mySourceCs->numSpeexPackets);
-		for(size_t i=0;i<mySourceCs->numSpeexPackets;++i)
+		pipe.write<Misc::UInt16>(sourceCs->numSpeexPackets);
+		for(size_t i=0;i<sourceCs->numSpeexPackets;++i)
 			{
-			const Byte* speexPacket=mySourceCs->speexPacketBuffer.getLockedSegment(i);
-			pipe.write(speexPacket,mySourceCs->speexPacketSize);
+			const Byte* speexPacket=sourceCs->speexPacketBuffer.getLockedSegment(i);
+			pipe.write(speexPacket,sourceCs->speexPacketSize);
 			}
 		}
 	
 	/* Check if the destination client expects streaming video from the source client: */
-	if(mySourceCs->hasTheora)
+	if(sourceCs->hasTheora)
 		{
-		/* Check if there is a new video packet for the client: */
-		if(mySourceCs->hasTheoraPacket)
+		/* Check if there is a new video packet the destination client can decode: */
+		if(sourceCs->hasTheoraPacket&&sendVideo)
 			{
 			/* Write the Theora packet to the client: */
 			pipe.write<Byte>(1);
-			mySourceCs->theoraPacketBuffer.getLockedValue().write(pipe);
+			sourceCs->theoraPacketBuffer.getLockedValue().write(pipe);
 			}
 		else
 			pipe.write<Byte>(0);
 		}
 	}
 
-void AgoraServer::beforeServerUpdate(ProtocolServer::ClientState* cs)
+bool AgoraServer::canSendVideo(AgoraServer::ClientState* sourceCs,AgoraServer::ClientState* destCs)
+	{
+	/* Nothing can be skipped if the source client did not send a new video packet: */
+	if(!sourceCs->hasTheoraPacket)
+		return true;
+	
+	/* Check if the destination client is waiting for the source client's next keyframe: */
+	Threads::Mutex::Lock resyncLock(destCs->resyncMutex);
+	if(!destCs->resyncSources.isEntry(sourceCs))
+		return true;
+	
+	/* Keep skipping inter frames, which the destination client's decoder cannot apply to the frame it missed: */
+	if(!sourceCs->theoraPacketBuffer.getLockedValue().isKeyframe())
+		return false;
+	
+	/* Resume the source client's video at the keyframe: */
+	destCs->resyncSources.removeEntry(sourceCs);
+	return true;
+	}
+
+void AgoraServer::sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get a handle on the Agora state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("AgoraServer::beforeServerUpdate: Client state object has mismatching type");
+	/* Send the source client's audio and video packets to the destination client: */
+	writeServerUpdate(sourceCs,canSendVideo(sourceCs,destCs),pipe);
+	}
+
+void AgoraServer::sendServerUpdate(ClientState* sourceCs,ProtocolServer::ServerUpdateBatch& batch)
+	{
+	/* Write separate payloads without video for destination clients waiting for the source client's next keyframe: */
+	for(unsigned int i=0;i<batch.getNumDestinations();++i)
+		if(!canSendVideo(sourceCs,static_cast<ClientState*>(batch.getDestination(i))))
+			writeServerUpdate(sourceCs,false,batch.getPayload(i));
+	
+	/* Walk the source client's packet buffers once per endianness, and share the result among all other destination clients: */
+	for(int swap=0;swap<2;++swap)
+		if(batch.needsSharedPayload(swap!=0))
+			writeServerUpdate(sourceCs,true,batch.getSharedPayload(swap!=0));
+	}
+
+bool AgoraServer::sendReducedServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
+	{
+	/* Drop the source client's SPEEX packets for this update: */
+	if(sourceCs->speexFrameSize>0)
+		pipe.write<Misc::UInt16>(0);
+	
+	if(sourceCs->hasTheora)
+		{
+		/* Drop the source client's new video packet: */
+		pipe.write<Byte>(0);
+		
+		/* Withhold the source client's following inter frames from the destination client until the next keyframe: */
+		if(sourceCs->hasTheoraPacket)
+			{
+			Threads::Mutex::Lock resyncLock(destCs->resyncMutex);
+			destCs->resyncSources.setEntry(ClientState::ClientSet::Entry(sourceCs));
+			}
+		}
 	
+	return true;
+	}
+
+void AgoraServer::beforeServerUpdate(ClientState* cs)
+	{
 	/* Lock the available SPEEX packets: */
-	myCs->numSpeexPackets=myCs->speexFrameSize>0?myCs->speexPacketBuffer.lockQueue():0;
+	cs->numSpeexPackets=cs->speexFrameSize>0?cs->speexPacketBuffer.lockQueue():0;
 	
 	/* Check if there is a new Theora packet in the receiving buffer: */
-	myCs->hasTheoraPacket=myCs->hasTheora&&myCs->theoraPacketBuffer.lockNewValue();
+	cs->hasTheoraPacket=cs->hasTheora&&cs->theoraPacketBuffer.lockNewValue();
 	}
 
-void AgoraServer::afterServerUpdate(ProtocolServer::ClientState* cs)
+void AgoraServer::afterServerUpdate(ClientState* cs)
 	{
-	/* Get a handle on the Agora state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("AgoraServer::afterServerUpdate: Client state object has mismatching type");
-	
 	/* Unlock the SPEEX packet buffer: */
-	if(myCs->speexFrameSize>0)
-		myCs->speexPacketBuffer.unlockQueue();
+	if(cs->speexFrameSize>0)
+		cs->speexPacketBuffer.unlockQueue();
 	}
 
 }
@@ -23,43 +23,30 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef COLLABORATION_AGORASERVER_INCLUDED
 #define COLLABORATION_AGORASERVER_INCLUDED
 
+#include <Misc/HashTable.h>
+#include <Threads/Mutex.h>
 #include <Threads/TripleBuffer.h>
 #include <Threads/DropoutBuffer.h>
-#include <Collaboration/ProtocolServer.h>
+#include <Collaboration/TypedProtocolServer.h>
 #include <Collaboration/AgoraProtocol.h>
 
+/* Forward declarations: */
+namespace Collaboration {
+class AgoraServerClientState;
+}
+
 namespace Collaboration {
 
-class AgoraServer:public ProtocolServer,private AgoraProtocol
+class AgoraServer:public TypedProtocolServer<AgoraServerClientState>,private AgoraProtocol
 	{
 	/* Embedded classes: */
 	protected:
-	class ClientState:public ProtocolServer::ClientState
-		{
-		friend class AgoraServer;
-		
-		/* Elements: */
-		private:
-		Point mouthPosition; // Client's mouth position in its main viewer's device space
-		size_t speexFrameSize; // Client's SPEEX frame size
-		size_t speexPacketSize; // Client's SPEEX packet size
-		Threads::DropoutBuffer<Byte> speexPacketBuffer; // Buffer holding encoded SPEEX audio packets sent by the client
-		
-		bool hasTheora; // Flag whether the client is streaming video data
-		ONTransform videoTransform; // Transformation from client's video space to client's physical space
-		Scalar videoSize[2]; // Client's virtual video size in client's physical space
-		size_t theoraHeadersSize; // Size of the client's Theora stream header packets
-		Byte* theoraHeaders; // A little-endian buffer containing the clients Theora stream header packets
-		Threads::TripleBuffer<VideoPacket> theoraPacketBuffer; // Triple buffer containing encoded video frames from the client
-		
-		size_t numSpeexPackets; // Transient number of SPEEX packets in the packet queue during server updates
-		bool hasTheoraPacket; // Transient flag to denote a fresh Theora frame in the packet buffer during server updates
-		
-		/* Constructors and destructors: */
-		public:
-		ClientState(void);
-		virtual ~ClientState(void);
-		};
+	typedef AgoraServerClientState ClientState; // Server-side state of a client sharing the Agora protocol
+	
+	/* Private methods: */
+	private:
+	void writeServerUpdate(ClientState* sourceCs,bool sendVideo,IO::File& pipe); // Writes the source client's SPEEX packets and, if requested, its new Theora packet to the given pipe
+	static bool canSendVideo(ClientState* sourceCs,ClientState* destCs); // Returns false if the destination client skipped one of the source client's video packets and the source client's new packet is not a keyframe
 	
 	/* Constructors and destructors: */
 	public:
@@ -68,12 +55,51 @@ class AgoraServer:public ProtocolServer,private AgoraProtocol
 	
 	/* Methods from ProtocolServer: */
 	virtual const char* getName(void) const;
+	virtual bool hasDestinationIndependentConnect(void) const;
+	virtual bool hasThreadSafeClientHooks(void) const;
+	virtual bool hasBatchedServerUpdates(void) const;
 	virtual ProtocolServer::ClientState* receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe);
-	virtual void receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
-	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void beforeServerUpdate(ProtocolServer::ClientState* cs);
-	virtual void afterServerUpdate(ProtocolServer::ClientState* cs);
+	
+	/* Methods from TypedProtocolServer: */
+	virtual void receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe);
+	virtual void sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ClientState* sourceCs,ServerUpdateBatch& batch);
+	virtual bool sendReducedServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void beforeServerUpdate(ClientState* cs);
+	virtual void afterServerUpdate(ClientState* cs);
+	};
+
+class AgoraServerClientState:public ProtocolServer::ClientState,private AgoraProtocol // Class representing server-side state of a client sharing the Agora protocol
+	{
+	friend class AgoraServer;
+	
+	/* Embedded classes: */
+	private:
+	typedef Misc::HashTable<AgoraServerClientState*,void> ClientSet; // Type for sets of clients
+	
+	/* Elements: */
+	Point mouthPosition; // Client's mouth position in its main viewer's device space
+	size_t speexFrameSize; // Client's SPEEX frame size
+	size_t speexPacketSize; // Client's SPEEX packet size
+	Threads::DropoutBuffer<Byte> speexPacketBuffer; // Buffer holding encoded SPEEX audio packets sent by the client
+	
+	bool hasTheora; // Flag whether the client is streaming video data
+	ONTransform videoTransform; // Transformation from client's video space to client's physical space
+	Scalar videoSize[2]; // Client's virtual video size in client's physical space
+	size_t theoraHeadersSize; // Size of the client's Theora stream header packets
+	Byte* theoraHeaders; // A little-endian buffer containing the clients Theora stream header packets
+	Threads::TripleBuffer<VideoPacket> theoraPacketBuffer; // Triple buffer containing encoded video frames from the client
+	Threads::Mutex resyncMutex; // Mutex protecting the set of resynchronizing source clients
+	ClientSet resyncSources; // Source clients of which this client skipped a video packet, and whose video it only receives again starting with their next keyframe
+	
+	size_t numSpeexPackets; // Transient number of SPEEX packets in the packet queue during server updates
+	bool hasTheoraPacket; // Transient flag to denote a fresh Theora frame in the packet buffer during server updates
+	
+	/* Constructors and destructors: */
+	public:
+	AgoraServerClientState(void);
+	virtual ~AgoraServerClientState(void);
 	};
 
 }
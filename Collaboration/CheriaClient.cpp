@@ -40,11 +40,11 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Collaboration {
 
-/*******************************************************************
-Methods of class CheriaClient::RemoteClientState::RemoteDeviceState:
-*******************************************************************/
+/*****************************************************************
+Methods of class CheriaClientRemoteClientState::RemoteDeviceState:
+*****************************************************************/
 
-CheriaClient::RemoteClientState::RemoteDeviceState::RemoteDeviceState(IO::File& source)
+CheriaClientRemoteClientState::RemoteDeviceState::RemoteDeviceState(IO::File& source)
 	:DeviceState(source),
 	 device(Vrui::getInputDeviceManager()->createInputDevice("CheriaRemoteDevice",trackType,numButtons,numValuators))
 	{
@@ -52,23 +52,23 @@ CheriaClient::RemoteClientState::RemoteDeviceState::RemoteDeviceState(IO::File&
 	Vrui::getInputGraphManager()->grabInputDevice(device,0);
 	}
 
-CheriaClient::RemoteClientState::RemoteDeviceState::~RemoteDeviceState(void)
+CheriaClientRemoteClientState::RemoteDeviceState::~RemoteDeviceState(void)
 	{
 	Vrui::getInputGraphManager()->releaseInputDevice(device,0);
 	Vrui::getInputDeviceManager()->destroyInputDevice(device);
 	}
 
-/************************************************
-Methods of class CheriaClient::RemoteClientState:
-************************************************/
+/**********************************************
+Methods of class CheriaClientRemoteClientState:
+**********************************************/
 
-CheriaClient::RemoteClientState::RemoteClientState(CheriaClient& sClient)
+CheriaClientRemoteClientState::CheriaClientRemoteClientState(CheriaClient& sClient)
 	:client(sClient),
 	 remoteDevices(17),remoteTools(17)
 	{
 	}
 
-CheriaClient::RemoteClientState::~RemoteClientState(void)
+CheriaClientRemoteClientState::~CheriaClientRemoteClientState(void)
 	{
 	/* Destroy all remote devices (which automatically destroys all remote tools): */
 	client.remoteClientDestroyingDevice=true;
@@ -79,17 +79,17 @@ CheriaClient::RemoteClientState::~RemoteClientState(void)
 	/* Delete any leftover message buffers: */
 	{
 	Threads::Mutex::Lock messageBufferLock(messageBufferMutex);
-	for(std::vector<IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
+	for(std::vector<CheriaClient::IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
 		delete *mIt;
 	}
 	}
 
-void CheriaClient::RemoteClientState::processMessages(void)
+void CheriaClientRemoteClientState::processMessages(void)
 	{
 	Threads::Mutex::Lock messageBufferLock(messageBufferMutex);
 	
 	/* Handle all state tracking and device state update messages: */
-	for(std::vector<IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
+	for(std::vector<CheriaClient::IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
 		{
 		/* Process all messages in this buffer: */
 		IO::File& msg=**mIt;
@@ -272,7 +272,7 @@ void CheriaClient::RemoteClientState::processMessages(void)
 					while((deviceId=msg.read<Card>())!=0)
 						{
 						/* Update the device state: */
-						remoteDevices.getEntry(deviceId).getDest()->read(msg);
+						remoteDevices.getEntry(deviceId).getDest()->read(client.poseCodec,msg);
 						}
 					
 					break;
@@ -297,6 +297,10 @@ CheriaClient::LocalDeviceState::LocalDeviceState(unsigned int sDeviceId,const Vr
 	 deviceId(sDeviceId),
 	 buttonMasks(numButtons>0?new Byte[(numButtons+7)/8]:0),valuatorMasks(numValuators>0?new Byte[(numValuators+7)/8]:0)
 	{
+	/* Quantize the device's position relative to the local environment: */
+	frameCenter=Point(Vrui::getDisplayCenter()); // Conversion to lower precision
+	frameSize=Scalar(Vrui::getDisplaySize()); // Conversion to lower precision
+	
 	/* Initialize the mask arrays to false: */
 	for(unsigned int i=0;i<(numButtons+7)/8;++i)
 		buttonMasks[i]=0x0U;
@@ -555,6 +559,11 @@ void CheriaClient::sendConnectRequest(Comm::NetPipe& pipe)
 
 void CheriaClient::receiveConnectReply(Comm::NetPipe& pipe)
 	{
+	/* Read the precision of the server's pose codec: */
+	unsigned int positionBits=pipe.read<Card>();
+	unsigned int rotationBits=pipe.read<Card>();
+	poseCodec=PoseCodec(positionBits,rotationBits);
+	
 	/* Set the message buffer's endianness swapping behavior to that of the pipe: */
 	message.setSwapOnWrite(pipe.mustSwapOnWrite());
 	
@@ -606,8 +615,11 @@ ProtocolClient::RemoteClientState* CheriaClient::receiveClientConnect(Comm::NetP
 	/* Create a new remote client state object: */
 	RemoteClientState* newClientState=new RemoteClientState(*this);
 	
+	/* Unpack the message if the server compressed it: */
+	IO::FilePtr payload=readBulkPayload(pipe);
+	
 	/* Read the size of the following message: */
-	unsigned int messageSize=pipe.read<Card>();
+	unsigned int messageSize=payload->read<Card>();
 	
 	#if DEBUGGING
 	std::cout<<"Received client connect message of size "<<messageSize<<std::endl;
@@ -616,7 +628,7 @@ ProtocolClient::RemoteClientState* CheriaClient::receiveClientConnect(Comm::NetP
 	/* Read the entire message into a new read buffer that has the same endianness as the pipe's read end: */
 	IncomingMessage* msg=new IncomingMessage(messageSize);
 	msg->setSwapOnRead(pipe.mustSwapOnRead());
-	pipe.readRaw(msg->getMemory(),messageSize);
+	payload->readRaw(msg->getMemory(),messageSize);
 	
 	/* Store the new buffer in the client's message list: */
 	newClientState->messages.push_back(msg);
@@ -624,13 +636,8 @@ ProtocolClient::RemoteClientState* CheriaClient::receiveClientConnect(Comm::NetP
 	return newClientState;
 	}
 
-bool CheriaClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe)
+bool CheriaClient::receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe)
 	{
-	/* Get a handle on the remote client state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("CheriaClient::receiveServerUpdate: Mismatching remote client state object type");
-	
 	/* Read the size of the following message: */
 	unsigned int messageSize=pipe.read<Card>();
 	
@@ -643,8 +650,8 @@ bool CheriaClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Co
 		
 		/* Store the new buffer in the client's message list: */
 		{
-		Threads::Mutex::Lock messageBufferLock(myRcs->messageBufferMutex);
-		myRcs->messages.push_back(msg);
+		Threads::Mutex::Lock messageBufferLock(rcs->messageBufferMutex);
+		rcs->messages.push_back(msg);
 		}
 		}
 	
@@ -673,7 +680,7 @@ void CheriaClient::sendClientUpdate(Comm::NetPipe& pipe)
 			pipe.write<Card>(lds->deviceId);
 			
 			/* Write the device's state update: */
-			lds->write(lds->updateMask,pipe);
+			lds->write(lds->updateMask,poseCodec,pipe);
 			
 			/* Reset the device's update mask: */
 			lds->updateMask=DeviceState::NO_CHANGE;
@@ -774,15 +781,10 @@ void CheriaClient::frame(void)
 		}
 	}
 
-void CheriaClient::frame(ProtocolClient::RemoteClientState* rcs)
+void CheriaClient::frame(RemoteClientState* rcs)
 	{
-	/* Get a handle on the remote client state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("CheriaClient::frame: Mismatching remote client state object type");
-	
 	/* Process the remote client's queued server update messages: */
-	myRcs->processMessages();
+	rcs->processMessages();
 	
 	/* Calculate the transformation from the remote client's physical space into the local client's physical space: */
 	Vrui::NavTransform remoteNav=Vrui::NavTransform(client->getClientState(rcs).getLockedValue().navTransform);
@@ -790,7 +792,7 @@ void CheriaClient::frame(ProtocolClient::RemoteClientState* rcs)
 	remoteNav.leftMultiply(Vrui::getNavigationTransformation());
 	
 	/* Update the states of all remote input devices: */
-	for(RemoteClientState::RemoteDeviceMap::Iterator rdIt=myRcs->remoteDevices.begin();!rdIt.isFinished();++rdIt)
+	for(RemoteClientState::RemoteDeviceMap::Iterator rdIt=rcs->remoteDevices.begin();!rdIt.isFinished();++rdIt)
 		{
 		RemoteClientState::RemoteDeviceState& rds=*(rdIt->getDest());
 		
@@ -838,7 +840,7 @@ void CheriaClient::frame(ProtocolClient::RemoteClientState* rcs)
 	
 	/* Update the states of all remote pointing tools: */
 	Scalar scaleFactor=remoteNav.getScaling();
-	for(RemoteClientState::RemoteToolMap::Iterator rtIt=myRcs->remoteTools.begin();!rtIt.isFinished();++rtIt)
+	for(RemoteClientState::RemoteToolMap::Iterator rtIt=rcs->remoteTools.begin();!rtIt.isFinished();++rtIt)
 		{
 		/* Set the pointing tool's scaling factor: */
 		rtIt->getDest()->setScaleFactor(scaleFactor);
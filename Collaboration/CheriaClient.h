@@ -30,8 +30,9 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/GlyphRenderer.h>
 #include <Vrui/InputDeviceManager.h>
 #include <Vrui/ToolManager.h>
-#include <Collaboration/ProtocolClient.h>
+#include <Collaboration/TypedProtocolClient.h>
 #include <Collaboration/CheriaProtocol.h>
+#include <Collaboration/PoseCodec.h>
 
 /* Forward declarations: */
 namespace IO {
@@ -40,48 +41,21 @@ class FixedMemoryFile;
 namespace Vrui {
 class PointingTool;
 }
+namespace Collaboration {
+class CheriaClientRemoteClientState;
+}
 
 namespace Collaboration {
 
-class CheriaClient:public ProtocolClient,private CheriaProtocol
+class CheriaClient:public TypedProtocolClient<CheriaClientRemoteClientState>,private CheriaProtocol
 	{
+	friend class CheriaClientRemoteClientState;
+	
 	/* Embedded classes: */
 	private:
 	typedef IO::FixedMemoryFile IncomingMessage; // Type for buffers storing incoming messages
 	typedef IO::VariableMemoryFile OutgoingMessage; // Type for buffers storing outgoing messages
-	
-	class RemoteClientState:public ProtocolClient::RemoteClientState
-		{
-		/* Embedded classes: */
-		public:
-		struct RemoteDeviceState:public DeviceState // Structure to represent remote devices and their states
-			{
-			/* Elements: */
-			public:
-			Vrui::InputDevice* device; // Pointer to local input device representing the remote device
-			
-			/* Constructors and destructors: */
-			RemoteDeviceState(IO::File& source); // Reads device state layout from the given source and creates local proxy device
-			~RemoteDeviceState(void); // Destroys local proxy device
-			};
-		
-		typedef Misc::HashTable<unsigned int,RemoteDeviceState*> RemoteDeviceMap; // Hash table to map remote device IDs to local input device pointers
-		typedef Misc::HashTable<unsigned int,Vrui::PointingTool*> RemoteToolMap; // Hash table to map remote device IDs to local pointing tool pointers
-		
-		/* Elements: */
-		CheriaClient& client; // Cheria client object to which the remote client state belongs
-		RemoteDeviceMap remoteDevices; // Map of remote client's device IDs to local input devices
-		RemoteToolMap remoteTools; // Map of remote client's tool IDs to local tools
-		Threads::Mutex messageBufferMutex; // Mutex serializing access to the message buffer list
-		std::vector<IncomingMessage*> messages; // List of buffers retaining server update messages between frame calls
-		
-		/* Constructors and destructors: */
-		RemoteClientState(CheriaClient& sClient);
-		virtual ~RemoteClientState(void);
-		
-		/* Methods: */
-		void processMessages(void); // Reads and processes all queued server update messages
-		};
+	typedef CheriaClientRemoteClientState RemoteClientState; // Client-side state of a remote client sharing the Cheria protocol
 	
 	struct LocalDeviceState:public DeviceState // Structure to associate button and valuator masks with represented local devices
 		{
@@ -112,6 +86,7 @@ class CheriaClient:public ProtocolClient,private CheriaProtocol
 	volatile bool remoteClientDestroyingDevice; // Flag if a remote Cheria client is currently destroying an input device
 	volatile bool remoteClientCreatingTool; // Flag if a remote Cheria client is currently creating a tool
 	volatile bool remoteClientDestroyingTool; // Flag if a remote Cheria client is currently destroying a tool
+	PoseCodec poseCodec; // Codec for device positions and orientations, as announced by the server
 	
 	/* Private methods: */
 	void createInputDevice(Vrui::InputDevice* device); // Method to add a newly-created local input device to the local input device set
@@ -134,10 +109,48 @@ class CheriaClient:public ProtocolClient,private CheriaProtocol
 	virtual void receiveConnectReply(Comm::NetPipe& pipe);
 	virtual void receiveDisconnectReply(Comm::NetPipe& pipe);
 	virtual ProtocolClient::RemoteClientState* receiveClientConnect(Comm::NetPipe& pipe);
-	virtual bool receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe);
 	virtual void sendClientUpdate(Comm::NetPipe& pipe);
 	virtual void frame(void);
-	virtual void frame(ProtocolClient::RemoteClientState* rcs);
+	
+	/* Methods from TypedProtocolClient: */
+	virtual bool receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe);
+	virtual void frame(RemoteClientState* rcs);
+	};
+
+class CheriaClientRemoteClientState:public ProtocolClient::RemoteClientState,private CheriaProtocol // Class representing client-side state of a remote client sharing the Cheria protocol
+	{
+	friend class CheriaClient;
+	
+	/* Embedded classes: */
+	public:
+	struct RemoteDeviceState:public DeviceState // Structure to represent remote devices and their states
+		{
+		/* Elements: */
+		public:
+		Vrui::InputDevice* device; // Pointer to local input device representing the remote device
+		
+		/* Constructors and destructors: */
+		RemoteDeviceState(IO::File& source); // Reads device state layout from the given source and creates local proxy device
+		~RemoteDeviceState(void); // Destroys local proxy device
+		};
+	
+	typedef Misc::HashTable<unsigned int,RemoteDeviceState*> RemoteDeviceMap; // Hash table to map remote device IDs to local input device pointers
+	typedef Misc::HashTable<unsigned int,Vrui::PointingTool*> RemoteToolMap; // Hash table to map remote device IDs to local pointing tool pointers
+	
+	/* Elements: */
+	private:
+	CheriaClient& client; // Cheria client object to which the remote client state belongs
+	RemoteDeviceMap remoteDevices; // Map of remote client's device IDs to local input devices
+	RemoteToolMap remoteTools; // Map of remote client's tool IDs to local tools
+	Threads::Mutex messageBufferMutex; // Mutex serializing access to the message buffer list
+	std::vector<CheriaClient::IncomingMessage*> messages; // List of buffers retaining server update messages between frame calls
+	
+	/* Constructors and destructors: */
+	CheriaClientRemoteClientState(CheriaClient& sClient);
+	virtual ~CheriaClientRemoteClientState(void);
+	
+	/* Methods: */
+	void processMessages(void); // Reads and processes all queued server update messages
 	};
 
 }
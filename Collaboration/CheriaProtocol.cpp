@@ -24,6 +24,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Collaboration/CheriaProtocol.h>
 
 #include <IO/File.h>
+#include <Collaboration/PoseCodec.h>
 
 namespace Collaboration {
 
@@ -36,6 +37,7 @@ CheriaProtocol::DeviceState::DeviceState(int sTrackType,unsigned int sNumButtons
 	 numButtons(sNumButtons),
 	 numValuators(sNumValuators),
 	 updateMask(NO_CHANGE),
+	 frameCenter(Point::origin),frameSize(1),
 	 rayDirection(0,1,0),rayStart(0),
 	 transform(ONTransform::identity),
 	 linearVelocity(Vector::zero),angularVelocity(Vector::zero),
@@ -56,6 +58,7 @@ CheriaProtocol::DeviceState::DeviceState(IO::File& source)
 	 numButtons(source.read<Card>()),
 	 numValuators(source.read<Card>()),
 	 updateMask(NO_CHANGE),
+	 frameCenter(CheriaProtocol::read<Point>(source)),frameSize(source.read<Scalar>()),
 	 rayDirection(0,1,0),rayStart(0),
 	 transform(ONTransform::identity),
 	 linearVelocity(Vector::zero),angularVelocity(Vector::zero),
@@ -81,6 +84,7 @@ void CheriaProtocol::DeviceState::skipLayout(IO::File& source)
 	{
 	source.skip<Misc::SInt32>(1);
 	source.skip<Card>(2);
+	source.skip<Scalar>(4);
 	}
 
 void CheriaProtocol::DeviceState::writeLayout(IO::File& sink) const
@@ -88,9 +92,11 @@ void CheriaProtocol::DeviceState::writeLayout(IO::File& sink) const
 	sink.write<Misc::SInt32>(trackType);
 	sink.write<Card>(numButtons);
 	sink.write<Card>(numValuators);
+	CheriaProtocol::write(frameCenter,sink);
+	sink.write<Scalar>(frameSize);
 	}
 
-void CheriaProtocol::DeviceState::read(IO::File& source)
+void CheriaProtocol::DeviceState::read(const PoseCodec& poseCodec,IO::File& source)
 	{
 	/* Read the update mask: */
 	unsigned int newUpdateMask=source.read<Byte>();
@@ -102,9 +108,9 @@ void CheriaProtocol::DeviceState::read(IO::File& source)
 		CheriaProtocol::read(rayStart,source);
 		}
 	
-	/* Read the device's position and orientation: */
+	/* Read the device's position and orientation relative to the client's environment: */
 	if(newUpdateMask&TRANSFORM)
-		CheriaProtocol::read(transform,source);
+		poseCodec.read(transform,frameCenter,frameSize,source);
 	
 	/* Read the device's linear and angular velocities: */
 	if(newUpdateMask&VELOCITY)
@@ -125,7 +131,7 @@ void CheriaProtocol::DeviceState::read(IO::File& source)
 	updateMask|=newUpdateMask;
 	}
 
-void CheriaProtocol::DeviceState::write(unsigned int writeUpdateMask,IO::File& sink) const
+void CheriaProtocol::DeviceState::write(unsigned int writeUpdateMask,const PoseCodec& poseCodec,IO::File& sink) const
 	{
 	/* Write the update mask: */
 	sink.write<Byte>(writeUpdateMask);
@@ -137,9 +143,9 @@ void CheriaProtocol::DeviceState::write(unsigned int writeUpdateMask,IO::File& s
 		CheriaProtocol::write(rayStart,sink);
 		}
 	
-	/* Write the device's position and orientation: */
+	/* Write the device's position and orientation relative to the client's environment: */
 	if(writeUpdateMask&TRANSFORM)
-		CheriaProtocol::write(transform,sink);
+		poseCodec.write(transform,frameCenter,frameSize,sink);
 	
 	/* Write the device's linear and angular velocities: */
 	if(writeUpdateMask&VELOCITY)
@@ -241,6 +247,6 @@ Static elements of class CheriaProtocol:
 ***************************************/
 
 const char* CheriaProtocol::protocolName="Cheria"; // How inventive
-const unsigned int CheriaProtocol::protocolVersion=(3U<<16)+0U; // Version 3.0
+const unsigned int CheriaProtocol::protocolVersion=(3U<<16)+1U; // Version 3.1
 
 }
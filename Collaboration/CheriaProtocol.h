@@ -27,6 +27,11 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <string>
 #include <Collaboration/Protocol.h>
 
+/* Forward declarations: */
+namespace Collaboration {
+class PoseCodec;
+}
+
 namespace Collaboration {
 
 class CheriaProtocol:public Protocol
@@ -64,6 +69,8 @@ class CheriaProtocol:public Protocol
 		unsigned int numButtons; // Number of buttons on the device
 		unsigned int numValuators; // Number of valuators on the device
 		unsigned int updateMask; // Cumulative update mask of this device state
+		Point frameCenter; // Center of the client's environment, relative to which the device's position is quantized
+		Scalar frameSize; // Size of the client's environment
 		Vector rayDirection; // Device's preferred ray direction in device space
 		Scalar rayStart; // Start parameter of device's ray
 		ONTransform transform; // Device's position and orientation in client's physical space
@@ -83,8 +90,8 @@ class CheriaProtocol:public Protocol
 		/* Methods: */
 		static void skipLayout(IO::File& source); // Skips a device layout transmitted on the given source
 		void writeLayout(IO::File& sink) const; // Writes device's layout to the given sink
-		void read(IO::File& source); // Reads device's state from the given source
-		void write(unsigned int writeUpdateMask,IO::File& sink) const; // Writes device's state to the given sink
+		void read(const PoseCodec& poseCodec,IO::File& source); // Reads device's state from the given source, with the device's position and orientation written by the given pose codec
+		void write(unsigned int writeUpdateMask,const PoseCodec& poseCodec,IO::File& sink) const; // Writes device's state to the given sink, with the device's position and orientation written by the given pose codec
 		};
 	
 	struct ToolState // Structure to exchange tool data between server and clients
@@ -28,28 +28,32 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #if DEBUGGING
 #include <iostream>
 #endif
+#include <algorithm>
 #include <Misc/ThrowStdErr.h>
 #include <Comm/NetPipe.h>
+#include <Collaboration/PoseCodec.h>
+#include <Collaboration/CollaborationServer.h>
 
 namespace Collaboration {
 
-/******************************************
-Methods of class CheriaServer::ClientState:
-******************************************/
+/****************************************
+Methods of class CheriaServerClientState:
+****************************************/
 
-CheriaServer::ClientState::ClientState(void)
-	:clientDevices(17),clientTools(17)
+CheriaServerClientState::CheriaServerClientState(void)
+	:clientDevices(17),clientTools(17),
+	 messageBuffer(&messageBuffers[0]),updateBuffer(&messageBuffers[1])
 	{
 	}
 
-CheriaServer::ClientState::~ClientState(void)
+CheriaServerClientState::~CheriaServerClientState(void)
 	{
 	/* Delete all device states: */
-	for(ClientDeviceMap::Iterator cdIt=clientDevices.begin();!cdIt.isFinished();++cdIt)
+	for(CheriaServer::ClientDeviceMap::Iterator cdIt=clientDevices.begin();!cdIt.isFinished();++cdIt)
 		delete cdIt->getDest();
 	
 	/* Delete all tool states: */
-	for(ClientToolMap::Iterator ctIt=clientTools.begin();!ctIt.isFinished();++ctIt)
+	for(CheriaServer::ClientToolMap::Iterator ctIt=clientTools.begin();!ctIt.isFinished();++ctIt)
 		delete ctIt->getDest();
 	}
 
@@ -75,6 +79,24 @@ unsigned int CheriaServer::getNumMessages(void) const
 	return MESSAGES_END;
 	}
 
+bool CheriaServer::hasDestinationIndependentConnect(void) const
+	{
+	/* Connect messages only carry the source client's devices and tools: */
+	return true;
+	}
+
+bool CheriaServer::hasThreadSafeClientHooks(void) const
+	{
+	/* Device state snapshots only touch the snapshotted client's state, and the server serializes connect messages per source client: */
+	return true;
+	}
+
+bool CheriaServer::hasBatchedServerUpdates(void) const
+	{
+	/* Accumulated state tracking messages are shared by all destination clients: */
+	return true;
+	}
+
 ProtocolServer::ClientState* CheriaServer::receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe)
 	{
 	#if DEBUGGING
@@ -96,7 +118,8 @@ ProtocolServer::ClientState* CheriaServer::receiveConnectRequest(unsigned int pr
 		{
 		/* Create the new client state object and set its message buffer's endianness: */
 		ClientState* result=new ClientState;
-		result->messageBuffer.setSwapOnWrite(pipe.mustSwapOnWrite());
+		for(int i=0;i<2;++i)
+			result->messageBuffers[i].setSwapOnWrite(pipe.mustSwapOnWrite());
 		
 		return result;
 		}
@@ -104,13 +127,16 @@ ProtocolServer::ClientState* CheriaServer::receiveConnectRequest(unsigned int pr
 		return 0;
 	}
 
-void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+void CheriaServer::sendConnectReply(ClientState* cs,Comm::NetPipe& pipe)
+	{
+	/* Tell the client the precision of the server's pose codec, which is shared by all clients because device states are forwarded verbatim: */
+	const PoseCodec& poseCodec=server->getPoseCodec();
+	pipe.write<Card>(poseCodec.getPositionBits());
+	pipe.write<Card>(poseCodec.getRotationBits());
+	}
+
+void CheriaServer::receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe)
 	{
-	/* Get a handle on the Cheria state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("CheriaServer::receiveClientUpdate: Client state object has mismatching type");
-	
 	/* Read all messages from the pipe: */
 	bool goOn=true;
 	while(goOn)
@@ -131,12 +157,12 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 				DeviceState* newDevice=new DeviceState(pipe);
 				
 				/* Store the new device in the client's device map: */
-				myCs->clientDevices[newDeviceId]=newDevice;
+				cs->clientDevices[newDeviceId]=newDevice;
 				
 				/* Append a creation message to the client's outgoing buffer: */
-				writeMessage(CREATE_DEVICE,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(newDeviceId);
-				newDevice->writeLayout(myCs->messageBuffer);
+				writeMessage(CREATE_DEVICE,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(newDeviceId);
+				newDevice->writeLayout(*cs->messageBuffer);
 				
 				#if DEBUGGING
 				std::cout<<" "<<newDevice->numButtons<<", "<<newDevice->numValuators<<std::endl<<std::flush;
@@ -155,17 +181,17 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 				#endif
 				
 				/* Erase the device from the client's device map: */
-				ClientDeviceMap::Iterator cdIt=myCs->clientDevices.findEntry(deviceId);
+				ClientDeviceMap::Iterator cdIt=cs->clientDevices.findEntry(deviceId);
 				if(!cdIt.isFinished())
 					{
 					/* Delete the device: */
 					delete cdIt->getDest();
-					myCs->clientDevices.removeEntry(cdIt);
+					cs->clientDevices.removeEntry(cdIt);
 					}
 				
 				/* Append the message to the client's outgoing buffer: */
-				writeMessage(DESTROY_DEVICE,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(deviceId);
+				writeMessage(DESTROY_DEVICE,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(deviceId);
 				
 				break;
 				}
@@ -183,12 +209,12 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 				ToolState* newTool=new ToolState(pipe);
 				
 				/* Store the new tool in the client's tool map: */
-				myCs->clientTools[newToolId]=newTool;
+				cs->clientTools[newToolId]=newTool;
 				
 				/* Append the message to the client's outgoing buffer: */
-				writeMessage(CREATE_TOOL,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(newToolId);
-				newTool->write(myCs->messageBuffer);
+				writeMessage(CREATE_TOOL,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(newToolId);
+				newTool->write(*cs->messageBuffer);
 				
 				#if DEBUGGING
 				std::cout<<" "<<newTool->numButtonSlots<<", "<<newTool->numValuatorSlots<<std::endl<<std::flush;
@@ -207,17 +233,17 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 				#endif
 				
 				/* Erase the tool from the client's tool map: */
-				ClientToolMap::Iterator ctIt=myCs->clientTools.findEntry(toolId);
+				ClientToolMap::Iterator ctIt=cs->clientTools.findEntry(toolId);
 				if(!ctIt.isFinished())
 					{
 					/* Delete the tool: */
 					delete ctIt->getDest();
-					myCs->clientTools.removeEntry(ctIt);
+					cs->clientTools.removeEntry(ctIt);
 					}
 				
 				/* Append the message to the client's outgoing buffer: */
-				writeMessage(DESTROY_TOOL,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(toolId);
+				writeMessage(DESTROY_TOOL,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(toolId);
 				
 				break;
 				}
@@ -229,7 +255,7 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 				while((deviceId=pipe.read<Card>())!=0)
 					{
 					/* Update the device state: */
-					myCs->clientDevices.getEntry(deviceId).getDest()->read(pipe);
+					cs->clientDevices.getEntry(deviceId).getDest()->read(server->getPoseCodec(),pipe);
 					}
 				
 				/* This is the last message: */
@@ -243,28 +269,23 @@ void CheriaServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::Net
 		}
 	}
 
-void CheriaServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void CheriaServer::sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get handles on the Cheria state objects: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	ClientState* myDestCs=dynamic_cast<ClientState*>(destCs);
-	if(mySourceCs==0||myDestCs==0)
-		Misc::throwStdErr("CheriaServer::sendClientConnect: Client state object has mismatching type");
-	
 	#if DEBUGGING
 	std::cout<<"CheriaServer::sendClientConnect..."<<std::flush;
 	#endif
 	
-	/* Create a temporary message buffer with the same endianness as the pipe's write end: */
-	MessageBuffer buffer;
+	/* Reset the source client's connect message buffer to the same endianness as the pipe's write end: */
+	MessageBuffer& buffer=sourceCs->connectBuffers[0];
+	buffer.clear();
 	buffer.setSwapOnWrite(pipe.mustSwapOnWrite());
 	
 	/*********************************************************************
-	Assemble the update message in the temporary buffer:
+	Assemble the update message in the connect message buffer:
 	*********************************************************************/
 	
 	/* Send creation messages for the source client's devices to the destination client: */
-	for(ClientDeviceMap::Iterator cdIt=mySourceCs->clientDevices.begin();!cdIt.isFinished();++cdIt)
+	for(ClientDeviceMap::Iterator cdIt=sourceCs->clientDevices.begin();!cdIt.isFinished();++cdIt)
 		{
 		writeMessage(CREATE_DEVICE,buffer);
 		buffer.write<Card>(cdIt->getSource());
@@ -272,7 +293,7 @@ void CheriaServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,Proto
 		}
 	
 	/* Send creation messages for the source client's tools to the destination client: */
-	for(ClientToolMap::Iterator ctIt=mySourceCs->clientTools.begin();!ctIt.isFinished();++ctIt)
+	for(ClientToolMap::Iterator ctIt=sourceCs->clientTools.begin();!ctIt.isFinished();++ctIt)
 		{
 		writeMessage(CREATE_TOOL,buffer);
 		buffer.write<Card>(ctIt->getSource());
@@ -281,11 +302,11 @@ void CheriaServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,Proto
 	
 	/* Send the current states of the source client's devices: */
 	writeMessage(DEVICE_STATES,buffer);
-	for(ClientDeviceMap::Iterator cdIt=mySourceCs->clientDevices.begin();!cdIt.isFinished();++cdIt)
+	for(ClientDeviceMap::Iterator cdIt=sourceCs->clientDevices.begin();!cdIt.isFinished();++cdIt)
 		{
 		/* Send a device state message: */
 		buffer.write<Card>(cdIt->getSource());
-		cdIt->getDest()->write(DeviceState::FULL_UPDATE,buffer);
+		cdIt->getDest()->write(DeviceState::FULL_UPDATE,server->getPoseCodec(),buffer);
 		}
 	buffer.write<Card>(0);
 	
@@ -297,29 +318,28 @@ void CheriaServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,Proto
 	std::cout<<" message size "<<buffer.getDataSize()<<std::endl;
 	#endif
 	
-	/* Write the message's total size first: */
-	pipe.write<Card>(buffer.getDataSize());
+	/* Prefix the message with its total size: */
+	MessageBuffer& payload=sourceCs->connectBuffers[1];
+	payload.clear();
+	payload.setSwapOnWrite(pipe.mustSwapOnWrite());
+	payload.write<Card>(buffer.getDataSize());
+	buffer.writeToSink(payload);
 	
-	/* Write the message itself: */
-	buffer.writeToSink(pipe);
+	/* Write the message, compressed if the client requested it: */
+	writeBulkPayload(destCs,payload,pipe);
 	}
 
-void CheriaServer::beforeServerUpdate(ProtocolServer::ClientState* cs)
+void CheriaServer::beforeServerUpdate(ClientState* cs)
 	{
-	/* Get a handle on the Cheria state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("CheriaServer::beforeServerUpdate: Client state object has mismatching type");
-	
 	/* Send the current states of the source client's managed input devices: */
-	writeMessage(DEVICE_STATES,myCs->messageBuffer);
-	for(ClientDeviceMap::Iterator cdIt=myCs->clientDevices.begin();!cdIt.isFinished();++cdIt)
+	writeMessage(DEVICE_STATES,*cs->messageBuffer);
+	for(ClientDeviceMap::Iterator cdIt=cs->clientDevices.begin();!cdIt.isFinished();++cdIt)
 		{
 		if(cdIt->getDest()->updateMask!=DeviceState::NO_CHANGE)
 			{
 			/* Send a device state message: */
-			myCs->messageBuffer.write<Card>(cdIt->getSource());
-			cdIt->getDest()->write(cdIt->getDest()->updateMask,myCs->messageBuffer);
+			cs->messageBuffer->write<Card>(cdIt->getSource());
+			cdIt->getDest()->write(cdIt->getDest()->updateMask,server->getPoseCodec(),*cs->messageBuffer);
 			
 			/* Reset the device's update mask: */
 			cdIt->getDest()->updateMask=DeviceState::NO_CHANGE;
@@ -327,38 +347,42 @@ void CheriaServer::beforeServerUpdate(ProtocolServer::ClientState* cs)
 		}
 	
 	/* Terminate the device state update message: */
-	myCs->messageBuffer.write<Card>(0);
+	cs->messageBuffer->write<Card>(0);
+	
+	/* Freeze the accumulated messages for this server update, and continue collecting messages in the other buffer: */
+	std::swap(cs->messageBuffer,cs->updateBuffer);
 	}
 
-void CheriaServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void CheriaServer::sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get handles on the Cheria state objects: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	ClientState* myDestCs=dynamic_cast<ClientState*>(destCs);
-	if(mySourceCs==0||myDestCs==0)
-		Misc::throwStdErr("CheriaServer::sendServerUpdate: Client state object has mismatching type");
-	
 	/*********************************************************************
 	Send the source client's accumulated state tracking messages to the
 	destination client:
 	*********************************************************************/
 	
 	/* Send the total size of the message first: */
-	pipe.write<Card>(mySourceCs->messageBuffer.getDataSize());
+	pipe.write<Card>(sourceCs->updateBuffer->getDataSize());
 	
 	/* Write the message itself: */
-	mySourceCs->messageBuffer.writeToSink(pipe);
+	sourceCs->updateBuffer->writeToSink(pipe);
 	}
 
-void CheriaServer::afterServerUpdate(ProtocolServer::ClientState* cs)
+void CheriaServer::sendServerUpdate(ClientState* sourceCs,ProtocolServer::ServerUpdateBatch& batch)
 	{
-	/* Get a handle on the Cheria state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("CheriaServer::afterServerUpdate: Client state object has mismatching type");
-	
-	/* Clear the client's message buffer: */
-	myCs->messageBuffer.clear();
+	/* Send the source client's accumulated state tracking messages once per endianness, shared by all destination clients: */
+	for(int swap=0;swap<2;++swap)
+		if(batch.needsSharedPayload(swap!=0))
+			{
+			IO::File& payload=batch.getSharedPayload(swap!=0);
+			payload.write<Card>(sourceCs->updateBuffer->getDataSize());
+			sourceCs->updateBuffer->writeToSink(payload);
+			}
+	}
+
+void CheriaServer::afterServerUpdate(ClientState* cs)
+	{
+	/* Clear the client's frozen message buffer: */
+	cs->updateBuffer->clear();
 	}
 
 }
@@ -26,33 +26,26 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Misc/HashTable.h>
 #include <IO/VariableMemoryFile.h>
-#include <Collaboration/ProtocolServer.h>
+#include <Collaboration/TypedProtocolServer.h>
 #include <Collaboration/CheriaProtocol.h>
 
+/* Forward declarations: */
+namespace Collaboration {
+class CheriaServerClientState;
+}
+
 namespace Collaboration {
 
-class CheriaServer:public ProtocolServer,private CheriaProtocol
+class CheriaServer:public TypedProtocolServer<CheriaServerClientState>,private CheriaProtocol
 	{
+	friend class CheriaServerClientState;
+	
 	/* Embedded classes: */
 	private:
 	typedef Misc::HashTable<unsigned int,DeviceState*> ClientDeviceMap; // Map from client device IDs to device states
 	typedef Misc::HashTable<unsigned int,ToolState*> ClientToolMap; // Map from client tool IDs to tool states
 	typedef IO::VariableMemoryFile MessageBuffer; // Buffer to hold outgoing messages from a client between two updates
-	
-	class ClientState:public ProtocolServer::ClientState
-		{
-		friend class CheriaServer;
-		
-		/* Elements: */
-		private:
-		ClientDeviceMap clientDevices; // Map of devices managed by the client
-		ClientToolMap clientTools; // Map of tools managed by the client
-		MessageBuffer messageBuffer; // Buffer for outgoing messages from this client
-		
-		/* Constructors and destructors: */
-		ClientState(void);
-		virtual ~ClientState(void);
-		};
+	typedef CheriaServerClientState ClientState; // Server-side state of a client sharing the Cheria protocol
 	
 	/* Constructors and destructors: */
 	public:
@@ -62,12 +55,37 @@ class CheriaServer:public ProtocolServer,private CheriaProtocol
 	/* Methods from ProtocolServer: */
 	virtual const char* getName(void) const;
 	virtual unsigned int getNumMessages(void) const;
+	virtual bool hasDestinationIndependentConnect(void) const;
+	virtual bool hasThreadSafeClientHooks(void) const;
+	virtual bool hasBatchedServerUpdates(void) const;
 	virtual ProtocolServer::ClientState* receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe);
-	virtual void receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
-	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void beforeServerUpdate(ProtocolServer::ClientState* cs);
-	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void afterServerUpdate(ProtocolServer::ClientState* cs);
+	
+	/* Methods from TypedProtocolServer: */
+	virtual void sendConnectReply(ClientState* cs,Comm::NetPipe& pipe);
+	virtual void receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe);
+	virtual void sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void beforeServerUpdate(ClientState* cs);
+	virtual void sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ClientState* sourceCs,ServerUpdateBatch& batch);
+	virtual void afterServerUpdate(ClientState* cs);
+	};
+
+class CheriaServerClientState:public ProtocolServer::ClientState // Class representing server-side state of a client sharing the Cheria protocol
+	{
+	friend class CheriaServer;
+	
+	/* Elements: */
+	private:
+	CheriaServer::ClientDeviceMap clientDevices; // Map of devices managed by the client
+	CheriaServer::ClientToolMap clientTools; // Map of tools managed by the client
+	CheriaServer::MessageBuffer messageBuffers[2]; // Pair of buffers for outgoing messages from this client
+	CheriaServer::MessageBuffer* messageBuffer; // Buffer collecting outgoing messages while receiving updates from this client
+	CheriaServer::MessageBuffer* updateBuffer; // Buffer holding the outgoing messages frozen for the current server update
+	CheriaServer::MessageBuffer connectBuffers[2]; // Buffers assembling the client's CLIENT_CONNECT message and its size-prefixed payload, reused for all destination clients
+	
+	/* Constructors and destructors: */
+	CheriaServerClientState(void);
+	virtual ~CheriaServerClientState(void);
 	};
 
 }
@@ -33,6 +33,8 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Misc/StandardValueCoders.h>
 #include <Misc/CompoundValueCoders.h>
 #include <Misc/StringMarshaller.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
 #include <Cluster/MulticastPipe.h>
 #include <Cluster/OpenPipe.h>
 #include <GL/gl.h>
@@ -98,6 +100,7 @@ Methods of class CollaborationClient::RemoteClientState:
 CollaborationClient::RemoteClientState::RemoteClientState(void)
 	:clientID(0),
 	 updateMask(ClientState::NO_CHANGE),
+	 poseValid(false),poseSequence(0),
 	 nameTextField(0),followToggle(0),faceToggle(0)
 	{
 	}
@@ -471,7 +474,7 @@ void* CollaborationClient::communicationThreadMethod(void)
 					/* Receive the new client's state: */
 					newClient->clientID=pipe->read<Card>();
 					ClientState& newState=newClient->state.startNewValue();
-					readClientState(newState,*pipe);
+					readClientState(newState,poseCodec,*pipe);
 					std::string newClientName=newState.clientName;
 					newClient->state.postNewValue();
 					
@@ -499,6 +502,13 @@ void* CollaborationClient::communicationThreadMethod(void)
 					/* Add the client to the private map: */
 					myClientMap[rcs->clientID]=rcs;
 					
+					if(datagramChannel!=0)
+						{
+						/* Let the datagram thread receive the client's poses: */
+						Threads::Mutex::Lock datagramClientMapLock(datagramClientMapMutex);
+						datagramClientMap[rcs->clientID]=rcs;
+						}
+					
 					{
 					/* Ask to have the new client added to the list: */
 					Threads::Mutex::Lock actionListLock(actionListMutex);
@@ -522,6 +532,13 @@ void* CollaborationClient::communicationThreadMethod(void)
 					/* Remove the client from the private map: */
 					myClientMap.removeEntry(clientID);
 					
+					if(datagramChannel!=0)
+						{
+						/* Stop the datagram thread from receiving the client's poses: */
+						Threads::Mutex::Lock datagramClientMapLock(datagramClientMapMutex);
+						datagramClientMap.removeEntry(clientID);
+						}
+					
 					{
 					/* Ask to have the client removed from the list: */
 					Threads::Mutex::Lock actionListLock(actionListMutex);
@@ -559,13 +576,19 @@ void* CollaborationClient::communicationThreadMethod(void)
 						RemoteClientState* client=myClientMap.getEntry(clientID).getDest();
 						
 						/* Read the client's transient state: */
+						{
+						Threads::Mutex::Lock stateLock(client->stateMutex);
 						ClientState& newState=client->state.startNewValue();
 						newState=client->state.getMostRecentValue();
 						newState.updateMask=ClientState::NO_CHANGE;
-						readClientState(newState,*pipe);
+						if(deltaStates)
+							StateDeltaCodec::readClientState(newState,client->deltaBaseline,*pipe);
+						else
+							readClientState(newState,poseCodec,*pipe);
 						client->updateMask|=newState.updateMask;
 						mustRefresh=mustRefresh||newState.updateMask!=ClientState::NO_CHANGE;
 						client->state.postNewValue();
+						}
 						
 						/* Process plug-in protocols shared with the remote client: */
 						for(RemoteClientState::RemoteClientProtocolList::const_iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
@@ -594,10 +617,10 @@ void* CollaborationClient::communicationThreadMethod(void)
 					Threads::Mutex::Lock pipeLock(pipeMutex);
 					writeMessage(CLIENT_UPDATE,*pipe);
 					
-					/* Send the local client state: */
+					/* Send the local client state, leaving out the pose once the server receives it by datagram: */
 					{
 					Threads::Spinlock::Lock clientStateLock(clientStateMutex);
-					writeClientState(clientState.updateMask,clientState,*pipe);
+					writeClientState(datagramsConfirmed?clientState.updateMask&~ClientState::POSE:clientState.updateMask,clientState,poseCodec,*pipe);
 					clientState.updateMask=ClientState::NO_CHANGE;
 					}
 					
@@ -657,6 +680,135 @@ void* CollaborationClient::communicationThreadMethod(void)
 	return 0;
 	}
 
+void* CollaborationClient::datagramThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	ClientState pose;
+	while(true)
+		{
+		/* Wait for the next datagram from the server: */
+		DatagramChannel::Address sender;
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> datagram;
+		try
+			{
+			datagram.setTarget(datagramChannel->receive(sender));
+			}
+		catch(std::runtime_error err)
+			{
+			std::cerr<<"Node "<<Vrui::getNodeIndex()<<": "<<"CollaborationClient: Terminating datagram thread due to exception "<<err.what()<<std::endl<<std::flush;
+			break;
+			}
+		
+		bool mustRefresh=false;
+		try
+			{
+			/* Read the datagram's header and drop unauthenticated datagrams: */
+			if(datagram->read<Card>()!=datagramToken)
+				continue;
+			unsigned int sequence=datagram->read<Card>();
+			
+			/* The server only sends poses once it receives the local client's datagrams: */
+			datagramsConfirmed=true;
+			
+			/* Read all poses contained in the datagram: */
+			while(!datagram->eof())
+				{
+				unsigned int clientID=datagram->read<Card>();
+				readPose(pose,*datagram);
+				
+				/* Find the client while holding the map lock, so the client cannot be deleted while its pose is posted: */
+				Threads::Mutex::Lock datagramClientMapLock(datagramClientMapMutex);
+				RemoteClientMap::Iterator cmIt=datagramClientMap.findEntry(clientID);
+				if(cmIt.isFinished())
+					continue;
+				RemoteClientState* client=cmIt->getDest();
+				
+				/* Drop poses that arrive after a newer one: */
+				if(client->poseValid&&int(sequence-client->poseSequence)<=0)
+					continue;
+				client->poseValid=true;
+				client->poseSequence=sequence;
+				
+				/* Apply the pose over the client's most recent state, unless its number of viewers changed since: */
+				Threads::Mutex::Lock stateLock(client->stateMutex);
+				ClientState& newState=client->state.startNewValue();
+				newState=client->state.getMostRecentValue();
+				if(applyPose(pose,newState))
+					{
+					newState.updateMask=ClientState::POSE;
+					client->updateMask|=ClientState::POSE;
+					mustRefresh=true;
+					}
+				client->state.postNewValue();
+				}
+			}
+		catch(std::runtime_error err)
+			{
+			/* Ignore the rest of malformed datagrams: */
+			}
+		
+		/* Wake up the main program if anything changed: */
+		if(mustRefresh)
+			Vrui::requestUpdate();
+		}
+	
+	return 0;
+	}
+
+void CollaborationClient::stopDatagrams(void)
+	{
+	if(datagramChannel!=0)
+		{
+		/* Stop the datagram thread and close the datagram channel: */
+		datagramThread.cancel();
+		datagramThread.join();
+		delete datagramChannel;
+		datagramChannel=0;
+		datagramClientMap.clear();
+		datagramsConfirmed=false;
+		}
+	}
+
+void CollaborationClient::sendPoseDatagram(void)
+	{
+	/* Send the pose if it changed, or to keep the server's copy alive, but not more often than the configured interval: */
+	double now=Vrui::getApplicationTime();
+	double elapsed=now-lastDatagramTime;
+	if(elapsed<datagramInterval)
+		{
+		/* Come back when the interval is over: */
+		if(posePending)
+			Vrui::scheduleUpdate(lastDatagramTime+datagramInterval);
+		return;
+		}
+	if(!posePending&&elapsed<1.0)
+		return;
+	
+	/* Assemble the datagram: */
+	Misc::SelfDestructPointer<IO::VariableMemoryFile> datagram(DatagramChannel::createDatagram());
+	datagram->write<Card>(datagramClientID);
+	datagram->write<Card>(datagramToken);
+	datagram->write<Card>(++datagramSequence);
+	{
+	Threads::Spinlock::Lock clientStateLock(clientStateMutex);
+	writePose(clientState,*datagram);
+	}
+	
+	/* Send the datagram: */
+	try
+		{
+		datagramChannel->send(*datagram);
+		}
+	catch(std::runtime_error err)
+		{
+		/* Ignore the error; the pose is still sent over the pipe until the server confirms receiving datagrams: */
+		}
+	posePending=false;
+	lastDatagramTime=now;
+	}
+
 void CollaborationClient::updateClientState(void)
 	{
 	/* Update the physical environment: */
@@ -706,7 +858,12 @@ CollaborationClient::CollaborationClient(CollaborationClient::Configuration* sCo
 	:configuration(sConfiguration!=0?sConfiguration:new Configuration),
 	 protocolLoader(configuration->cfg.retrieveString("./pluginDsoNameTemplate",COLLABORATION_PLUGINDSONAMETEMPLATE)),
 	 disconnect(false),
+	 deltaStates(false),
 	 remoteClientMap(17),protocolClientMap(31),
+	 datagramChannel(0),datagramClientID(0),datagramToken(0),datagramSequence(0),
+	 datagramInterval(configuration->cfg.retrieveValue<double>("./datagramInterval",0.02)),
+	 lastDatagramTime(0.0),posePending(false),datagramsConfirmed(false),
+	 datagramClientMap(17),
 	 followClientID(0),faceClientID(0),
 	 clientDialogPopup(0),showSettingsToggle(0),clientListRowColumn(0),
 	 settingsDialogPopup(0),
@@ -818,6 +975,9 @@ CollaborationClient::~CollaborationClient(void)
 		/* Wait until the communication thread receives the disconnect reply and terminates: */
 		communicationThread.join();
 		
+		/* Stop exchanging poses by datagram: */
+		stopDatagrams();
+		
 		/* Close the pipe: */
 		pipe=0;
 		}
@@ -892,6 +1052,26 @@ void CollaborationClient::registerProtocol(ProtocolClient* newProtocol)
 
 void CollaborationClient::connect(void)
 	{
+	/* Get the name of the session to join: */
+	std::string sessionName=configuration->cfg.retrieveString("./sessionName","");
+	
+	/* Only exchange poses by datagram if the client is not a cluster, whose nodes cannot share a UDP socket: */
+	bool useDatagrams=configuration->cfg.retrieveValue<bool>("./useDatagrams",false)&&Vrui::getClusterMultiplexer()==0;
+	unsigned int datagramIndex=protocols.size()+(sessionName.empty()?0:1);
+	
+	/* Ask for server updates encoded as differences against previous states: */
+	bool useDeltaStates=configuration->cfg.retrieveValue<bool>("./useDeltaStates",false);
+	unsigned int deltaIndex=datagramIndex+(useDatagrams?1:0);
+	
+	/* Offer to exchange poses in quantized form if the server supports it: */
+	bool useQuantizedPoses=configuration->cfg.retrieveValue<bool>("./useQuantizedPoses",false);
+	unsigned int quantizedPosesIndex=deltaIndex+(useDeltaStates?1:0);
+	
+	/* Ask for large protocol payloads, such as session snapshots sent on joining, in compression envelopes: */
+	bool useCompression=configuration->cfg.retrieveValue<bool>("./useCompression",false);
+	unsigned int compressionIndex=quantizedPosesIndex+(useQuantizedPoses?1:0);
+	bool compressPayloads=false;
+	
 	{
 	Threads::Mutex::Lock pipeLock(pipeMutex);
 	
@@ -925,7 +1105,7 @@ void CollaborationClient::connect(void)
 	#ifdef VERBOSE
 	std::cout<<"Node "<<Vrui::getNodeIndex()<<": "<<"Requesting protocols";
 	#endif
-	pipe->write<Card>(protocols.size());
+	pipe->write<Card>(compressionIndex+(useCompression?1:0));
 	for(ProtocolList::iterator pIt=protocols.begin();pIt!=protocols.end();++pIt)
 		{
 		/* Write the protocol name: */
@@ -938,6 +1118,57 @@ void CollaborationClient::connect(void)
 		/* Write the protocol's message payload (protocol writes length first): */
 		(*pIt)->sendConnectRequest(*pipe);
 		}
+	if(!sessionName.empty())
+		{
+		/* Request to join a named session in a reserved entry after all protocols, so servers without session support skip it: */
+		write(std::string(sessionProtocolName),*pipe);
+		pipe->write<Card>(sessionName.size());
+		pipe->write<char>(sessionName.data(),sessionName.size());
+		
+		#ifdef VERBOSE
+		std::cout<<" (session "<<sessionName<<')';
+		#endif
+		}
+	if(useDatagrams)
+		{
+		/* Request to exchange poses by datagram in another reserved entry: */
+		write(std::string(datagramProtocolName),*pipe);
+		pipe->write<Card>(0);
+		
+		#ifdef VERBOSE
+		std::cout<<" (datagrams)";
+		#endif
+		}
+	if(useDeltaStates)
+		{
+		/* Request delta-encoded server updates in another reserved entry: */
+		write(std::string(deltaProtocolName),*pipe);
+		pipe->write<Card>(0);
+		
+		#ifdef VERBOSE
+		std::cout<<" (delta states)";
+		#endif
+		}
+	if(useQuantizedPoses)
+		{
+		/* Offer quantized poses in another reserved entry: */
+		write(std::string(quantizedPosesProtocolName),*pipe);
+		pipe->write<Card>(0);
+		
+		#ifdef VERBOSE
+		std::cout<<" (quantized poses)";
+		#endif
+		}
+	if(useCompression)
+		{
+		/* Request compressed bulk payloads in another reserved entry: */
+		write(std::string(compressionProtocolName),*pipe);
+		pipe->write<Card>(0);
+		
+		#ifdef VERBOSE
+		std::cout<<" (compression)";
+		#endif
+		}
 	#ifdef VERBOSE
 	std::cout<<std::endl;
 	#endif
@@ -1001,6 +1232,66 @@ void CollaborationClient::connect(void)
 		/* Read the protocol index: */
 		unsigned int protocolIndex=pipe->read<Card>();
 		
+		if(useDatagrams&&protocolIndex==datagramIndex)
+			{
+			/* Read the server's datagram port and the credentials for the local client's datagrams: */
+			pipe->read<Card>();
+			int datagramPortId=int(pipe->read<Card>());
+			datagramClientID=pipe->read<Card>();
+			datagramToken=pipe->read<Card>();
+			
+			/* Open a datagram channel to the server: */
+			try
+				{
+				datagramChannel=new DatagramChannel(-1);
+				datagramChannel->connect(configuration->cfg.retrieveString("./serverHostName").c_str(),datagramPortId);
+				datagramChannel->setLossRate(configuration->cfg.retrieveValue<double>("./datagramLossRate",0.0));
+				}
+			catch(std::runtime_error err)
+				{
+				/* Fall back to sending poses over the pipe: */
+				std::cerr<<"Node "<<Vrui::getNodeIndex()<<": "<<"CollaborationClient: Unable to exchange poses by datagram due to exception "<<err.what()<<std::endl<<std::flush;
+				delete datagramChannel;
+				datagramChannel=0;
+				}
+			
+			#ifdef VERBOSE
+			if(datagramChannel!=0)
+				std::cout<<"Node "<<Vrui::getNodeIndex()<<": "<<"Exchanging poses by datagram with server port "<<datagramPortId<<std::endl;
+			#endif
+			continue;
+			}
+		
+		if(useDeltaStates&&protocolIndex==deltaIndex)
+			{
+			/* Decode other clients' state updates as differences from now on: */
+			pipe->read<Card>();
+			deltaStates=true;
+			continue;
+			}
+		
+		if(useQuantizedPoses&&protocolIndex==quantizedPosesIndex)
+			{
+			/* Exchange poses with the precision chosen by the server from now on: */
+			pipe->read<Card>();
+			unsigned int positionBits=pipe->read<Card>();
+			unsigned int rotationBits=pipe->read<Card>();
+			poseCodec=PoseCodec(positionBits,rotationBits);
+			
+			#ifdef VERBOSE
+			std::cout<<"Node "<<Vrui::getNodeIndex()<<": "<<"Exchanging quantized poses with "<<positionBits<<" position bits and "<<rotationBits<<" rotation bits"<<std::endl;
+			#endif
+			continue;
+			}
+		
+		if(useCompression&&protocolIndex==compressionIndex)
+			{
+			/* Expect bulk payloads of all negotiated protocols in compression envelopes from now on: */
+			pipe->read<Card>();
+			compressPayloads=true;
+			continue;
+			}
+		
 		/* Move the protocol plug-in from the original list to the negotiated list: */
 		ProtocolClient* protocol=protocols[protocolIndex];
 		negotiatedProtocols.push_back(protocol);
@@ -1034,6 +1325,8 @@ void CollaborationClient::connect(void)
 	
 	/* Store the list of negotiated protocols: */
 	protocols=negotiatedProtocols;
+	for(ProtocolList::iterator pIt=protocols.begin();pIt!=protocols.end();++pIt)
+		(*pIt)->compressPayloads=compressPayloads;
 	
 	/* Process higher-level protocols: */
 	receiveConnectReply();
@@ -1041,6 +1334,10 @@ void CollaborationClient::connect(void)
 	/* Start server communication thread: */
 	communicationThread.start(this,&CollaborationClient::communicationThreadMethod);
 	
+	/* Start receiving other clients' poses by datagram: */
+	if(datagramChannel!=0)
+		datagramThread.start(this,&CollaborationClient::datagramThreadMethod);
+	
 	/* Create the client's user interface: */
 	createClientDialog();
 	createSettingsDialog();
@@ -1120,6 +1417,9 @@ void CollaborationClient::frame(void)
 			communicationThread.join();
 			}
 		
+		/* Stop exchanging poses by datagram: */
+		stopDatagrams();
+		
 		/* Disconnect all remote clients: */
 		{
 		Threads::Mutex::Lock actionListLock(actionListMutex);
@@ -1245,9 +1545,18 @@ void CollaborationClient::frame(void)
 	/* Update the local client state structure: */
 	{
 	Threads::Spinlock::Lock clientStateLock(clientStateMutex);
+	unsigned int oldUpdateMask=clientState.updateMask;
+	clientState.updateMask=ClientState::NO_CHANGE;
 	updateClientState();
+	if(clientState.updateMask&ClientState::POSE)
+		posePending=true;
+	clientState.updateMask|=oldUpdateMask;
 	}
 	
+	/* Send the local client's pose by datagram: */
+	if(datagramChannel!=0)
+		sendPoseDatagram();
+	
 	/* Update all remote clients' states: */
 	for(RemoteClientMap::Iterator cmIt=remoteClientMap.begin();!cmIt.isFinished();++cmIt)
 		{
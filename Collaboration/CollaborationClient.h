@@ -40,6 +40,9 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/GlyphRenderer.h>
 #include <Collaboration/ProtocolClient.h>
 #include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/DatagramChannel.h>
+#include <Collaboration/StateDeltaCodec.h>
+#include <Collaboration/PoseCodec.h>
 
 /* Forward declarations: */
 class GLContextData;
@@ -102,8 +105,12 @@ class CollaborationClient:private CollaborationProtocol
 		public:
 		unsigned int clientID; // Server-wide unique client ID
 		RemoteClientProtocolList protocols; // List of protocols and protocol states shared with this client
+		Threads::Mutex stateMutex; // Mutex serializing the threads posting new transient client states
 		Threads::TripleBuffer<ClientState> state; // Transient client state
 		volatile unsigned int updateMask; // Accumulated update mask from recent server updates
+		bool poseValid; // Flag whether a pose was received by datagram; only accessed by the datagram thread
+		unsigned int poseSequence; // Server update counter of the most recent pose received by datagram; only accessed by the datagram thread
+		StateDeltaCodec::Baseline deltaBaseline; // Client state most recently received in a server update encoded as differences; only accessed by the communication thread
 		GLMotif::TextField* nameTextField; // Pointer to display name text field for this client
 		GLMotif::ToggleButton* followToggle; // Pointer to "follow" toggle button for this client
 		GLMotif::ToggleButton* faceToggle; // Pointer to "face" toggle button for this client
@@ -150,6 +157,8 @@ class CollaborationClient:private CollaborationProtocol
 	Threads::Thread communicationThread; // Thread handling communication with the collaboration server
 	ProtocolList protocols; // List of protocols currently registered with the server
 	std::vector<ProtocolClient*> messageTable; // Table mapping from message IDs to the protocol engines handling them
+	bool deltaStates; // Flag whether the server sends other clients' state updates as differences against previous states
+	PoseCodec poseCodec; // Codec for viewer states and navigation transformations exchanged with the server after connecting
 	
 	/* Lists keeping track of persistent state of remote clients: */
 	Threads::Mutex actionListMutex; // Mutex protecting the client action list
@@ -158,6 +167,19 @@ class CollaborationClient:private CollaborationProtocol
 	RemoteClientMap remoteClientMap; // Hash table mapping from client IDs to remote client state structures
 	ProtocolClientMap protocolClientMap; // Hash table mapping from per-protocol client state structures to remote client state structures
 	
+	/* Pose exchange by datagram: */
+	DatagramChannel* datagramChannel; // UDP channel exchanging poses with the server, or 0 if poses are only sent over the pipe
+	Threads::Thread datagramThread; // Thread receiving other clients' poses by datagram
+	unsigned int datagramClientID; // The local client's ID, authenticating its datagrams to the server
+	unsigned int datagramToken; // Random number assigned by the server, authenticating datagrams in both directions
+	unsigned int datagramSequence; // Sequence number of the most recently sent datagram
+	double datagramInterval; // Minimum time between sending pose datagrams in seconds
+	double lastDatagramTime; // Application time at which the most recent pose datagram was sent
+	bool posePending; // Flag whether the local pose changed since the most recent pose datagram was sent
+	volatile bool datagramsConfirmed; // Flag whether the server sent poses by datagram, i.e., whether it receives the local client's datagrams
+	Threads::Mutex datagramClientMapMutex; // Mutex protecting the datagram thread's client hash table
+	RemoteClientMap datagramClientMap; // Hash table mapping from client IDs to remote client state structures for the datagram thread
+	
 	/* Local client state: */
 	Threads::Spinlock clientStateMutex; // Mutex protecting the local client state
 	ClientState clientState; // Transient state of local client
@@ -189,6 +211,9 @@ class CollaborationClient:private CollaborationProtocol
 	void settingsDialogCloseCallback(Misc::CallbackData* cbData);
 	void* communicationThreadMethod(void); // Method for thread receiving messages from the collaboration server
 	void* serverUpdateThreadMethod(void); // Method for thread sending client state updates to the collaboration server
+	void* datagramThreadMethod(void); // Method for thread receiving other clients' poses from the collaboration server by datagram
+	void stopDatagrams(void); // Stops exchanging poses by datagram
+	void sendPoseDatagram(void); // Sends the local client's pose to the collaboration server by datagram if it changed
 	void updateClientState(void); // Updates the local client state from current Vrui state
 	
 	/* Constructors and destructors: */
@@ -23,10 +23,23 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Collaboration/CollaborationProtocol.h>
 
+#include <Misc/ThrowStdErr.h>
 #include <IO/File.h>
+#include <Collaboration/PoseCodec.h>
 
 namespace Collaboration {
 
+/**********************************************
+Static elements of class CollaborationProtocol:
+**********************************************/
+
+const char* CollaborationProtocol::sessionProtocolName="Session";
+const char* CollaborationProtocol::relayProtocolName="Relay";
+const char* CollaborationProtocol::datagramProtocolName="Datagram";
+const char* CollaborationProtocol::deltaProtocolName="Delta";
+const char* CollaborationProtocol::quantizedPosesProtocolName="QuantizedPoses";
+const char* CollaborationProtocol::compressionProtocolName="Compression";
+
 /***************************************************
 Methods of class CollaborationProtocol::ClientState:
 ***************************************************/
@@ -99,6 +112,18 @@ Methods of class CollaborationProtocol:
 **************************************/
 
 void CollaborationProtocol::readClientState(CollaborationProtocol::ClientState& clientState,IO::File& source)
+	{
+	/* Read the update with a codec using raw scalars: */
+	readClientState(clientState,PoseCodec(),source);
+	}
+
+void CollaborationProtocol::writeClientState(unsigned int updateMask,const CollaborationProtocol::ClientState& clientState,IO::File& sink)
+	{
+	/* Write the update with a codec using raw scalars: */
+	writeClientState(updateMask,clientState,PoseCodec(),sink);
+	}
+
+void CollaborationProtocol::readClientState(CollaborationProtocol::ClientState& clientState,const PoseCodec& poseCodec,IO::File& source)
 	{
 	/* Read this update's update mask: */
 	unsigned int newUpdateMask=source.read<Byte>();
@@ -129,22 +154,22 @@ void CollaborationProtocol::readClientState(CollaborationProtocol::ClientState&
 	
 	if(newUpdateMask&ClientState::VIEWER)
 		{
-		/* Read the client's viewer states: */
+		/* Read the client's viewer states relative to the client's environment: */
 		for(unsigned int i=0;i<clientState.numViewers;++i)
-			read(clientState.viewerStates[i],source);
+			poseCodec.read(clientState.viewerStates[i],clientState.displayCenter,clientState.displaySize,source);
 		}
 	
 	if(newUpdateMask&&ClientState::NAVTRANSFORM)
 		{
 		/* Read the navigation transformation: */
-		read(clientState.navTransform,source);
+		poseCodec.read(clientState.navTransform,source);
 		}
 	
 	/* Update the client state's update mask: */
 	clientState.updateMask|=newUpdateMask;
 	}
 
-void CollaborationProtocol::writeClientState(unsigned int updateMask,const CollaborationProtocol::ClientState& clientState,IO::File& sink)
+void CollaborationProtocol::writeClientState(unsigned int updateMask,const CollaborationProtocol::ClientState& clientState,const PoseCodec& poseCodec,IO::File& sink)
 	{
 	/* Write the update mask: */
 	sink.write<Byte>(updateMask);
@@ -174,16 +199,53 @@ void CollaborationProtocol::writeClientState(unsigned int updateMask,const Colla
 	
 	if(updateMask&ClientState::VIEWER)
 		{
-		/* Write the client's viewer states: */
+		/* Write the client's viewer states relative to the client's environment: */
 		for(unsigned int i=0;i<clientState.numViewers;++i)
-			write(clientState.viewerStates[i],sink);
+			poseCodec.write(clientState.viewerStates[i],clientState.displayCenter,clientState.displaySize,sink);
 		}
 	
 	if(updateMask&&ClientState::NAVTRANSFORM)
 		{
 		/* Write the navigation transformation: */
-		write(clientState.navTransform,sink);
+		poseCodec.write(clientState.navTransform,sink);
 		}
 	}
 
+void CollaborationProtocol::readPose(CollaborationProtocol::ClientState& pose,IO::File& source)
+	{
+	/* Read the number of viewers and resize the pose buffer; a datagram cannot hold more than a few dozen viewers: */
+	unsigned int numViewers=source.read<Card>();
+	if(numViewers>64)
+		Misc::throwStdErr("CollaborationProtocol::readPose: Invalid number of viewers %u",numViewers);
+	pose.resize(numViewers);
+	
+	/* Read the viewer states and the navigation transformation: */
+	for(unsigned int i=0;i<numViewers;++i)
+		read(pose.viewerStates[i],source);
+	read(pose.navTransform,source);
+	}
+
+void CollaborationProtocol::writePose(const CollaborationProtocol::ClientState& clientState,IO::File& sink)
+	{
+	/* Write the number of viewers, the viewer states, and the navigation transformation: */
+	sink.write<Card>(clientState.numViewers);
+	for(unsigned int i=0;i<clientState.numViewers;++i)
+		write(clientState.viewerStates[i],sink);
+	write(clientState.navTransform,sink);
+	}
+
+bool CollaborationProtocol::applyPose(const CollaborationProtocol::ClientState& pose,CollaborationProtocol::ClientState& clientState)
+	{
+	/* Ignore poses with a different number of viewers; the client state will be resized by a reliable update: */
+	if(pose.numViewers!=clientState.numViewers)
+		return false;
+	
+	/* Copy the viewer states and the navigation transformation: */
+	for(unsigned int i=0;i<pose.numViewers;++i)
+		clientState.viewerStates[i]=pose.viewerStates[i];
+	clientState.navTransform=pose.navTransform;
+	
+	return true;
+	}
+
 }
@@ -32,6 +32,9 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 namespace IO {
 class File;
 }
+namespace Collaboration {
+class PoseCodec;
+}
 
 namespace Collaboration {
 
@@ -67,7 +70,8 @@ class CollaborationProtocol:public Protocol
 			NUM_VIEWERS=0x4,   // The number of viewers changed
 			VIEWER=0x8,        // Any viewer changed position and/or orientation
 			NAVTRANSFORM=0x10, // The navigation transformation changed
-			FULL_UPDATE=0x1f   // Full initialization
+			FULL_UPDATE=0x1f,  // Full initialization
+			POSE=0x18		  // Parts of the client state that can be sent by datagram
 			};
 		
 		/* Elements: */
@@ -102,9 +106,22 @@ class CollaborationProtocol:public Protocol
 		bool resize(unsigned int newNumViewers); // Re-allocates the viewer state array; returns true if size changed
 		};
 	
+	/* Elements: */
+	static const char* sessionProtocolName; // Name of the reserved protocol list entry in which a client sends the name of the session it wants to join
+	static const char* relayProtocolName; // Name of the reserved protocol list entry with which a relay requests to open a relay link
+	static const char* datagramProtocolName; // Name of the reserved protocol list entry with which a client requests to exchange transient state over UDP
+	static const char* deltaProtocolName; // Name of the reserved protocol list entry with which a client requests server updates encoded as differences against previous states
+	static const char* quantizedPosesProtocolName; // Name of the reserved protocol list entry with which a client requests viewer states and navigation transformations in quantized form
+	static const char* compressionProtocolName; // Name of the reserved protocol list entry with which a client requests bulk protocol payloads in compression envelopes
+	
 	/* Methods: */
 	static void readClientState(ClientState& clientState,IO::File& source); // Reads client state update from the given source
 	static void writeClientState(unsigned int updateMask,const ClientState& clientState,IO::File& sink); // Writes client state update to the given sink using the specific state update mask
+	static void readClientState(ClientState& clientState,const PoseCodec& poseCodec,IO::File& source); // Reads client state update with viewer states and navigation transformation written by the given pose codec
+	static void writeClientState(unsigned int updateMask,const ClientState& clientState,const PoseCodec& poseCodec,IO::File& sink); // Writes client state update with viewer states and navigation transformation written by the given pose codec
+	static void readPose(ClientState& pose,IO::File& source); // Reads the viewer states and navigation transformation sent in a datagram into a client state used as pose buffer
+	static void writePose(const ClientState& clientState,IO::File& sink); // Writes the viewer states and navigation transformation to be sent in a datagram
+	static bool applyPose(const ClientState& pose,ClientState& clientState); // Copies the viewer states and navigation transformation from a pose buffer; returns false and leaves the client state unchanged if the numbers of viewers do not match
 	};
 
 }
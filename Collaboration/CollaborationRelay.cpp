@@ -0,0 +1,117 @@
+/***********************************************************************
+CollaborationRelay - Class to relay all clients connecting to a local
+port to an upstream collaboration server over a single relay link.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/CollaborationRelay.h>
+
+#include <iostream>
+#include <stdexcept>
+#include <Misc/ThrowStdErr.h>
+#include <Comm/TCPPipe.h>
+#include <Collaboration/RelayLink.h>
+
+namespace Collaboration {
+
+/***********************************
+Methods of class CollaborationRelay:
+***********************************/
+
+void* CollaborationRelay::listenThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next local client: */
+		Comm::NetPipePtr clientPipe=new Comm::TCPPipe(listenSocket);
+		
+		try
+			{
+			#ifdef VERBOSE
+			std::cout<<"CollaborationRelay: Relaying client from host "<<clientPipe->getPeerHostName()<<", port "<<clientPipe->getPeerPortId()<<std::endl<<std::flush;
+			#endif
+			
+			/* Relay the client without interpreting its data; the upstream server negotiates endianness with the client: */
+			link->openChannel(clientPipe);
+			}
+		catch(std::runtime_error err)
+			{
+			std::cerr<<"CollaborationRelay: Cancelled relaying new client due to exception "<<err.what()<<std::endl<<std::flush;
+			}
+		}
+	
+	return 0;
+	}
+
+CollaborationRelay::CollaborationRelay(int listenPortId,const char* upstreamHostName,int upstreamPortId,double sSendTimeout)
+	:listenSocket(listenPortId,0),
+	 sendTimeout(sSendTimeout),
+	 link(0)
+	{
+	/* Connect to the upstream server: */
+	Comm::NetPipePtr upstreamPipe=new Comm::TCPPipe(upstreamHostName,upstreamPortId);
+	upstreamPipe->negotiateEndianness();
+	
+	/* Request a relay link by sending a connect request containing only the reserved relay entry: */
+	writeMessage(CONNECT_REQUEST,*upstreamPipe);
+	ClientState relayState;
+	relayState.clientName="Relay";
+	writeClientState(ClientState::FULL_UPDATE,relayState,*upstreamPipe);
+	upstreamPipe->write<Card>(1);
+	write(std::string(relayProtocolName),*upstreamPipe);
+	upstreamPipe->write<Card>(0);
+	upstreamPipe->flush();
+	
+	/* Check that the upstream server accepted the relay entry: */
+	if(readMessage(*upstreamPipe)!=CONNECT_REPLY)
+		Misc::throwStdErr("CollaborationRelay::CollaborationRelay: Relay link refused by upstream server");
+	unsigned int numNegotiatedProtocols=upstreamPipe->read<Card>();
+	if(numNegotiatedProtocols!=1||upstreamPipe->read<Card>()!=0)
+		Misc::throwStdErr("CollaborationRelay::CollaborationRelay: Upstream server does not support relay links");
+	upstreamPipe->read<Card>();
+	
+	#ifdef VERBOSE
+	std::cout<<"CollaborationRelay: Opened relay link to server "<<upstreamHostName<<", port "<<upstreamPortId<<std::endl<<std::flush;
+	#endif
+	
+	/* Start relaying: */
+	link=new RelayLink(upstreamPipe,sendTimeout);
+	listenThread.start(this,&CollaborationRelay::listenThreadMethod);
+	}
+
+CollaborationRelay::~CollaborationRelay(void)
+	{
+	/* Stop accepting clients: */
+	listenThread.cancel();
+	listenThread.join();
+	
+	/* Close the relay link and all relayed client connections: */
+	delete link;
+	}
+
+bool CollaborationRelay::isConnected(void) const
+	{
+	return !link->isFinished();
+	}
+
+}
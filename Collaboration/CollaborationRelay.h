@@ -0,0 +1,67 @@
+/***********************************************************************
+CollaborationRelay - Class to relay all clients connecting to a local
+port to an upstream collaboration server over a single relay link.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_COLLABORATIONRELAY_INCLUDED
+#define COLLABORATION_COLLABORATIONRELAY_INCLUDED
+
+#include <string>
+#include <Threads/Thread.h>
+#include <Comm/ListeningTCPSocket.h>
+#include <Comm/NetPipe.h>
+#include <Collaboration/CollaborationProtocol.h>
+
+/* Forward declarations: */
+namespace Collaboration {
+class RelayLink;
+}
+
+namespace Collaboration {
+
+class CollaborationRelay:private CollaborationProtocol
+	{
+	/* Elements: */
+	private:
+	Comm::ListeningTCPSocket listenSocket; // Socket receiving connection requests from local clients
+	double sendTimeout; // Maximum time in seconds the relay waits for a local client to accept data before the client is disconnected
+	RelayLink* link; // Relay link to the upstream server
+	Threads::Thread listenThread; // Thread accepting local clients
+	
+	/* Private methods: */
+	void* listenThreadMethod(void); // Method for thread accepting local clients
+	
+	/* Constructors and destructors: */
+	public:
+	CollaborationRelay(int listenPortId,const char* upstreamHostName,int upstreamPortId,double sSendTimeout); // Connects to the given upstream server and relays clients connecting to the given local port
+	~CollaborationRelay(void);
+	
+	/* Methods: */
+	int getListenPortId(void) const // Returns the port ID the relay listens on
+		{
+		return listenSocket.getPortId();
+		}
+	bool isConnected(void) const; // Returns true while the relay link to the upstream server is intact
+	};
+
+}
+
+#endif
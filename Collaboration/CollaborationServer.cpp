@@ -24,15 +24,92 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Collaboration/CollaborationServer.h>
 
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/time.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <netinet/in.h>
+#include <netdb.h>
 #include <iostream>
+#include <sstream>
+#include <stdexcept>
 #include <algorithm>
 #include <Misc/ThrowStdErr.h>
+#include <Misc/SelfDestructPointer.h>
 #include <Misc/StandardValueCoders.h>
 #include <Misc/CompoundValueCoders.h>
+#include <IO/FixedMemoryFile.h>
 #include <Comm/TCPPipe.h>
 
 namespace Collaboration {
 
+namespace {
+
+/****************
+Helper constants:
+****************/
+
+const Misc::UInt32 endiannessIndicator=0x12345678U; // Indicator exchanged by Comm::NetPipe::negotiateEndianness, as sent by a peer of the same endianness
+const Misc::UInt32 swappedEndiannessIndicator=0x78563412U; // The same indicator as sent by a peer of opposite endianness
+
+/**************
+Helper classes:
+**************/
+
+struct ClientMetrics // Structure holding a snapshot of a connected client's metrics
+	{
+	/* Elements: */
+	public:
+	unsigned int clientID; // ID of the client
+	std::string sessionName; // Name of the client's session
+	Misc::UInt64 sentMessages; // Number of messages written to the client
+	Misc::UInt64 sentBytes; // Number of bytes written to the client
+	bool haveSocketBytes; // Flag whether the kernel reported the client socket's byte counts
+	Misc::UInt64 socketReceivedBytes; // Number of bytes the kernel received from the client
+	Misc::UInt64 socketAckedBytes; // Number of bytes the client acknowledged to the kernel
+	size_t numQueuedMessages; // Number of messages waiting in the client's outbound queue
+	size_t queueSize; // Total size of messages waiting in the client's outbound queue
+	bool congested; // Flag whether the slow client policy is currently applied to the client
+	};
+
+/****************
+Helper functions:
+****************/
+
+void writeClientLabels(std::ostream& os,const char* name,const ClientMetrics& cm) // Writes a per-client metric's name and labels
+	{
+	os<<name<<"{client=\""<<cm.clientID<<"\",session=\""<<ServerMetrics::escapeLabel(cm.sessionName)<<"\"} ";
+	}
+
+unsigned int createDatagramToken(void) // Returns an unpredictable token to authenticate a client's datagrams
+	{
+	/* Read the token from the kernel's random number generator: */
+	int randomFd=open("/dev/urandom",O_RDONLY);
+	if(randomFd<0)
+		Misc::throwStdErr("Unable to open /dev/urandom");
+	unsigned char tokenBytes[4];
+	size_t numRead=0;
+	while(numRead<sizeof(tokenBytes))
+		{
+		ssize_t readResult=read(randomFd,tokenBytes+numRead,sizeof(tokenBytes)-numRead);
+		if(readResult>0)
+			numRead+=size_t(readResult);
+		else if(readResult==0||errno!=EINTR)
+			break;
+		}
+	close(randomFd);
+	if(numRead<sizeof(tokenBytes))
+		Misc::throwStdErr("Unable to read from /dev/urandom");
+	
+	return (unsigned int)(tokenBytes[0])<<24|(unsigned int)(tokenBytes[1])<<16|(unsigned int)(tokenBytes[2])<<8|(unsigned int)(tokenBytes[3]);
+	}
+
+}
+
 /***************************************************
 Methods of class CollaborationServer::Configuration:
 ***************************************************/
@@ -48,28 +125,84 @@ void CollaborationServer::Configuration::setListenPortId(int newListenPortId)
 	cfg.storeValue<int>("./listenPortId",newListenPortId);
 	}
 
+void CollaborationServer::Configuration::setDatagramPortId(int newDatagramPortId)
+	{
+	cfg.storeValue<int>("./datagramPortId",newDatagramPortId);
+	}
+
+void CollaborationServer::Configuration::setDeltaStates(bool newDeltaStates)
+	{
+	cfg.storeValue<bool>("./deltaStates",newDeltaStates);
+	}
+
+void CollaborationServer::Configuration::setPoseBits(unsigned int newPositionBits,unsigned int newRotationBits)
+	{
+	cfg.storeValue<unsigned int>("./posePositionBits",newPositionBits);
+	cfg.storeValue<unsigned int>("./poseRotationBits",newRotationBits);
+	}
+
 double CollaborationServer::Configuration::getTickTime(void)
 	{
 	return cfg.retrieveValue<double>("./tickTime",0.02);
 	}
 
+TickScheduler::OverrunPolicy CollaborationServer::Configuration::getOverrunPolicy(void)
+	{
+	std::string policyName=cfg.retrieveString("./overrunPolicy","Skip");
+	if(policyName=="Skip")
+		return TickScheduler::SKIP;
+	else if(policyName=="CatchUp")
+		return TickScheduler::CATCH_UP;
+	else
+		Misc::throwStdErr("CollaborationServer::Configuration::getOverrunPolicy: Unknown overrun policy %s",policyName.c_str());
+	
+	/* Just to make g++ happy... */
+	return TickScheduler::SKIP;
+	}
+
+bool CollaborationServer::Configuration::getIdleWhenEmpty(void)
+	{
+	return cfg.retrieveValue<bool>("./idleWhenEmpty",true);
+	}
+
+double CollaborationServer::Configuration::getStatisticsInterval(void)
+	{
+	return cfg.retrieveValue<double>("./statisticsInterval",0.0);
+	}
+
 /******************************************************
 Methods of class CollaborationServer::ClientConnection:
 ******************************************************/
 
 CollaborationServer::ClientConnection::ClientConnection(unsigned int sClientID,Comm::NetPipePtr sPipe)
-	:clientID(sClientID),pipe(sPipe),
+	:clientID(sClientID),pipe(sPipe),recordingStreamId(-1),
 	 clientHostname(pipe->getPeerHostName()),
 	 clientPortId(pipe->getPeerPortId()),
-	 stateUpdateMask(ClientState::NO_CHANGE)
+	 communicationState(NEGOTIATE),clientAdded(false),addPending(false),session(0),listIndex(0),relayIndex(-1),
+	 datagramIndex(-1),deltaIndex(-1),quantizedPosesIndex(-1),compressionIndex(-1),datagramToken(0),datagramSequence(0),datagramSenderKnown(false),
+	 hasPose(false),datagramAddressValid(false),poseChangeCounter(0),
+	 receivedSerial(0),consumedSerial(0),
+	 stateUpdateMask(ClientState::NO_CHANGE),joining(false),
+	 updateFailed(false),sendScheduled(false),sending(false),
+	 sendBuffer(0),sendSize(0),sendOffset(0),waitingWritable(false),writableWatched(false),
+	 outboundFailed(false),killed(false),
+	 congested(false),pendingStateMasks(17),
+	 interestingClients(17),deltaBaselines(17)
 	{
+	for(int i=0;i<NUM_UPDATE_BITS;++i)
+		changeSerials[i]=0;
 	}
 
 CollaborationServer::ClientConnection::~ClientConnection(void)
 	{
-	/* Delete the client states of all protocol plug-ins: */
+	/* Delete the client states and server update batches of all protocol plug-ins: */
 	for(ClientProtocolList::iterator pIt=protocols.begin();pIt!=protocols.end();++pIt)
+		{
 		delete pIt->protocolClientState;
+		delete pIt->batch;
+		}
+	
+	delete sendBuffer;
 	}
 
 bool CollaborationServer::ClientConnection::negotiateProtocols(CollaborationServer& server)
@@ -86,6 +219,64 @@ bool CollaborationServer::ClientConnection::negotiateProtocols(CollaborationServ
 		/* Read the length of the protocol-specific message payload: */
 		size_t protocolMessageLength=pipe->read<Card>();
 		
+		if(protocolName==relayProtocolName&&server.acceptRelayLinks)
+			{
+			/* Remember that the connection is a relay link: */
+			relayIndex=int(i);
+			pipe->skip<Byte>(protocolMessageLength);
+			continue;
+			}
+		
+		if(protocolName==datagramProtocolName)
+			{
+			/* Remember that the client wants to exchange poses by datagram: */
+			datagramIndex=int(i);
+			pipe->skip<Byte>(protocolMessageLength);
+			continue;
+			}
+		
+		if(protocolName==deltaProtocolName)
+			{
+			/* Remember that the client wants to receive state updates as differences: */
+			deltaIndex=int(i);
+			pipe->skip<Byte>(protocolMessageLength);
+			continue;
+			}
+		
+		if(protocolName==quantizedPosesProtocolName)
+			{
+			/* Remember that the client wants to exchange poses in quantized form: */
+			quantizedPosesIndex=int(i);
+			pipe->skip<Byte>(protocolMessageLength);
+			continue;
+			}
+		
+		if(protocolName==compressionProtocolName)
+			{
+			/* Remember that the client accepts compressed bulk payloads: */
+			compressionIndex=int(i);
+			pipe->skip<Byte>(protocolMessageLength);
+			continue;
+			}
+		
+		if(protocolName==sessionProtocolName)
+			{
+			/* Reject unreasonably long session names: */
+			if(protocolMessageLength>256)
+				{
+				std::cerr<<"CollaborationServer: Session name of "<<protocolMessageLength<<" bytes rejected"<<std::endl;
+				pipe->skip<Byte>(protocolMessageLength);
+				result=false;
+				continue;
+				}
+			
+			/* Read the name of the session the client wants to join: */
+			sessionName.clear();
+			for(size_t j=0;j<protocolMessageLength;++j)
+				sessionName.push_back(pipe->read<char>());
+			continue;
+			}
+		
 		/* Ask the server to load the protocol: */
 		#ifdef VERBOSE
 		std::cout<<"CollaborationServer: Loading protocol "<<protocolName<<"..."<<std::flush;
@@ -128,797 +319,2767 @@ bool CollaborationServer::ClientConnection::negotiateProtocols(CollaborationServ
 	return result;
 	}
 
-void CollaborationServer::ClientConnection::sendClientConnectProtocols(ClientConnection* dest,Comm::NetPipe& destPipe)
+void CollaborationServer::ClientConnection::indexProtocols(void)
 	{
-	/* Count the number of protocol plug-ins supported by both clients: */
-	unsigned int numSharedProtocols=0;
-	const ClientProtocolList& cpl1=protocols;
-	const ClientProtocolList& cpl2=dest->protocols;
-	unsigned int i1=0;
-	unsigned int i2=0;
-	while(i1<cpl1.size()&&i2<cpl2.size())
+	/* Sort the negotiated protocol list in order of ascending main list index: */
+	std::sort(protocols.begin(),protocols.end(),ProtocolListEntry::comp);
+	
+	/* Enter all negotiated protocols into the protocol set and the slot array: */
+	protocolSet.clear();
+	protocolSlots.clear();
+	for(unsigned int i=0;i<protocols.size();++i)
 		{
-		if(cpl1[i1].index<cpl2[i2].index)
-			++i1; // Protocol in first list is not shared
-		else if(cpl1[i1].index>cpl2[i2].index)
-			++i2; // Protocol in second list is not shared
-		else
+		protocolSet.add(protocols[i].index);
+		if(protocols[i].index>=protocolSlots.size())
+			protocolSlots.resize(protocols[i].index+1,~0x0U);
+		protocolSlots[protocols[i].index]=i;
+		}
+	}
+
+void CollaborationServer::ClientConnection::publishState(void)
+	{
+	/* Remember which parts of the client state were changed by this update: */
+	++receivedSerial;
+	for(int i=0;i<NUM_UPDATE_BITS;++i)
+		if(receivedState.updateMask&(0x1U<<i))
+			changeSerials[i]=receivedSerial;
+	
+	/* Post a new snapshot of the received client state: */
+	StateSnapshot& snapshot=stateSnapshots.startNewValue();
+	snapshot.state=receivedState;
+	snapshot.serial=receivedSerial;
+	for(int i=0;i<NUM_UPDATE_BITS;++i)
+		snapshot.changeSerials[i]=changeSerials[i];
+	stateSnapshots.postNewValue();
+	}
+
+void CollaborationServer::ClientConnection::consumeState(void)
+	{
+	if(stateSnapshots.lockNewValue())
+		{
+		const StateSnapshot& snapshot=stateSnapshots.getLockedValue();
+		
+		/* Copy the most recent client state: */
+		state=snapshot.state;
+		
+		/* Reconstruct the update mask from all client updates since the last picked-up snapshot, including any that were overwritten before being picked up: */
+		state.updateMask=ClientState::NO_CHANGE;
+		for(int i=0;i<NUM_UPDATE_BITS;++i)
+			if(snapshot.changeSerials[i]>consumedSerial)
+				state.updateMask|=0x1U<<i;
+		consumedSerial=snapshot.serial;
+		}
+	
+	/* Pick up the most recent pose received by datagram: */
+	bool newPose=false;
+	if(poseSnapshots.lockNewValue())
+		{
+		const PoseSnapshot& snapshot=poseSnapshots.getLockedValue();
+		hasPose=true;
+		pose=snapshot.pose;
+		datagramAddressValid=true;
+		datagramAddress=snapshot.address;
+		newPose=true;
+		}
+	
+	/* Apply the pose over the state received over the pipe, unless the client's number of viewers changed since: */
+	if(hasPose&&applyPose(pose,state)&&newPose)
+		state.updateMask|=ClientState::POSE;
+	}
+
+void CollaborationServer::ClientConnection::writeClientConnect(ClientConnection* dest,unsigned int updateCounter,IO::VariableMemoryFile& destPipe,TickProfiler* profiler)
+	{
+	/* Select the cached message matching the destination's endianness, pose codec, and bulk payload compression: */
+	JoinSnapshot& snapshot=joinSnapshots[(destPipe.mustSwapOnWrite()?1:0)|(dest->poseCodec.isQuantized()?2:0)|(dest->compressionIndex>=0?4:0)];
+	
+	if(snapshot.header.getPointer()==0||snapshot.updateCounter!=updateCounter)
+		{
+		/* Create or reset the message header: */
+		if(snapshot.header.getPointer()==0)
 			{
-			++numSharedProtocols;
-			++i1;
-			++i2;
+			snapshot.header=new IO::VariableMemoryFile;
+			snapshot.header->setSwapOnWrite(destPipe.mustSwapOnWrite());
 			}
+		else
+			snapshot.header->clear();
+		snapshot.updateCounter=updateCounter;
+		
+		/* Write the message ID, the client's ID, and the client's full state as frozen for the current server update: */
+		writeMessage(CLIENT_CONNECT,*snapshot.header);
+		snapshot.header->write<Card>(clientID);
+		writeClientState(ClientState::FULL_UPDATE,state,dest->poseCodec,*snapshot.header);
+		
+		/* Invalidate all protocol payloads encoded during previous server updates: */
+		snapshot.protocolPayloads.clear();
+		snapshot.protocolPayloads.resize(protocols.size());
 		}
 	
-	/* Write the number of shared protocols: */
-	destPipe.write<Card>(numSharedProtocols);
+	/* Copy the message header: */
+	snapshot.header->writeToSink(destPipe);
+	
+	/* Write the number of protocol plug-ins supported by both clients: */
+	destPipe.write<Card>(protocolSet.countShared(dest->protocolSet));
 	
 	/* Now send the actual protocol messages: */
-	i1=0;
-	i2=0;
-	while(i1<cpl1.size()&&i2<cpl2.size())
-		{
-		if(cpl1[i1].index<cpl2[i2].index)
-			++i1; // Protocol in first list is not shared
-		else if(cpl1[i1].index>cpl2[i2].index)
-			++i2; // Protocol in second list is not shared
-		else
+	for(ProtocolSet::SharedIterator psIt(protocolSet,dest->protocolSet);!psIt.isFinished();++psIt)
+		{
+		unsigned int i1=protocolSlots[*psIt];
+		unsigned int i2=dest->protocolSlots[*psIt];
+		ProtocolListEntry& ple1=protocols[i1];
+		
+		/* Write the destination client's protocol index: */
+		destPipe.write<Card>(i2);
+		
+		if(!ple1.protocol->hasDestinationIndependentConnect())
+			{
+			/* Let the protocol write the payload for this destination client, and account for its size: */
+			size_t dataSize=destPipe.getDataSize();
+			{
+			TickProfiler::HookTimer hookTimer(profiler,ple1.protocol->hookTotals,TickProfiler::SEND_CLIENT_CONNECT);
+			ple1.protocol->sendClientConnect(ple1.protocolClientState,dest->protocols[i2].protocolClientState,destPipe);
+			}
+			ple1.protocol->sentBytes.add(destPipe.getDataSize()-dataSize);
+			continue;
+			}
+		
+		/* Let the protocol write its payload if no earlier destination of the same variant shared the protocol: */
+		MessageSegment& payload=snapshot.protocolPayloads[i1];
+		if(payload.getPointer()==0)
+			{
+			payload=new IO::VariableMemoryFile;
+			payload->setSwapOnWrite(destPipe.mustSwapOnWrite());
+			TickProfiler::HookTimer hookTimer(profiler,ple1.protocol->hookTotals,TickProfiler::SEND_CLIENT_CONNECT);
+			ple1.protocol->sendClientConnect(ple1.protocolClientState,dest->protocols[i2].protocolClientState,*payload);
+			}
+		
+		/* Copy the payload and account for its size: */
+		payload->writeToSink(destPipe);
+		ple1.protocol->sentBytes.add(payload->getDataSize());
+		}
+	}
+
+void CollaborationServer::ClientConnection::batchServerUpdateProtocols(const CollaborationServer::ClientList& clientList,TickProfiler* profiler)
+	{
+	/* Create or reset the server update batches of all negotiated protocol plug-ins that batch their server updates: */
+	bool haveBatches=false;
+	for(ClientProtocolList::iterator cplIt=protocols.begin();cplIt!=protocols.end();++cplIt)
+		if(cplIt->protocol->hasBatchedServerUpdates())
+			{
+			if(cplIt->batch==0)
+				cplIt->batch=new ServerUpdateBatch;
+			else
+				cplIt->batch->clear();
+			cplIt->batchFailed=false;
+			haveBatches=true;
+			}
+	if(!haveBatches)
+		return;
+	
+	/* Add all other live clients to the batches of the protocol plug-ins they share with this client, in the order in which they receive server updates: */
+	for(ClientList::const_iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
+		{
+		ClientConnection* dest=*clIt;
+		if(dest==this||dest->killed)
+			continue;
+		
+		bool swapOnWrite=dest->pipe->mustSwapOnWrite();
+		for(ProtocolSet::SharedIterator psIt(protocolSet,dest->protocolSet);!psIt.isFinished();++psIt)
+			{
+			ProtocolListEntry& ple=protocols[protocolSlots[*psIt]];
+			if(ple.batch!=0)
+				ple.batch->addDestination(dest->protocols[dest->protocolSlots[*psIt]].protocolClientState,swapOnWrite,dest->listIndex);
+			}
+		}
+	
+	/* Let each batching protocol plug-in write its payloads for all destination clients at once: */
+	for(ClientProtocolList::iterator cplIt=protocols.begin();cplIt!=protocols.end();++cplIt)
+		if(cplIt->batch!=0&&cplIt->batch->getNumDestinations()>0)
+			{
+			try
+				{
+				TickProfiler::HookTimer hookTimer(profiler,cplIt->protocol->hookTotals,TickProfiler::SEND_SERVER_UPDATE);
+				cplIt->protocol->sendServerUpdate(cplIt->protocolClientState,*cplIt->batch);
+				}
+			catch(std::runtime_error err)
+				{
+				/* Remember the failure, so the affected destination clients' update messages fail as if the protocol had failed writing them: */
+				cplIt->batchFailed=true;
+				}
+			}
+	}
+
+void CollaborationServer::ClientConnection::sendServerUpdateProtocols(CollaborationServer::ClientConnection* dest,IO::VariableMemoryFile& destPipe,bool reduced,TickProfiler* profiler)
+	{
+	/* Process plug-in protocols shared by the two clients: */
+	for(ProtocolSet::SharedIterator psIt(protocolSet,dest->protocolSet);!psIt.isFinished();++psIt)
+		{
+		ProtocolListEntry& ple1=protocols[protocolSlots[*psIt]];
+		ProtocolListEntry& ple2=dest->protocols[dest->protocolSlots[*psIt]];
+		
+		/* Let the shared protocol write a payload without bulk data if requested and supported by the protocol: */
+		size_t dataSize=destPipe.getDataSize();
+		bool sent=false;
+		if(reduced)
+			{
+			TickProfiler::HookTimer hookTimer(profiler,ple1.protocol->hookTotals,TickProfiler::SEND_SERVER_UPDATE);
+			sent=ple1.protocol->sendReducedServerUpdate(ple1.protocolClientState,ple2.protocolClientState,destPipe);
+			}
+		
+		if(!sent)
+			{
+			const IO::VariableMemoryFile* payload=0;
+			if(ple1.batch!=0&&ple1.batch->findPayload(ple2.protocolClientState,dest->listIndex,payload))
+				{
+				/* Fail the destination's update message if the protocol could not write its batch: */
+				if(ple1.batchFailed)
+					Misc::throwStdErr("CollaborationServer: Protocol %s failed to write server update batch",ple1.protocol->getName());
+				
+				/* Copy the payload the protocol wrote for the destination client in its batch: */
+				if(payload!=0)
+					payload->writeToSink(destPipe);
+				}
+			else
+				{
+				/* Let the protocol write the payload for a destination client that is not in its batch, or if the protocol does not batch its server updates: */
+				TickProfiler::HookTimer hookTimer(profiler,ple1.protocol->hookTotals,TickProfiler::SEND_SERVER_UPDATE);
+				ple1.protocol->sendServerUpdate(ple1.protocolClientState,ple2.protocolClientState,destPipe);
+				}
+			}
+		
+		/* Account the payload to the destination client's entry; it is only touched by the thread assembling the destination's update message: */
+		ple2.sentBytes+=destPipe.getDataSize()-dataSize;
+		}
+	}
+
+/*********************************************
+Methods of class CollaborationServer::Session:
+*********************************************/
+
+CollaborationServer::Session::Session(CollaborationServer* sServer,const std::string& sName)
+	:server(sServer),name(sName),
+	 numReferences(0),
+	 interestGrid(0),updateCounter(0),
+	 datagramEntry(0),datagram(0),
+	 numPendingUpdateJobs(0)
+	{
+	/* Create the spatial index for area of interest filtering: */
+	if(server->interestRadius>Scalar(0))
+		interestGrid=new InterestGrid(server->interestCellSize);
+	}
+
+CollaborationServer::Session::~Session(void)
+	{
+	delete interestGrid;
+	delete datagramEntry;
+	delete datagram;
+	}
+
+void CollaborationServer::Session::run(void)
+	{
+	/* Send state updates to all clients in the session: */
+	server->updateSession(this);
+	}
+
+/***********************************************
+Methods of class CollaborationServer::UpdateJob:
+***********************************************/
+
+void CollaborationServer::UpdateJob::run(void)
+	{
+	/* Run the job's phase for its range of clients, calling only thread-safe protocol hooks: */
+	CollaborationServer* server=session->server;
+	try
+		{
+		switch(phase)
 			{
-			/* Write the destination client's protocol index: */
-			destPipe.write<Card>(i2);
+			case FREEZE_CLIENTS:
+				server->freezeClients(session,begin,end,THREAD_SAFE_HOOKS);
+				break;
 			
-			/* Let the protocol send its data: */
-			cpl1[i1].protocol->sendClientConnect(cpl1[i1].protocolClientState,cpl2[i2].protocolClientState,destPipe);
+			case WRITE_UPDATES:
+				server->writeUpdateMessages(session,begin,end);
+				break;
 			
-			++i1;
-			++i2;
+			case FINISH_CLIENTS:
+				server->finishClients(session,begin,end,THREAD_SAFE_HOOKS);
+				break;
 			}
 		}
+	catch(std::runtime_error err)
+		{
+		/* Print an error message and carry on, so the session's update does not wait for the job forever: */
+		std::cerr<<"CollaborationServer::UpdateJob: Caught exception "<<err.what()<<" while updating session "<<session->name<<std::endl;
+		}
+	
+	/* Wake up the session's update if this was its last pending job: */
+	Threads::MutexCond::Lock updateJobLock(session->updateJobCond);
+	--session->numPendingUpdateJobs;
+	if(session->numPendingUpdateJobs==0)
+		session->updateJobCond.signal();
 	}
 
 /************************************
 Methods of class CollaborationServer:
 ************************************/
 
-void* CollaborationServer::listenThreadMethod(void)
+CollaborationServer::ClientConnection* CollaborationServer::acceptClient(void)
 	{
-	/* Enable immediate cancellation of this thread: */
-	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
-	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	/* Wait for the next incoming connection: */
+	#ifdef VERBOSE
+	std::cout<<"CollaborationServer: Waiting for client connection"<<std::endl<<std::flush;
+	#endif
+	Comm::NetPipePtr clientPipe;
+	int recordingStreamId=-1;
+	try
+		{
+		if(sessionRecorder!=0)
+			{
+			/* Record all data received from the client: */
+			SessionRecorder::Pipe* recordingPipe=new SessionRecorder::Pipe(*sessionRecorder,listenSocket);
+			recordingStreamId=int(recordingPipe->getStreamId());
+			clientPipe=recordingPipe;
+			}
+		else
+			clientPipe=new Comm::TCPPipe(listenSocket);
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"CollaborationServer: Unable to accept client connection due to exception "<<err.what()<<std::endl<<std::flush;
+		}
 	
-	while(true)
+	if(eventLoop)
 		{
-		/* Wait for the next incoming connection: */
-		#ifdef VERBOSE
-		std::cout<<"CollaborationServer: Waiting for client connection"<<std::endl<<std::flush;
-		#endif
-		Comm::NetPipePtr clientPipe=new Comm::TCPPipe(listenSocket);
+		try
+			{
+			/* Let another I/O thread accept the next connection while this one sets up the new client: */
+			watchSocket(listenSocket.getFd(),0,false);
+			}
+		catch(std::runtime_error err)
+			{
+			std::cerr<<"CollaborationServer: Unable to watch listening socket due to exception "<<err.what()<<std::endl<<std::flush;
+			}
+		}
+	
+	if(clientPipe==0)
+		return 0;
+	
+	/**************************************************************************
+	Connect the new client by creating a new client connection state structure:
+	**************************************************************************/
+	
+	try
+		{
+		if(eventLoop)
+			{
+			/* Limit the time an I/O thread can be blocked by a client that stalls in the middle of a message: */
+			struct timeval timeout;
+			timeout.tv_sec=long(ioTimeout);
+			timeout.tv_usec=long((ioTimeout-double(timeout.tv_sec))*1.0e6);
+			if(setsockopt(clientPipe->getFd(),SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(struct timeval))!=0)
+				Misc::throwStdErr("Unable to set receive timeout on client socket");
+			}
 		
-		/**************************************************************************
-		Connect the new client by creating a new client connection state structure:
-		**************************************************************************/
+		/* Limit the time a thread writing a reply directly to the client can be blocked by a client that does not accept data: */
+		struct timeval sendTimeoutTv;
+		sendTimeoutTv.tv_sec=long(sendTimeout);
+		sendTimeoutTv.tv_usec=long((sendTimeout-double(sendTimeoutTv.tv_sec))*1.0e6);
+		if(setsockopt(clientPipe->getFd(),SOL_SOCKET,SO_SNDTIMEO,&sendTimeoutTv,sizeof(struct timeval))!=0)
+			Misc::throwStdErr("Unable to set send timeout on client socket");
 		
+		/* Send the server's endianness indicator; the client's indicator is received by the thread reading from the client, so a client that does not send it cannot stall accepting other clients: */
+		clientPipe->write<Misc::UInt32>(endiannessIndicator);
+		clientPipe->flush();
+		
+		/* Create a new client connection state structure: */
+		ClientConnection* newClientConnection=new ClientConnection(0,clientPipe);
+		
+		/* Assign an ID to the new client by entering it into the client table: */
 		try
 			{
-			/* Create a new client connection state structure: */
-			clientPipe->negotiateEndianness();
-			ClientConnection* newClientConnection=new ClientConnection(nextClientID,clientPipe);
-			if(++nextClientID==0)
-				nextClientID=1;
-			
-			#ifdef VERBOSE
-			std::cout<<"CollaborationServer: Connecting new client from host "<<newClientConnection->clientHostname<<", port "<<newClientConnection->clientPortId<<std::endl<<std::flush;
-			#endif
+			/* Create an unpredictable token to authenticate the client's datagrams before the datagram thread can find the client: */
+			newClientConnection->datagramToken=createDatagramToken();
 			
-			/* Start a communication thread for the new client: */
-			newClientConnection->communicationThread.start(this,&CollaborationServer::clientCommunicationThreadMethod,newClientConnection);
+			Threads::Mutex::Lock clientTableLock(clientTableMutex);
+			newClientConnection->clientID=clientTable.insert(newClientConnection);
 			}
-		catch(std::runtime_error err)
+		catch(...)
 			{
-			std::cerr<<"CollaborationServer: Cancelled connecting new client due to exception "<<err.what()<<std::endl<<std::flush;
+			delete newClientConnection;
+			throw;
 			}
+		
+		/* Link the client's recorded traffic to its ID: */
+		newClientConnection->recordingStreamId=recordingStreamId;
+		if(recordingStreamId>=0)
+			sessionRecorder->recordClientId(recordingStreamId,newClientConnection->clientID);
+		
+		/* Wake up a server loop waiting for clients: */
+		eventfd_write(clientArrivalFd,1);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Connecting new client from host "<<newClientConnection->clientHostname<<", port "<<newClientConnection->clientPortId<<std::endl<<std::flush;
+		#endif
+		
+		return newClientConnection;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"CollaborationServer: Cancelled connecting new client due to exception "<<err.what()<<std::endl<<std::flush;
 		}
 	
 	return 0;
 	}
 
-void* CollaborationServer::clientCommunicationThreadMethod(CollaborationServer::ClientConnection* client)
+bool CollaborationServer::handleClientMessage(CollaborationServer::ClientConnection* client)
 	{
-	/* Enable immediate cancellation of this thread: */
-	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
-	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
-	
-	enum State // Possible states of the client communication state machine
-		{
-		START,CONNECTED,FINISH
-		};
-	
 	Threads::Mutex& pipeMutex=client->pipeMutex;
 	Comm::NetPipe& pipe=*(client->pipe);
 	unsigned int clientID=client->clientID;
+	ClientConnection::CommunicationState& state=client->communicationState;
 	
-	/* Run the client communication state machine until the client disconnects or there is a communication error: */
-	bool clientAdded=false; // Flag to remember whether this client was ever "officially" connected
-	try
+	if(state==ClientConnection::NEGOTIATE)
+		{
+		/* Receive the client's endianness indicator, and swap all further data if the client's endianness differs from the server's: */
+		Misc::UInt32 clientEndiannessIndicator=pipe.read<Misc::UInt32>();
+		if(clientEndiannessIndicator==swappedEndiannessIndicator)
+			{
+			pipe.setSwapOnRead(true);
+			pipe.setSwapOnWrite(true);
+			}
+		else if(clientEndiannessIndicator!=endiannessIndicator)
+			Misc::throwStdErr("CollaborationServer: Unable to negotiate endianness with client");
+		
+		state=ClientConnection::START;
+		return true;
+		}
+	
+	/* Wait for the next message: */
+	MessageIdType message=readMessage(pipe);
+	if(message<MESSAGES_END)
+		metrics.receivedMessages[message].add(1);
+	
+	if(client->recordingStreamId>=0)
 		{
-		State state=START;
-		while(state!=FINISH)
+		/* Tag the client's recorded traffic with the message and the protocol owning it: */
+		const char* protocolName="";
+		if(message<MESSAGES_END)
+			protocolName="Collaboration";
+		else
 			{
-			/* Wait for the next message: */
-			MessageIdType message=readMessage(pipe);
+			const ProtocolTable* table=getProtocolTable();
+			if(message<table->messageTable.size()&&table->messageTable[message]!=0)
+				protocolName=table->messageTable[message]->getName();
+			}
+		sessionRecorder->recordMessage(client->recordingStreamId,message,protocolName);
+		}
+	
+	/* Process the message based on the communication state: */
+	switch(state)
+		{
+		case ClientConnection::START:
+			
+			/*************************************************************
+			Handle message exchanges related to connection initiation:
+			*************************************************************/
 			
-			/* Process the message based on the communication state: */
-			switch(state)
+			switch(message)
 				{
-				case START:
+				case CONNECT_REQUEST:
+					{
+					bool connectionOk=true;
+					
+					/* Read the client's initial client state: */
+					readClientState(client->state,pipe);
+					client->receivedState=client->state;
 					
-					/*************************************************************
-					Handle message exchanges related to connection initiation:
-					*************************************************************/
+					/* Negotiate protocol plug-ins with the new client: */
+					connectionOk=connectionOk&&client->negotiateProtocols(*this);
 					
-					switch(message)
+					/* Sort and index the new client's negotiated protocol list to facilitate quick intersection tests: */
+					client->indexProtocols();
+					
+					if(connectionOk&&client->relayIndex>=0&&client->protocols.empty())
+						{
+						/* Hand the connection to a relay link instead of connecting a client: */
+						acceptRelayLink(client);
+						state=ClientConnection::FINISH;
+						break;
+						}
+					
+					/* Process higher-level protocols: */
+					bool higherLevelsSawRequest=connectionOk;
+					connectionOk=connectionOk&&receiveConnectRequest(clientID,pipe);
+					
+					/* Reply appropriately to the connect request: */
+					if(connectionOk)
 						{
-						case CONNECT_REQUEST:
+						/* Send connect reply message: */
+						{
+						Threads::Mutex::Lock pipeLock(pipeMutex);
+						writeMessage(CONNECT_REPLY,pipe);
+						
+						/* Only accept datagrams from the client if the server has a datagram channel: */
+						if(datagramChannel==0)
+							client->datagramIndex=-1;
+						
+						/* Only send state updates as differences if the server enables them: */
+						if(!deltaStates)
+							client->deltaIndex=-1;
+						
+						/* Only quantize poses if the server has a quantizing codec: */
+						if(!poseCodec.isQuantized())
+							client->quantizedPosesIndex=-1;
+						
+						/* Only send compression envelopes if the server compresses bulk payloads: */
+						if(compressionThreshold==0)
+							client->compressionIndex=-1;
+						
+						/* Write the number of negotiated protocols, including accepted reserved entries: */
+						pipe.write<Card>(client->protocols.size()+(client->datagramIndex>=0?1:0)+(client->deltaIndex>=0?1:0)+(client->quantizedPosesIndex>=0?1:0)+(client->compressionIndex>=0?1:0));
+						
+						/* Let all negotiated protocols insert their message payloads: */
+						for(ClientConnection::ClientProtocolList::const_iterator cpIt=client->protocols.begin();cpIt!=client->protocols.end();++cpIt)
 							{
-							bool connectionOk=true;
-							
-							/* Read the client's initial client state: */
-							readClientState(client->state,pipe);
+							/* Write the client's index of the protocol: */
+							pipe.write<Card>(cpIt->clientIndex);
 							
-							/* Negotiate protocol plug-ins with the new client: */
-							connectionOk=connectionOk&&client->negotiateProtocols(*this);
+							/* Write the protocol's message ID base: */
+							pipe.write<Card>(cpIt->protocol->messageIdBase);
 							
-							/* Sort the new client's negotiated protocol list in order of ascending main list index to facilitate quick intersection tests: */
-							std::sort(client->protocols.begin(),client->protocols.end(),ClientConnection::ProtocolListEntry::comp);
-							
-							/* Process higher-level protocols: */
-							bool higherLevelsSawRequest=connectionOk;
-							connectionOk=connectionOk&&receiveConnectRequest(clientID,pipe);
+							/* Write the protocol's message payload: */
+							cpIt->protocol->sendConnectReply(cpIt->protocolClientState,pipe);
+							}
+						
+						if(client->datagramIndex>=0)
+							{
+							/* Accept the reserved datagram entry, and tell the client where and how to send its datagrams: */
+							pipe.write<Card>(client->datagramIndex);
+							pipe.write<Card>(0);
+							pipe.write<Card>(datagramChannel->getPortId());
+							pipe.write<Card>(clientID);
+							pipe.write<Card>(client->datagramToken);
+							}
+						
+						if(client->deltaIndex>=0)
+							{
+							/* Accept the reserved delta entry: */
+							pipe.write<Card>(client->deltaIndex);
+							pipe.write<Card>(0);
+							}
+						
+						if(client->quantizedPosesIndex>=0)
+							{
+							/* Accept the reserved quantized poses entry, and tell the client the codec's precision: */
+							pipe.write<Card>(client->quantizedPosesIndex);
+							pipe.write<Card>(0);
+							pipe.write<Card>(poseCodec.getPositionBits());
+							pipe.write<Card>(poseCodec.getRotationBits());
+							client->poseCodec=poseCodec;
+							}
+						
+						if(client->compressionIndex>=0)
+							{
+							/* Accept the reserved compression entry, and let all negotiated protocols send bulk payloads in compression envelopes: */
+							pipe.write<Card>(client->compressionIndex);
+							pipe.write<Card>(0);
+							for(ClientConnection::ClientProtocolList::iterator cpIt=client->protocols.begin();cpIt!=client->protocols.end();++cpIt)
+								if(cpIt->protocolClientState!=0)
+									cpIt->protocolClientState->compressPayloads=true;
+							}
+						
+						/* Process higher-level protocols: */
+						sendConnectReply(clientID,pipe);
+						pipe.flush();
+						
+						/* Join the session requested by the client; its first server update will carry client connect messages for all clients already in the session: */
+						client->session=getSession(client->sessionName);
+						{
+						Threads::Mutex::Lock clientListLock(client->session->clientListMutex);
+						
+						/* Add client action to list: */
+						client->clientAdded=true;
+						client->addPending=true;
+						client->session->actionList.push_back(ClientListAction(ClientListAction::ADD_CLIENT,clientID));
+						}
+						}
+						
+						#ifdef VERBOSE
+						std::cout<<"CollaborationServer: Connected client from host "<<client->clientHostname<<", port "<<client->clientPortId<<" as "<<client->state.clientName<<" to session \""<<client->sessionName<<"\""<<std::endl<<std::flush;
+						#endif
+						
+						metrics.clientConnects.add(1);
+						state=ClientConnection::CONNECTED;
+						}
+					else
+						{
+						{
+						Threads::Mutex::Lock pipeLock(pipeMutex);
+						
+						/* Reject the connection request: */
+						writeMessage(CONNECT_REJECT,pipe);
+						
+						/* Write the number of negotiated protocols (including the one that might have failed): */
+						pipe.write<Card>(client->protocols.size());
+						
+						/* Inform all protocol plug-ins that have seen the CONNECT_REQUEST message: */
+						for(ClientConnection::ClientProtocolList::const_iterator cpIt=client->protocols.begin();cpIt!=client->protocols.end();++cpIt)
+							{
+							/* Write the client's index of the protocol: */
+							pipe.write<Card>(cpIt->clientIndex);
 							
-							/* Reply appropriately to the connect request: */
-							if(connectionOk)
-								{
-								/* Send connect reply message: */
+							cpIt->protocol->sendConnectReject(cpIt->protocolClientState,pipe);
+							}
+						
+						if(higherLevelsSawRequest)
+							{
+							/* Process higher-level protocols: */
+							sendConnectReject(clientID,pipe);
+							}
+						
+						pipe.flush();
+						}
+						
+						metrics.clientRejects.add(1);
+						state=ClientConnection::FINISH;
+						}
+					break;
+					}
+				
+				default:
+					/* Bail out: */
+					Misc::throwStdErr("Protocol error during connection initialization");
+				}
+			break;
+		
+		case ClientConnection::CONNECTED:
+			
+			/*************************************************************
+			Handle message exchanges while the client is connected:
+			*************************************************************/
+			
+			switch(message)
+				{
+				case CLIENT_UPDATE:
+					{
+					/* Read the client's updated client state and hand it to the server update without waiting for it: */
+					client->receivedState.updateMask=ClientState::NO_CHANGE;
+					readClientState(client->receivedState,client->poseCodec,pipe);
+					client->publishState();
+					
+					{
+					/* Lock the client's protocol plug-in states; server updates only hold the lock briefly while plug-ins take their snapshots: */
+					Threads::Mutex::Lock clientLock(client->mutex);
+					
+					/* Let protocol plug-ins read their own client update messages: */
+					for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+						cplIt->protocol->receiveClientUpdate(cplIt->protocolClientState,pipe);
+					
+					/* Process higher-level protocols: */
+					receiveClientUpdate(clientID,pipe);
+					}
+					
+					break;
+					}
+				
+				case DISCONNECT_REQUEST:
+					{
+					{
+					/* Lock client state: */
+					Threads::Mutex::Lock clientLock(client->mutex);
+					
+					/* Let protocol plug-ins read their own disconnect request messages: */
+					for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+						cplIt->protocol->receiveDisconnectRequest(cplIt->protocolClientState,pipe);
+					
+					/* Process higher-level protocols: */
+					receiveDisconnectRequest(clientID,pipe);
+					
+					{
+					Threads::Mutex::Lock pipeLock(pipeMutex);
+					
+					/* Complete an update message a sender thread started writing: */
+					finishSendBuffer(client);
+					
+					/* Send a disconnect reply: */
+					writeMessage(DISCONNECT_REPLY,pipe);
+					
+					/* Let protocol plug-ins insert their own disconnect reply messages: */
+					for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+						cplIt->protocol->sendDisconnectReply(cplIt->protocolClientState,pipe);
+					
+					/* Process higher-level protocols: */
+					sendDisconnectReply(clientID,pipe);
+					
+					pipe.flush();
+					}
+					}
+					
+					/* Go to finish state: */
+					state=ClientConnection::FINISH;
+					break;
+					}
+				
+				default:
+					{
+					{
+					Threads::Mutex::Lock clientLock(client->mutex);
+					
+					/* Find the protocol that registered itself for this message ID: */
+					const ProtocolTable* table=getProtocolTable();
+					if(message<table->messageTable.size())
+						{
+						/* Find the protocol's client state object: */
+						ProtocolServer* protocol=table->messageTable[message];
+						ProtocolClientState* pcs=0;
+						for(ClientConnection::ClientProtocolList::iterator pclIt=client->protocols.begin();pclIt!=client->protocols.end();++pclIt)
+							if(pclIt->protocol==protocol)
+								pcs=pclIt->protocolClientState;
+						
+						/* Call on the protocol plug-in to handle the message: */
+						if(protocol!=0)
+							protocol->receivedMessages[message-protocol->messageIdBase].add(1);
+						if(protocol==0||pcs==0||!protocol->handleMessage(pcs,message-protocol->messageIdBase,pipe))
+							{
+							/* Bail out: */
+							Misc::throwStdErr("Protocol error, received message %d",int(message));
+							}
+						}
+					else
+						{
+						/* Check for higher-level protocol messages: */
+						if(!handleMessage(clientID,pipe,message))
+							{
+							/* Bail out: */
+							Misc::throwStdErr("Protocol error, received message %d",int(message));
+							}
+						}
+					}
+					}
+				}
+			break;
+		
+		default:
+			/* Just to make g++ happy... */
+			;
+		}
+	
+	return state!=ClientConnection::FINISH;
+	}
+
+CollaborationServer::ClientConnection* CollaborationServer::findClient(unsigned int clientID)
+	{
+	Threads::Mutex::Lock clientTableLock(clientTableMutex);
+	return clientTable.find(clientID);
+	}
+
+void CollaborationServer::destroyClient(CollaborationServer::ClientConnection* client)
+	{
+	/* Release the client's ID; any actions still referring to it will no longer find the client: */
+	{
+	Threads::Mutex::Lock clientTableLock(clientTableMutex);
+	clientTable.remove(client->clientID);
+	}
+	
+	/* Delete the client connection state structure: */
+	delete client;
+	}
+
+void CollaborationServer::finishClient(CollaborationServer::ClientConnection* client)
+	{
+	unsigned int clientID=client->clientID;
+	
+	/******************************************************************************************
+	Disconnect the client by removing it from the list and deleting the client state structure:
+	******************************************************************************************/
+	
+	#ifdef VERBOSE
+	std::cout<<"CollaborationServer: Disconnecting client from host "<<client->clientHostname<<", port "<<client->clientPortId<<std::endl<<std::flush;
+	#endif
+	
+	/* Delete the client state structure directly, or defer to main thread: */
+	Session* session=client->session;
+	bool deleteClient=!client->clientAdded;
+	if(client->clientAdded)
+		{
+		metrics.clientDisconnects.add(1);
+		
+		/* Lock the session's client list: */
+		Threads::Mutex::Lock clientListLock(session->clientListMutex);
+		
+		/* Check if the request to add the client is still in the action list: */
+		if(client->addPending)
+			{
+			/* Delete the client right away; the pending add action will not find the client's ID anymore: */
+			deleteClient=true;
+			}
+		else
+			{
+			/* Add the client removal action to the list: */
+			session->actionList.push_back(ClientListAction(ClientListAction::REMOVE_CLIENT,clientID));
+			}
+		}
+	
+	if(deleteClient)
+		{
+		/* Delete the client connection state structure immediately (closing the TCP pipe): */
+		destroyClient(client);
+		
+		/* Leave the client's session: */
+		if(session!=0)
+			releaseSession(session);
+		
+		/* Process higher-level protocols: */
+		disconnectClient(clientID);
+		}
+	}
+
+void* CollaborationServer::listenThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	
+	while(true)
+		{
+		/* Wait for and connect the next client: */
+		ClientConnection* newClientConnection=acceptClient();
+		
+		/* Start a communication thread for the new client: */
+		if(newClientConnection!=0)
+			newClientConnection->communicationThread.start(this,&CollaborationServer::clientCommunicationThreadMethod,newClientConnection);
+		}
+	
+	return 0;
+	}
+
+void* CollaborationServer::clientCommunicationThreadMethod(CollaborationServer::ClientConnection* client)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	// Threads::Thread::setCancelType(Threads::Thread::CANCEL_ASYNCHRONOUS);
+	
+	/* Run the client communication state machine until the client disconnects or there is a communication error: */
+	try
+		{
+		while(handleClientMessage(client))
+			;
+		}
+	catch(std::runtime_error err)
+		{
+		/* Print error message to stderr and disconnect the client: */
+		std::cerr<<"CollaborationServer::clientCommunicationThread: Terminating client connection due to exception "<<err.what()<<std::endl<<std::flush;
+		}
+	
+	/* Remove the client: */
+	finishClient(client);
+	
+	/* Terminate: */
+	return 0;
+	}
+
+void CollaborationServer::watchSocket(int fd,CollaborationServer::ClientConnection* client,bool firstTime)
+	{
+	/* Wait for the socket to become readable; only one I/O thread at a time is woken up for any socket: */
+	struct epoll_event event;
+	memset(&event,0,sizeof(struct epoll_event));
+	event.events=EPOLLIN|EPOLLONESHOT;
+	event.data.ptr=client;
+	if(epoll_ctl(epollFd,firstTime?EPOLL_CTL_ADD:EPOLL_CTL_MOD,fd,&event)!=0)
+		Misc::throwStdErr("CollaborationServer::watchSocket: Unable to watch socket %d",fd);
+	}
+
+void* CollaborationServer::ioThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next socket to become readable: */
+		struct epoll_event event;
+		int numEvents=epoll_wait(epollFd,&event,1,-1);
+		if(numEvents<0&&errno!=EINTR)
+			{
+			std::cerr<<"CollaborationServer::ioThread: Terminating I/O thread due to error "<<strerror(errno)<<std::endl<<std::flush;
+			break;
+			}
+		if(numEvents<=0)
+			continue;
+		
+		ClientConnection* client=static_cast<ClientConnection*>(event.data.ptr);
+		if(client==0)
+			{
+			/* Accept the pending connection on the listening socket, which re-arms the listening socket for the next connection: */
+			ClientConnection* newClientConnection=acceptClient();
+			
+			try
+				{
+				/* Watch the new client's socket: */
+				if(newClientConnection!=0)
+					watchSocket(newClientConnection->pipe->getFd(),newClientConnection,true);
+				}
+			catch(std::runtime_error err)
+				{
+				std::cerr<<"CollaborationServer::ioThread: Cancelled connecting new client due to exception "<<err.what()<<std::endl<<std::flush;
+				if(newClientConnection!=0)
+					destroyClient(newClientConnection);
+				}
+			}
+		else
+			{
+			bool keepClient=true;
+			try
+				{
+				/* Process all messages that are already in the client pipe's read buffer, but do not wait for more: */
+				do
+					{
+					keepClient=handleClientMessage(client);
+					}
+				while(keepClient&&client->pipe->canReadImmediately());
+				
+				/* Watch the client's socket for the next message: */
+				if(keepClient)
+					watchSocket(client->pipe->getFd(),client,false);
+				}
+			catch(std::runtime_error err)
+				{
+				/* Print error message to stderr and disconnect the client: */
+				std::cerr<<"CollaborationServer::ioThread: Terminating client connection due to exception "<<err.what()<<std::endl<<std::flush;
+				keepClient=false;
+				}
+			
+			if(!keepClient)
+				{
+				/* Stop watching the client's socket and remove the client: */
+				epoll_ctl(epollFd,EPOLL_CTL_DEL,client->pipe->getFd(),0);
+				finishClient(client);
+				}
+			}
+		}
+	
+	return 0;
+	}
+
+void CollaborationServer::queueMessage(CollaborationServer::ClientConnection* client,OutboundQueue::Message message)
+	{
+	/* Append the message to the client's outbound queue: */
+	client->outboundQueue.push(message);
+	
+	/* Schedule the client for sending if no sender thread is already taking care of it: */
+	Threads::MutexCond::Lock senderLock(senderCond);
+	if(!client->sendScheduled&&!client->outboundFailed)
+		{
+		client->sendScheduled=true;
+		readyClients.push_back(client);
+		senderCond.broadcast();
+		}
+	}
+
+void CollaborationServer::unscheduleClient(CollaborationServer::ClientConnection* client)
+	{
+	/* Abort any write to the client that might still be in progress: */
+	shutdown(client->pipe->getFd(),SHUT_RDWR);
+	
+	Threads::MutexCond::Lock senderLock(senderCond);
+	
+	/* Wait until no sender thread is writing to the client: */
+	while(client->sending)
+		senderCond.wait(senderLock);
+	
+	/* Stop waiting for the client's socket to become writable: */
+	if(client->writableWatched)
+		epoll_ctl(writableEpollFd,EPOLL_CTL_DEL,client->pipe->getFd(),0);
+	client->waitingWritable=false;
+	
+	/* Remove the client from the list of clients with pending messages: */
+	readyClients.remove(client);
+	client->sendScheduled=false;
+	client->outboundFailed=true;
+	}
+
+bool CollaborationServer::writeSendBuffer(CollaborationServer::ClientConnection* client)
+	{
+	/* Write the rest of the message until the socket's send buffer is full: */
+	const char* data=static_cast<const char*>(client->sendBuffer->getMemory());
+	int fd=client->pipe->getFd();
+	while(client->sendOffset<client->sendSize)
+		{
+		ssize_t written=send(fd,data+client->sendOffset,client->sendSize-client->sendOffset,MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(written>0)
+			client->sendOffset+=size_t(written);
+		else if(written<0&&(errno==EAGAIN||errno==EWOULDBLOCK))
+			return false;
+		else if(written<0&&errno!=EINTR)
+			Misc::throwStdErr("CollaborationServer: Unable to write to client due to error %s",strerror(errno));
+		else if(written==0)
+			Misc::throwStdErr("CollaborationServer: Client does not accept data");
+		}
+	
+	/* Account for the finished message: */
+	client->sentMessages.add(1);
+	client->sentBytes.add(client->sendSize);
+	client->sendSize=0;
+	client->sendOffset=0;
+	
+	return true;
+	}
+
+void CollaborationServer::finishSendBuffer(CollaborationServer::ClientConnection* client)
+	{
+	if(client->sendSize>0)
+		{
+		/* Write the rest of the message through the pipe, which blocks for at most the send timeout: */
+		const char* data=static_cast<const char*>(client->sendBuffer->getMemory());
+		client->pipe->write<char>(data+client->sendOffset,client->sendSize-client->sendOffset);
+		
+		/* Account for the finished message: */
+		client->sentMessages.add(1);
+		client->sentBytes.add(client->sendSize);
+		client->sendSize=0;
+		client->sendOffset=0;
+		}
+	}
+
+void* CollaborationServer::senderThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next client with pending outbound messages: */
+		ClientConnection* client;
+		{
+		Threads::MutexCond::Lock senderLock(senderCond);
+		while(readyClients.empty())
+			senderCond.wait(senderLock);
+		client=readyClients.front();
+		readyClients.pop_front();
+		client->sending=true;
+		}
+		
+		/* Write at most one message, and only as much of it as the client's socket accepts without blocking, so that slow clients with deep queues cannot starve the others: */
+		bool messagePending=false;
+		bool wouldBlock=false;
+		try
+			{
+			Threads::Mutex::Lock pipeLock(client->pipeMutex);
+			TickProfiler::Scope scope(tickProfiler,"send","sender");
+			
+			/* Start the first queued message if the previous one is complete: */
+			OutboundQueue::Message message;
+			if(client->sendSize==0&&client->outboundQueue.front(message))
+				{
+				/* Copy the message into the client's contiguous send buffer, growing it if necessary: */
+				size_t messageSize=message->getDataSize();
+				if(client->sendBuffer==0||client->sendBuffer->getSize()<messageSize)
+					{
+					size_t bufferSize=client->sendBuffer!=0?client->sendBuffer->getSize()*2:size_t(MessagePool::MIN_BUFFER_SIZE);
+					while(bufferSize<messageSize)
+						bufferSize*=2;
+					delete client->sendBuffer;
+					client->sendBuffer=0;
+					client->sendBuffer=new IO::FixedMemoryFile(bufferSize);
+					}
+				client->sendBuffer->setWritePosAbs(0);
+				message->writeToSink(*client->sendBuffer);
+				client->sendBuffer->flush();
+				client->sendSize=messageSize;
+				client->sendOffset=0;
+				
+				/* Remove the message from the queue, and hand it back to the client's pool for the next server update: */
+				client->outboundQueue.pop();
+				client->messagePool.release(message);
+				}
+			
+			if(client->sendSize>0)
+				wouldBlock=!writeSendBuffer(client);
+			messagePending=client->sendSize>0||client->outboundQueue.getNumMessages()>0;
+			}
+		catch(std::runtime_error err)
+			{
+			/* Stop sending to the client; the next server update will disconnect it: */
+			std::cerr<<"CollaborationServer::senderThread: Stopped sending to client "<<client->clientID<<" due to exception "<<err.what()<<std::endl<<std::flush;
+			client->outboundFailed=true;
+			client->outboundQueue.clear();
+			}
+		
+		{
+		Threads::MutexCond::Lock senderLock(senderCond);
+		client->sending=false;
+		
+		if(!client->outboundFailed&&wouldBlock)
+			{
+			/* Park the client until its socket accepts more data, and disconnect it if that takes too long: */
+			struct epoll_event event;
+			memset(&event,0,sizeof(struct epoll_event));
+			event.events=EPOLLOUT|EPOLLONESHOT;
+			event.data.u32=client->clientID;
+			if(epoll_ctl(writableEpollFd,client->writableWatched?EPOLL_CTL_MOD:EPOLL_CTL_ADD,client->pipe->getFd(),&event)==0)
+				{
+				client->writableWatched=true;
+				client->waitingWritable=true;
+				client->sendDeadline=Misc::Time::now();
+				client->sendDeadline+=Misc::Time(sendTimeout);
+				}
+			else
+				{
+				std::cerr<<"CollaborationServer::senderThread: Stopped sending to client "<<client->clientID<<" due to error "<<strerror(errno)<<std::endl<<std::flush;
+				client->outboundFailed=true;
+				client->sendScheduled=false;
+				}
+			}
+		else if(!client->outboundFailed&&messagePending)
+			{
+			/* Put the client at the end of the schedule: */
+			readyClients.push_back(client);
+			}
+		else
+			client->sendScheduled=false;
+		
+		/* Wake up other sender threads, and any server update waiting to remove the client: */
+		senderCond.broadcast();
+		}
+		}
+	
+	return 0;
+	}
+
+void* CollaborationServer::writableThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next parked client's socket to become writable: */
+		struct epoll_event event;
+		int numEvents=epoll_wait(writableEpollFd,&event,1,-1);
+		if(numEvents<0&&errno!=EINTR)
+			{
+			std::cerr<<"CollaborationServer::writableThread: Terminating writable thread due to error "<<strerror(errno)<<std::endl<<std::flush;
+			break;
+			}
+		if(numEvents<=0)
+			continue;
+		
+		/* Find the client by its ID while holding the client table lock, as it might have been removed since it was parked: */
+		Threads::Mutex::Lock clientTableLock(clientTableMutex);
+		ClientConnection* client=clientTable.find(event.data.u32);
+		if(client!=0)
+			{
+			/* Return the client to the sender schedule: */
+			Threads::MutexCond::Lock senderLock(senderCond);
+			if(client->waitingWritable&&!client->outboundFailed)
+				{
+				client->waitingWritable=false;
+				readyClients.push_back(client);
+				senderCond.broadcast();
+				}
+			}
+		}
+	
+	return 0;
+	}
+
+void* CollaborationServer::datagramThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	ClientState pose;
+	while(true)
+		{
+		/* Wait for the next datagram: */
+		DatagramChannel::Address sender;
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> datagram;
+		try
+			{
+			datagram.setTarget(datagramChannel->receive(sender));
+			}
+		catch(std::runtime_error err)
+			{
+			std::cerr<<"CollaborationServer::datagramThread: Terminating datagram thread due to exception "<<err.what()<<std::endl;
+			break;
+			}
+		
+		try
+			{
+			/* Read the datagram's header and the client's pose: */
+			unsigned int clientID=datagram->read<Card>();
+			unsigned int token=datagram->read<Card>();
+			unsigned int sequence=datagram->read<Card>();
+			readPose(pose,*datagram);
+			
+			/* Find the client while holding the client table lock, so the client cannot be deleted while its pose is posted: */
+			Threads::Mutex::Lock clientTableLock(clientTableMutex);
+			ClientConnection* client=clientTable.find(clientID);
+			
+			/* Drop unauthenticated datagrams, datagrams that arrive after a newer one, and datagrams from other than the client's first authenticated address: */
+			if(client!=0&&client->datagramIndex>=0&&token==client->datagramToken&&int(sequence-client->datagramSequence)>0
+			   &&(!client->datagramSenderKnown||(sender.sin_addr.s_addr==client->datagramSender.sin_addr.s_addr&&sender.sin_port==client->datagramSender.sin_port)))
+				{
+				/* Bind the client's datagrams to the sender's address, so a replayed or forged datagram cannot redirect the client's poses: */
+				if(!client->datagramSenderKnown)
+					{
+					client->datagramSenderKnown=true;
+					client->datagramSender=sender;
+					}
+				
+				/* Post the pose to the server update: */
+				client->datagramSequence=sequence;
+				ClientConnection::PoseSnapshot& snapshot=client->poseSnapshots.startNewValue();
+				snapshot.pose=pose;
+				snapshot.address=sender;
+				client->poseSnapshots.postNewValue();
+				}
+			}
+		catch(std::runtime_error err)
+			{
+			/* Ignore malformed datagrams: */
+			}
+		}
+	
+	return 0;
+	}
+
+void* CollaborationServer::metricsThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next scrape: */
+		int connectionFd=accept(metricsSocketFd,0,0);
+		if(connectionFd<0)
+			{
+			if(errno==EINTR||errno==ECONNABORTED)
+				continue;
+			std::cerr<<"CollaborationServer::metricsThread: Terminating metrics thread due to error "<<strerror(errno)<<std::endl;
+			break;
+			}
+		
+		/* Do not cancel the thread while it holds server locks or the connection: */
+		Threads::Thread::setCancelState(Threads::Thread::CANCEL_DISABLE);
+		
+		/* Time out stalled scrapers, so they cannot hold up server shutdown: */
+		struct timeval timeout;
+		timeout.tv_sec=1;
+		timeout.tv_usec=0;
+		setsockopt(connectionFd,SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(struct timeval));
+		setsockopt(connectionFd,SOL_SOCKET,SO_SNDTIMEO,&timeout,sizeof(struct timeval));
+		
+		/* Read the request header; every request is answered with the current metrics: */
+		char request[1024];
+		size_t requestSize=0;
+		while(requestSize<sizeof(request)-1)
+			{
+			ssize_t readSize=recv(connectionFd,request+requestSize,sizeof(request)-1-requestSize,0);
+			if(readSize<=0)
+				break;
+			requestSize+=readSize;
+			request[requestSize]='\0';
+			if(strstr(request,"\r\n\r\n")!=0)
+				break;
+			}
+		
+		if(requestSize>0)
+			{
+			/* Assemble the reply: */
+			std::ostringstream body;
+			writeMetrics(body);
+			std::string bodyString=body.str();
+			std::ostringstream reply;
+			reply<<"HTTP/1.0 200 OK\r\n";
+			reply<<"Content-Type: text/plain; version=0.0.4\r\n";
+			reply<<"Content-Length: "<<bodyString.size()<<"\r\n";
+			reply<<"Connection: close\r\n\r\n";
+			reply<<bodyString;
+			std::string replyString=reply.str();
+			
+			/* Send the reply: */
+			const char* replyPtr=replyString.data();
+			size_t replySize=replyString.size();
+			while(replySize>0)
+				{
+				ssize_t writeSize=send(connectionFd,replyPtr,replySize,MSG_NOSIGNAL);
+				if(writeSize<=0)
+					break;
+				replyPtr+=writeSize;
+				replySize-=writeSize;
+				}
+			}
+		
+		close(connectionFd);
+		Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+		}
+	
+	return 0;
+	}
+
+void CollaborationServer::sendPoseDatagrams(CollaborationServer::Session* session,CollaborationServer::ClientConnection* destClient,bool interestRefresh)
+	{
+	/* Create the session's datagram buffers on first use: */
+	if(session->datagramEntry==0)
+		{
+		session->datagramEntry=DatagramChannel::createDatagram();
+		session->datagram=DatagramChannel::createDatagram();
+		}
+	IO::VariableMemoryFile& entry=*session->datagramEntry;
+	IO::VariableMemoryFile& datagram=*session->datagram;
+	bool datagramStarted=false;
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		{
+		ClientConnection* sourceClient=*clIt;
+		
+		/* Skip the destination itself, and clients whose poses did not change recently: */
+		if(sourceClient==destClient||session->updateCounter-sourceClient->poseChangeCounter>=datagramRedundancy)
+			continue;
+		
+		/* Skip clients outside the destination's area of interest, except during refreshes: */
+		if(session->interestGrid!=0&&!interestRefresh&&!destClient->interestingClients.isEntry(sourceClient->clientID))
+			continue;
+		
+		/* Write the client's ID and pose: */
+		entry.clear();
+		entry.write<Card>(sourceClient->clientID);
+		writePose(sourceClient->state,entry);
+		
+		/* Send the current datagram if the pose does not fit anymore: */
+		if(datagramStarted&&datagram.getDataSize()+entry.getDataSize()>DatagramChannel::MAX_DATAGRAM_SIZE)
+			{
+			datagramChannel->send(datagram,destClient->datagramAddress);
+			datagramStarted=false;
+			}
+		
+		if(!datagramStarted)
+			{
+			/* Start a new datagram with the destination's token and the session's update counter as sequence number: */
+			datagram.clear();
+			datagram.write<Card>(destClient->datagramToken);
+			datagram.write<Card>(session->updateCounter);
+			datagramStarted=true;
+			}
+		
+		/* Append the pose: */
+		entry.writeToSink(datagram);
+		}
+	
+	/* Send the last datagram: */
+	if(datagramStarted)
+		datagramChannel->send(datagram,destClient->datagramAddress);
+	}
+
+void CollaborationServer::killClient(CollaborationServer::ClientConnection* client,std::vector<CollaborationServer::ClientConnection*>& deadClientList)
+	{
+	#ifdef VERBOSE
+	std::cout<<"CollaborationServer::update: Disconnecting client from host "<<client->clientHostname<<", port "<<client->clientPortId<<std::endl<<std::flush;
+	#endif
+	
+	/* Stop sending to the client: */
+	client->killed=true;
+	client->outboundFailed=true;
+	
+	if(eventLoop)
+		{
+		/* Shut down the client's socket; the I/O thread serving the client will remove it: */
+		shutdown(client->pipe->getFd(),SHUT_RDWR);
+		}
+	else
+		{
+		/* Stop client communication thread: */
+		client->communicationThread.cancel();
+		client->communicationThread.join();
+		
+		/* Properly disconnect the client on the next update: */
+		deadClientList.push_back(client);
+		}
+	}
+
+void CollaborationServer::acceptRelayLink(CollaborationServer::ClientConnection* client)
+	{
+	/* Acknowledge the relay link by accepting the reserved relay entry as the only protocol: */
+	{
+	Threads::Mutex::Lock pipeLock(client->pipeMutex);
+	writeMessage(CONNECT_REPLY,*client->pipe);
+	client->pipe->write<Card>(1);
+	client->pipe->write<Card>(client->relayIndex);
+	client->pipe->write<Card>(0);
+	client->pipe->flush();
+	}
+	
+	if(eventLoop)
+		{
+		/* Let the relay link wait for data indefinitely: */
+		struct timeval timeout;
+		timeout.tv_sec=0;
+		timeout.tv_usec=0;
+		if(setsockopt(client->pipe->getFd(),SOL_SOCKET,SO_RCVTIMEO,&timeout,sizeof(struct timeval))!=0)
+			Misc::throwStdErr("Unable to reset receive timeout on relay link socket");
+		}
+	
+	/* Find the address on which the server listens for clients: */
+	struct sockaddr_storage listenAddress;
+	socklen_t listenAddressLen=sizeof(listenAddress);
+	if(getsockname(listenSocket.getFd(),reinterpret_cast<struct sockaddr*>(&listenAddress),&listenAddressLen)!=0)
+		Misc::throwStdErr("Unable to query listening socket address");
+	std::string channelHostName;
+	if(listenAddress.ss_family==AF_INET6)
+		{
+		/* Connect through the IPv6 loopback address if the server listens on all interfaces: */
+		const struct sockaddr_in6* address6=reinterpret_cast<const struct sockaddr_in6*>(&listenAddress);
+		if(IN6_IS_ADDR_UNSPECIFIED(&address6->sin6_addr))
+			channelHostName="::1";
+		}
+	else if(listenAddress.ss_family==AF_INET)
+		{
+		/* Connect through the IPv4 loopback address if the server listens on all interfaces: */
+		const struct sockaddr_in* address4=reinterpret_cast<const struct sockaddr_in*>(&listenAddress);
+		if(address4->sin_addr.s_addr==htonl(INADDR_ANY))
+			channelHostName="127.0.0.1";
+		}
+	if(channelHostName.empty())
+		{
+		/* Connect to the exact address to which the listening socket is bound: */
+		char hostName[NI_MAXHOST];
+		if(getnameinfo(reinterpret_cast<const struct sockaddr*>(&listenAddress),listenAddressLen,hostName,sizeof(hostName),0,0,NI_NUMERICHOST)!=0)
+			Misc::throwStdErr("Unable to format listening socket address");
+		channelHostName=hostName;
+		}
+	
+	/* Create a relay link connecting all channels opened by the relay back to this server: */
+	RelayLink* link=new RelayLink(client->pipe,channelHostName,listenSocket.getPortId(),sendTimeout);
+	
+	{
+	Threads::Mutex::Lock relayLinkLock(relayLinkMutex);
+	relayLinks.push_back(link);
+	}
+	
+	#ifdef VERBOSE
+	std::cout<<"CollaborationServer: Accepted relay link from host "<<client->clientHostname<<", port "<<client->clientPortId<<std::endl<<std::flush;
+	#endif
+	}
+
+CollaborationServer::Session* CollaborationServer::getSession(const std::string& sessionName)
+	{
+	/* Lock the session list: */
+	Threads::Mutex::Lock sessionListLock(sessionListMutex);
+	
+	/* Find the session of the given name: */
+	Session* result=0;
+	for(SessionList::iterator sIt=sessions.begin();sIt!=sessions.end();++sIt)
+		if((*sIt)->name==sessionName)
+			{
+			result=*sIt;
+			break;
+			}
+	
+	if(result==0)
+		{
+		/* Start a new session: */
+		result=new Session(this,sessionName);
+		sessions.push_back(result);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Starting session \""<<sessionName<<"\""<<std::endl<<std::flush;
+		#endif
+		}
+	
+	++result->numReferences;
+	return result;
+	}
+
+void CollaborationServer::getSessions(CollaborationServer::SessionList& sessionList)
+	{
+	/* Lock the session list: */
+	Threads::Mutex::Lock sessionListLock(sessionListMutex);
+	
+	/* Reference and return all sessions: */
+	for(SessionList::iterator sIt=sessions.begin();sIt!=sessions.end();++sIt)
+		{
+		++(*sIt)->numReferences;
+		sessionList.push_back(*sIt);
+		}
+	}
+
+void CollaborationServer::releaseSession(CollaborationServer::Session* session)
+	{
+	/* Lock the session list: */
+	Threads::Mutex::Lock sessionListLock(sessionListMutex);
+	
+	if(--session->numReferences==0)
+		{
+		/* Remove the session from the list: */
+		for(SessionList::iterator sIt=sessions.begin();sIt!=sessions.end();++sIt)
+			if(*sIt==session)
+				{
+				sessions.erase(sIt);
+				break;
+				}
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Ending session \""<<session->name<<"\""<<std::endl<<std::flush;
+		#endif
+		
+		/* Delete the session: */
+		delete session;
+		}
+	}
+
+CollaborationServer::CollaborationServer(CollaborationServer::Configuration* sConfiguration)
+	:configuration(sConfiguration!=0?sConfiguration:new Configuration),
+	 protocolLoader(configuration->cfg.retrieveString("./pluginDsoNameTemplate",COLLABORATION_PLUGINDSONAMETEMPLATE)),
+	 listenSocket(configuration->cfg.retrieveValue<int>("./listenPortId",-1),0),
+	 eventLoop(configuration->cfg.retrieveValue<bool>("./eventLoop",false)),
+	 ioTimeout(configuration->cfg.retrieveValue<double>("./ioTimeout",5.0)),
+	 epollFd(-1),
+	 numIoThreads(configuration->cfg.retrieveValue<unsigned int>("./numIoThreads",4)),
+	 ioThreads(0),
+	 sendTimeout(configuration->cfg.retrieveValue<double>("./sendTimeout",5.0)),
+	 acceptRelayLinks(configuration->cfg.retrieveValue<bool>("./acceptRelayLinks",false)),
+	 maxQueueDepth(configuration->cfg.retrieveValue<unsigned int>("./maxQueueDepth",16)),
+	 maxQueueSize(configuration->cfg.retrieveValue<unsigned int>("./maxQueueSize",16*1024*1024)),
+	 slowClientPolicy(COALESCE_STATES),
+	 slowClientTimeout(configuration->cfg.retrieveValue<double>("./slowClientTimeout",10.0)),
+	 numSenderThreads(configuration->cfg.retrieveValue<unsigned int>("./numSenderThreads",2)),
+	 senderThreads(0),
+	 writableEpollFd(-1),
+	 interestRadius(configuration->cfg.retrieveValue<Scalar>("./interestRadius",Scalar(0))),
+	 interestLeaveRadius(interestRadius*(Scalar(1)+configuration->cfg.retrieveValue<Scalar>("./interestHysteresis",Scalar(0.25)))),
+	 outOfInterestInterval(configuration->cfg.retrieveValue<unsigned int>("./outOfInterestInterval",10)),
+	 interestCellSize(configuration->cfg.retrieveValue<Scalar>("./interestCellSize",interestRadius)),
+	 updatePool(0),hookPool(0),
+	 datagramChannel(0),
+	 datagramRedundancy(configuration->cfg.retrieveValue<unsigned int>("./datagramRedundancy",3)),
+	 deltaStates(configuration->cfg.retrieveValue<bool>("./deltaStates",false)),
+	 poseCodec(configuration->cfg.retrieveValue<unsigned int>("./posePositionBits",0),configuration->cfg.retrieveValue<unsigned int>("./poseRotationBits",0)),
+	 compressionThreshold(configuration->cfg.retrieveValue<unsigned int>("./compressionThreshold",0)),
+	 protocolTable(new ProtocolTable),
+	 clientArrivalFd(-1),
+	 metricsSocketFd(-1),
+	 tickProfiler(0),
+	 sessionRecorder(0)
+	{
+	typedef std::vector<std::string> StringList;
+	
+	/* Determine how to treat clients that cannot keep up with server updates: */
+	std::string policyName=configuration->cfg.retrieveString("./slowClientPolicy","CoalesceStates");
+	if(policyName=="CoalesceStates")
+		slowClientPolicy=COALESCE_STATES;
+	else if(policyName=="DropMedia")
+		slowClientPolicy=DROP_MEDIA;
+	else if(policyName=="Disconnect")
+		slowClientPolicy=DISCONNECT;
+	else
+		Misc::throwStdErr("CollaborationServer::CollaborationServer: Unknown slow client policy %s",policyName.c_str());
+	
+	/* Limit the number of spatial index cells each area of interest query visits, which grows with the cube of the radius over the cell size: */
+	if(interestRadius>Scalar(0)&&!(interestCellSize>=interestRadius*Scalar(0.5)))
+		{
+		std::cerr<<"CollaborationServer: Raising interest cell size "<<interestCellSize<<" to half the interest radius "<<interestRadius<<std::endl;
+		interestCellSize=interestRadius*Scalar(0.5);
+		}
+	
+	/* Get additional search paths from configuration file section and add them to the object loader: */
+	StringList pluginSearchPaths=configuration->cfg.retrieveValue<StringList>("./pluginSearchPaths",StringList());
+	for(StringList::const_iterator tspIt=pluginSearchPaths.begin();tspIt!=pluginSearchPaths.end();++tspIt)
+		{
+		/* Add the path: */
+		protocolLoader.getDsoLocator().addPath(*tspIt);
+		}
+	
+	/* Initialize the protocol message table to have invalid entries for the protocol's own messages: */
+	for(unsigned int i=0;i<MESSAGES_END;++i)
+		protocolTable->messageTable.push_back(0);
+	
+	/* Load and initialize the configured protocol plug-ins up front, so that connecting clients do not have to wait for them: */
+	StringList preloadProtocols=configuration->cfg.retrieveValue<StringList>("./preloadProtocols",StringList());
+	for(StringList::const_iterator ppIt=preloadProtocols.begin();ppIt!=preloadProtocols.end();++ppIt)
+		loadProtocol(*ppIt);
+	
+	/* Create the datagram channel if requested: */
+	int datagramPortId=configuration->cfg.retrieveValue<int>("./datagramPortId",-1);
+	if(datagramPortId>=0)
+		{
+		datagramChannel=new DatagramChannel(datagramPortId);
+		datagramChannel->setLossRate(configuration->cfg.retrieveValue<double>("./datagramLossRate",0.0));
+		if(datagramRedundancy<1)
+			datagramRedundancy=1;
+		datagramThread.start(this,&CollaborationServer::datagramThreadMethod);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Exchanging poses by datagram on UDP port "<<datagramChannel->getPortId()<<std::endl<<std::flush;
+		#endif
+		}
+	
+	#ifdef VERBOSE
+	if(poseCodec.isQuantized())
+		std::cout<<"CollaborationServer: Offering quantized poses with maximum position error "<<poseCodec.getMaxPositionError(Scalar(1))<<" display sizes and maximum rotation error "<<poseCodec.getMaxRotationError()<<" radians"<<std::endl<<std::flush;
+	#endif
+	
+	/* Create the client arrival event: */
+	clientArrivalFd=eventfd(0,EFD_NONBLOCK);
+	if(clientArrivalFd<0)
+		Misc::throwStdErr("CollaborationServer::CollaborationServer: Unable to create client arrival event");
+	
+	/* Create the tick profiler if requested: */
+	unsigned int profileTicks=configuration->cfg.retrieveValue<unsigned int>("./profileTicks",0);
+	if(profileTicks>0)
+		{
+		unsigned int profileEvents=configuration->cfg.retrieveValue<unsigned int>("./profileEvents",4096);
+		double profileThreshold=configuration->cfg.retrieveValue<double>("./profileThreshold",0.0);
+		std::string profileFileNamePrefix=configuration->cfg.retrieveString("./profileFileNamePrefix","CollaborationServerProfile");
+		tickProfiler=new TickProfiler(profileTicks,profileEvents,profileThreshold,profileFileNamePrefix);
+		}
+	
+	/* Start recording all traffic received from clients if requested: */
+	std::string recordFileName=configuration->cfg.retrieveString("./recordFileName","");
+	if(!recordFileName.empty())
+		{
+		sessionRecorder=new SessionRecorder(recordFileName);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Recording client traffic to "<<recordFileName<<std::endl<<std::flush;
+		#endif
+		}
+	
+	/* Open the metrics socket if requested; it only accepts connections from the local host: */
+	int metricsPortId=configuration->cfg.retrieveValue<int>("./metricsPortId",-1);
+	if(metricsPortId>=0)
+		{
+		metricsSocketFd=socket(PF_INET,SOCK_STREAM,0);
+		if(metricsSocketFd<0)
+			Misc::throwStdErr("CollaborationServer::CollaborationServer: Unable to create metrics socket");
+		int reuseAddress=1;
+		setsockopt(metricsSocketFd,SOL_SOCKET,SO_REUSEADDR,&reuseAddress,sizeof(int));
+		struct sockaddr_in socketAddress;
+		memset(&socketAddress,0,sizeof(struct sockaddr_in));
+		socketAddress.sin_family=AF_INET;
+		socketAddress.sin_port=htons(metricsPortId);
+		socketAddress.sin_addr.s_addr=htonl(INADDR_LOOPBACK);
+		if(bind(metricsSocketFd,(struct sockaddr*)&socketAddress,sizeof(struct sockaddr_in))!=0||listen(metricsSocketFd,4)!=0)
+			{
+			close(metricsSocketFd);
+			Misc::throwStdErr("CollaborationServer::CollaborationServer: Unable to listen for metrics scrapes on port %d",metricsPortId);
+			}
+		metricsThread.start(this,&CollaborationServer::metricsThreadMethod);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Serving metrics on local TCP port "<<metricsPortId<<std::endl<<std::flush;
+		#endif
+		}
+	
+	/* Start the session update threads: */
+	unsigned int numUpdateThreads=configuration->cfg.retrieveValue<unsigned int>("./numUpdateThreads",1);
+	if(numUpdateThreads>1)
+		updatePool=new WorkerPool(numUpdateThreads);
+	
+	/* Start the threads running per-client protocol hooks: */
+	unsigned int numHookThreads=configuration->cfg.retrieveValue<unsigned int>("./numHookThreads",1);
+	if(numHookThreads>1)
+		hookPool=new WorkerPool(numHookThreads);
+	
+	/* Start the sender threads: */
+	if(numSenderThreads<1)
+		numSenderThreads=1;
+	senderThreads=new Threads::Thread[numSenderThreads];
+	for(unsigned int i=0;i<numSenderThreads;++i)
+		senderThreads[i].start(this,&CollaborationServer::senderThreadMethod);
+	
+	/* Create the epoll set watching the sockets of clients that did not accept more data, and start the thread watching it: */
+	writableEpollFd=epoll_create(64);
+	if(writableEpollFd<0)
+		Misc::throwStdErr("CollaborationServer::CollaborationServer: Unable to create writable socket set");
+	writableThread.start(this,&CollaborationServer::writableThreadMethod);
+	
+	if(eventLoop)
+		{
+		/* Create the event loop's epoll set and watch the listening socket: */
+		epollFd=epoll_create(64);
+		if(epollFd<0)
+			Misc::throwStdErr("CollaborationServer::CollaborationServer: Unable to create event loop");
+		watchSocket(listenSocket.getFd(),0,true);
+		
+		/* Start the I/O threads: */
+		if(numIoThreads<1)
+			numIoThreads=1;
+		ioThreads=new Threads::Thread[numIoThreads];
+		for(unsigned int i=0;i<numIoThreads;++i)
+			ioThreads[i].start(this,&CollaborationServer::ioThreadMethod);
+		
+		#ifdef VERBOSE
+		std::cout<<"CollaborationServer: Serving clients from "<<numIoThreads<<" event-driven I/O threads"<<std::endl<<std::flush;
+		#endif
+		}
+	else
+		{
+		/* Start connection initiating thread: */
+		listenThread.start(this,&CollaborationServer::listenThreadMethod);
+		}
+	}
+
+CollaborationServer::~CollaborationServer(void)
+	{
+	#ifdef VERBOSE
+	std::cout<<"CollaborationServer: Shutting down server"<<std::endl<<std::flush;
+	#endif
+	
+	{
+	/* Lock session list: */
+	Threads::Mutex::Lock sessionListLock(sessionListMutex);
+	
+	if(eventLoop)
+		{
+		/* Stop all I/O threads: */
+		for(unsigned int i=0;i<numIoThreads;++i)
+			{
+			ioThreads[i].cancel();
+			ioThreads[i].join();
+			}
+		delete[] ioThreads;
+		close(epollFd);
+		}
+	else
+		{
+		/* Stop connection initiating thread: */
+		listenThread.cancel();
+		listenThread.join();
+		}
+	
+	/* Stop all sender threads: */
+	for(unsigned int i=0;i<numSenderThreads;++i)
+		{
+		senderThreads[i].cancel();
+		senderThreads[i].join();
+		}
+	delete[] senderThreads;
+	
+	/* Stop the writable thread: */
+	writableThread.cancel();
+	writableThread.join();
+	close(writableEpollFd);
+	
+	/* Stop the session update and hook threads: */
+	delete updatePool;
+	delete hookPool;
+	
+	if(datagramChannel!=0)
+		{
+		/* Stop the datagram thread and close the datagram channel: */
+		datagramThread.cancel();
+		datagramThread.join();
+		delete datagramChannel;
+		}
+	
+	if(metricsSocketFd>=0)
+		{
+		/* Stop the metrics thread and close the metrics socket: */
+		metricsThread.cancel();
+		metricsThread.join();
+		close(metricsSocketFd);
+		}
+	
+	/* Close the client arrival event: */
+	close(clientArrivalFd);
+	
+	/* Close all relay links: */
+	{
+	Threads::Mutex::Lock relayLinkLock(relayLinkMutex);
+	for(std::vector<RelayLink*>::iterator rlIt=relayLinks.begin();rlIt!=relayLinks.end();++rlIt)
+		delete *rlIt;
+	relayLinks.clear();
+	}
+	
+	for(SessionList::iterator sIt=sessions.begin();sIt!=sessions.end();++sIt)
+		{
+		ClientList& clientList=(*sIt)->clientList;
+		if(!clientList.empty())
+			{
+			#ifdef VERBOSE
+			std::cout<<"CollaborationServer: Disconnecting "<<clientList.size()<<" clients from session \""<<(*sIt)->name<<"\""<<std::endl<<std::flush;
+			#endif
+			
+			/* Disconnect all clients: */
+			for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
+				{
+				if(!eventLoop)
+					{
+					Threads::Mutex::Lock clientLock((*clIt)->mutex);
+					
+					/* Stop client communication thread: */
+					(*clIt)->communicationThread.cancel();
+					(*clIt)->communicationThread.join();
+					}
+				
+				/* Delete client connection state structure (closing TCP pipe): */
+				destroyClient(*clIt);
+				}
+			}
+		
+		/* Delete the session: */
+		delete *sIt;
+		}
+	sessions.clear();
+	}
+	
+	/* Delete all protocol plug-ins: */
+	for(ProtocolList::iterator pIt=protocolTable->protocols.begin();pIt!=protocolTable->protocols.end();++pIt)
+		{
+		/* Only delete the protocol plug-in if it is not managed by the protocol loader: */
+		if(!protocolLoader.isManaged(*pIt))
+			delete *pIt;
+		}
+	
+	/* Delete all protocol tables: */
+	delete protocolTable;
+	for(std::vector<ProtocolTable*>::iterator ptIt=retiredProtocolTables.begin();ptIt!=retiredProtocolTables.end();++ptIt)
+		delete *ptIt;
+	
+	/* Delete the tick profiler and close the session log: */
+	delete tickProfiler;
+	delete sessionRecorder;
+	
+	/* Delete the configuration object: */
+	delete configuration;
+	}
+
+std::pair<ProtocolServer*,int> CollaborationServer::addProtocol(ProtocolServer* newProtocol)
+	{
+	/* Extend a copy of the current protocol table; only threads holding the protocol load mutex change the table: */
+	ProtocolTable* newTable=new ProtocolTable(*protocolTable);
+	int index=int(newTable->protocols.size());
+	newTable->protocols.push_back(newProtocol);
+	newTable->protocolIndices.setEntry(ProtocolIndexMap::Entry(newProtocol->getName(),index));
+	
+	/* Register message IDs for the new protocol: */
+	newProtocol->messageIdBase=newTable->messageTable.size();
+	unsigned int numMessages=newProtocol->getNumMessages();
+	newProtocol->receivedMessages.resize(numMessages);
+	for(unsigned int i=0;i<numMessages;++i)
+		newTable->messageTable.push_back(newProtocol);
+	#ifdef VERBOSE
+	if(numMessages>0)
+		std::cout<<"Protocol "<<newProtocol->getName()<<" is assigned message IDs "<<newProtocol->messageIdBase<<" to "<<newProtocol->messageIdBase+numMessages-1<<std::endl;
+	#endif
+	
+	/* Publish the extended table, and retire the old one: */
+	{
+	Threads::Spinlock::Lock protocolTableLock(protocolTableMutex);
+	retiredProtocolTables.push_back(protocolTable);
+	protocolTable=newTable;
+	}
+	
+	return std::pair<ProtocolServer*,int>(newProtocol,index);
+	}
+
+void CollaborationServer::registerProtocol(ProtocolServer* newProtocol)
+	{
+	/* Simply add the protocol to the table; already-connected clients won't be able to use it: */
+	Threads::Mutex::Lock protocolLoadLock(protocolLoadMutex);
+	addProtocol(newProtocol);
+	}
+
+std::pair<ProtocolServer*,int> CollaborationServer::loadProtocol(std::string protocolName)
+	{
+	/* Check if a protocol plug-in of the given name already exists, without blocking other threads: */
+	const ProtocolTable* table=getProtocolTable();
+	ProtocolIndexMap::ConstIterator piIt=table->protocolIndices.findEntry(protocolName);
+	if(!piIt.isFinished())
+		return std::pair<ProtocolServer*,int>(table->protocols[piIt->getDest()],int(piIt->getDest()));
+	
+	/* Serialize loading, and check again in case another thread loaded the plug-in in the meantime: */
+	Threads::Mutex::Lock protocolLoadLock(protocolLoadMutex);
+	table=protocolTable;
+	piIt=table->protocolIndices.findEntry(protocolName);
+	if(!piIt.isFinished())
+		return std::pair<ProtocolServer*,int>(table->protocols[piIt->getDest()],int(piIt->getDest()));
+	
+	std::pair<ProtocolServer*,int> result=std::pair<ProtocolServer*,int>(0,-1);
+	
+	/* Try loading a protocol plug-in dynamically: */
+	try
+		{
+		#ifdef VERBOSE
+		std::cout<<"Loading protocol plug-in "<<protocolName<<"Server"<<std::endl;
+		#endif
+		ProtocolServer* newProtocol=protocolLoader.createObject((protocolName+"Server").c_str());
+		
+		/* Initialize the protocol before other threads can see it: */
+		Misc::ConfigurationFileSection protocolSection=configuration->cfg.getSection(protocolName.c_str());
+		newProtocol->initialize(this,protocolSection);
+		
+		/* Append the new protocol plug-in to the table: */
+		result=addProtocol(newProtocol);
+		}
+	catch(std::runtime_error err)
+		{
+		/* Print an error message and carry on: */
+		std::cerr<<"CollaborationServer::loadProtocol: Caught exception "<<err.what()<<" while loading protocol "<<protocolName<<std::endl;
+		}
+	
+	return result;
+	}
+
+void CollaborationServer::freezeClients(CollaborationServer::Session* session,unsigned int begin,unsigned int end,CollaborationServer::HookSelection hooks)
+	{
+	for(unsigned int i=begin;i<end;++i)
+		{
+		ClientConnection* client=session->clientList[i];
+		
+		if(hooks!=OTHER_HOOKS)
+			{
+			/* Pick up the client's most recently published state: */
+			client->consumeState();
+			if(client->state.updateMask&ClientState::POSE)
+				client->poseChangeCounter=session->updateCounter;
+			}
+		
+		/* Let the selected plug-in protocols take snapshots of their client states while briefly locking out the client's communication thread: */
+		Threads::Mutex::Lock clientLock(client->mutex);
+		for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+			if(hooks==ALL_HOOKS||cplIt->protocol->hasThreadSafeClientHooks()==(hooks==THREAD_SAFE_HOOKS))
+				{
+				TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::BEFORE_SERVER_UPDATE);
+				cplIt->protocol->beforeServerUpdate(cplIt->protocolClientState);
+				}
+		}
+	}
+
+void CollaborationServer::writeUpdateMessages(CollaborationServer::Session* session,unsigned int begin,unsigned int end)
+	{
+	/* Assemble update messages for the range of clients: */
+	const ClientList& addedClients=session->addedClients;
+	for(unsigned int i=begin;i<end;++i)
+		{
+		ClientConnection* destClient=session->clientList[i];
+		if(destClient->killed)
+			continue;
+		destClient->updateFailed=false;
+		
+		/* Determine how to treat the client if it cannot keep up: */
+		bool coalesceStates=destClient->congested&&slowClientPolicy==COALESCE_STATES;
+		bool dropMedia=destClient->congested&&slowClientPolicy==DROP_MEDIA;
+		
+		try
+			{
+			/* Assemble the client's update message in memory, in the client's endianness, reusing a message the sender threads already wrote: */
+			OutboundQueue::Message message=destClient->messagePool.acquire(destClient->pipe->mustSwapOnWrite());
+			IO::VariableMemoryFile& pipe=*message;
+			
+			/* Check the client state action list for any actions relevant for this client: */
+			ClientList::const_iterator acIt=addedClients.begin();
+			for(ActionList::const_iterator alIt=session->actionList.begin();alIt!=session->actionList.end();++alIt,++acIt)
+				if(alIt->clientID!=destClient->clientID)
+					{
+					switch(alIt->action)
+						{
+						case ClientListAction::ADD_CLIENT:
+							{
+							/* Get the added client's state: */
+							ClientConnection* newClient=*acIt;
+							if(newClient!=0)
 								{
-								Threads::Mutex::Lock pipeLock(pipeMutex);
-								writeMessage(CONNECT_REPLY,pipe);
+								/* Lock the added client's protocol plug-in states: */
+								Threads::Mutex::Lock newClientLock(newClient->mutex);
 								
-								/* Write the number of negotiated protocols: */
-								pipe.write<Card>(client->protocols.size());
-								
-								/* Let all negotiated protocols insert their message payloads: */
-								for(ClientConnection::ClientProtocolList::const_iterator cpIt=client->protocols.begin();cpIt!=client->protocols.end();++cpIt)
-									{
-									/* Write the client's index of the protocol: */
-									pipe.write<Card>(cpIt->clientIndex);
-									
-									/* Write the protocol's message ID base: */
-									pipe.write<Card>(cpIt->protocol->messageIdBase);
-									
-									/* Write the protocol's message payload: */
-									cpIt->protocol->sendConnectReply(cpIt->protocolClientState,pipe);
-									}
+								/* Send a client connect message with the intersection of protocol plug-ins negotiated with both clients, encoded once for all destinations: */
+								newClient->writeClientConnect(destClient,session->updateCounter,pipe,tickProfiler);
 								
 								/* Process higher-level protocols: */
-								sendConnectReply(clientID,pipe);
-								
-								/* Send client connect messages for all clients that are already connected: */
-								{
-								Threads::Mutex::Lock clientListLock(clientListMutex);
-								for(ClientList::const_iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
-									{
-									Threads::Mutex::Lock clientLock((*clIt)->mutex);
-									
-									/* Send a client connect message: */
-									writeMessage(CLIENT_CONNECT,pipe);
-									pipe.write<Card>((*clIt)->clientID);
-									
-									/* Send the full client state: */
-									writeClientState(ClientState::FULL_UPDATE,(*clIt)->state,pipe);
-									
-									/* Send the intersection of protocol plug-ins negotiated with both clients to the client: */
-									(*clIt)->sendClientConnectProtocols(client,pipe);
-									
-									/* Process higher-level protocols: */
-									sendClientConnect((*clIt)->clientID,clientID,pipe);
-									}
-								
-								/* Add client action to list: */
-								clientAdded=true;
-								actionList.push_back(ClientListAction(ClientListAction::ADD_CLIENT,clientID,client));
-								}
-								
-								pipe.flush();
-								}
-								
-								#ifdef VERBOSE
-								std::cout<<"CollaborationServer: Connected client from host "<<client->clientHostname<<", port "<<client->clientPortId<<" as "<<client->state.clientName<<std::endl<<std::flush;
-								#endif
-								
-								state=CONNECTED;
+								sendClientConnect(newClient->clientID,destClient->clientID,pipe);
 								}
-							else
-								{
+							break;
+							}
+						
+						case ClientListAction::REMOVE_CLIENT:
+							{
+							/* Send a client disconnect message, unless the client just joined and never heard of the removed client: */
+							if(!destClient->joining)
 								{
-								Threads::Mutex::Lock pipeLock(pipeMutex);
-								
-								/* Reject the connection request: */
-								writeMessage(CONNECT_REJECT,pipe);
-								
-								/* Write the number of negotiated protocols (including the one that might have failed): */
-								pipe.write<Card>(client->protocols.size());
-								
-								/* Inform all protocol plug-ins that have seen the CONNECT_REQUEST message: */
-								for(ClientConnection::ClientProtocolList::const_iterator cpIt=client->protocols.begin();cpIt!=client->protocols.end();++cpIt)
-									{
-									/* Write the client's index of the protocol: */
-									pipe.write<Card>(cpIt->clientIndex);
-									
-									cpIt->protocol->sendConnectReject(cpIt->protocolClientState,pipe);
-									}
-								
-								if(higherLevelsSawRequest)
-									{
-									/* Process higher-level protocols: */
-									sendConnectReject(clientID,pipe);
-									}
-								
-								pipe.flush();
-								}
-								
-								state=FINISH;
+								writeMessage(CLIENT_DISCONNECT,pipe);
+								pipe.write<Card>(alIt->clientID);
 								}
+							
 							break;
 							}
+						}
+					}
+			
+			if(destClient->joining)
+				{
+				/* Send client connect messages for all clients that were already in the session, copied from their cached snapshots: */
+				for(ClientList::iterator cl2It=session->clientList.begin();cl2It!=session->clientList.end();++cl2It)
+					if(*cl2It!=destClient&&!(*cl2It)->joining)
+						{
+						ClientConnection* sourceClient=*cl2It;
 						
-						default:
-							/* Bail out: */
-							Misc::throwStdErr("Protocol error during connection initialization");
+						/* Lock the source client's protocol plug-in states: */
+						Threads::Mutex::Lock sourceClientLock(sourceClient->mutex);
+						
+						/* Send a client connect message with the intersection of protocol plug-ins negotiated with both clients: */
+						sourceClient->writeClientConnect(destClient,session->updateCounter,pipe,tickProfiler);
+						
+						/* Process higher-level protocols: */
+						sendClientConnect(sourceClient->clientID,destClient->clientID,pipe);
 						}
-					break;
-				
-				case CONNECTED:
+				}
+			
+			/* Process plug-in protocols for the client: */
+			for(ClientConnection::ClientProtocolList::iterator cplIt=destClient->protocols.begin();cplIt!=destClient->protocols.end();++cplIt)
+				{
+				size_t dataSize=pipe.getDataSize();
+				{
+				TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::BEFORE_SERVER_UPDATE);
+				cplIt->protocol->beforeServerUpdate(cplIt->protocolClientState,pipe);
+				}
+				cplIt->sentBytes+=pipe.getDataSize()-dataSize;
+				}
+			
+			/* Process higher-level protocols: */
+			beforeServerUpdate(destClient->clientID,pipe);
+			
+			/* Send the server update packet header: */
+			writeMessage(SERVER_UPDATE,pipe);
+			pipe.write<Card>(session->clientList.size()-1);
+			
+			/* Process plug-in protocols for the client: */
+			for(ClientConnection::ClientProtocolList::iterator cplIt=destClient->protocols.begin();cplIt!=destClient->protocols.end();++cplIt)
+				{
+				size_t dataSize=pipe.getDataSize();
+				{
+				TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::SEND_SERVER_UPDATE);
+				cplIt->protocol->sendServerUpdate(cplIt->protocolClientState,pipe);
+				}
+				cplIt->sentBytes+=pipe.getDataSize()-dataSize;
+				}
+			
+			/* Process higher-level protocols: */
+			sendServerUpdate(destClient->clientID,pipe);
+			
+			/* Determine whether clients outside the client's area of interest get a state refresh during this update: */
+			bool interestRefresh=outOfInterestInterval>0&&(session->updateCounter+destClient->clientID)%outOfInterestInterval==0;
+			
+			/* Leave poses out of the state updates if the client receives them by datagram: */
+			unsigned int reliableMask=destClient->datagramAddressValid?ClientState::FULL_UPDATE&~ClientState::POSE:ClientState::FULL_UPDATE;
+			int segmentVariant=(pipe.mustSwapOnWrite()?1:0)|(destClient->datagramAddressValid?2:0)|(destClient->poseCodec.isQuantized()?4:0);
+			
+			/* Send the states of all other clients: */
+			for(ClientList::iterator cl2It=session->clientList.begin();cl2It!=session->clientList.end();++cl2It)
+				if(*cl2It!=destClient)
+					{
+					ClientConnection* sourceClient=*cl2It;
 					
-					/*************************************************************
-					Handle message exchanges while the client is connected:
-					*************************************************************/
+					/* Check whether the source client is inside the client's area of interest: */
+					bool inInterest=session->interestGrid==0||destClient->interestingClients.isEntry(sourceClient->clientID);
 					
-					switch(message)
+					if(coalesceStates||!(inInterest||interestRefresh))
 						{
-						case CLIENT_UPDATE:
-							{
+						/* Withhold the source client's state update, and remember what changed: */
+						pipe.write<Card>(sourceClient->clientID);
+						writeClientState(ClientState::NO_CHANGE,sourceClient->state,pipe);
+						UpdateMaskMap::Iterator psmIt=destClient->pendingStateMasks.findEntry(sourceClient->clientID);
+						if(psmIt.isFinished())
+							destClient->pendingStateMasks.setEntry(UpdateMaskMap::Entry(sourceClient->clientID,sourceClient->state.updateMask));
+						else
+							psmIt->getDest()|=sourceClient->state.updateMask;
+						}
+					else if(destClient->deltaIndex>=0)
+						{
+						/* Include everything that changed while the source client's updates were withheld: */
+						unsigned int updateMask=sourceClient->state.updateMask;
+						UpdateMaskMap::Iterator psmIt=destClient->pendingStateMasks.findEntry(sourceClient->clientID);
+						if(!psmIt.isFinished())
 							{
-							/* Lock client state: */
-							Threads::Mutex::Lock clientLock(client->mutex);
-							
-							/* Read the client's updated client state: */
-							readClientState(client->state,pipe);
-							
-							/* Let protocol plug-ins read their own client update messages: */
-							for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
-								cplIt->protocol->receiveClientUpdate(cplIt->protocolClientState,pipe);
-							
-							/* Process higher-level protocols: */
-							receiveClientUpdate(clientID,pipe);
-							}
-							
-							break;
+							updateMask|=psmIt->getDest();
+							destClient->pendingStateMasks.removeEntry(psmIt);
 							}
 						
-						case DISCONNECT_REQUEST:
-							{
-							{
-							/* Lock client state: */
-							Threads::Mutex::Lock clientLock(client->mutex);
-							
-							/* Let protocol plug-ins read their own disconnect request messages: */
-							for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
-								cplIt->protocol->receiveDisconnectRequest(cplIt->protocolClientState,pipe);
-							
-							/* Process higher-level protocols: */
-							receiveDisconnectRequest(clientID,pipe);
-							
+						/* Find the source client state the destination already received, or send everything the first time: */
+						BaselineMap::Iterator dbIt=destClient->deltaBaselines.findEntry(sourceClient->clientID);
+						if(dbIt.isFinished())
 							{
-							Threads::Mutex::Lock pipeLock(pipeMutex);
-							
-							/* Send a disconnect reply: */
-							writeMessage(DISCONNECT_REPLY,pipe);
-							
-							/* Let protocol plug-ins insert their own disconnect reply messages: */
-							for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
-								cplIt->protocol->sendDisconnectReply(cplIt->protocolClientState,pipe);
-							
-							/* Process higher-level protocols: */
-							sendDisconnectReply(clientID,pipe);
-							
-							pipe.flush();
-							}
-							}
-							
-							/* Go to finish state: */
-							state=FINISH;
-							break;
+							destClient->deltaBaselines.setEntry(BaselineMap::Entry(sourceClient->clientID,StateDeltaCodec::Baseline()));
+							dbIt=destClient->deltaBaselines.findEntry(sourceClient->clientID);
+							updateMask|=ClientState::FULL_UPDATE&~ClientState::CLIENTNAME;
 							}
 						
-						default:
-							{
-							{
-							Threads::Mutex::Lock clientLock(client->mutex);
-							
-							/* Find the protocol that registered itself for this message ID: */
-							if(message<messageTable.size())
-								{
-								/* Find the protocol's client state object: */
-								ProtocolServer* protocol=messageTable[message];
-								ProtocolClientState* pcs=0;
-								for(ClientConnection::ClientProtocolList::iterator pclIt=client->protocols.begin();pclIt!=client->protocols.end();++pclIt)
-									if(pclIt->protocol==protocol)
-										pcs=pclIt->protocolClientState;
-								
-								/* Call on the protocol plug-in to handle the message: */
-								if(protocol==0||pcs==0||!protocol->handleMessage(pcs,message-protocol->messageIdBase,pipe))
-									{
-									/* Bail out: */
-									Misc::throwStdErr("Protocol error, received message %d",int(message));
-									}
-								}
-							else
-								{
-								/* Check for higher-level protocol messages: */
-								if(!handleMessage(clientID,pipe,message))
-									{
-									/* Bail out: */
-									Misc::throwStdErr("Protocol error, received message %d",int(message));
-									}
-								}
-							}
-							}
+						/* Send the source client's state update as differences against the destination's baseline: */
+						pipe.write<Card>(sourceClient->clientID);
+						StateDeltaCodec::writeClientState(updateMask&reliableMask,sourceClient->state,dbIt->getDest(),pipe);
 						}
-					break;
-				
-				default:
-					/* Just to make g++ happy... */
-					;
+					else if(destClient->pendingStateMasks.isEntry(sourceClient->clientID))
+						{
+						/* Send the source client's current state for everything that changed while its updates were withheld: */
+						pipe.write<Card>(sourceClient->clientID);
+						writeClientState((destClient->pendingStateMasks.getEntry(sourceClient->clientID).getDest()|sourceClient->state.updateMask)&reliableMask,sourceClient->state,destClient->poseCodec,pipe);
+						destClient->pendingStateMasks.removeEntry(sourceClient->clientID);
+						}
+					else
+						{
+						/* Send the source client's pre-encoded state update in the destination's endianness: */
+						sourceClient->updateSegments[segmentVariant]->writeToSink(pipe);
+						}
+					
+					/* Process plug-in protocols shared by the two clients, without bulk media data from clients outside the area of interest: */
+					sourceClient->sendServerUpdateProtocols(destClient,pipe,dropMedia||!inInterest,tickProfiler);
+					
+					/* Process higher-level protocols: */
+					sendServerUpdate(sourceClient->clientID,destClient->clientID,pipe);
+					}
+			
+			/* Keep the finished message until it is queued in client list order: */
+			destClient->updateMessage=message;
+			}
+		catch(std::runtime_error err)
+			{
+			/* Mark clients whose protocol plug-ins fail during a state update to be forcibly disconnected: */
+			std::cerr<<"CollaborationServer::update: Terminating client connection due to exception "<<err.what()<<std::endl;
+			destClient->updateMessage=0;
+			destClient->updateFailed=true;
+			}
+		}
+	}
+
+void CollaborationServer::finishClients(CollaborationServer::Session* session,unsigned int begin,unsigned int end,CollaborationServer::HookSelection hooks)
+	{
+	for(unsigned int i=begin;i<end;++i)
+		{
+		ClientConnection* client=session->clientList[i];
+		
+		/* Process the selected plug-in protocols for the client, and publish the payload sizes all plug-ins wrote for it during this update: */
+		for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+			{
+			if(hooks==ALL_HOOKS||cplIt->protocol->hasThreadSafeClientHooks()==(hooks==THREAD_SAFE_HOOKS))
+				{
+				TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::AFTER_SERVER_UPDATE);
+				cplIt->protocol->afterServerUpdate(cplIt->protocolClientState);
+				}
+			if(hooks!=OTHER_HOOKS&&cplIt->sentBytes!=0)
+				{
+				cplIt->protocol->sentBytes.add(cplIt->sentBytes);
+				cplIt->sentBytes=0;
 				}
 			}
 		}
-	catch(std::runtime_error err)
+	}
+
+void CollaborationServer::runUpdatePhase(CollaborationServer::Session* session,CollaborationServer::UpdatePhase phase,bool threadSafeHooks)
+	{
+	unsigned int numClients=session->clientList.size();
+	
+	/* Run the phase on this thread if there is no hook pool, or if some plug-ins cannot write update messages concurrently: */
+	if(hookPool==0||numClients<2||(phase==WRITE_UPDATES&&!threadSafeHooks))
 		{
-		/* Print error message to stderr and disconnect the client: */
-		std::cerr<<"CollaborationServer::clientCommunicationThread: Terminating client connection due to exception "<<err.what()<<std::endl<<std::flush;
+		switch(phase)
+			{
+			case FREEZE_CLIENTS:
+				freezeClients(session,0,numClients,ALL_HOOKS);
+				break;
+			
+			case WRITE_UPDATES:
+				writeUpdateMessages(session,0,numClients);
+				break;
+			
+			case FINISH_CLIENTS:
+				finishClients(session,0,numClients,ALL_HOOKS);
+				break;
+			}
+		return;
+		}
+	
+	/* Split the client list into contiguous ranges, several per hook thread to balance uneven per-client work: */
+	unsigned int numJobs=hookPool->getNumThreads()*4;
+	if(numJobs>numClients)
+		numJobs=numClients;
+	session->updateJobs.resize(numJobs);
+	{
+	Threads::MutexCond::Lock updateJobLock(session->updateJobCond);
+	session->numPendingUpdateJobs=numJobs;
+	}
+	for(unsigned int i=0;i<numJobs;++i)
+		{
+		UpdateJob& job=session->updateJobs[i];
+		job.session=session;
+		job.phase=phase;
+		job.begin=(numClients*i)/numJobs;
+		job.end=(numClients*(i+1))/numJobs;
+		hookPool->submit(&job);
+		}
+	
+	/* Wait until this session's ranges are done, but not for other sessions' jobs sharing the hook pool; the results are independent of the order in which the hook threads ran them: */
+	{
+	Threads::MutexCond::Lock updateJobLock(session->updateJobCond);
+	while(session->numPendingUpdateJobs>0)
+		session->updateJobCond.wait(updateJobLock);
+	}
+	
+	/* Run the hooks of plug-ins that did not declare them thread-safe on this thread, in client list order: */
+	if(!threadSafeHooks)
+		{
+		if(phase==FREEZE_CLIENTS)
+			freezeClients(session,0,numClients,OTHER_HOOKS);
+		else if(phase==FINISH_CLIENTS)
+			finishClients(session,0,numClients,OTHER_HOOKS);
+		}
+	}
+
+void CollaborationServer::updateSession(CollaborationServer::Session* session)
+	{
+	double updateStart=ServerMetrics::now();
+	TickProfiler::PhaseTimer phaseTimer(tickProfiler,"session");
+	
+	/* Lock the session's client list: */
+	Threads::Mutex::Lock clientListLock(session->clientListMutex);
+	phaseTimer.endPhase("lock client list");
+	
+	/* Process all actions from the client action list, and remember the clients added by each action: */
+	ClientList& addedClients=session->addedClients;
+	addedClients.clear();
+	for(ActionList::const_iterator alIt=session->actionList.begin();alIt!=session->actionList.end();++alIt)
+		{
+		/* Look up the client affected by the action; it is gone if its connection finished before it was added: */
+		ClientConnection* client=findClient(alIt->clientID);
+		addedClients.push_back(0);
+		
+		switch(alIt->action)
+			{
+			case ClientListAction::ADD_CLIENT:
+				if(client!=0)
+					{
+					/* Add the client state to the list: */
+					client->addPending=false;
+					client->listIndex=session->clientList.size();
+					session->clientList.push_back(client);
+					addedClients.back()=client;
+					client->joining=true;
+					
+					/* Process plug-in protocols: */
+					{
+					Threads::Mutex::Lock clientLock(client->mutex);
+					for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+						{
+						TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::CONNECT_CLIENT);
+						cplIt->protocol->connectClient(cplIt->protocolClientState);
+						}
+					}
+					
+					/* Process higher-level protocols: */
+					connectClient(alIt->clientID);
+					}
+				break;
+			
+			case ClientListAction::REMOVE_CLIENT:
+				if(client!=0)
+					{
+					/* Make sure no sender thread is still using the client: */
+					unscheduleClient(client);
+					
+					/* Process plug-in protocols: */
+					{
+					Threads::Mutex::Lock clientLock(client->mutex);
+					for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
+						{
+						TickProfiler::HookTimer hookTimer(tickProfiler,cplIt->protocol->hookTotals,TickProfiler::DISCONNECT_CLIENT);
+						cplIt->protocol->disconnectClient(cplIt->protocolClientState);
+						}
+					}
+					
+					/* Remove the client from the list by moving the last client into its place: */
+					unsigned int listIndex=client->listIndex;
+					session->clientList[listIndex]=session->clientList.back();
+					session->clientList[listIndex]->listIndex=listIndex;
+					session->clientList.pop_back();
+					
+					/* Delete client connection state structure (closing TCP pipe), and release its reference to the session: */
+					destroyClient(client);
+					releaseSession(session);
+					
+					/* Forget any state updates withheld from the remaining clients: */
+					for(ClientList::iterator cl2It=session->clientList.begin();cl2It!=session->clientList.end();++cl2It)
+						{
+						(*cl2It)->pendingStateMasks.removeEntry(alIt->clientID);
+						(*cl2It)->interestingClients.removeEntry(alIt->clientID);
+						(*cl2It)->deltaBaselines.removeEntry(alIt->clientID);
+						}
+					
+					/* Process higher-level protocols: */
+					disconnectClient(alIt->clientID);
+					}
+				break;
+			}
+		}
+	phaseTimer.endPhase("client actions");
+	
+	/* Check whether the higher-level protocol and all protocol plug-ins negotiated in the session declared their per-client hooks thread-safe: */
+	bool threadSafeHooks=hookPool!=0&&hasThreadSafeClientHooks();
+	for(ClientList::iterator clIt=session->clientList.begin();threadSafeHooks&&clIt!=session->clientList.end();++clIt)
+		for(ClientConnection::ClientProtocolList::iterator cplIt=(*clIt)->protocols.begin();cplIt!=(*clIt)->protocols.end();++cplIt)
+			if(!cplIt->protocol->hasThreadSafeClientHooks())
+				threadSafeHooks=false;
+	
+	/* Freeze the states of all clients for this update: */
+	runUpdatePhase(session,FREEZE_CLIENTS,threadSafeHooks);
+	phaseTimer.endPhase("state snapshots");
+	
+	if(session->interestGrid!=0)
+		{
+		/* Index all clients by the positions of their display centers in navigational space: */
+		session->interestGrid->clear();
+		for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+			{
+			ClientConnection* client=*clIt;
+			client->navPosition=client->state.navTransform.inverseTransform(client->state.displayCenter);
+			session->interestGrid->insert(client->clientID,client->navPosition);
+			}
+		
+		/* Update all clients' areas of interest: */
+		Scalar sqrInterestRadius=interestRadius*interestRadius;
+		InterestGrid::NeighborList& neighbors=session->neighbors;
+		std::vector<unsigned int>& interestingClients=session->interestingClients;
+		for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+			{
+			ClientConnection* client=*clIt;
+			
+			/* Find all clients inside the leave radius: */
+			neighbors.clear();
+			session->interestGrid->findNeighbors(client->navPosition,interestLeaveRadius,neighbors);
+			
+			/* Clients enter the area of interest inside the interest radius, and stay in it until they leave the leave radius: */
+			interestingClients.clear();
+			for(InterestGrid::NeighborList::iterator nIt=neighbors.begin();nIt!=neighbors.end();++nIt)
+				if(nIt->clientID!=client->clientID&&(nIt->sqrDist<=sqrInterestRadius||client->interestingClients.isEntry(nIt->clientID)))
+					interestingClients.push_back(nIt->clientID);
+			client->interestingClients.clear();
+			for(std::vector<unsigned int>::iterator icIt=interestingClients.begin();icIt!=interestingClients.end();++icIt)
+				client->interestingClients.setEntry(ClientIDSet::Entry(*icIt));
+			}
+		phaseTimer.endPhase("areas of interest");
+		}
+	
+	/* Determine the endiannesses in which client state updates need to be sent, whether they need to include poses, and whether poses are quantized: */
+	bool needUpdateSegments[8]={false,false,false,false,false,false,false,false};
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		needUpdateSegments[((*clIt)->pipe->mustSwapOnWrite()?1:0)|((*clIt)->datagramAddressValid?2:0)|((*clIt)->poseCodec.isQuantized()?4:0)]=true;
+	
+	/* Encode every client's state update once per required variant, to be shared by all destination clients: */
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		{
+		ClientConnection* client=*clIt;
+		for(int variant=0;variant<8;++variant)
+			if(needUpdateSegments[variant])
+				{
+				/* Create or reset the update segment: */
+				if(client->updateSegments[variant].getPointer()==0)
+					{
+					client->updateSegments[variant]=new IO::VariableMemoryFile;
+					client->updateSegments[variant]->setSwapOnWrite((variant&1)!=0);
+					}
+				else
+					client->updateSegments[variant]->clear();
+				
+				/* Write the client's ID and state update, leaving out the pose for destinations receiving poses by datagram: */
+				IO::VariableMemoryFile& segment=*client->updateSegments[variant];
+				segment.write<Card>(client->clientID);
+				writeClientState((variant&2)!=0?client->state.updateMask&~ClientState::POSE:client->state.updateMask,client->state,(variant&4)!=0?poseCodec:PoseCodec(),segment);
+				}
+		}
+	phaseTimer.endPhase("state encoding");
+	
+	/* Reset the list of clients that bomb out during the update step, to disconnect them cleanly: */
+	ClientList& deadClientList=session->deadClientList;
+	deadClientList.clear();
+	
+	/* Apply the slow client policy to all clients based on the states of their outbound queues: */
+	Misc::Time now=Misc::Time::now();
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		{
+		ClientConnection* client=*clIt;
+		if(client->killed)
+			continue;
+		
+		/* Disconnect clients to which a sender thread could not write: */
+		if(client->outboundFailed)
+			{
+			killClient(client,deadClientList);
+			continue;
+			}
+		
+		/* Disconnect clients that did not accept any outbound data for too long: */
+		bool sendStalled;
+		{
+		Threads::MutexCond::Lock senderLock(senderCond);
+		sendStalled=client->waitingWritable&&(client->sendDeadline-now).tv_sec<0;
+		}
+		if(sendStalled)
+			{
+			std::cerr<<"CollaborationServer::update: Terminating client connection due to send timeout"<<std::endl;
+			killClient(client,deadClientList);
+			continue;
+			}
+		
+		/* Disconnect clients whose outbound queues grew beyond the hard limit: */
+		size_t numMessages=client->outboundQueue.getNumMessages();
+		size_t queueSize=client->outboundQueue.getQueueSize();
+		if(queueSize>maxQueueSize)
+			{
+			std::cerr<<"CollaborationServer::update: Terminating client connection due to outbound queue size of "<<queueSize<<" bytes"<<std::endl;
+			killClient(client,deadClientList);
+			continue;
+			}
+		
+		if(!client->congested&&numMessages>maxQueueDepth)
+			{
+			/* Start applying the slow client policy: */
+			client->congested=true;
+			client->congestionDeadline=now;
+			client->congestionDeadline+=Misc::Time(slowClientTimeout);
+			
+			#ifdef VERBOSE
+			std::cout<<"CollaborationServer: Client "<<client->clientID<<" is congested with "<<numMessages<<" queued messages ("<<queueSize<<" bytes)"<<std::endl<<std::flush;
+			#endif
+			}
+		else if(client->congested&&numMessages<=maxQueueDepth/2)
+			{
+			/* Stop applying the slow client policy once the backlog has mostly drained: */
+			client->congested=false;
+			
+			#ifdef VERBOSE
+			std::cout<<"CollaborationServer: Client "<<client->clientID<<" is no longer congested"<<std::endl<<std::flush;
+			#endif
+			}
+		
+		/* Disconnect clients that stayed congested for too long: */
+		if(client->congested&&slowClientPolicy==DISCONNECT&&(client->congestionDeadline-now).tv_sec<0)
+			{
+			std::cerr<<"CollaborationServer::update: Terminating client connection due to slow client timeout"<<std::endl;
+			killClient(client,deadClientList);
+			}
 		}
+	phaseTimer.endPhase("slow client policy");
 	
-	/******************************************************************************************
-	Disconnect the client by removing it from the list and deleting the client state structure:
-	******************************************************************************************/
+	/* Let the plug-in protocols that batch their server updates write every client's payloads for all destination clients at once: */
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		(*clIt)->batchServerUpdateProtocols(session->clientList,tickProfiler);
+	phaseTimer.endPhase("protocol batches");
 	
-	#ifdef VERBOSE
-	std::cout<<"CollaborationServer::clientCommunicationThread: Disconnecting client from host "<<client->clientHostname<<", port "<<client->clientPortId<<std::endl<<std::flush;
-	#endif
+	/* Assemble the update messages of all connected clients: */
+	runUpdatePhase(session,WRITE_UPDATES,threadSafeHooks);
 	
-	/* Delete the client state structure directly, or defer to main thread: */
-	if(clientAdded)
+	/* Queue the update messages in client list order, and disconnect clients whose messages could not be assembled: */
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
 		{
-		/* Lock the client list: */
-		Threads::Mutex::Lock clientListLock(clientListMutex);
+		ClientConnection* destClient=*clIt;
+		if(destClient->killed)
+			continue;
 		
-		/* Check if the request to add the client is still in the action list: */
-		ActionList::iterator alIt;
-		for(alIt=actionList.begin();alIt!=actionList.end();++alIt)
-			if(alIt->clientID==clientID&&alIt->action==ClientListAction::ADD_CLIENT)
-				break;
-		if(alIt!=actionList.end())
+		if(destClient->updateFailed)
 			{
-			/* Remove the request to add the client from the action list: */
-			actionList.erase(alIt);
-			
-			/* Delete the client connection state structure immediately (closing the TCP pipe): */
-			delete client;
-			
-			/* Process higher-level protocols: */
-			disconnectClient(clientID);
+			killClient(destClient,deadClientList);
+			continue;
 			}
+		
+		/* Hand the finished message to the sender threads, or append it to the last message a congested client did not start receiving yet, so that coalescing states does not add a queued message per update: */
+		if(destClient->congested&&slowClientPolicy==COALESCE_STATES&&destClient->outboundQueue.appendToBack(destClient->updateMessage))
+			destClient->messagePool.release(destClient->updateMessage);
 		else
+			queueMessage(destClient,destClient->updateMessage);
+		destClient->updateMessage=0;
+		
+		/* Send recently changed poses by datagram, bypassing the outbound queue: */
+		if(destClient->datagramAddressValid)
 			{
-			/* Add the client removal action to the list: */
-			actionList.push_back(ClientListAction(ClientListAction::REMOVE_CLIENT,clientID,client));
+			bool interestRefresh=outOfInterestInterval>0&&(session->updateCounter+destClient->clientID)%outOfInterestInterval==0;
+			sendPoseDatagrams(session,destClient,interestRefresh);
 			}
 		}
-	else
+	phaseTimer.endPhase("update messages");
+	
+	/* Process plug-in protocols: */
+	runUpdatePhase(session,FINISH_CLIENTS,threadSafeHooks);
+	
+	/* Clear the client state list action list: */
+	session->actionList.clear();
+	
+	/* Reset change flags on all clients' state objects, and mark all clients added during this update as fully joined: */
+	for(ClientList::iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
 		{
-		/* Delete the client connection state structure immediately (closing the TCP pipe): */
-		delete client;
-		
-		/* Process higher-level protocols: */
-		disconnectClient(clientID);
+		(*clIt)->state.updateMask=ClientState::NO_CHANGE;
+		(*clIt)->joining=false;
 		}
+	++session->updateCounter;
 	
-	/* Terminate: */
-	return 0;
-	}
-
-CollaborationServer::CollaborationServer(CollaborationServer::Configuration* sConfiguration)
-	:configuration(sConfiguration!=0?sConfiguration:new Configuration),
-	 protocolLoader(configuration->cfg.retrieveString("./pluginDsoNameTemplate",COLLABORATION_PLUGINDSONAMETEMPLATE)),
-	 listenSocket(configuration->cfg.retrieveValue<int>("./listenPortId",-1),0),
-	 nextClientID(1)
-	{
-	typedef std::vector<std::string> StringList;
-	
-	/* Get additional search paths from configuration file section and add them to the object loader: */
-	StringList pluginSearchPaths=configuration->cfg.retrieveValue<StringList>("./pluginSearchPaths",StringList());
-	for(StringList::const_iterator tspIt=pluginSearchPaths.begin();tspIt!=pluginSearchPaths.end();++tspIt)
+	/* Mark all dead clients for removal on the next update: */
+	for(ClientList::const_iterator dclIt=deadClientList.begin();dclIt!=deadClientList.end();++dclIt)
 		{
-		/* Add the path: */
-		protocolLoader.getDsoLocator().addPath(*tspIt);
+		/* Add the client removal action to the list: */
+		session->actionList.push_back(ClientListAction(ClientListAction::REMOVE_CLIENT,(*dclIt)->clientID));
 		}
+	phaseTimer.endPhase("finish update");
 	
-	/* Initialize the protocol message table to have invalid entries for the protocol's own messages: */
-	for(unsigned int i=0;i<MESSAGES_END;++i)
-		messageTable.push_back(0);
+	/* Publish the clients' metrics, so that metrics scrapes never wait for the session's client list: */
+	std::vector<ClientGauges>& gauges=session->clientGauges.startNewValue();
+	gauges.clear();
+	for(ClientList::const_iterator clIt=session->clientList.begin();clIt!=session->clientList.end();++clIt)
+		{
+		ClientGauges cg;
+		cg.clientID=(*clIt)->clientID;
+		cg.socketFd=(*clIt)->pipe->getFd();
+		cg.sentMessages=(*clIt)->sentMessages.get();
+		cg.sentBytes=(*clIt)->sentBytes.get();
+		cg.numQueuedMessages=(*clIt)->outboundQueue.getNumMessages();
+		cg.queueSize=(*clIt)->outboundQueue.getQueueSize();
+		cg.congested=(*clIt)->congested;
+		gauges.push_back(cg);
+		}
+	session->clientGauges.postNewValue();
 	
-	/* Start connection initiating thread: */
-	listenThread.start(this,&CollaborationServer::listenThreadMethod);
+	metrics.sessionUpdateDuration.observe(ServerMetrics::now()-updateStart);
 	}
 
-CollaborationServer::~CollaborationServer(void)
+void CollaborationServer::update(void)
 	{
-	#ifdef VERBOSE
-	std::cout<<"CollaborationServer: Shutting down server"<<std::endl<<std::flush;
-	#endif
+	double tickStart=ServerMetrics::now();
+	if(tickProfiler!=0)
+		tickProfiler->startTick();
+	TickProfiler::PhaseTimer phaseTimer(tickProfiler,"update");
 	
-	{
-	/* Lock client list: */
-	Threads::Mutex::Lock clientListLock(clientListMutex);
+	/* Get the current protocol table; protocols loaded during this update take part in the next one: */
+	const ProtocolTable* table=getProtocolTable();
 	
-	/* Stop connection initiating thread: */
-	listenThread.cancel();
-	listenThread.join();
+	/* Process plug-in protocols: */
+	for(ProtocolList::const_iterator plIt=table->protocols.begin();plIt!=table->protocols.end();++plIt)
+		{
+		TickProfiler::Scope scope(tickProfiler,"beforeServerUpdate",(*plIt)->getName());
+		(*plIt)->beforeServerUpdate();
+		}
+	phaseTimer.endPhase("protocol updates");
 	
-	if(!clientList.empty())
+	{
+	/* Remove relay links that failed or were closed by their relays: */
+	Threads::Mutex::Lock relayLinkLock(relayLinkMutex);
+	for(std::vector<RelayLink*>::iterator rlIt=relayLinks.begin();rlIt!=relayLinks.end();)
 		{
-		#ifdef VERBOSE
-		std::cout<<"CollaborationServer: Disconnecting "<<clientList.size()<<" clients"<<std::endl<<std::flush;
-		#endif
-		
-		/* Disconnect all clients: */
-		for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
-			{
+		if((*rlIt)->isFinished())
 			{
-			Threads::Mutex::Lock clientLock((*clIt)->mutex);
-
-			/* Stop client communication thread: */
-			(*clIt)->communicationThread.cancel();
-			(*clIt)->communicationThread.join();
-			}
-
-			/* Delete client connection state structure (closing TCP pipe): */
-			delete *clIt;
+			delete *rlIt;
+			rlIt=relayLinks.erase(rlIt);
 			}
+		else
+			++rlIt;
 		}
 	}
+	phaseTimer.endPhase("relay links");
 	
-	/* Delete all protocol plug-ins: */
-	for(ProtocolList::iterator pIt=protocols.begin();pIt!=protocols.end();++pIt)
+	/* Get the list of active sessions: */
+	updateSessions.clear();
+	getSessions(updateSessions);
+	
+	if(updatePool!=0&&updateSessions.size()>1)
 		{
-		/* Only delete the protocol plug-in if it is not managed by the protocol loader: */
-		if(!protocolLoader.isManaged(*pIt))
-			delete *pIt;
+		/* Update all sessions in parallel: */
+		for(SessionList::iterator sIt=updateSessions.begin();sIt!=updateSessions.end();++sIt)
+			updatePool->submit(*sIt);
+		updatePool->wait();
+		}
+	else
+		{
+		/* Update all sessions in order: */
+		for(SessionList::iterator sIt=updateSessions.begin();sIt!=updateSessions.end();++sIt)
+			updateSession(*sIt);
 		}
 	
-	/* Delete the configuration object: */
-	delete configuration;
+	/* Release the sessions, which deletes sessions that were left by all their clients: */
+	for(SessionList::iterator sIt=updateSessions.begin();sIt!=updateSessions.end();++sIt)
+		releaseSession(*sIt);
+	phaseTimer.endPhase("sessions");
+	
+	/* Process plug-in protocols: */
+	for(ProtocolList::const_iterator plIt=table->protocols.begin();plIt!=table->protocols.end();++plIt)
+		{
+		TickProfiler::Scope scope(tickProfiler,"afterServerUpdate",(*plIt)->getName());
+		(*plIt)->afterServerUpdate();
+		}
+	phaseTimer.endPhase("protocol updates");
+	
+	metrics.tickDuration.observe(ServerMetrics::now()-tickStart);
+	
+	if(tickProfiler!=0)
+		{
+		/* Record the times protocol plug-ins spent in per-client hooks in one lane per plug-in: */
+		for(unsigned int i=0;i<table->protocols.size();++i)
+			tickProfiler->recordHooks(i+1,table->protocols[i]->getName(),table->protocols[i]->hookTotals);
+		
+		tickProfiler->finishTick();
+		}
 	}
 
-void CollaborationServer::registerProtocol(ProtocolServer* newProtocol)
+bool CollaborationServer::isIdle(void)
 	{
-	/* Simply add the protocol to the list; already-connected clients won't be able to use it: */
-	Threads::Mutex::Lock protocolListLock(protocolListMutex);
-	protocols.push_back(newProtocol);
+	/* Reset the client arrival event first, so that a client connecting after the check below still wakes up a waiting server loop: */
+	eventfd_t numArrivals;
+	eventfd_read(clientArrivalFd,&numArrivals);
 	
-	/* Register message IDs for the new protocol: */
-	newProtocol->messageIdBase=messageTable.size();
-	unsigned int numMessages=newProtocol->getNumMessages();
-	for(unsigned int i=0;i<numMessages;++i)
-		messageTable.push_back(newProtocol);
+	Threads::Mutex::Lock clientTableLock(clientTableMutex);
+	return clientTable.getNumEntries()==0;
 	}
 
-std::pair<ProtocolServer*,int> CollaborationServer::loadProtocol(std::string protocolName)
+CollaborationServer::OutboundQueueStatusList CollaborationServer::getOutboundQueueStatus(void)
 	{
-	Threads::Mutex::Lock protocolListLock(protocolListMutex);
-	
-	std::pair<ProtocolServer*,int> result=std::pair<ProtocolServer*,int>(0,-1);
+	OutboundQueueStatusList result;
 	
-	/* Check if a protocol plug-in of the given name already exists: */
-	int numProtocols=int(protocols.size());
-	for(int index=0;index<numProtocols;++index)
-		if(protocols[index]->getName()==protocolName)
-			{
-			result.first=protocols[index];
-			result.second=index;
-			break;
-			}
+	/* Get the list of active sessions: */
+	SessionList querySessions;
+	getSessions(querySessions);
 	
-	if(result.first==0)
+	for(SessionList::iterator sIt=querySessions.begin();sIt!=querySessions.end();++sIt)
 		{
-		/* Try loading a protocol plug-in dynamically: */
-		try
-			{
-			#ifdef VERBOSE
-			std::cout<<"Loading protocol plug-in "<<protocolName<<"Server"<<std::endl;
-			#endif
-			result.first=protocolLoader.createObject((protocolName+"Server").c_str());
-			result.second=numProtocols;
-			
-			/* Append the new protocol plug-in to the list: */
-			protocols.push_back(result.first);
-			
-			/* Register message IDs for the new protocol: */
-			result.first->messageIdBase=messageTable.size();
-			unsigned int numMessages=result.first->getNumMessages();
-			for(unsigned int i=0;i<numMessages;++i)
-				messageTable.push_back(result.first);
-			#ifdef VERBOSE
-			if(numMessages>0)
-				std::cout<<"Protocol "<<protocolName<<" is assigned message IDs "<<result.first->messageIdBase<<" to "<<result.first->messageIdBase+numMessages-1<<std::endl;
-			#endif
-			
-			/* Initialize the protocol: */
-			Misc::ConfigurationFileSection protocolSection=configuration->cfg.getSection(protocolName.c_str());
-			result.first->initialize(this,protocolSection);
-			}
-		catch(std::runtime_error err)
+		{
+		/* Lock the session's client list: */
+		Threads::Mutex::Lock clientListLock((*sIt)->clientListMutex);
+		
+		/* Query the outbound queues of all connected clients: */
+		for(ClientList::const_iterator clIt=(*sIt)->clientList.begin();clIt!=(*sIt)->clientList.end();++clIt)
 			{
-			/* Print an error message and carry on: */
-			std::cerr<<"CollaborationServer::loadProtocol: Caught exception "<<err.what()<<" while loading protocol "<<protocolName<<std::endl;
+			OutboundQueueStatus status;
+			status.clientID=(*clIt)->clientID;
+			status.numMessages=(*clIt)->outboundQueue.getNumMessages();
+			status.queueSize=(*clIt)->outboundQueue.getQueueSize();
+			status.congested=(*clIt)->congested;
+			result.push_back(status);
 			}
 		}
+		
+		releaseSession(*sIt);
+		}
 	
 	return result;
 	}
 
-void CollaborationServer::update(void)
-	{
-	{
-	/* Lock protocol list: */
-	Threads::Mutex::Lock protocolListLock(protocolListMutex);
-	
-	/* Process plug-in protocols: */
-	for(ProtocolList::iterator plIt=protocols.begin();plIt!=protocols.end();++plIt)
-		(*plIt)->beforeServerUpdate();
-	
+void CollaborationServer::writeMetrics(std::ostream& os)
 	{
-	/* Lock client list: */
-	Threads::Mutex::Lock clientListLock(clientListMutex);
+	/* Get the list of active sessions: */
+	SessionList metricSessions;
+	getSessions(metricSessions);
 	
-	/* Process all actions from the client action list: */
-	for(ActionList::const_iterator alIt=actionList.begin();alIt!=actionList.end();++alIt)
+	/* Take snapshots of all connected clients' metrics, so that each metric's samples can be written together: */
+	std::vector<ClientMetrics> clientMetrics;
+	for(SessionList::iterator sIt=metricSessions.begin();sIt!=metricSessions.end();++sIt)
 		{
-		switch(alIt->action)
+		/* Read the client metrics the session published at the end of its most recent update; the metrics thread is the triple buffer's only consumer: */
+		(*sIt)->clientGauges.lockNewValue();
+		const std::vector<ClientGauges>& gauges=(*sIt)->clientGauges.getLockedValue();
+		for(std::vector<ClientGauges>::const_iterator cgIt=gauges.begin();cgIt!=gauges.end();++cgIt)
 			{
-			case ClientListAction::ADD_CLIENT:
-				{
-				/* Add the client state to the list: */
-				clientList.push_back(alIt->client);
-				
-				/* Process plug-in protocols: */
-				{
-				Threads::Mutex::Lock clientLock(alIt->client->mutex);
-				for(ClientConnection::ClientProtocolList::iterator cplIt=alIt->client->protocols.begin();cplIt!=alIt->client->protocols.end();++cplIt)
-					cplIt->protocol->connectClient(cplIt->protocolClientState);
-				}
-				
-				/* Process higher-level protocols: */
-				connectClient(alIt->clientID);
-				break;
-				}
+			ClientMetrics cm;
+			cm.clientID=cgIt->clientID;
+			cm.sessionName=(*sIt)->name;
+			cm.sentMessages=cgIt->sentMessages;
+			cm.sentBytes=cgIt->sentBytes;
 			
-			case ClientListAction::REMOVE_CLIENT:
-				{
-				/* Find the client connection state structure in the list: */
-				ClientList::iterator clIt;
-				for(clIt=clientList.begin();clIt!=clientList.end()&&(*clIt)->clientID!=alIt->clientID;++clIt)
-					;
-				if(clIt!=clientList.end())
-					{
-					/* Process plug-in protocols: */
-					{
-					Threads::Mutex::Lock clientLock(alIt->client->mutex);
-					for(ClientConnection::ClientProtocolList::iterator cplIt=(*clIt)->protocols.begin();cplIt!=(*clIt)->protocols.end();++cplIt)
-						cplIt->protocol->disconnectClient(cplIt->protocolClientState);
-					}
-					
-					/* Delete client connection state structure (closing TCP pipe): */
-					delete *clIt;
-					
-					/* Remove the client from the list: */
-					clientList.erase(clIt);
-					
-					/* Process higher-level protocols: */
-					disconnectClient(alIt->clientID);
-					}
-				break;
-				}
+			/* Query the kernel's byte counts; if the client disconnected since the update, its socket's file descriptor might already be reused, which only skews one scrape: */
+			cm.haveSocketBytes=ServerMetrics::getSocketBytes(cgIt->socketFd,cm.socketReceivedBytes,cm.socketAckedBytes);
+			cm.numQueuedMessages=cgIt->numQueuedMessages;
+			cm.queueSize=cgIt->queueSize;
+			cm.congested=cgIt->congested;
+			clientMetrics.push_back(cm);
 			}
-		}
-	
-	/* Lock the connection states of all clients: */
-	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
-		{
-		ClientConnection* client=*clIt;
 		
-		/* Lock the client state: */
-		client->mutex.lock();
-		
-		/* Process plug-in protocols for the client: */
-		for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
-			cplIt->protocol->beforeServerUpdate(cplIt->protocolClientState);
+		releaseSession(*sIt);
 		}
 	
-	/* Create a temporary action list to cleanly disconnect all clients that bomb out during the update step: */
-	std::vector<ClientConnection*> deadClientList;
+	/* Write server-wide gauges: */
+	unsigned int numClients;
+	{
+	Threads::Mutex::Lock clientTableLock(clientTableMutex);
+	numClients=clientTable.getNumEntries();
+	}
+	ServerMetrics::writeHeader(os,"collaboration_clients","gauge","Number of client connections, including connections that are still being established");
+	os<<"collaboration_clients "<<numClients<<'\n';
+	ServerMetrics::writeHeader(os,"collaboration_sessions","gauge","Number of active sessions");
+	os<<"collaboration_sessions "<<metricSessions.size()<<'\n';
+	
+	/* Write server-wide counters: */
+	ServerMetrics::writeHeader(os,"collaboration_client_connects_total","counter","Number of clients that completed connecting");
+	os<<"collaboration_client_connects_total "<<metrics.clientConnects.get()<<'\n';
+	ServerMetrics::writeHeader(os,"collaboration_client_rejects_total","counter","Number of rejected connection requests");
+	os<<"collaboration_client_rejects_total "<<metrics.clientRejects.get()<<'\n';
+	ServerMetrics::writeHeader(os,"collaboration_client_disconnects_total","counter","Number of connected clients that disconnected");
+	os<<"collaboration_client_disconnects_total "<<metrics.clientDisconnects.get()<<'\n';
+	
+	/* Write received message counts of the base protocol and all protocol plug-ins: */
+	const ProtocolTable* table=getProtocolTable();
+	ServerMetrics::writeHeader(os,"collaboration_received_messages_total","counter","Number of messages received from clients");
+	for(unsigned int i=0;i<MESSAGES_END;++i)
+		os<<"collaboration_received_messages_total{protocol=\"Collaboration\",message=\""<<ServerMetrics::messageNames[i]<<"\"} "<<metrics.receivedMessages[i].get()<<'\n';
+	for(ProtocolList::const_iterator plIt=table->protocols.begin();plIt!=table->protocols.end();++plIt)
+		for(unsigned int i=0;i<(*plIt)->receivedMessages.size();++i)
+			os<<"collaboration_received_messages_total{protocol=\""<<ServerMetrics::escapeLabel((*plIt)->getName())<<"\",message=\""<<i<<"\"} "<<(*plIt)->receivedMessages[i].get()<<'\n';
+	
+	/* Write the payload sizes sent by all protocol plug-ins: */
+	ServerMetrics::writeHeader(os,"collaboration_protocol_sent_bytes_total","counter","Number of payload bytes protocol plug-ins wrote into messages to clients");
+	for(ProtocolList::const_iterator plIt=table->protocols.begin();plIt!=table->protocols.end();++plIt)
+		os<<"collaboration_protocol_sent_bytes_total{protocol=\""<<ServerMetrics::escapeLabel((*plIt)->getName())<<"\"} "<<(*plIt)->sentBytes.get()<<'\n';
 	
-	/* Send state updates to all connected clients: */
-	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
+	/* Write the update duration histograms: */
+	metrics.tickDuration.write(os,"collaboration_tick_duration_seconds","Duration of complete server updates");
+	metrics.sessionUpdateDuration.write(os,"collaboration_session_update_duration_seconds","Duration of encoding and queueing one session's updates");
+	
+	/* Write per-client metrics: */
+	ServerMetrics::writeHeader(os,"collaboration_client_sent_messages_total","counter","Number of messages written to a client");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
 		{
-		ClientConnection* destClient=*clIt;
-		Comm::NetPipe& pipe=*(destClient->pipe);
-		
-		try
-			{
+		writeClientLabels(os,"collaboration_client_sent_messages_total",*cmIt);
+		os<<cmIt->sentMessages<<'\n';
+		}
+	ServerMetrics::writeHeader(os,"collaboration_client_sent_bytes_total","counter","Number of bytes written to a client");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
+		{
+		writeClientLabels(os,"collaboration_client_sent_bytes_total",*cmIt);
+		os<<cmIt->sentBytes<<'\n';
+		}
+	ServerMetrics::writeHeader(os,"collaboration_client_socket_received_bytes_total","counter","Number of bytes the kernel received from a client");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
+		if(cmIt->haveSocketBytes)
 			{
-			Threads::Mutex::Lock pipeLock(destClient->pipeMutex);
-			
-			/* Check the client state action list for any actions relevant for this client: */
-			for(ActionList::const_iterator alIt=actionList.begin();alIt!=actionList.end();++alIt)
-				if(alIt->clientID!=destClient->clientID)
-					{
-					switch(alIt->action)
-						{
-						case ClientListAction::ADD_CLIENT:
-							{
-							/* Find the added client's state: */
-							ClientConnection* newClient=0;
-							for(ClientList::iterator cl2It=clientList.begin();cl2It!=clientList.end();++cl2It)
-								if((*cl2It)->clientID==alIt->clientID)
-									{
-									newClient=*cl2It;
-									break;
-									}
-							
-							if(newClient!=0)
-								{
-								/* Send a client connect message: */
-								writeMessage(CLIENT_CONNECT,pipe);
-								pipe.write<Card>(newClient->clientID);
-								
-								/* Send the full state of the client: */
-								writeClientState(ClientState::FULL_UPDATE,newClient->state,pipe);
-								
-								/* Send the intersection of protocol plug-ins negotiated with both clients to the client: */
-								newClient->sendClientConnectProtocols(destClient,pipe);
-								
-								/* Process higher-level protocols: */
-								sendClientConnect(newClient->clientID,destClient->clientID,pipe);
-								}
-							break;
-							}
-						
-						case ClientListAction::REMOVE_CLIENT:
-							{
-							/* Send a client disconnect message: */
-							writeMessage(CLIENT_DISCONNECT,pipe);
-							pipe.write<Card>(alIt->clientID);
-							
-							break;
-							}
-						}
-					}
-			
-			/* Process plug-in protocols for the client: */
-			for(ClientConnection::ClientProtocolList::iterator cplIt=destClient->protocols.begin();cplIt!=destClient->protocols.end();++cplIt)
-				cplIt->protocol->beforeServerUpdate(cplIt->protocolClientState,pipe);
-			
-			/* Process higher-level protocols: */
-			beforeServerUpdate(destClient->clientID,pipe);
-			
-			/* Send the server update packet header: */
-			writeMessage(SERVER_UPDATE,pipe);
-			pipe.write<Card>(clientList.size()-1);
-			
-			/* Process plug-in protocols for the client: */
-			for(ClientConnection::ClientProtocolList::iterator cplIt=destClient->protocols.begin();cplIt!=destClient->protocols.end();++cplIt)
-				cplIt->protocol->sendServerUpdate(cplIt->protocolClientState,pipe);
-			
-			/* Process higher-level protocols: */
-			sendServerUpdate(destClient->clientID,pipe);
-			
-			/* Send the states of all other clients: */
-			for(ClientList::iterator cl2It=clientList.begin();cl2It!=clientList.end();++cl2It)
-				if(cl2It!=clIt)
-					{
-					ClientConnection* sourceClient=*cl2It;
-					
-					/* Send the server update packet: */
-					pipe.write<Card>(sourceClient->clientID);
-					writeClientState(sourceClient->state.updateMask,sourceClient->state,pipe);
-					
-					/* Process plug-in protocols shared by the two clients: */
-					ClientConnection::ClientProtocolList::iterator cpl1It=sourceClient->protocols.begin();
-					ClientConnection::ClientProtocolList::iterator cpl2It=destClient->protocols.begin();
-					while(cpl1It!=sourceClient->protocols.end()&&cpl2It!=destClient->protocols.end())
-						{
-						if(cpl1It->index<cpl2It->index)
-							++cpl1It;
-						else if(cpl1It->index>cpl2It->index)
-							++cpl2It;
-						else
-							{
-							/* Send the shared protocol's payload: */
-							cpl1It->protocol->sendServerUpdate(cpl1It->protocolClientState,cpl2It->protocolClientState,pipe);
-							++cpl1It;
-							++cpl2It;
-							}
-						}
-					
-					/* Process higher-level protocols: */
-					sendServerUpdate(sourceClient->clientID,destClient->clientID,pipe);
-					}
-			
-			/* Finish the message: */
-			pipe.flush();
+			writeClientLabels(os,"collaboration_client_socket_received_bytes_total",*cmIt);
+			os<<cmIt->socketReceivedBytes<<'\n';
 			}
-			}
-		catch(std::runtime_error err)
+	ServerMetrics::writeHeader(os,"collaboration_client_socket_acked_bytes_total","counter","Number of bytes a client acknowledged to the kernel");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
+		if(cmIt->haveSocketBytes)
 			{
-			/* Forcibly disconnect clients that cause pipe errors during a state update: */
-			std::cerr<<"CollaborationServer::update: Terminating client connection due to exception "<<err.what()<<std::endl;
-			
-			#ifdef VERBOSE
-			std::cout<<"CollaborationServer::update: Disconnecting client from host "<<destClient->clientHostname<<", port "<<destClient->clientPortId<<std::endl<<std::flush;
-			#endif
-			
-			/* Stop client communication thread: */
-			destClient->communicationThread.cancel();
-			destClient->communicationThread.join();
-			
-			/* Properly disconnect the client on the next update: */
-			deadClientList.push_back(destClient);
+			writeClientLabels(os,"collaboration_client_socket_acked_bytes_total",*cmIt);
+			os<<cmIt->socketAckedBytes<<'\n';
 			}
+	ServerMetrics::writeHeader(os,"collaboration_client_queued_messages","gauge","Number of messages waiting in a client's outbound queue");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
+		{
+		writeClientLabels(os,"collaboration_client_queued_messages",*cmIt);
+		os<<cmIt->numQueuedMessages<<'\n';
 		}
-	
-	/* Process plug-in protocols: */
-	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
+	ServerMetrics::writeHeader(os,"collaboration_client_queued_bytes","gauge","Total size of messages waiting in a client's outbound queue");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
 		{
-		ClientConnection* client=*clIt;
-		
-		/* Process plug-in protocols for the client: */
-		for(ClientConnection::ClientProtocolList::iterator cplIt=client->protocols.begin();cplIt!=client->protocols.end();++cplIt)
-			cplIt->protocol->afterServerUpdate(cplIt->protocolClientState);
-		
-		/* Unlock the client state: */
-		client->mutex.unlock();
+		writeClientLabels(os,"collaboration_client_queued_bytes",*cmIt);
+		os<<cmIt->queueSize<<'\n';
 		}
-	
-	/* Clear the client state list action list: */
-	actionList.clear();
-	
-	/* Reset change flags on all clients' state objects: */
-	for(ClientList::iterator clIt=clientList.begin();clIt!=clientList.end();++clIt)
-		(*clIt)->state.updateMask=ClientState::NO_CHANGE;
-	
-	/* Mark all dead clients for removal on the next update: */
-	for(std::vector<ClientConnection*>::const_iterator dclIt=deadClientList.begin();dclIt!=deadClientList.end();++dclIt)
+	ServerMetrics::writeHeader(os,"collaboration_client_congested","gauge","Whether the slow client policy is currently applied to a client");
+	for(std::vector<ClientMetrics>::const_iterator cmIt=clientMetrics.begin();cmIt!=clientMetrics.end();++cmIt)
 		{
-		/* Add the client removal action to the list: */
-		actionList.push_back(ClientListAction(ClientListAction::REMOVE_CLIENT,(*dclIt)->clientID,*dclIt));
+		writeClientLabels(os,"collaboration_client_congested",*cmIt);
+		os<<(cmIt->congested?1:0)<<'\n';
 		}
 	}
+
+bool CollaborationServer::dumpTickProfile(void)
+	{
+	if(tickProfiler==0)
+		return false;
 	
-	/* Process plug-in protocols: */
-	for(ProtocolList::iterator plIt=protocols.begin();plIt!=protocols.end();++plIt)
-		(*plIt)->afterServerUpdate();
-	}
+	std::string fileName=tickProfiler->dump();
+	std::cout<<"CollaborationServer: Wrote profile of recent server updates to "<<fileName<<std::endl<<std::flush;
+	return true;
 	}
 
 bool CollaborationServer::receiveConnectRequest(unsigned int clientID,Comm::NetPipe& pipe)
@@ -947,15 +3108,15 @@ void CollaborationServer::receiveClientUpdate(unsigned int clientID,Comm::NetPip
 	{
 	}
 
-void CollaborationServer::sendClientConnect(unsigned int sourceClientID,unsigned int destClientID,Comm::NetPipe& pipe)
+void CollaborationServer::sendClientConnect(unsigned int sourceClientID,unsigned int destClientID,IO::File& pipe)
 	{
 	}
 
-void CollaborationServer::sendServerUpdate(unsigned int destClientID,Comm::NetPipe& pipe)
+void CollaborationServer::sendServerUpdate(unsigned int destClientID,IO::File& pipe)
 	{
 	}
 
-void CollaborationServer::sendServerUpdate(unsigned int sourceClientID,unsigned int destClientID,Comm::NetPipe& pipe)
+void CollaborationServer::sendServerUpdate(unsigned int sourceClientID,unsigned int destClientID,IO::File& pipe)
 	{
 	}
 
@@ -973,8 +3134,14 @@ void CollaborationServer::disconnectClient(unsigned int clientID)
 	{
 	}
 
-void CollaborationServer::beforeServerUpdate(unsigned int clientID,Comm::NetPipe& pipe)
+void CollaborationServer::beforeServerUpdate(unsigned int clientID,IO::File& pipe)
 	{
 	}
 
+bool CollaborationServer::hasThreadSafeClientHooks(void) const
+	{
+	/* Default is to assemble all update messages from a single thread: */
+	return false;
+	}
+
 }
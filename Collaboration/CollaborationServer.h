@@ -26,17 +26,42 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #define COLLABORATION_COLLABORATIONSERVER_INCLUDED
 
 #include <utility>
+#include <iosfwd>
 #include <string>
 #include <vector>
+#include <Misc/Autopointer.h>
+#include <Misc/HashTable.h>
+#include <Misc/StringHashFunctions.h>
+#include <Misc/Time.h>
 #include <Misc/ConfigurationFile.h>
+#include <IO/VariableMemoryFile.h>
+#include <IO/FixedMemoryFile.h>
 #include <Plugins/ObjectLoader.h>
 #include <Threads/Thread.h>
+#include <Threads/Spinlock.h>
 #include <Threads/Mutex.h>
+#include <Threads/MutexCond.h>
+#include <Threads/TripleBuffer.h>
 #include <Comm/ListeningTCPSocket.h>
 #include <Comm/NetPipe.h>
 #include <Vrui/Geometry.h>
 #include <Collaboration/ProtocolServer.h>
 #include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/RingBuffer.h>
+#include <Collaboration/MessagePool.h>
+#include <Collaboration/OutboundQueue.h>
+#include <Collaboration/InterestGrid.h>
+#include <Collaboration/WorkerPool.h>
+#include <Collaboration/RelayLink.h>
+#include <Collaboration/SlotTable.h>
+#include <Collaboration/ProtocolSet.h>
+#include <Collaboration/TickScheduler.h>
+#include <Collaboration/DatagramChannel.h>
+#include <Collaboration/StateDeltaCodec.h>
+#include <Collaboration/PoseCodec.h>
+#include <Collaboration/ServerMetrics.h>
+#include <Collaboration/TickProfiler.h>
+#include <Collaboration/SessionRecorder.h>
 
 namespace Collaboration {
 
@@ -59,12 +84,63 @@ class CollaborationServer:private CollaborationProtocol
 		
 		/* Methods: */
 		void setListenPortId(int newListenPortId); // Overrides the default server listening port ID
+		void setDatagramPortId(int newDatagramPortId); // Overrides the default server datagram port ID; 0 picks any free port, negative values disable datagrams
+		void setDeltaStates(bool newDeltaStates); // Overrides whether the server sends state updates as differences to clients that request it
+		void setPoseBits(unsigned int newPositionBits,unsigned int newRotationBits); // Overrides the default precisions of quantized poses
 		double getTickTime(void); // Returns server loop's tick time in seconds
+		TickScheduler::OverrunPolicy getOverrunPolicy(void); // Returns the server loop's treatment of ticks missed due to long server updates
+		bool getIdleWhenEmpty(void); // Returns true if the server loop stops ticking while no clients are connected
+		double getStatisticsInterval(void); // Returns the interval in seconds at which the server loop reports tick statistics; 0 disables reports
 		};
 	
+	struct OutboundQueueStatus // Structure reporting the state of a client's outbound message queue
+		{
+		/* Elements: */
+		public:
+		unsigned int clientID; // ID of the client
+		size_t numMessages; // Number of messages waiting to be sent to the client
+		size_t queueSize; // Total size of messages waiting to be sent to the client in bytes
+		bool congested; // Flag whether the slow client policy is currently applied to the client
+		};
+	
+	typedef std::vector<OutboundQueueStatus> OutboundQueueStatusList; // Type for lists of outbound queue states
+	
 	private:
 	typedef std::vector<ProtocolServer*> ProtocolList; // Type for lists of server protocol plug-ins
+	typedef Misc::HashTable<std::string,unsigned int> ProtocolIndexMap; // Type for hash tables mapping protocol names to indices in the protocol list
 	typedef ProtocolServer::ClientState ProtocolClientState; // Type for protocol-specific client states
+	typedef ProtocolServer::ServerUpdateBatch ServerUpdateBatch; // Type for batches of protocol-specific server update payloads from one source client
+	typedef Misc::Autopointer<IO::VariableMemoryFile> MessageSegment; // Type for reference-counted pre-encoded message segments
+	typedef Misc::HashTable<unsigned int,unsigned int> UpdateMaskMap; // Type for hash tables mapping client IDs to accumulated state update masks
+	typedef Misc::HashTable<unsigned int,void> ClientIDSet; // Type for sets of client IDs
+	typedef Misc::HashTable<unsigned int,StateDeltaCodec::Baseline> BaselineMap; // Type for hash tables mapping client IDs to the client states a destination client already received
+	
+	struct ProtocolTable // Structure holding a snapshot of all registered protocol plug-ins; never changed after it is published, but replaced by an extended copy when a protocol is added
+		{
+		/* Elements: */
+		public:
+		ProtocolList protocols; // List of protocols registered with the server
+		ProtocolIndexMap protocolIndices; // Hash table mapping protocol names to their indices in the protocol list
+		std::vector<ProtocolServer*> messageTable; // Table mapping from message IDs to the protocol engines handling them
+		
+		/* Constructors and destructors: */
+		ProtocolTable(void)
+			:protocolIndices(17)
+			{
+			}
+		};
+	
+	enum SlowClientPolicy // Enumerated type for ways to treat clients whose outbound queues overflow
+		{
+		COALESCE_STATES, // Only send the newest state of every other client once the backlog has drained
+		DROP_MEDIA, // Let protocol plug-ins drop bulk media data until the backlog has drained
+		DISCONNECT // Disconnect clients that stay congested for longer than the slow client timeout
+		};
+	
+	struct Session;
+	struct ClientConnection;
+	
+	typedef std::vector<ClientConnection*> ClientList; // Type for lists of client connection state structures
 	
 	struct ClientConnection // Structure containing the current state of a client connection
 		{
@@ -78,10 +154,13 @@ class CollaborationServer:private CollaborationProtocol
 			unsigned int clientIndex; // Index of protocol in client's proposed list
 			ProtocolServer* protocol; // Pointer to protocol plug-in object
 			ProtocolClientState* protocolClientState; // Pointer to protocol's state object for this client
+			size_t sentBytes; // Number of payload bytes the protocol wrote for this client during the current server update
+			ServerUpdateBatch* batch; // Payloads the protocol wrote from this client to all destination clients during the current server update, or 0 if not yet created or if the protocol does not batch its server updates
+			bool batchFailed; // Flag whether the protocol failed to write its batch during the current server update
 			
 			/* Constructors and destructors: */
 			ProtocolListEntry(unsigned int sIndex,unsigned int sClientIndex,ProtocolServer* sProtocol,ProtocolClientState* sProtocolClientState)
-				:index(sIndex),clientIndex(sClientIndex),protocol(sProtocol),protocolClientState(sProtocolClientState)
+				:index(sIndex),clientIndex(sClientIndex),protocol(sProtocol),protocolClientState(sProtocolClientState),sentBytes(0),batch(0),batchFailed(false)
 				{
 				}
 			
@@ -94,18 +173,115 @@ class CollaborationServer:private CollaborationProtocol
 		
 		typedef std::vector<ProtocolListEntry> ClientProtocolList; // Type for lists of negotiated protocols
 		
+		enum
+			{
+			NUM_UPDATE_BITS=5 // Number of bits in a client state update mask
+			};
+		
+		struct StateSnapshot // Structure to hand a client's state from its receiving thread to the server update
+			{
+			/* Elements: */
+			public:
+			ClientState state; // Client's complete state after the most recent client update
+			unsigned int serial; // Serial number of the client update that produced this snapshot
+			unsigned int changeSerials[NUM_UPDATE_BITS]; // Serial numbers of the most recent client updates that changed each part of the client state
+			};
+		
+		struct JoinSnapshot // Structure caching a client's CLIENT_CONNECT message in serialized form, to be copied to all clients joining during one server update
+			{
+			/* Elements: */
+			public:
+			unsigned int updateCounter; // Update counter of the client's session at the server update that encoded the snapshot
+			MessageSegment header; // Segment containing the message ID, the client's ID, and its full state
+			std::vector<MessageSegment> protocolPayloads; // Segments containing the CLIENT_CONNECT payloads of the client's negotiated protocol plug-ins in list order, or null if not yet encoded or written per destination
+			
+			/* Constructors and destructors: */
+			JoinSnapshot(void)
+				:updateCounter(0)
+				{
+				}
+			};
+		
+		struct PoseSnapshot // Structure to hand a client's most recent pose received by datagram to the server update
+			{
+			/* Elements: */
+			public:
+			ClientState pose; // Viewer states and navigation transformation received from the client
+			DatagramChannel::Address address; // Address from which the client sent the datagram
+			};
+		
+		enum CommunicationState // Enumerated type for states of the client communication state machine
+			{
+			NEGOTIATE,START,CONNECTED,FINISH
+			};
+		
 		/* Elements: */
 		public:
 		Threads::Mutex mutex; // Mutex protecting the client connection state structure
-		unsigned int clientID; // Server-wide unique client ID
+		unsigned int clientID; // Server-wide unique client ID, encoding the client's slot in the server's client table
 		Threads::Mutex pipeMutex; // Mutex protecting the client communication pipe
 		Comm::NetPipePtr pipe; // Communication pipe connecting to the client
+		int recordingStreamId; // ID of the client's stream in the server's session log, or -1 if the client's traffic is not recorded
 		std::string clientHostname; // Hostname of connected client
 		int clientPortId; // Port ID of connected client
 		ClientProtocolList protocols; // List of protocol plug-ins negotiated with this client sorted in order of ascending index
-		Threads::Thread communicationThread; // Thread receiving messages from the connected client
-		ClientState state; // Transient client state
+		ProtocolSet protocolSet; // Set of main list indices of all protocol plug-ins negotiated with this client
+		std::vector<unsigned int> protocolSlots; // Dense array mapping main list indices of negotiated protocol plug-ins to their positions in the negotiated protocol list
+		Threads::Thread communicationThread; // Thread receiving messages from the connected client if the server does not run an event loop
+		CommunicationState communicationState; // Current state of the client communication state machine
+		bool clientAdded; // Flag whether the client was ever "officially" connected
+		bool addPending; // Flag whether the client's add action is still waiting in its session's action list; protected by the session's client list mutex
+		std::string sessionName; // Name of the session the client requested to join
+		Session* session; // Session the client joined, or 0 if the client was never added
+		unsigned int listIndex; // Index of the client in its session's client list; protected by the session's client list mutex
+		int relayIndex; // Index of the reserved relay entry in the client's protocol list if the connection is a relay link, or -1
+		int datagramIndex; // Index of the reserved datagram entry in the client's protocol list if the client exchanges poses by datagram, or -1
+		int deltaIndex; // Index of the reserved delta entry in the client's protocol list if the client receives state updates as differences, or -1
+		int quantizedPosesIndex; // Index of the reserved quantized poses entry in the client's protocol list if the client exchanges poses in quantized form, or -1
+		PoseCodec poseCodec; // Codec for viewer states and navigation transformations exchanged with the client over the pipe
+		int compressionIndex; // Index of the reserved compression entry in the client's protocol list if the client accepts bulk payloads in compression envelopes, or -1
+		unsigned int datagramToken; // Random number authenticating datagrams from the client
+		unsigned int datagramSequence; // Sequence number of the most recent datagram received from the client; only accessed by the server's datagram thread
+		bool datagramSenderKnown; // Flag whether an authenticated datagram was received from the client; only accessed by the server's datagram thread
+		DatagramChannel::Address datagramSender; // Address of the client's first authenticated datagram, the only address accepted afterwards; only accessed by the server's datagram thread
+		Threads::TripleBuffer<PoseSnapshot> poseSnapshots; // Buffer publishing poses received by datagram to the server update
+		bool hasPose; // Flag whether a pose was received by datagram
+		ClientState pose; // Most recent pose received by datagram, applied over every client state received over the pipe
+		bool datagramAddressValid; // Flag whether the client's datagram address is known, i.e., whether the client receives other clients' poses by datagram
+		DatagramChannel::Address datagramAddress; // Address to which datagrams for the client are sent
+		unsigned int poseChangeCounter; // Update counter of the client's session at the most recent server update that changed the client's pose
+		ClientState receivedState; // Client state as most recently received; only accessed by the thread reading from the client
+		unsigned int receivedSerial; // Serial number of the most recently received client update
+		unsigned int changeSerials[NUM_UPDATE_BITS]; // Serial numbers of the most recently received client updates that changed each part of the client state
+		Threads::TripleBuffer<StateSnapshot> stateSnapshots; // Buffer publishing the received client state to the server update without locking
+		unsigned int consumedSerial; // Serial number of the snapshot most recently picked up by the server update
+		ClientState state; // Transient client state as frozen for the current server update; protected by the server's client list mutex
 		unsigned int stateUpdateMask; // Update mask for the transient client state
+		MessageSegment updateSegments[8]; // Segments containing the client's ID and state update for the current server update, in native and swapped endianness, with and without the pose, and with raw or quantized poses
+		JoinSnapshot joinSnapshots[8]; // Cached CLIENT_CONNECT messages for clients joining during the current server update, in native and swapped endianness, with raw or quantized poses, and with plain or compressed bulk payloads
+		bool joining; // Flag whether the client was added during the current server update and still needs CLIENT_CONNECT messages for all clients already in its session; protected by the session's client list mutex
+		MessagePool messagePool; // Pool recycling the client's update messages after sender threads wrote them
+		OutboundQueue::Message updateMessage; // Update message assembled for the client during the current server update, until it is queued in client list order
+		bool updateFailed; // Flag whether assembling the client's update message failed during the current server update
+		OutboundQueue outboundQueue; // Queue of messages waiting to be sent to the client by a sender thread
+		bool sendScheduled; // Flag whether the client is in the server's list of clients with pending outbound messages; protected by the server's sender condition variable
+		bool sending; // Flag whether a sender thread is currently writing to the client; protected by the server's sender condition variable
+		IO::FixedMemoryFile* sendBuffer; // Contiguous copy of the outbound message currently written to the client, reused between messages, or 0 if not yet created; protected by the pipe mutex
+		size_t sendSize; // Size of the message in the send buffer, or 0 if no message is partially written; protected by the pipe mutex
+		size_t sendOffset; // Number of bytes of the message in the send buffer already written to the client; protected by the pipe mutex
+		bool waitingWritable; // Flag whether the client's socket did not accept more data, and the client waits for the writable thread instead of being in the sender schedule; protected by the server's sender condition variable
+		bool writableWatched; // Flag whether the client's socket was ever added to the server's writable epoll set; protected by the server's sender condition variable
+		Misc::Time sendDeadline; // Time at which a client waiting for its socket to become writable is disconnected; protected by the server's sender condition variable
+		volatile bool outboundFailed; // Flag whether writing to the client failed, or the client is being disconnected
+		bool killed; // Flag whether the server forcibly disconnected the client
+		bool congested; // Flag whether the client's outbound queue is currently over its limit
+		Misc::Time congestionDeadline; // Time at which a congested client is disconnected under the DISCONNECT policy
+		UpdateMaskMap pendingStateMasks; // Map from source client IDs to state update masks withheld from the client while its outbound queue is congested or the source is outside its area of interest
+		Point navPosition; // Position of the client's display center in shared navigational space for the current server update
+		ClientIDSet interestingClients; // Set of IDs of clients inside the client's area of interest
+		BaselineMap deltaBaselines; // Map from source client IDs to the source client states most recently sent to the client, if the client receives state updates as differences
+		ServerMetrics::Counter sentMessages; // Number of messages sender threads wrote to the client
+		ServerMetrics::Counter sentBytes; // Number of bytes sender threads wrote to the client
 		
 		/* Constructors and destructors: */
 		ClientConnection(unsigned int sClientID,Comm::NetPipePtr sPipe);
@@ -113,11 +289,14 @@ class CollaborationServer:private CollaborationProtocol
 		
 		/* Methods: */
 		bool negotiateProtocols(CollaborationServer& server); // Finds the common subset of protocol plug-ins registered on the client and server; returns false if any protocol rejects the client
-		void sendClientConnectProtocols(ClientConnection* dest,Comm::NetPipe& destPipe); // Lets all protocol plug-ins shared by the two clients write their CLIENT_CONNECT message payloads
+		void indexProtocols(void); // Sorts the negotiated protocol list and builds the protocol set and slot array to intersect it with other clients' lists
+		void publishState(void); // Publishes the received client state after it was updated from the client
+		void consumeState(void); // Picks up the most recently published client state for the current server update
+		void writeClientConnect(ClientConnection* dest,unsigned int updateCounter,IO::VariableMemoryFile& destPipe,TickProfiler* profiler); // Writes a CLIENT_CONNECT message for this client with the payloads of all protocol plug-ins shared by the two clients, encoding the header and destination-independent plug-in payloads only once per server update and destination variant; times the plug-ins if the profiler is not null
+		void batchServerUpdateProtocols(const ClientList& clientList,TickProfiler* profiler); // Lets all protocol plug-ins negotiated with this client that declare batched server updates write their SERVER_UPDATE message payloads for all other live clients in the given list at once; times the plug-ins if the profiler is not null
+		void sendServerUpdateProtocols(ClientConnection* dest,IO::VariableMemoryFile& destPipe,bool reduced,TickProfiler* profiler); // Copies the SERVER_UPDATE message payloads of all protocol plug-ins shared by the two clients, or lets the plug-ins write reduced payloads without bulk media data if reduced is true; times the plug-ins if the profiler is not null
 		};
 	
-	typedef std::vector<ClientConnection*> ClientList; // Type for lists of client connection state structures
-	
 	struct ClientListAction // Structure to hold recent changes to the client list
 		{
 		/* Embedded classes: */
@@ -129,35 +308,179 @@ class CollaborationServer:private CollaborationProtocol
 		
 		/* Elements: */
 		Action action; // Which action was taken
-		unsigned int clientID; // ID of the client that was added or removed
-		ClientConnection* client; // Pointer to client connection state structure of an added client
+		unsigned int clientID; // ID of the client that was added or removed; resolved through the server's client table
 		
 		/* Constructors and destructors: */
-		ClientListAction(Action sAction,unsigned int sClientID,ClientConnection* sClient)
-			:action(sAction),clientID(sClientID),client(sClient)
+		ClientListAction(Action sAction,unsigned int sClientID)
+			:action(sAction),clientID(sClientID)
 			{
 			}
 		};
 	
 	typedef std::vector<ClientListAction> ActionList; // Type for lists of client list actions
 	
+	enum UpdatePhase // Enumerated type for phases of a session's server update that can run for disjoint ranges of clients in parallel
+		{
+		FREEZE_CLIENTS,WRITE_UPDATES,FINISH_CLIENTS
+		};
+	
+	enum HookSelection // Enumerated type to select the protocol plug-ins whose per-client hooks a server update phase calls
+		{
+		ALL_HOOKS,THREAD_SAFE_HOOKS,OTHER_HOOKS
+		};
+	
+	struct UpdateJob:public WorkerPool::Job // Structure for jobs running one phase of a session's server update for a range of the session's clients
+		{
+		/* Elements: */
+		public:
+		Session* session; // Session being updated
+		UpdatePhase phase; // Phase to run
+		unsigned int begin,end; // Range of indices in the session's client list
+		
+		/* Methods from WorkerPool::Job: */
+		virtual void run(void);
+		};
+	
+	friend struct UpdateJob;
+	
+	struct ClientGauges // Structure holding a client's per-client metrics as of the end of a server update
+		{
+		/* Elements: */
+		public:
+		unsigned int clientID; // ID of the client
+		int socketFd; // File descriptor of the client's TCP socket, to query the kernel's byte counts
+		Misc::UInt64 sentMessages; // Number of messages written to the client
+		Misc::UInt64 sentBytes; // Number of bytes written to the client
+		size_t numQueuedMessages; // Number of messages waiting in the client's outbound queue
+		size_t queueSize; // Total size of messages waiting in the client's outbound queue
+		bool congested; // Flag whether the slow client policy is currently applied to the client
+		};
+	
+	struct Session:public WorkerPool::Job // Structure for independent sets of clients sharing the server's listening socket and protocol plug-ins
+		{
+		/* Elements: */
+		public:
+		CollaborationServer* server; // Pointer to the server hosting the session
+		std::string name; // Name of the session
+		unsigned int numReferences; // Number of clients and server updates referencing the session; protected by the server's session list mutex
+		Threads::Mutex clientListMutex; // Mutex protecting the session's client list and action list
+		ClientList clientList; // The list containing the states of all clients currently connected to the session
+		ActionList actionList; // List of recent client state list actions in the session
+		InterestGrid* interestGrid; // Spatial index of the session's clients' positions in navigational space, or 0 if area of interest filtering is disabled
+		unsigned int updateCounter; // Number of server updates sent to the session so far
+		ClientList addedClients; // Clients added by the actions in the action list during the current server update, or null for other actions; like the following scratch elements, kept between updates to reuse its memory
+		ClientList deadClientList; // Clients forcibly disconnected during the current server update
+		InterestGrid::NeighborList neighbors; // Clients near the client whose area of interest is being updated
+		std::vector<unsigned int> interestingClients; // IDs of clients inside the area of interest being updated
+		IO::VariableMemoryFile* datagramEntry; // Buffer holding one client's pose while pose datagrams are assembled, or 0 if not yet created
+		IO::VariableMemoryFile* datagram; // Buffer holding the pose datagram being assembled, or 0 if not yet created
+		std::vector<UpdateJob> updateJobs; // Jobs running the current phase of the server update on the server's hook pool
+		Threads::MutexCond updateJobCond; // Condition variable signalling when the last of the session's update jobs is finished
+		unsigned int numPendingUpdateJobs; // Number of the session's update jobs that are not yet finished; protected by updateJobCond
+		Threads::TripleBuffer<std::vector<ClientGauges> > clientGauges; // Metrics of all clients in the session, published at the end of each server update and read by the metrics thread without locking the client list
+		
+		/* Constructors and destructors: */
+		Session(CollaborationServer* sServer,const std::string& sName);
+		virtual ~Session(void);
+		
+		/* Methods from WorkerPool::Job: */
+		virtual void run(void);
+		};
+	
+	friend struct Session;
+	
+	typedef std::vector<Session*> SessionList; // Type for lists of sessions
+	
+	typedef SlotTable<ClientConnection> ClientTable; // Type for tables mapping client IDs to client connection state structures
+	
 	/* Elements: */
 	private:
 	Configuration* configuration; // Pointer to the server's configuration object
 	ProtocolServerLoader protocolLoader; // Object loader to dynamically load protocol plug-ins requested by clients
 	Comm::ListeningTCPSocket listenSocket; // Socket receiving connection requests from clients
-	Threads::Thread listenThread; // Thread receiving connection request messages
-	Threads::Mutex protocolListMutex; // Mutex protecting the protocol list
-	ProtocolList protocols; // List of protocols currently registered with the server
-	std::vector<ProtocolServer*> messageTable; // Table mapping from message IDs to the protocol engines handling them
-	Threads::Mutex clientListMutex; // Mutex protecting the client state list
-	ClientList clientList; // The list containing the states of all currently connected clients
-	ActionList actionList; // List of recent client state list actions
-	unsigned int nextClientID; // Unique identification numbers assigned to clients in order of connection
+	Threads::Thread listenThread; // Thread receiving connection request messages if the server does not run an event loop
+	bool eventLoop; // Flag whether client communication is handled by a small pool of event-driven I/O threads instead of one thread per client
+	double ioTimeout; // Maximum time in seconds an I/O thread waits for the remainder of a partially received message in event loop mode
+	int epollFd; // File descriptor of the epoll set watching the listening socket and all client sockets in event loop mode
+	unsigned int numIoThreads; // Number of I/O threads in event loop mode
+	Threads::Thread* ioThreads; // Array of I/O threads in event loop mode
+	double sendTimeout; // Maximum time in seconds a client may not accept any outbound data before it is disconnected
+	bool acceptRelayLinks; // Flag whether the server accepts relay links from CollaborationRelay processes
+	size_t maxQueueDepth; // Number of queued outbound messages above which a client is considered congested
+	size_t maxQueueSize; // Total size of queued outbound messages in bytes above which a client is disconnected
+	SlowClientPolicy slowClientPolicy; // Policy applied to congested clients
+	double slowClientTimeout; // Time in seconds after which a congested client is disconnected under the DISCONNECT policy
+	Threads::MutexCond senderCond; // Condition variable protecting the list of clients with pending outbound messages
+	RingBuffer<ClientConnection*> readyClients; // List of clients with pending outbound messages, in order of scheduling
+	unsigned int numSenderThreads; // Number of sender threads
+	Threads::Thread* senderThreads; // Array of threads draining the clients' outbound queues
+	int writableEpollFd; // File descriptor of the epoll set watching the sockets of clients that did not accept more outbound data
+	Threads::Thread writableThread; // Thread returning clients to the sender schedule once their sockets accept more data
+	Scalar interestRadius; // Radius around each client's position in navigational space inside which other clients receive full updates; 0 disables area of interest filtering
+	Scalar interestLeaveRadius; // Radius beyond which a client leaves another client's area of interest once inside
+	unsigned int outOfInterestInterval; // Number of server updates between state refreshes for clients outside another client's area of interest; 0 never refreshes
+	Scalar interestCellSize; // Cell size of the sessions' spatial indices for area of interest filtering
+	WorkerPool* updatePool; // Pool of threads updating sessions in parallel, or 0 if sessions are updated sequentially
+	WorkerPool* hookPool; // Pool of threads running thread-safe per-client protocol hooks and assembling update messages in parallel, or 0 if server updates run them on their own threads
+	DatagramChannel* datagramChannel; // UDP channel exchanging poses with clients that requested it, or 0 if disabled
+	Threads::Thread datagramThread; // Thread receiving poses from clients by datagram
+	unsigned int datagramRedundancy; // Number of server updates during which a client's pose is sent by datagram after it last changed, to recover from lost datagrams
+	bool deltaStates; // Flag whether the server sends state updates as differences to clients that request it
+	PoseCodec poseCodec; // Codec for poses exchanged with clients that request quantized poses; writes raw scalars if quantization is disabled
+	size_t compressionThreshold; // Size in bytes above which bulk protocol payloads are compressed for clients that request it; 0 disables compression
+	Threads::Mutex protocolLoadMutex; // Mutex serializing the loading and registering of protocol plug-ins; never held by server updates
+	Threads::Spinlock protocolTableMutex; // Mutex protecting the pointer to the current protocol table
+	ProtocolTable* protocolTable; // Protocol table holding all protocols currently registered with the server
+	std::vector<ProtocolTable*> retiredProtocolTables; // Protocol tables replaced by extended copies, kept until shutdown because other threads might still be reading them
+	Threads::Mutex relayLinkMutex; // Mutex protecting the list of relay links
+	std::vector<RelayLink*> relayLinks; // List of relay links connected to the server
+	Threads::Mutex sessionListMutex; // Mutex protecting the session list
+	SessionList sessions; // List of currently active sessions
+	SessionList updateSessions; // List of sessions taking part in the current server update, kept between updates to reuse its memory
+	Threads::Mutex clientTableMutex; // Mutex protecting the client table
+	ClientTable clientTable; // Table assigning IDs to all client connections and mapping IDs back to their state structures
+	int clientArrivalFd; // Event file descriptor signalled whenever a new client connects
+	ServerMetrics metrics; // Server-wide counters and histograms
+	int metricsSocketFd; // Loopback TCP socket on which the server answers metrics scrapes, or -1 if disabled
+	Threads::Thread metricsThread; // Thread answering metrics scrapes
+	TickProfiler* tickProfiler; // Flight recorder of the most recent server updates, or 0 if server updates are not profiled
+	SessionRecorder* sessionRecorder; // Recorder logging all traffic received from clients, or 0 if traffic is not recorded
 	
 	/* Private methods: */
+	const ProtocolTable* getProtocolTable(void) // Returns the current protocol table, which stays valid for the server's lifetime
+		{
+		Threads::Spinlock::Lock protocolTableLock(protocolTableMutex);
+		return protocolTable;
+		}
+	std::pair<ProtocolServer*,int> addProtocol(ProtocolServer* newProtocol); // Assigns message IDs to a new protocol and publishes an extended protocol table; must be called with the protocol load mutex locked
+	ClientConnection* acceptClient(void); // Accepts the next incoming connection on the listening socket, re-arms the listening socket in event loop mode, and sends the server's endianness indicator; returns 0 if connection failed
+	bool handleClientMessage(ClientConnection* client); // Reads and processes the next message from the given client; returns false when the client connection is finished
+	ClientConnection* findClient(unsigned int clientID); // Returns the client connection state structure of the given ID, or 0 if the client has been deleted
+	void destroyClient(ClientConnection* client); // Releases the given client's ID and deletes its connection state structure (closing its TCP pipe)
+	void finishClient(ClientConnection* client); // Removes the given client from the server after its connection has finished
 	void* listenThreadMethod(void); // Method for thread receiving connection request messages
 	void* clientCommunicationThreadMethod(ClientConnection* client); // Method for thread receiving messages from connected clients
+	void watchSocket(int fd,ClientConnection* client,bool firstTime); // Adds a socket to the event loop's epoll set, or re-arms it after an event
+	void* ioThreadMethod(void); // Method for event-driven I/O threads serving the listening socket and all client connections
+	void queueMessage(ClientConnection* client,OutboundQueue::Message message); // Appends a message to a client's outbound queue and schedules the client for sending
+	void unscheduleClient(ClientConnection* client); // Waits until no sender thread is writing to the given client anymore, and removes it from the sender schedule
+	bool writeSendBuffer(ClientConnection* client); // Writes as much of the client's partially written message as its socket accepts without blocking; returns false if the socket did not accept all of it; must be called with the client's pipe mutex locked
+	void finishSendBuffer(ClientConnection* client); // Writes the rest of the client's partially written message into its pipe, so that other data can follow it; must be called with the client's pipe mutex locked
+	void* senderThreadMethod(void); // Method for threads draining clients' outbound message queues without blocking
+	void* writableThreadMethod(void); // Method for thread returning clients to the sender schedule once their sockets accept more data
+	void* datagramThreadMethod(void); // Method for thread receiving poses from clients by datagram
+	void* metricsThreadMethod(void); // Method for thread answering metrics scrapes on the loopback socket
+	void sendPoseDatagrams(Session* session,ClientConnection* destClient,bool interestRefresh); // Sends the recently changed poses of all other clients in a session to the given client by datagram
+	void killClient(ClientConnection* client,std::vector<ClientConnection*>& deadClientList); // Forcibly disconnects a client from inside a server update
+	void acceptRelayLink(ClientConnection* client); // Turns the given connection into a relay link after its connect request was accepted
+	Session* getSession(const std::string& sessionName); // Returns a new reference to the session of the given name, creating the session if it does not exist
+	void getSessions(SessionList& sessionList); // Returns new references to all active sessions
+	void releaseSession(Session* session); // Releases a reference to the given session, and deletes the session when it is no longer referenced
+	void freezeClients(Session* session,unsigned int begin,unsigned int end,HookSelection hooks); // Picks up the most recent states of a range of a session's clients, and lets the selected protocol plug-ins take snapshots of their client states
+	void writeUpdateMessages(Session* session,unsigned int begin,unsigned int end); // Assembles the update messages of a range of a session's clients without queueing them
+	void finishClients(Session* session,unsigned int begin,unsigned int end,HookSelection hooks); // Lets the selected protocol plug-ins finish the server update for a range of a session's clients
+	void runUpdatePhase(Session* session,UpdatePhase phase,bool threadSafeHooks); // Runs a phase of a session's server update, splitting it across the hook pool if there is one; threadSafeHooks is true if the server and all protocol plug-ins in the session declared thread-safe client hooks
+	void updateSession(Session* session); // Sends state updates to all clients connected to the given session
 	
 	/* Constructors and destructors: */
 	public:
@@ -172,6 +495,26 @@ class CollaborationServer:private CollaborationProtocol
 	virtual void registerProtocol(ProtocolServer* newProtocol); // Registers a new protocol plug-in with the server; server inherits objects
 	virtual std::pair<ProtocolServer*,int> loadProtocol(std::string protocolName); // Returns a protocol server plug-in for the given protocol, or 0
 	virtual void update(void); // Signals the server to send state updates to all connected clients
+	OutboundQueueStatusList getOutboundQueueStatus(void); // Returns the states of the outbound message queues of all connected clients
+	int getClientArrivalFd(void) const // Returns a file descriptor that becomes readable when a new client connects
+		{
+		return clientArrivalFd;
+		}
+	bool isIdle(void); // Returns true if no clients are connected; resets the client arrival file descriptor before checking
+	const PoseCodec& getPoseCodec(void) const // Returns the codec for quantized poses offered to clients
+		{
+		return poseCodec;
+		}
+	size_t getCompressionThreshold(void) const // Returns the size in bytes above which bulk protocol payloads are compressed, or 0 if compression is disabled
+		{
+		return compressionThreshold;
+		}
+	const ServerMetrics& getMetrics(void) const // Returns the server-wide counters and histograms
+		{
+		return metrics;
+		}
+	void writeMetrics(std::ostream& os); // Writes all server, protocol, and per-client metrics in Prometheus text format
+	bool dumpTickProfile(void); // Writes the profiles of the most recent server updates to a new dump file; returns false if server updates are not profiled
 	
 	/*********************************************************************
 	Hook methods to layer application-level protocols over the base
@@ -185,15 +528,16 @@ class CollaborationServer:private CollaborationProtocol
 	virtual void receiveDisconnectRequest(unsigned int clientID,Comm::NetPipe& pipe); // Hook called when the server receives a disconnection request
 	virtual void sendDisconnectReply(unsigned int clientID,Comm::NetPipe& pipe); // Hook called when the server sends a disconnect reply to a client
 	virtual void receiveClientUpdate(unsigned int clientID,Comm::NetPipe& pipe); // Hook called when the server receives a client's state update packet
-	virtual void sendClientConnect(unsigned int sourceClientID,unsigned int destClientID,Comm::NetPipe& pipe); // Hook called when the server sends a connection message for client sourceClient to client destClient
-	virtual void sendServerUpdate(unsigned int destClientID,Comm::NetPipe& pipe); // Hook called when the server sends a state update to a client
-	virtual void sendServerUpdate(unsigned int sourceClientID,unsigned int destClientID,Comm::NetPipe& pipe); // Hook called when the server sends a state update for client sourceClient to client destClient
+	virtual void sendClientConnect(unsigned int sourceClientID,unsigned int destClientID,IO::File& pipe); // Hook called when the server sends a connection message for client sourceClient to client destClient
+	virtual void sendServerUpdate(unsigned int destClientID,IO::File& pipe); // Hook called when the server sends a state update to a client
+	virtual void sendServerUpdate(unsigned int sourceClientID,unsigned int destClientID,IO::File& pipe); // Hook called when the server sends a state update for client sourceClient to client destClient
 	
 	/* Hooks to insert processing into the lower-level protocol state machine: */
 	virtual bool handleMessage(unsigned int clientID,Comm::NetPipe& pipe,Protocol::MessageIdType messageId); // Hook called when server receives unknown message from client; returns false to signal protocol error
 	virtual void connectClient(unsigned int clientID); // Hook called when connection to a new client has been fully established
 	virtual void disconnectClient(unsigned int clientID); // Hook called after a client has been disconnected (voluntarily or involuntarily)
-	virtual void beforeServerUpdate(unsigned int clientID,Comm::NetPipe& pipe); // Hook called right before the server sends a state update message to the given client
+	virtual void beforeServerUpdate(unsigned int clientID,IO::File& pipe); // Hook called right before the server sends a state update message to the given client
+	virtual bool hasThreadSafeClientHooks(void) const; // Returns true if the server may call the above per-destination update message hooks concurrently for different destination clients; default returns false
 	};
 
 }
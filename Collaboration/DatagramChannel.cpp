@@ -0,0 +1,176 @@
+/***********************************************************************
+DatagramChannel - Class for UDP sockets carrying transient client state
+that is superseded by every newer update, with optional simulated packet
+loss for testing.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/DatagramChannel.h>
+
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Endianness.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
+#include <Math/Random.h>
+
+namespace Collaboration {
+
+/********************************
+Methods of class DatagramChannel:
+********************************/
+
+DatagramChannel::DatagramChannel(int portId)
+	:socketFd(socket(PF_INET,SOCK_DGRAM,0)),
+	 lossRate(0.0),
+	 packet(0)
+	{
+	if(socketFd<0)
+		Misc::throwStdErr("DatagramChannel::DatagramChannel: Unable to create UDP socket");
+	
+	/* Bind the socket to the requested local port: */
+	struct sockaddr_in socketAddress;
+	memset(&socketAddress,0,sizeof(struct sockaddr_in));
+	socketAddress.sin_family=AF_INET;
+	socketAddress.sin_port=portId>=0?htons(portId):0;
+	socketAddress.sin_addr.s_addr=htonl(INADDR_ANY);
+	if(bind(socketFd,(struct sockaddr*)&socketAddress,sizeof(struct sockaddr_in))!=0)
+		{
+		close(socketFd);
+		Misc::throwStdErr("DatagramChannel::DatagramChannel: Unable to bind UDP socket to port %d",portId);
+		}
+	}
+
+DatagramChannel::~DatagramChannel(void)
+	{
+	close(socketFd);
+	delete packet;
+	}
+
+int DatagramChannel::getPortId(void) const
+	{
+	struct sockaddr_in socketAddress;
+	socklen_t socketAddressLen=sizeof(struct sockaddr_in);
+	if(getsockname(socketFd,(struct sockaddr*)&socketAddress,&socketAddressLen)!=0)
+		return -1;
+	return ntohs(socketAddress.sin_port);
+	}
+
+void DatagramChannel::setLossRate(double newLossRate)
+	{
+	lossRate=newLossRate;
+	}
+
+void DatagramChannel::connect(const char* hostName,int portId)
+	{
+	/* Look up the host's IP address: */
+	struct hostent* hostEntry=gethostbyname(hostName);
+	if(hostEntry==0)
+		Misc::throwStdErr("DatagramChannel::connect: Unable to resolve host name %s",hostName);
+	
+	/* Connect the socket to the host and port: */
+	struct sockaddr_in hostAddress;
+	memset(&hostAddress,0,sizeof(struct sockaddr_in));
+	hostAddress.sin_family=AF_INET;
+	hostAddress.sin_port=htons(portId);
+	hostAddress.sin_addr=*(struct in_addr*)(hostEntry->h_addr_list[0]);
+	if(::connect(socketFd,(struct sockaddr*)&hostAddress,sizeof(struct sockaddr_in))!=0)
+		Misc::throwStdErr("DatagramChannel::connect: Unable to connect UDP socket to host %s, port %d",hostName,portId);
+	}
+
+IO::VariableMemoryFile* DatagramChannel::createDatagram(void)
+	{
+	/* Datagrams are always little-endian, since they are not covered by a pipe's endianness negotiation: */
+	IO::VariableMemoryFile* result=new IO::VariableMemoryFile(MAX_DATAGRAM_SIZE);
+	result->setEndianness(Misc::LittleEndian);
+	return result;
+	}
+
+void DatagramChannel::sendPacket(const IO::VariableMemoryFile& datagram,const DatagramChannel::Address* address)
+	{
+	/* Simulate packet loss: */
+	if(lossRate>0.0&&Math::randUniformCO()<lossRate)
+		return;
+	
+	size_t datagramSize=datagram.getDataSize();
+	if(datagramSize>MAX_DATAGRAM_SIZE)
+		{
+		/* Copy an oversized datagram into its own contiguous memory and send it; failures are ignored like any lost datagram: */
+		IO::FixedMemoryFile oversizedPacket(datagramSize);
+		datagram.writeToSink(oversizedPacket);
+		oversizedPacket.flush();
+		if(address!=0)
+			sendto(socketFd,oversizedPacket.getMemory(),datagramSize,MSG_DONTWAIT,(const struct sockaddr*)address,sizeof(Address));
+		else
+			::send(socketFd,oversizedPacket.getMemory(),datagramSize,MSG_DONTWAIT);
+		return;
+		}
+	
+	/* Copy the datagram into the reused packet buffer and send it; failures are ignored like any lost datagram: */
+	Threads::Mutex::Lock packetLock(packetMutex);
+	if(packet==0)
+		packet=new IO::FixedMemoryFile(MAX_DATAGRAM_SIZE);
+	packet->setWritePosAbs(0);
+	datagram.writeToSink(*packet);
+	packet->flush();
+	if(address!=0)
+		sendto(socketFd,packet->getMemory(),datagramSize,MSG_DONTWAIT,(const struct sockaddr*)address,sizeof(Address));
+	else
+		::send(socketFd,packet->getMemory(),datagramSize,MSG_DONTWAIT);
+	}
+
+void DatagramChannel::send(const IO::VariableMemoryFile& datagram)
+	{
+	sendPacket(datagram,0);
+	}
+
+void DatagramChannel::send(const IO::VariableMemoryFile& datagram,const DatagramChannel::Address& address)
+	{
+	sendPacket(datagram,&address);
+	}
+
+IO::FixedMemoryFile* DatagramChannel::receive(DatagramChannel::Address& sender)
+	{
+	char buffer[MAX_DATAGRAM_SIZE];
+	ssize_t datagramSize;
+	while(true)
+		{
+		/* Wait for the next datagram: */
+		socklen_t senderLen=sizeof(Address);
+		datagramSize=recvfrom(socketFd,buffer,sizeof(buffer),0,(struct sockaddr*)&sender,&senderLen);
+		if(datagramSize>0)
+			break;
+		if(datagramSize<0&&errno!=EINTR&&errno!=ECONNREFUSED)
+			Misc::throwStdErr("DatagramChannel::receive: Error while receiving datagram");
+		}
+	
+	/* Wrap the datagram into a memory file in the channel's byte order: */
+	IO::FixedMemoryFile* result=new IO::FixedMemoryFile(datagramSize);
+	memcpy(result->getMemory(),buffer,datagramSize);
+	result->setEndianness(Misc::LittleEndian);
+	return result;
+	}
+
+}
@@ -0,0 +1,83 @@
+/***********************************************************************
+DatagramChannel - Class for UDP sockets carrying transient client state
+that is superseded by every newer update, with optional simulated packet
+loss for testing.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_DATAGRAMCHANNEL_INCLUDED
+#define COLLABORATION_DATAGRAMCHANNEL_INCLUDED
+
+#include <stddef.h>
+#include <netinet/in.h>
+#include <Threads/Mutex.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+class FixedMemoryFile;
+class VariableMemoryFile;
+}
+
+namespace Collaboration {
+
+class DatagramChannel
+	{
+	/* Embedded classes: */
+	public:
+	enum
+		{
+		MAX_DATAGRAM_SIZE=1200 // Maximum size of datagrams in bytes, to avoid IP fragmentation on typical paths
+		};
+	
+	typedef struct sockaddr_in Address; // Type for datagram source and destination addresses
+	
+	/* Elements: */
+	private:
+	int socketFd; // File descriptor of the UDP socket
+	double lossRate; // Probability with which outgoing datagrams are dropped to simulate packet loss
+	Threads::Mutex packetMutex; // Mutex serializing access to the packet buffer
+	IO::FixedMemoryFile* packet; // Buffer copying outgoing datagrams into contiguous memory, reused for all datagrams that fit
+	
+	/* Private methods: */
+	void sendPacket(const IO::VariableMemoryFile& datagram,const Address* address); // Sends a datagram to the given address, or to the connected peer if the address is null
+	
+	/* Constructors and destructors: */
+	public:
+	DatagramChannel(int portId); // Creates a channel bound to the given local UDP port, or to any free port if portId is negative
+	private:
+	DatagramChannel(const DatagramChannel& source); // Prohibit copy constructor
+	DatagramChannel& operator=(const DatagramChannel& source); // Prohibit assignment operator
+	public:
+	~DatagramChannel(void);
+	
+	/* Methods: */
+	int getPortId(void) const; // Returns the local UDP port to which the channel is bound
+	void setLossRate(double newLossRate); // Sets the probability with which outgoing datagrams are dropped
+	void connect(const char* hostName,int portId); // Restricts the channel to exchanging datagrams with the given host and port
+	static IO::VariableMemoryFile* createDatagram(void); // Returns a new buffer to assemble an outgoing datagram in the channel's byte order
+	void send(const IO::VariableMemoryFile& datagram); // Sends a datagram to the connected peer
+	void send(const IO::VariableMemoryFile& datagram,const Address& address); // Sends a datagram to the given address
+	IO::FixedMemoryFile* receive(Address& sender); // Blocks until the next datagram arrives and returns it with its sender's address; caller must delete the returned buffer
+	};
+
+}
+
+#endif
@@ -0,0 +1,159 @@
+/***********************************************************************
+FakeClient - Class for minimal collaboration clients without protocol
+plug-ins, used by benchmarks and test programs to load a server.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/FakeClient.h>
+
+#include <stdio.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/VariableMemoryFile.h>
+#include <Comm/TCPPipe.h>
+#include <Collaboration/DatagramChannel.h>
+
+namespace Collaboration {
+
+/***************************
+Methods of class FakeClient:
+***************************/
+
+FakeClient::FakeClient(const char* serverHostName,int serverPortId,unsigned int index,FakeClient::Kind kind)
+	:pipe(new Comm::TCPPipe(serverHostName,serverPortId)),
+	 datagramChannel(0),datagramClientID(0),datagramToken(0),datagramSequence(0),
+	 updateCounter(0)
+	{
+	pipe->negotiateEndianness();
+	
+	/* Send a connect request without any protocol plug-ins, but with the kind's reserved entries: */
+	writeMessage(CONNECT_REQUEST,*pipe);
+	char clientName[32];
+	snprintf(clientName,sizeof(clientName),"FakeClient%u",index);
+	state.clientName=clientName;
+	writeClientState(ClientState::FULL_UPDATE,state,*pipe);
+	bool useDatagrams=kind==DATAGRAM;
+	bool useDeltaStates=kind==DELTA||kind==DATAGRAM;
+	bool useQuantizedPoses=kind==QUANTIZED||kind==DATAGRAM;
+	unsigned int datagramIndex=0;
+	unsigned int deltaIndex=datagramIndex+(useDatagrams?1:0);
+	unsigned int quantizedPosesIndex=deltaIndex+(useDeltaStates?1:0);
+	pipe->write<Card>(quantizedPosesIndex+(useQuantizedPoses?1:0));
+	if(useDatagrams)
+		{
+		write(std::string(datagramProtocolName),*pipe);
+		pipe->write<Card>(0);
+		}
+	if(useDeltaStates)
+		{
+		write(std::string(deltaProtocolName),*pipe);
+		pipe->write<Card>(0);
+		}
+	if(useQuantizedPoses)
+		{
+		write(std::string(quantizedPosesProtocolName),*pipe);
+		pipe->write<Card>(0);
+		}
+	pipe->flush();
+	
+	/* Wait for the server's reply: */
+	if(readMessage(*pipe)!=CONNECT_REPLY)
+		Misc::throwStdErr("FakeClient::FakeClient: Connection refused by server");
+	
+	/* Read the accepted reserved entries: */
+	unsigned int numNegotiatedProtocols=pipe->read<Card>();
+	for(unsigned int i=0;i<numNegotiatedProtocols;++i)
+		{
+		unsigned int protocolIndex=pipe->read<Card>();
+		pipe->read<Card>();
+		if(useDatagrams&&protocolIndex==datagramIndex)
+			{
+			/* Open a datagram channel to the server's datagram port: */
+			int datagramPortId=int(pipe->read<Card>());
+			datagramClientID=pipe->read<Card>();
+			datagramToken=pipe->read<Card>();
+			datagramChannel=new DatagramChannel(-1);
+			datagramChannel->connect(serverHostName,datagramPortId);
+			}
+		else if(useQuantizedPoses&&protocolIndex==quantizedPosesIndex)
+			{
+			/* Write poses with the precision chosen by the server: */
+			unsigned int positionBits=pipe->read<Card>();
+			unsigned int rotationBits=pipe->read<Card>();
+			poseCodec=PoseCodec(positionBits,rotationBits);
+			}
+		else if(!(useDeltaStates&&protocolIndex==deltaIndex))
+			Misc::throwStdErr("FakeClient::FakeClient: Server accepted unknown protocol %u",protocolIndex);
+		}
+	}
+
+FakeClient::~FakeClient(void)
+	{
+	delete datagramChannel;
+	}
+
+void FakeClient::sendUpdate(void)
+	{
+	/* Move the navigation transformation, so every server update carries state changes: */
+	++updateCounter;
+	state.navTransform=OGTransform(Vector(Scalar(updateCounter%1000),Scalar(0),Scalar(0)),Rotation::identity,Scalar(1));
+	
+	if(datagramChannel!=0)
+		{
+		/* Send the pose by datagram: */
+		Misc::SelfDestructPointer<IO::VariableMemoryFile> datagram(DatagramChannel::createDatagram());
+		datagram->write<Card>(datagramClientID);
+		datagram->write<Card>(datagramToken);
+		datagram->write<Card>(++datagramSequence);
+		writePose(state,*datagram);
+		datagramChannel->send(*datagram);
+		}
+	else
+		{
+		/* Send the pose over the pipe: */
+		writeMessage(CLIENT_UPDATE,*pipe);
+		writeClientState(ClientState::NAVTRANSFORM,state,poseCodec,*pipe);
+		pipe->flush();
+		}
+	}
+
+size_t FakeClient::drain(void)
+	{
+	return discardReceivedData(pipe->getFd());
+	}
+
+/****************
+Helper functions:
+****************/
+
+size_t discardReceivedData(int socketFd)
+	{
+	size_t result=0;
+	char buffer[16384];
+	ssize_t readSize;
+	while((readSize=recv(socketFd,buffer,sizeof(buffer),MSG_DONTWAIT))>0)
+		result+=size_t(readSize);
+	return result;
+	}
+
+}
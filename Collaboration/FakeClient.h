@@ -0,0 +1,81 @@
+/***********************************************************************
+FakeClient - Class for minimal collaboration clients without protocol
+plug-ins, used by benchmarks and test programs to load a server.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_FAKECLIENT_INCLUDED
+#define COLLABORATION_FAKECLIENT_INCLUDED
+
+#include <stddef.h>
+#include <Comm/NetPipe.h>
+#include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/PoseCodec.h>
+
+/* Forward declarations: */
+namespace Collaboration {
+class DatagramChannel;
+}
+
+namespace Collaboration {
+
+class FakeClient:public CollaborationProtocol // Class for minimal clients without protocol plug-ins that move their navigation transformations and discard everything the server sends
+	{
+	/* Embedded classes: */
+	public:
+	enum Kind // Enumerated type for the reserved protocol entries requested by a client
+		{
+		PLAIN=0, // Full server updates and raw poses over the pipe
+		DELTA, // Delta-encoded server updates
+		QUANTIZED, // Quantized poses
+		DATAGRAM, // Poses by datagram, delta-encoded server updates, and quantized poses
+		NUM_KINDS
+		};
+	
+	/* Elements: */
+	private:
+	Comm::NetPipePtr pipe; // Pipe connected to the server
+	ClientState state; // The client's current state
+	PoseCodec poseCodec; // Codec for poses sent over the pipe, as negotiated with the server
+	DatagramChannel* datagramChannel; // Channel to send poses to the server by datagram, or null if the server did not accept datagrams
+	unsigned int datagramClientID; // Client ID to authenticate datagrams
+	unsigned int datagramToken; // Token to authenticate datagrams
+	unsigned int datagramSequence; // Sequence number of the most recently sent datagram
+	unsigned int updateCounter; // Number of client updates sent so far
+	
+	/* Constructors and destructors: */
+	public:
+	FakeClient(const char* serverHostName,int serverPortId,unsigned int index,Kind kind =PLAIN); // Connects to the server, requesting the given kind's reserved entries, and waits for the connect reply
+	private:
+	FakeClient(const FakeClient& source); // Prohibit copy constructor
+	FakeClient& operator=(const FakeClient& source); // Prohibit assignment operator
+	public:
+	~FakeClient(void);
+	
+	/* Methods: */
+	void sendUpdate(void); // Moves the client's navigation transformation and sends a client update
+	size_t drain(void); // Discards all data the server has sent so far without blocking; returns the number of discarded bytes
+	};
+
+size_t discardReceivedData(int socketFd); // Discards all data that arrived on the given socket without blocking; returns the number of discarded bytes
+
+}
+
+#endif
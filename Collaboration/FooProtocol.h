@@ -31,7 +31,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #endif
 #include <Misc/ThrowStdErr.h>
 #include <Math/Random.h>
-#include <Comm/NetPipe.h>
+#include <IO/File.h>
 #include <Collaboration/Protocol.h>
 
 namespace Collaboration {
@@ -47,7 +47,7 @@ class FooProtocol:public Protocol
 		};
 	
 	/* Methods: */
-	static void sendRandomCrap(Comm::NetPipe& pipe)
+	static void sendRandomCrap(IO::File& pipe)
 		{
 		unsigned int messageSize=Math::randUniformCO(0,64)+32;
 		pipe.write<Card>(messageSize);
@@ -63,7 +63,7 @@ class FooProtocol:public Protocol
 		std::cout<<"Sent "<<messageSize<<" bytes with checksum "<<sumTotal<<std::endl;
 		#endif
 		}
-	static void receiveRandomCrap(Comm::NetPipe& pipe)
+	static void receiveRandomCrap(IO::File& pipe)
 		{
 		unsigned int messageSize=pipe.read<Card>();
 		unsigned int sumTotal=0;
@@ -27,6 +27,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <iostream>
 #endif
 #include <Misc/ThrowStdErr.h>
+#include <Comm/NetPipe.h>
 
 namespace Collaboration {
 
@@ -168,7 +169,7 @@ void FooServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPip
 	receiveRandomCrap(pipe);
 	}
 
-void FooServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void FooServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	#if DUMP_PROTOCOL
 	std::cout<<"FooServer::sendClientConnect"<<std::endl;
@@ -182,7 +183,7 @@ void FooServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,Protocol
 	sendRandomCrap(pipe);
 	}
 
-void FooServer::sendServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void FooServer::sendServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	#if DUMP_PROTOCOL
 	std::cout<<"FooServer::sendServerUpdate(destCs)"<<std::endl;
@@ -195,7 +196,7 @@ void FooServer::sendServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPi
 	sendRandomCrap(pipe);
 	}
 
-void FooServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void FooServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	#if DUMP_PROTOCOL
 	std::cout<<"FooServer::sendServerUpdate(sourceCs,destCs)"<<std::endl;
@@ -272,7 +273,7 @@ void FooServer::beforeServerUpdate(ProtocolServer::ClientState* cs)
 	++myCs->bracketLevel;
 	}
 
-void FooServer::beforeServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void FooServer::beforeServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	#if DUMP_PROTOCOL
 	std::cout<<"FooServer::beforeServerUpdate(destCs,pipe)"<<std::endl;
@@ -65,15 +65,15 @@ class FooServer:public ProtocolServer,private FooProtocol
 	virtual void receiveDisconnectRequest(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
 	virtual void sendDisconnectReply(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
 	virtual void receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
-	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void sendServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
+	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe);
 	virtual bool handleMessage(ProtocolServer::ClientState* cs,unsigned int messageId,Comm::NetPipe& pipe);
 	virtual void connectClient(ProtocolServer::ClientState* cs);
 	virtual void disconnectClient(ProtocolServer::ClientState* cs);
 	virtual void beforeServerUpdate(void);
 	virtual void beforeServerUpdate(ProtocolServer::ClientState* cs);
-	virtual void beforeServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
+	virtual void beforeServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe);
 	virtual void afterServerUpdate(ProtocolServer::ClientState* cs);
 	virtual void afterServerUpdate(void);
 	};
@@ -43,16 +43,16 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 namespace Collaboration {
 
-/**************************************************
-Methods of class GrapheinClient::RemoteClientState:
-**************************************************/
+/************************************************
+Methods of class GrapheinClientRemoteClientState:
+************************************************/
 
-GrapheinClient::RemoteClientState::RemoteClientState(void)
+GrapheinClientRemoteClientState::GrapheinClientRemoteClientState(void)
 	:curves(17)
 	{
 	}
 
-GrapheinClient::RemoteClientState::~RemoteClientState(void)
+GrapheinClientRemoteClientState::~GrapheinClientRemoteClientState(void)
 	{
 	/* Delete all curves in the hash table: */
 	for(CurveMap::Iterator cIt=curves.begin();!cIt.isFinished();++cIt)
@@ -61,17 +61,17 @@ GrapheinClient::RemoteClientState::~RemoteClientState(void)
 	/* Delete any leftover message buffers: */
 	{
 	Threads::Mutex::Lock messageBufferLock(messageBufferMutex);
-	for(std::vector<IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
+	for(std::vector<GrapheinClient::IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
 		delete *mIt;
 	}
 	}
 
-void GrapheinClient::RemoteClientState::processMessages(void)
+void GrapheinClientRemoteClientState::processMessages(void)
 	{
 	Threads::Mutex::Lock messageBufferLock(messageBufferMutex);
 	
 	/* Handle all state tracking messages: */
-	for(std::vector<IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
+	for(std::vector<GrapheinClient::IncomingMessage*>::iterator mIt=messages.begin();mIt!=messages.end();++mIt)
 		{
 		/* Process all messages in this buffer: */
 		IO::File& msg=**mIt;
@@ -162,7 +162,7 @@ void GrapheinClient::RemoteClientState::processMessages(void)
 	messages.clear();
 	}
 
-void GrapheinClient::RemoteClientState::glRenderAction(GLContextData& contextData) const
+void GrapheinClientRemoteClientState::glRenderAction(GLContextData& contextData) const
 	{
 	glPushAttrib(GL_ENABLE_BIT|GL_LINE_BIT);
 	glDisable(GL_LIGHTING);
@@ -500,33 +500,31 @@ ProtocolClient::RemoteClientState* GrapheinClient::receiveClientConnect(Comm::Ne
 	/* Create a new remote client state object: */
 	RemoteClientState* newClientState=new RemoteClientState;
 	
+	/* Unpack the message if the server compressed it: */
+	IO::FilePtr payload=readBulkPayload(pipe);
+	
 	/* Read the number of existing curves in this message: */
-	unsigned int numCurves=pipe.read<Card>();
+	unsigned int numCurves=payload->read<Card>();
 	
 	/* Read all curves: */
 	for(unsigned int i=0;i<numCurves;++i)
 		{
 		/* Read the new curve's ID: */
-		unsigned int newCurveId=pipe.read<Card>();
+		unsigned int newCurveId=payload->read<Card>();
 		
 		/* Create the new curve and add it to the new client's curve set: */
 		Curve* newCurve=new Curve;
 		newClientState->curves.setEntry(CurveMap::Entry(newCurveId,newCurve));
 		
 		/* Read the curve's state: */
-		newCurve->read(pipe);
+		newCurve->read(*payload);
 		}
 	
 	return newClientState;
 	}
 
-bool GrapheinClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe)
+bool GrapheinClient::receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe)
 	{
-	/* Get a handle on the remote client state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("GrapheinClient::receiveServerUpdate: Mismatching remote client state object type");
-	
 	/* Read the size of the following message: */
 	unsigned int messageSize=pipe.read<Card>();
 	
@@ -537,8 +535,8 @@ bool GrapheinClient::receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,
 	
 	/* Store the new buffer in the client's message list: */
 	{
-	Threads::Mutex::Lock messageBufferLock(myRcs->messageBufferMutex);
-	myRcs->messages.push_back(msg);
+	Threads::Mutex::Lock messageBufferLock(rcs->messageBufferMutex);
+	rcs->messages.push_back(msg);
 	}
 	
 	return messageSize!=0;
@@ -557,15 +555,10 @@ void GrapheinClient::sendClientUpdate(Comm::NetPipe& pipe)
 	writeMessage(UPDATE_END,pipe);
 	}
 
-void GrapheinClient::frame(ProtocolClient::RemoteClientState* rcs)
+void GrapheinClient::frame(RemoteClientState* rcs)
 	{
-	/* Get a handle on the remote client state object: */
-	RemoteClientState* myRcs=dynamic_cast<RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("GrapheinClient::frame: Mismatching remote client state object type");
-	
 	/* Process the remote client's queued server update messages: */
-	myRcs->processMessages();
+	rcs->processMessages();
 	}
 
 void GrapheinClient::glRenderAction(GLContextData& contextData) const
@@ -587,15 +580,10 @@ void GrapheinClient::glRenderAction(GLContextData& contextData) const
 	glPopAttrib();
 	}
 
-void GrapheinClient::glRenderAction(const ProtocolClient::RemoteClientState* rcs,GLContextData& contextData) const
+void GrapheinClient::glRenderAction(const RemoteClientState* rcs,GLContextData& contextData) const
 	{
-	/* Get a handle on the Graphein state object: */
-	const RemoteClientState* myRcs=dynamic_cast<const RemoteClientState*>(rcs);
-	if(myRcs==0)
-		Misc::throwStdErr("GrapheinClient::display: Remote client state object has mismatching type");
-	
 	/* Display the remote client's state: */
-	myRcs->glRenderAction(contextData);
+	rcs->glRenderAction(contextData);
 	}
 
 void GrapheinClient::toolCreationCallback(Vrui::ToolManager::ToolCreationCallbackData* cbData)
@@ -32,7 +32,7 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <Vrui/UtilityTool.h>
 #include <Vrui/GenericToolFactory.h>
 #include <Vrui/ToolManager.h>
-#include <Collaboration/ProtocolClient.h>
+#include <Collaboration/TypedProtocolClient.h>
 #include <Collaboration/GrapheinProtocol.h>
 
 /* Forward declarations: */
@@ -45,32 +45,21 @@ class PopupWindow;
 class RowColumn;
 class TextField;
 }
+namespace Collaboration {
+class GrapheinClientRemoteClientState;
+}
 
 namespace Collaboration {
 
-class GrapheinClient:public ProtocolClient,private GrapheinProtocol
+class GrapheinClient:public TypedProtocolClient<GrapheinClientRemoteClientState>,private GrapheinProtocol
 	{
+	friend class GrapheinClientRemoteClientState;
+	
 	/* Embedded classes: */
 	private:
 	typedef IO::FixedMemoryFile IncomingMessage; // Type for buffers storing incoming messages
 	typedef IO::VariableMemoryFile OutgoingMessage; // Type for buffers storing outgoing messages
-	
-	class RemoteClientState:public ProtocolClient::RemoteClientState
-		{
-		/* Elements: */
-		public:
-		CurveMap curves; // Set of curves owned by the remote client
-		Threads::Mutex messageBufferMutex; // Mutex serializing access to the message buffer list
-		std::vector<IncomingMessage*> messages; // List of buffers retaining server update messages between frame calls
-		
-		/* Constructors and destructors: */
-		RemoteClientState(void);
-		virtual ~RemoteClientState(void);
-		
-		/* Methods: */
-		void processMessages(void); // Reads and processes all queued server update messages
-		void glRenderAction(GLContextData& contextData) const; // Displays the remote client's state
-		};
+	typedef GrapheinClientRemoteClientState RemoteClientState; // Client-side state of a remote client sharing the Graphein protocol
 	
 	class GrapheinTool; // Forward declaration
 	typedef Vrui::GenericToolFactory<GrapheinTool> GrapheinToolFactory; // Graphein tool class uses the generic factory class
@@ -137,16 +126,37 @@ class GrapheinClient:public ProtocolClient,private GrapheinProtocol
 	virtual void receiveConnectReply(Comm::NetPipe& pipe);
 	virtual void receiveDisconnectReply(Comm::NetPipe& pipe);
 	virtual ProtocolClient::RemoteClientState* receiveClientConnect(Comm::NetPipe& pipe);
-	virtual bool receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe);
 	virtual void sendClientUpdate(Comm::NetPipe& pipe);
-	virtual void frame(ProtocolClient::RemoteClientState* rcs);
 	virtual void glRenderAction(GLContextData& contextData) const;
-	virtual void glRenderAction(const ProtocolClient::RemoteClientState* rcs,GLContextData& contextData) const;
+	
+	/* Methods from TypedProtocolClient: */
+	virtual bool receiveServerUpdate(RemoteClientState* rcs,Comm::NetPipe& pipe);
+	virtual void frame(RemoteClientState* rcs);
+	virtual void glRenderAction(const RemoteClientState* rcs,GLContextData& contextData) const;
 	
 	/* New methods: */
 	void toolCreationCallback(Vrui::ToolManager::ToolCreationCallbackData* cbData);
 	};
 
+class GrapheinClientRemoteClientState:public ProtocolClient::RemoteClientState,private GrapheinProtocol // Class representing client-side state of a remote client sharing the Graphein protocol
+	{
+	friend class GrapheinClient;
+	
+	/* Elements: */
+	public:
+	CurveMap curves; // Set of curves owned by the remote client
+	Threads::Mutex messageBufferMutex; // Mutex serializing access to the message buffer list
+	std::vector<GrapheinClient::IncomingMessage*> messages; // List of buffers retaining server update messages between frame calls
+	
+	/* Constructors and destructors: */
+	GrapheinClientRemoteClientState(void);
+	virtual ~GrapheinClientRemoteClientState(void);
+	
+	/* Methods: */
+	void processMessages(void); // Reads and processes all queued server update messages
+	void glRenderAction(GLContextData& contextData) const; // Displays the remote client's state
+	};
+
 }
 
 #endif
@@ -23,21 +23,23 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Collaboration/GrapheinServer.h>
 
+#include <algorithm>
 #include <Misc/ThrowStdErr.h>
 #include <Comm/NetPipe.h>
 
 namespace Collaboration {
 
-/********************************************
-Methods of class GrapheinServer::ClientState:
-********************************************/
+/******************************************
+Methods of class GrapheinServerClientState:
+******************************************/
 
-GrapheinServer::ClientState::ClientState(void)
-	:curves(17)
+GrapheinServerClientState::GrapheinServerClientState(void)
+	:curves(17),
+	 messageBuffer(&messageBuffers[0]),updateBuffer(&messageBuffers[1])
 	{
 	}
 
-GrapheinServer::ClientState::~ClientState(void)
+GrapheinServerClientState::~GrapheinServerClientState(void)
 	{
 	/* Delete all curves in the curve map: */
 	for(CurveMap::Iterator cIt=curves.begin();!cIt.isFinished();++cIt)
@@ -66,6 +68,24 @@ unsigned int GrapheinServer::getNumMessages(void) const
 	return MESSAGES_END;
 	}
 
+bool GrapheinServer::hasDestinationIndependentConnect(void) const
+	{
+	/* Connect messages only carry the source client's curves: */
+	return true;
+	}
+
+bool GrapheinServer::hasThreadSafeClientHooks(void) const
+	{
+	/* Message buffer swaps only touch the given client's state, and the server serializes connect messages per source client: */
+	return true;
+	}
+
+bool GrapheinServer::hasBatchedServerUpdates(void) const
+	{
+	/* Accumulated state tracking messages are shared by all destination clients: */
+	return true;
+	}
+
 ProtocolServer::ClientState* GrapheinServer::receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe)
 	{
 	/* Check the protocol message length: */
@@ -83,7 +103,8 @@ ProtocolServer::ClientState* GrapheinServer::receiveConnectRequest(unsigned int
 		{
 		/* Create the new client state object and set its message buffer's endianness: */
 		ClientState* result=new ClientState;
-		result->messageBuffer.setSwapOnWrite(pipe.mustSwapOnWrite());
+		for(int i=0;i<2;++i)
+			result->messageBuffers[i].setSwapOnWrite(pipe.mustSwapOnWrite());
 		
 		return result;
 		}
@@ -91,13 +112,8 @@ ProtocolServer::ClientState* GrapheinServer::receiveConnectRequest(unsigned int
 		return 0;
 	}
 
-void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+void GrapheinServer::receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe)
 	{
-	/* Get a handle on the Graphein state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("GrapheinServer::receiveClientUpdate: Client state object has mismatching type");
-	
 	/* Receive a list of curve action messages from the client: */
 	MessageIdType message;
 	while((message=readMessage(pipe))!=UPDATE_END)
@@ -110,15 +126,15 @@ void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 				
 				/* Create a new curve object and add it to the client's curve map: */
 				Curve* newCurve=new Curve;
-				myCs->curves.setEntry(CurveMap::Entry(newCurveId,newCurve));
+				cs->curves.setEntry(CurveMap::Entry(newCurveId,newCurve));
 				
 				/* Read the new curve's state from the pipe: */
 				newCurve->read(pipe);
 				
 				/* Append a curve creation message to the client's outgoing buffer: */
-				writeMessage(ADD_CURVE,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(newCurveId);
-				newCurve->write(myCs->messageBuffer);
+				writeMessage(ADD_CURVE,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(newCurveId);
+				newCurve->write(*cs->messageBuffer);
 				
 				break;
 				}
@@ -132,15 +148,15 @@ void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 				Point newVertex=read<Point>(pipe);
 				
 				/* Append the new vertex to the curve: */
-				Curve* curve=myCs->curves.getEntry(curveId).getDest();
+				Curve* curve=cs->curves.getEntry(curveId).getDest();
 				unsigned int vertexIndex=curve->vertices.size();
 				curve->vertices.push_back(newVertex);
 				
 				/* Append a vertex addition message to the client's outgoing buffer: */
-				writeMessage(APPEND_POINT,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(curveId);
-				myCs->messageBuffer.write<Card>(vertexIndex);
-				write(newVertex,myCs->messageBuffer);
+				writeMessage(APPEND_POINT,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(curveId);
+				cs->messageBuffer->write<Card>(vertexIndex);
+				write(newVertex,*cs->messageBuffer);
 				
 				break;
 				}
@@ -151,17 +167,17 @@ void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 				unsigned int curveId=pipe.read<Card>();
 				
 				/* Erase the curve from the client's curve map: */
-				CurveMap::Iterator cIt=myCs->curves.findEntry(curveId);
+				CurveMap::Iterator cIt=cs->curves.findEntry(curveId);
 				if(!cIt.isFinished())
 					{
 					/* Delete the curve: */
 					delete cIt->getDest();
-					myCs->curves.removeEntry(cIt);
+					cs->curves.removeEntry(cIt);
 					}
 				
 				/* Append a curve destruction message to the client's outgoing buffer: */
-				writeMessage(DELETE_CURVE,myCs->messageBuffer);
-				myCs->messageBuffer.write<Card>(curveId);
+				writeMessage(DELETE_CURVE,*cs->messageBuffer);
+				cs->messageBuffer->write<Card>(curveId);
 				
 				break;
 				}
@@ -169,12 +185,12 @@ void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 			case DELETE_ALL_CURVES:
 				{
 				/* Delete all curves in the client's curve map: */
-				for(CurveMap::Iterator cIt=myCs->curves.begin();!cIt.isFinished();++cIt)
+				for(CurveMap::Iterator cIt=cs->curves.begin();!cIt.isFinished();++cIt)
 					delete cIt->getDest();
-				myCs->curves.clear();
+				cs->curves.clear();
 				
 				/* Append a curve set destruction message to the client's outgoing buffer: */
-				writeMessage(DELETE_ALL_CURVES,myCs->messageBuffer);
+				writeMessage(DELETE_ALL_CURVES,*cs->messageBuffer);
 				
 				break;
 				}
@@ -184,56 +200,65 @@ void GrapheinServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 			}
 	}
 
-void GrapheinServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void GrapheinServer::sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get handles on the Graphein state objects: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	ClientState* myDestCs=dynamic_cast<ClientState*>(destCs);
-	if(mySourceCs==0||myDestCs==0)
-		Misc::throwStdErr("GrapheinServer::sendClientConnect: Client state object has mismatching type");
+	/* Reset the source client's connect message buffer to the same endianness as the pipe's write end: */
+	MessageBuffer& buffer=sourceCs->connectBuffer;
+	buffer.clear();
+	buffer.setSwapOnWrite(pipe.mustSwapOnWrite());
 	
-	/* Send all curves currently owned by the source client to the destination client: */
-	unsigned int numCurves=mySourceCs->curves.getNumEntries();
-	pipe.write<Card>(numCurves);
-	for(CurveMap::Iterator cIt=mySourceCs->curves.begin();!cIt.isFinished();++cIt)
+	/* Assemble all curves currently owned by the source client in the connect message buffer: */
+	unsigned int numCurves=sourceCs->curves.getNumEntries();
+	buffer.write<Card>(numCurves);
+	for(CurveMap::Iterator cIt=sourceCs->curves.begin();!cIt.isFinished();++cIt)
 		{
 		/* Send the curve's ID: */
-		pipe.write<Card>(cIt->getSource());
+		buffer.write<Card>(cIt->getSource());
 		
 		/* Send the curve itself: */
-		cIt->getDest()->write(pipe);
+		cIt->getDest()->write(buffer);
 		}
+	
+	/* Send the assembled curves to the destination client, compressed if the client requested it: */
+	writeBulkPayload(destCs,buffer,pipe);
 	}
 
-void GrapheinServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void GrapheinServer::beforeServerUpdate(ClientState* cs)
+	{
+	/* Freeze the accumulated messages for this server update, and continue collecting messages in the other buffer: */
+	std::swap(cs->messageBuffer,cs->updateBuffer);
+	}
+
+void GrapheinServer::sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe)
 	{
-	/* Get handles on the Graphein state objects: */
-	ClientState* mySourceCs=dynamic_cast<ClientState*>(sourceCs);
-	ClientState* myDestCs=dynamic_cast<ClientState*>(destCs);
-	if(mySourceCs==0||myDestCs==0)
-		Misc::throwStdErr("GrapheinServer::sendServerUpdate: Client state object has mismatching type");
-	
 	/*********************************************************************
 	Send the source client's accumulated state tracking messages to the
 	destination client:
 	*********************************************************************/
 	
 	/* Send the total size of the message first: */
-	pipe.write<Card>(mySourceCs->messageBuffer.getDataSize());
+	pipe.write<Card>(sourceCs->updateBuffer->getDataSize());
 	
 	/* Write the message itself: */
-	mySourceCs->messageBuffer.writeToSink(pipe);
+	sourceCs->updateBuffer->writeToSink(pipe);
 	}
 
-void GrapheinServer::afterServerUpdate(ProtocolServer::ClientState* cs)
+void GrapheinServer::sendServerUpdate(ClientState* sourceCs,ProtocolServer::ServerUpdateBatch& batch)
 	{
-	/* Get a handle on the Graphein state object: */
-	ClientState* myCs=dynamic_cast<ClientState*>(cs);
-	if(myCs==0)
-		Misc::throwStdErr("GrapheinServer::afterServerUpdate: Mismatching client state object type");
-	
-	/* Clear the client's message buffer: */
-	myCs->messageBuffer.clear();
+	/* Send the source client's accumulated state tracking messages once per endianness, shared by all destination clients: */
+	for(int swap=0;swap<2;++swap)
+		if(batch.needsSharedPayload(swap!=0))
+			{
+			IO::File& payload=batch.getSharedPayload(swap!=0);
+			payload.write<Card>(sourceCs->updateBuffer->getDataSize());
+			sourceCs->updateBuffer->writeToSink(payload);
+			}
+	}
+
+void GrapheinServer::afterServerUpdate(ClientState* cs)
+	{
+	/* Clear the client's frozen message buffer: */
+	cs->updateBuffer->clear();
 	}
 
 }
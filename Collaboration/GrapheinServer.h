@@ -26,30 +26,24 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <vector>
 #include <IO/VariableMemoryFile.h>
-#include <Collaboration/ProtocolServer.h>
+#include <Collaboration/TypedProtocolServer.h>
 #include <Collaboration/GrapheinProtocol.h>
 
+/* Forward declarations: */
+namespace Collaboration {
+class GrapheinServerClientState;
+}
+
 namespace Collaboration {
 
-class GrapheinServer:public ProtocolServer,private GrapheinProtocol
+class GrapheinServer:public TypedProtocolServer<GrapheinServerClientState>,private GrapheinProtocol
 	{
+	friend class GrapheinServerClientState;
+	
 	/* Embedded classes: */
 	private:
 	typedef IO::VariableMemoryFile MessageBuffer; // Buffer to hold outgoing messages from a client between two updates
-	
-	class ClientState:public ProtocolServer::ClientState
-		{
-		friend class GrapheinServer;
-		
-		/* Elements: */
-		private:
-		CurveMap curves; // The set of curves currently owned by the client
-		MessageBuffer messageBuffer; // Buffer for outgoing messages from this client
-		
-		/* Constructors and destructors: */
-		ClientState(void);
-		virtual ~ClientState(void);
-		};
+	typedef GrapheinServerClientState ClientState; // Server-side state of a client sharing the Graphein protocol
 	
 	/* Constructors and destructors: */
 	public:
@@ -59,11 +53,35 @@ class GrapheinServer:public ProtocolServer,private GrapheinProtocol
 	/* Methods from ProtocolServer: */
 	virtual const char* getName(void) const;
 	virtual unsigned int getNumMessages(void) const;
+	virtual bool hasDestinationIndependentConnect(void) const;
+	virtual bool hasThreadSafeClientHooks(void) const;
+	virtual bool hasBatchedServerUpdates(void) const;
 	virtual ProtocolServer::ClientState* receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe);
-	virtual void receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe);
-	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe);
-	virtual void afterServerUpdate(ProtocolServer::ClientState* cs);
+	
+	/* Methods from TypedProtocolServer: */
+	virtual void receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe);
+	virtual void sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void beforeServerUpdate(ClientState* cs);
+	virtual void sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe);
+	virtual void sendServerUpdate(ClientState* sourceCs,ServerUpdateBatch& batch);
+	virtual void afterServerUpdate(ClientState* cs);
+	};
+
+class GrapheinServerClientState:public ProtocolServer::ClientState,private GrapheinProtocol // Class representing server-side state of a client sharing the Graphein protocol
+	{
+	friend class GrapheinServer;
+	
+	/* Elements: */
+	private:
+	CurveMap curves; // The set of curves currently owned by the client
+	GrapheinServer::MessageBuffer messageBuffers[2]; // Pair of buffers for outgoing messages from this client
+	GrapheinServer::MessageBuffer* messageBuffer; // Buffer collecting outgoing messages while receiving updates from this client
+	GrapheinServer::MessageBuffer* updateBuffer; // Buffer holding the outgoing messages frozen for the current server update
+	GrapheinServer::MessageBuffer connectBuffer; // Buffer assembling the client's CLIENT_CONNECT payload, reused for all destination clients
+	
+	/* Constructors and destructors: */
+	GrapheinServerClientState(void);
+	virtual ~GrapheinServerClientState(void);
 	};
 
 }
@@ -0,0 +1,103 @@
+/***********************************************************************
+InterestGrid - Class to index clients by their positions in shared
+navigational space using a uniform grid, to find all clients inside a
+given radius around a point.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/InterestGrid.h>
+
+#include <math.h>
+
+namespace Collaboration {
+
+/*****************************
+Methods of class InterestGrid:
+*****************************/
+
+InterestGrid::CellIndex InterestGrid::getCell(const InterestGrid::Point& position) const
+	{
+	CellIndex result;
+	for(int i=0;i<3;++i)
+		result.index[i]=int(floor(position[i]/cellSize));
+	return result;
+	}
+
+InterestGrid::InterestGrid(InterestGrid::Scalar sCellSize)
+	:cellSize(sCellSize),
+	 cells(101),numEntries(0)
+	{
+	}
+
+void InterestGrid::clear(void)
+	{
+	if(cells.getNumEntries()>size_t(numEntries)*2+16)
+		{
+		/* Reset the grid, so that cells left behind by moving clients do not accumulate: */
+		cells.clear();
+		}
+	else
+		{
+		/* Empty all cells, keeping their lists for the next round of insertions: */
+		for(CellMap::Iterator cIt=cells.begin();!cIt.isFinished();++cIt)
+			cIt->getDest().clear();
+		}
+	numEntries=0;
+	}
+
+void InterestGrid::insert(unsigned int clientID,const InterestGrid::Point& position)
+	{
+	/* Add the client to the cell containing its position: */
+	cells[getCell(position)].push_back(Entry(clientID,position));
+	++numEntries;
+	}
+
+void InterestGrid::findNeighbors(const InterestGrid::Point& center,InterestGrid::Scalar radius,InterestGrid::NeighborList& neighbors) const
+	{
+	/* Find the range of cells overlapping the query sphere's bounding box: */
+	CellIndex min,max;
+	for(int i=0;i<3;++i)
+		{
+		min.index[i]=int(floor((center[i]-radius)/cellSize));
+		max.index[i]=int(floor((center[i]+radius)/cellSize));
+		}
+	
+	/* Check all clients in all overlapping cells: */
+	Scalar sqrRadius=radius*radius;
+	CellIndex cell;
+	for(cell.index[0]=min.index[0];cell.index[0]<=max.index[0];++cell.index[0])
+		for(cell.index[1]=min.index[1];cell.index[1]<=max.index[1];++cell.index[1])
+			for(cell.index[2]=min.index[2];cell.index[2]<=max.index[2];++cell.index[2])
+				{
+				CellMap::ConstIterator cIt=cells.findEntry(cell);
+				if(!cIt.isFinished())
+					{
+					const EntryList& entries=cIt->getDest();
+					for(EntryList::const_iterator eIt=entries.begin();eIt!=entries.end();++eIt)
+						{
+						Scalar sqrDist=Geometry::sqrDist(center,eIt->position);
+						if(sqrDist<=sqrRadius)
+							neighbors.push_back(Neighbor(eIt->clientID,sqrDist));
+						}
+					}
+				}
+	}
+
+}
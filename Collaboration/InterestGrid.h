@@ -0,0 +1,113 @@
+/***********************************************************************
+InterestGrid - Class to index clients by their positions in shared
+navigational space using a uniform grid, to find all clients inside a
+given radius around a point.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_INTERESTGRID_INCLUDED
+#define COLLABORATION_INTERESTGRID_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/HashTable.h>
+#include <Collaboration/Protocol.h>
+
+namespace Collaboration {
+
+class InterestGrid
+	{
+	/* Embedded classes: */
+	public:
+	typedef Protocol::Scalar Scalar; // Scalar type for positions and distances
+	typedef Protocol::Point Point; // Type for positions
+	
+	struct Neighbor // Structure for clients found by a neighborhood query
+		{
+		/* Elements: */
+		public:
+		unsigned int clientID; // ID of the found client
+		Scalar sqrDist; // Squared distance from the query point to the found client
+		
+		/* Constructors and destructors: */
+		Neighbor(unsigned int sClientID,Scalar sSqrDist)
+			:clientID(sClientID),sqrDist(sSqrDist)
+			{
+			}
+		};
+	
+	typedef std::vector<Neighbor> NeighborList; // Type for lists of found clients
+	
+	private:
+	struct CellIndex // Structure to identify grid cells
+		{
+		/* Elements: */
+		public:
+		int index[3]; // Integer cell coordinates
+		
+		/* Methods: */
+		bool operator==(const CellIndex& other) const
+			{
+			return index[0]==other.index[0]&&index[1]==other.index[1]&&index[2]==other.index[2];
+			}
+		static size_t hash(const CellIndex& source,size_t tableSize) // Hash function for cell indices
+			{
+			return (size_t(source.index[0])*73856093U^size_t(source.index[1])*19349663U^size_t(source.index[2])*83492791U)%tableSize;
+			}
+		};
+	
+	struct Entry // Structure for clients stored in a grid cell
+		{
+		/* Elements: */
+		public:
+		unsigned int clientID; // ID of the client
+		Point position; // Client's position in navigational space
+		
+		/* Constructors and destructors: */
+		Entry(unsigned int sClientID,const Point& sPosition)
+			:clientID(sClientID),position(sPosition)
+			{
+			}
+		};
+	
+	typedef std::vector<Entry> EntryList; // Type for lists of clients in a grid cell
+	typedef Misc::HashTable<CellIndex,EntryList,CellIndex> CellMap; // Type for hash tables mapping cell indices to the clients inside the cells
+	
+	/* Elements: */
+	Scalar cellSize; // Edge length of the grid's cubic cells
+	CellMap cells; // Map of grid cells that contained clients since the grid was last reset; emptied cells keep their lists to reuse their memory
+	unsigned int numEntries; // Number of clients inserted since the grid was last cleared
+	
+	/* Private methods: */
+	CellIndex getCell(const Point& position) const; // Returns the index of the cell containing the given position
+	
+	/* Constructors and destructors: */
+	public:
+	InterestGrid(Scalar sCellSize); // Creates an empty grid with the given cell size
+	
+	/* Methods: */
+	void clear(void); // Removes all clients from the grid
+	void insert(unsigned int clientID,const Point& position); // Inserts a client at the given position
+	void findNeighbors(const Point& center,Scalar radius,NeighborList& neighbors) const; // Appends all clients within the given radius around the given center to the given list
+	};
+
+}
+
+#endif
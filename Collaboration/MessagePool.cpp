@@ -0,0 +1,91 @@
+/***********************************************************************
+MessagePool - Class to recycle the memory files holding a client's
+outbound messages once they were sent, sizing new files to fit the
+largest recent message in a single buffer.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/MessagePool.h>
+
+namespace Collaboration {
+
+/****************************
+Methods of class MessagePool:
+****************************/
+
+MessagePool::MessagePool(void)
+	:bufferSize(MIN_BUFFER_SIZE)
+	{
+	freeMessages.reserve(MAX_FREE_MESSAGES);
+	}
+
+MessagePool::Message MessagePool::acquire(bool swapOnWrite)
+	{
+	Message result;
+	size_t newBufferSize;
+	{
+	Threads::Spinlock::Lock poolLock(mutex);
+	if(!freeMessages.empty())
+		{
+		/* Take the most recently released message: */
+		result=freeMessages.back();
+		freeMessages.pop_back();
+		}
+	newBufferSize=bufferSize;
+	}
+	
+	/* Create a new message outside the lock if there was none to reuse: */
+	if(result.getPointer()==0)
+		result=new MessageFile(newBufferSize);
+	result->setSwapOnWrite(swapOnWrite);
+	
+	return result;
+	}
+
+void MessagePool::release(MessagePool::Message& message)
+	{
+	/* Clear the message if it fitted into its first buffer: */
+	size_t messageSize=message->getDataSize();
+	bool fits=messageSize<=message->bufferSize;
+	if(fits)
+		message->clear();
+	
+	{
+	Threads::Spinlock::Lock poolLock(mutex);
+	if(fits)
+		{
+		/* Keep the message if it was created at the current buffer size, and the pool is not full: */
+		if(message->bufferSize==bufferSize&&freeMessages.size()<MAX_FREE_MESSAGES)
+			freeMessages.push_back(message);
+		}
+	else if(messageSize>bufferSize&&messageSize<=MAX_BUFFER_SIZE)
+		{
+		/* Create future messages large enough to hold the message in a single buffer, and drop all idle messages of the old buffer size: */
+		while(bufferSize<messageSize)
+			bufferSize*=2;
+		freeMessages.clear();
+		}
+	}
+	
+	/* Drop the caller's reference, which deletes the message if it was not kept: */
+	message=0;
+	}
+
+}
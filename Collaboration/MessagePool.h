@@ -0,0 +1,82 @@
+/***********************************************************************
+MessagePool - Class to recycle the memory files holding a client's
+outbound messages once they were sent, sizing new files to fit the
+largest recent message in a single buffer.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_MESSAGEPOOL_INCLUDED
+#define COLLABORATION_MESSAGEPOOL_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/Autopointer.h>
+#include <Threads/Spinlock.h>
+#include <IO/VariableMemoryFile.h>
+
+namespace Collaboration {
+
+class MessagePool
+	{
+	/* Embedded classes: */
+	public:
+	class MessageFile:public IO::VariableMemoryFile // Class for memory files created by a pool
+		{
+		friend class MessagePool;
+		
+		/* Elements: */
+		private:
+		size_t bufferSize; // Size of the file's first buffer
+		
+		/* Constructors and destructors: */
+		public:
+		MessageFile(size_t sBufferSize)
+			:IO::VariableMemoryFile(sBufferSize),bufferSize(sBufferSize)
+			{
+			}
+		};
+	
+	typedef Misc::Autopointer<MessageFile> Message; // Type for reference-counted pre-encoded messages
+	
+	enum
+		{
+		MIN_BUFFER_SIZE=8192, // Buffer size of the first messages created by a pool
+		MAX_BUFFER_SIZE=1024*1024, // Largest buffer size of messages created by a pool; larger messages are not recycled
+		MAX_FREE_MESSAGES=8 // Maximum number of idle messages held by a pool
+		};
+	
+	/* Elements: */
+	private:
+	Threads::Spinlock mutex; // Mutex serializing access to the pool
+	std::vector<Message> freeMessages; // List of cleared messages ready for reuse
+	size_t bufferSize; // Buffer size of newly created messages; only messages of this buffer size are recycled
+	
+	/* Constructors and destructors: */
+	public:
+	MessagePool(void); // Creates an empty pool
+	
+	/* Methods: */
+	Message acquire(bool swapOnWrite); // Returns an empty message writing in the given endianness, reusing a released message if possible
+	void release(Message& message); // Returns a message that is not referenced anywhere else to the pool, and resets the given pointer
+	};
+
+}
+
+#endif
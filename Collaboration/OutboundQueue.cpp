@@ -0,0 +1,103 @@
+/***********************************************************************
+OutboundQueue - Class for queues of pre-encoded messages waiting to be
+sent to a client by a background writer.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/OutboundQueue.h>
+
+namespace Collaboration {
+
+/******************************
+Methods of class OutboundQueue:
+******************************/
+
+OutboundQueue::OutboundQueue(void)
+	:queueSize(0),backTaken(false)
+	{
+	}
+
+size_t OutboundQueue::getNumMessages(void) const
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	return messages.size();
+	}
+
+size_t OutboundQueue::getQueueSize(void) const
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	return queueSize;
+	}
+
+void OutboundQueue::push(OutboundQueue::Message message)
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	queueSize+=message->getDataSize();
+	messages.push_back(message);
+	backTaken=false;
+	}
+
+bool OutboundQueue::appendToBack(const OutboundQueue::Message& message)
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	if(messages.empty()||backTaken)
+		return false;
+	
+	/* Extend the last message; the client receives the same data as if both messages had been queued: */
+	message->writeToSink(*messages.back());
+	queueSize+=message->getDataSize();
+	return true;
+	}
+
+bool OutboundQueue::front(OutboundQueue::Message& message)
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	if(messages.empty())
+		return false;
+	
+	message=messages.front();
+	
+	/* Stop extending the message once a sender thread started writing it: */
+	if(messages.size()==1)
+		backTaken=true;
+	
+	return true;
+	}
+
+bool OutboundQueue::pop(void)
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	if(!messages.empty())
+		{
+		queueSize-=messages.front()->getDataSize();
+		messages.pop_front();
+		}
+	
+	return messages.empty();
+	}
+
+void OutboundQueue::clear(void)
+	{
+	Threads::Mutex::Lock queueLock(mutex);
+	messages.clear();
+	queueSize=0;
+	}
+
+}
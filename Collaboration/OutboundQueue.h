@@ -0,0 +1,65 @@
+/***********************************************************************
+OutboundQueue - Class for queues of pre-encoded messages waiting to be
+sent to a client by a background writer.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_OUTBOUNDQUEUE_INCLUDED
+#define COLLABORATION_OUTBOUNDQUEUE_INCLUDED
+
+#include <stddef.h>
+#include <Threads/Mutex.h>
+#include <Collaboration/RingBuffer.h>
+#include <Collaboration/MessagePool.h>
+
+namespace Collaboration {
+
+class OutboundQueue
+	{
+	/* Embedded classes: */
+	public:
+	typedef MessagePool::Message Message; // Type for reference-counted pre-encoded messages
+	
+	private:
+	typedef RingBuffer<Message> MessageList; // Type for lists of queued messages, reusing their slots once the queue reached its typical depth
+	
+	/* Elements: */
+	mutable Threads::Mutex mutex; // Mutex serializing access to the queue
+	MessageList messages; // List of queued messages in sending order
+	size_t queueSize; // Total size of all queued messages in bytes
+	bool backTaken; // Flag whether a sender thread retrieved the last queued message, which therefore cannot be extended anymore
+	
+	/* Constructors and destructors: */
+	public:
+	OutboundQueue(void); // Creates an empty queue
+	
+	/* Methods: */
+	size_t getNumMessages(void) const; // Returns the number of queued messages
+	size_t getQueueSize(void) const; // Returns the total size of all queued messages in bytes
+	void push(Message message); // Appends a message to the end of the queue
+	bool appendToBack(const Message& message); // Appends the given message's data to the last queued message if no sender thread retrieved it yet; returns false if the message must be pushed instead
+	bool front(Message& message); // Retrieves the message at the front of the queue without removing it, after which it cannot be extended anymore; returns false if the queue is empty
+	bool pop(void); // Removes the message at the front of the queue; returns true if the queue is empty afterwards
+	void clear(void); // Removes all messages from the queue
+	};
+
+}
+
+#endif
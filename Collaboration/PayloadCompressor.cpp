@@ -0,0 +1,298 @@
+/***********************************************************************
+PayloadCompressor - Class to wrap bulk protocol payloads into envelopes
+that are compressed with a simple LZ77-style codec if they exceed a size
+threshold.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/PayloadCompressor.h>
+
+#include <string.h>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/File.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
+
+namespace Collaboration {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline unsigned int hash(const Misc::UInt8* data)
+	{
+	/* Multiplicatively hash the next four bytes into the 14 bits indexing the hash table: */
+	Misc::UInt32 run=Misc::UInt32(data[0])|(Misc::UInt32(data[1])<<8)|(Misc::UInt32(data[2])<<16)|(Misc::UInt32(data[3])<<24);
+	return (run*2654435761U)>>(32-14);
+	}
+
+inline void writeLength(size_t length,std::vector<Misc::UInt8>& compressed)
+	{
+	/* Write the part of a length that did not fit into the token in bytes of 255, terminated by a smaller byte: */
+	for(;length>=255;length-=255)
+		compressed.push_back(255);
+	compressed.push_back(Misc::UInt8(length));
+	}
+
+void writeSequence(const Misc::UInt8* literals,size_t numLiterals,size_t matchLength,size_t matchOffset,std::vector<Misc::UInt8>& compressed)
+	{
+	/* Write the token containing the short forms of the literal run length and match length: */
+	size_t matchCode=matchLength>0?matchLength-PayloadCompressor::MIN_MATCH:0;
+	compressed.push_back(Misc::UInt8(((numLiterals<15?numLiterals:15)<<4)|(matchCode<15?matchCode:15)));
+	
+	/* Write the literal run: */
+	if(numLiterals>=15)
+		writeLength(numLiterals-15,compressed);
+	compressed.insert(compressed.end(),literals,literals+numLiterals);
+	
+	if(matchLength>0)
+		{
+		/* Write the match offset in little-endian byte order and the rest of the match length: */
+		compressed.push_back(Misc::UInt8(matchOffset&0xffU));
+		compressed.push_back(Misc::UInt8((matchOffset>>8)&0xffU));
+		if(matchCode>=15)
+			writeLength(matchCode-15,compressed);
+		}
+	}
+
+void shuffle(const Misc::UInt8* data,size_t dataSize,Misc::UInt8* planes)
+	{
+	/* Gather the bytes of all complete 32-bit words plane by plane, and append any trailing bytes verbatim: */
+	size_t numWords=dataSize/4;
+	for(int plane=0;plane<4;++plane)
+		for(size_t i=0;i<numWords;++i)
+			*(planes++)=data[i*4+plane];
+	memcpy(planes,data+numWords*4,dataSize-numWords*4);
+	}
+
+void unshuffle(const Misc::UInt8* planes,size_t dataSize,Misc::UInt8* data)
+	{
+	/* Scatter the byte planes back into 32-bit words, followed by the trailing bytes: */
+	size_t numWords=dataSize/4;
+	for(int plane=0;plane<4;++plane)
+		for(size_t i=0;i<numWords;++i)
+			data[i*4+plane]=*(planes++);
+	memcpy(data+numWords*4,planes,dataSize-numWords*4);
+	}
+
+inline size_t readLength(size_t length,const Misc::UInt8*& cPtr,const Misc::UInt8* cEnd)
+	{
+	/* Add the extension bytes of a length that did not fit into the token: */
+	if(length==15)
+		{
+		Misc::UInt8 b;
+		do
+			{
+			if(cPtr==cEnd)
+				Misc::throwStdErr("PayloadCompressor::decompress: Truncated length");
+			b=*(cPtr++);
+			length+=b;
+			}
+		while(b==255);
+		}
+	return length;
+	}
+
+}
+
+/**********************************
+Methods of class PayloadCompressor:
+**********************************/
+
+void PayloadCompressor::compress(const PayloadCompressor::Byte* data,size_t dataSize,std::vector<PayloadCompressor::Byte>& compressed)
+	{
+	/* Create a table of the most recent positions of byte runs, offset by one so that zero denotes an empty slot: */
+	std::vector<size_t> hashTable(HASHTABLE_SIZE,0);
+	
+	/* Greedily match byte runs against earlier data: */
+	size_t anchor=0;
+	size_t pos=0;
+	while(pos+MIN_MATCH<=dataSize)
+		{
+		/* Look up and replace the most recent position of the byte run at the current position: */
+		unsigned int slot=hash(data+pos);
+		size_t candidate=hashTable[slot];
+		hashTable[slot]=pos+1;
+		
+		if(candidate!=0&&pos-(candidate-1)<=MAX_OFFSET&&memcmp(data+candidate-1,data+pos,MIN_MATCH)==0)
+			{
+			/* Extend the match as far as possible: */
+			size_t matchStart=candidate-1;
+			size_t matchLength=MIN_MATCH;
+			while(pos+matchLength<dataSize&&data[matchStart+matchLength]==data[pos+matchLength])
+				++matchLength;
+			
+			/* Write the literals preceding the match and the match: */
+			writeSequence(data+anchor,pos-anchor,matchLength,pos-matchStart,compressed);
+			
+			/* Enter some of the byte runs inside the match into the hash table, and continue after the match: */
+			size_t matchEnd=pos+matchLength;
+			for(pos+=2;pos+MIN_MATCH<=matchEnd&&pos+MIN_MATCH<=dataSize;pos+=2)
+				hashTable[hash(data+pos)]=pos+1;
+			pos=matchEnd;
+			anchor=pos;
+			}
+		else
+			++pos;
+		}
+	
+	/* Write the remaining literals; the decoder stops when it has produced all data: */
+	if(anchor<dataSize)
+		writeSequence(data+anchor,dataSize-anchor,0,0,compressed);
+	}
+
+void PayloadCompressor::decompress(const PayloadCompressor::Byte* compressed,size_t compressedSize,PayloadCompressor::Byte* data,size_t dataSize)
+	{
+	const Byte* cPtr=compressed;
+	const Byte* cEnd=compressed+compressedSize;
+	Byte* dPtr=data;
+	Byte* dEnd=data+dataSize;
+	while(dPtr!=dEnd)
+		{
+		/* Read the next token: */
+		if(cPtr==cEnd)
+			Misc::throwStdErr("PayloadCompressor::decompress: Truncated data");
+		Byte token=*(cPtr++);
+		
+		/* Copy the literal run: */
+		size_t numLiterals=readLength(token>>4,cPtr,cEnd);
+		if(numLiterals>size_t(cEnd-cPtr)||numLiterals>size_t(dEnd-dPtr))
+			Misc::throwStdErr("PayloadCompressor::decompress: Literal run out of bounds");
+		memcpy(dPtr,cPtr,numLiterals);
+		cPtr+=numLiterals;
+		dPtr+=numLiterals;
+		
+		/* Stop after the final literal run: */
+		if(dPtr==dEnd)
+			break;
+		
+		/* Read the match offset and length: */
+		if(cEnd-cPtr<2)
+			Misc::throwStdErr("PayloadCompressor::decompress: Truncated match");
+		size_t matchOffset=size_t(cPtr[0])|(size_t(cPtr[1])<<8);
+		cPtr+=2;
+		size_t matchLength=readLength(token&0x0fU,cPtr,cEnd)+MIN_MATCH;
+		if(matchOffset==0||matchOffset>size_t(dPtr-data)||matchLength>size_t(dEnd-dPtr))
+			Misc::throwStdErr("PayloadCompressor::decompress: Match out of bounds");
+		
+		/* Copy the match byte by byte, as it can overlap itself: */
+		const Byte* mPtr=dPtr-matchOffset;
+		for(size_t i=0;i<matchLength;++i)
+			*(dPtr++)=*(mPtr++);
+		}
+	}
+
+size_t PayloadCompressor::writePayload(const IO::VariableMemoryFile& payload,size_t threshold,IO::File& sink)
+	{
+	size_t payloadSize=payload.getDataSize();
+	if(threshold==0||payloadSize<threshold)
+		{
+		/* Write the payload verbatim: */
+		sink.write<Byte>(STORED);
+		sink.write<Card>(Card(payloadSize));
+		payload.writeToSink(sink);
+		return sizeof(Byte)+sizeof(Card)+payloadSize;
+		}
+	
+	/* Copy the payload into contiguous memory and compress it: */
+	IO::FixedMemoryFile raw(payloadSize);
+	payload.writeToSink(raw);
+	raw.flush();
+	const Byte* rawData=static_cast<const Byte*>(raw.getMemory());
+	Method method=LZ;
+	std::vector<Byte> compressed;
+	compressed.reserve(payloadSize/2);
+	compress(rawData,payloadSize,compressed);
+	
+	/* Compress the payload's byte planes as well, and keep whichever is smaller: */
+	std::vector<Byte> planes(payloadSize);
+	shuffle(rawData,payloadSize,&planes[0]);
+	std::vector<Byte> shuffledCompressed;
+	shuffledCompressed.reserve(compressed.size());
+	compress(&planes[0],payloadSize,shuffledCompressed);
+	if(shuffledCompressed.size()<compressed.size())
+		{
+		method=SHUFFLED_LZ;
+		compressed.swap(shuffledCompressed);
+		}
+	
+	if(compressed.size()+sizeof(Card)>=payloadSize)
+		{
+		/* Write the payload verbatim if compression did not help: */
+		sink.write<Byte>(STORED);
+		sink.write<Card>(Card(payloadSize));
+		sink.write(rawData,payloadSize);
+		return sizeof(Byte)+sizeof(Card)+payloadSize;
+		}
+	
+	/* Write the compressed payload: */
+	sink.write<Byte>(method);
+	sink.write<Card>(Card(payloadSize));
+	sink.write<Card>(Card(compressed.size()));
+	sink.write(&compressed[0],compressed.size());
+	return sizeof(Byte)+2*sizeof(Card)+compressed.size();
+	}
+
+IO::FixedMemoryFile* PayloadCompressor::readPayload(IO::File& source)
+	{
+	/* Read the envelope header: */
+	unsigned int method=source.read<Byte>();
+	size_t payloadSize=source.read<Card>();
+	if(method!=STORED&&method!=LZ&&method!=SHUFFLED_LZ)
+		Misc::throwStdErr("PayloadCompressor::readPayload: Unknown payload encoding method %u",method);
+	if(payloadSize>size_t(MAX_PAYLOAD_SIZE))
+		Misc::throwStdErr("PayloadCompressor::readPayload: Payload size %u exceeds limit",(unsigned int)payloadSize);
+	
+	/* Create a memory file that reads with the same endianness as the source: */
+	Misc::SelfDestructPointer<IO::FixedMemoryFile> result(new IO::FixedMemoryFile(payloadSize));
+	result->setSwapOnRead(source.mustSwapOnRead());
+	Byte* data=static_cast<Byte*>(result->getMemory());
+	
+	if(method==STORED)
+		{
+		/* Read the payload verbatim: */
+		source.read(data,payloadSize);
+		}
+	else
+		{
+		/* Read and decompress the payload: */
+		size_t compressedSize=source.read<Card>();
+		if(compressedSize==0||compressedSize>size_t(MAX_PAYLOAD_SIZE))
+			Misc::throwStdErr("PayloadCompressor::readPayload: Invalid compressed payload size %u",(unsigned int)compressedSize);
+		std::vector<Byte> compressed(compressedSize);
+		source.read(&compressed[0],compressedSize);
+		if(method==SHUFFLED_LZ)
+			{
+			/* Decompress the byte planes and interleave them: */
+			std::vector<Byte> planes(payloadSize);
+			decompress(&compressed[0],compressedSize,planes.empty()?0:&planes[0],payloadSize);
+			unshuffle(planes.empty()?0:&planes[0],payloadSize,data);
+			}
+		else
+			decompress(&compressed[0],compressedSize,data,payloadSize);
+		}
+	
+	return result.releaseTarget();
+	}
+
+}
@@ -0,0 +1,72 @@
+/***********************************************************************
+PayloadCompressor - Class to wrap bulk protocol payloads into envelopes
+that are compressed with a simple LZ77-style codec if they exceed a size
+threshold.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_PAYLOADCOMPRESSOR_INCLUDED
+#define COLLABORATION_PAYLOADCOMPRESSOR_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/SizedTypes.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+class FixedMemoryFile;
+class VariableMemoryFile;
+}
+
+namespace Collaboration {
+
+class PayloadCompressor
+	{
+	/* Embedded classes: */
+	public:
+	typedef Misc::UInt8 Byte; // Type for raw data
+	typedef Misc::UInt32 Card; // Type for transmitted cardinal numbers
+	
+	enum Method // Enumerated type for payload encoding methods
+		{
+		STORED=0, // Payload follows verbatim
+		LZ, // Payload is compressed
+		SHUFFLED_LZ // Payload is split into byte planes of 32-bit words, which separates the slowly-changing high bytes of coordinates, and then compressed
+		};
+	
+	enum
+		{
+		MIN_MATCH=4, // Minimum length of matched byte runs
+		MAX_OFFSET=65535, // Maximum distance of matched byte runs
+		HASHTABLE_SIZE=1<<14, // Number of slots in the table of recently seen byte runs
+		MAX_PAYLOAD_SIZE=1<<28 // Largest accepted decompressed payload size, to reject corrupted envelopes
+		};
+	
+	/* Methods: */
+	static void compress(const Byte* data,size_t dataSize,std::vector<Byte>& compressed); // Appends the compressed form of the given data to the given buffer
+	static void decompress(const Byte* compressed,size_t compressedSize,Byte* data,size_t dataSize); // Decompresses data of the given decompressed size; throws exception if the compressed data is corrupted
+	static size_t writePayload(const IO::VariableMemoryFile& payload,size_t threshold,IO::File& sink); // Writes the given payload in an envelope to the given sink, compressing it if it is at least threshold bytes long and threshold is not zero; returns the envelope size
+	static IO::FixedMemoryFile* readPayload(IO::File& source); // Reads a payload envelope from the given source and returns a new memory file containing the payload with the source's endianness
+	};
+
+}
+
+#endif
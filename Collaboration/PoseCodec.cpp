@@ -0,0 +1,274 @@
+/***********************************************************************
+PoseCodec - Class to write rigid body and navigation transformations in
+quantized form, with positions in fixed point relative to an environment
+frame and rotations in smallest-three quaternion form.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/PoseCodec.h>
+
+#include <math.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/File.h>
+
+namespace Collaboration {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void writeBits(Misc::UInt64 bits,unsigned int numBits,IO::File& sink)
+	{
+	/* Write the bits in little-endian byte order, independent of the sink's endianness: */
+	for(unsigned int bit=0;bit<numBits;bit+=8,bits>>=8)
+		sink.write<Misc::UInt8>(Misc::UInt8(bits&0xffU));
+	}
+
+Misc::UInt64 readBits(Misc::UInt64 bits,unsigned int numBits,unsigned int firstBit,IO::File& source)
+	{
+	/* Read the remaining bytes in little-endian byte order and append them to the already-read bits: */
+	for(unsigned int bit=firstBit;bit<numBits;bit+=8)
+		bits|=Misc::UInt64(source.read<Misc::UInt8>())<<bit;
+	return bits;
+	}
+
+}
+
+/**********************************
+Static elements of class PoseCodec:
+**********************************/
+
+const PoseCodec::Scalar PoseCodec::positionRange=Scalar(8);
+
+/**************************
+Methods of class PoseCodec:
+**************************/
+
+void PoseCodec::writeRotation(const PoseCodec::Rotation& rotation,IO::File& sink) const
+	{
+	/* Find the quaternion component with the largest absolute value: */
+	const Scalar* q=rotation.getQuaternion();
+	unsigned int largest=0;
+	for(unsigned int i=1;i<4;++i)
+		if(fabs(q[i])>fabs(q[largest]))
+			largest=i;
+	
+	/* Flip the quaternion such that the largest component is positive, so that it can be reconstructed from the other three: */
+	double sign=q[largest]<Scalar(0)?-1.0:1.0;
+	
+	/* Quantize the other three components, which are in [-sqrt(1/2), sqrt(1/2)]: */
+	double maxValue=double((Misc::UInt64(1)<<rotationBits)-1);
+	Misc::UInt64 bits=largest;
+	unsigned int shift=2;
+	for(unsigned int i=0;i<4;++i)
+		if(i!=largest)
+			{
+			double v=(double(q[i])*sign*M_SQRT2+1.0)*0.5*maxValue;
+			if(v<0.0)
+				v=0.0;
+			if(v>maxValue)
+				v=maxValue;
+			bits|=Misc::UInt64(v+0.5)<<shift;
+			shift+=rotationBits;
+			}
+	writeBits(bits,shift,sink);
+	}
+
+PoseCodec::Rotation PoseCodec::readRotation(IO::File& source) const
+	{
+	/* Read the packed components: */
+	Misc::UInt64 bits=readBits(0,2+rotationBits*3,0,source);
+	unsigned int largest=(unsigned int)(bits&0x3U);
+	bits>>=2;
+	
+	/* Dequantize the three smallest components and reconstruct the largest: */
+	double maxValue=double((Misc::UInt64(1)<<rotationBits)-1);
+	Misc::UInt64 mask=(Misc::UInt64(1)<<rotationBits)-1;
+	double q[4];
+	double sqrSum=0.0;
+	for(unsigned int i=0;i<4;++i)
+		if(i!=largest)
+			{
+			q[i]=(double(bits&mask)*2.0/maxValue-1.0)*M_SQRT1_2;
+			sqrSum+=q[i]*q[i];
+			bits>>=rotationBits;
+			}
+	q[largest]=sqrSum<1.0?sqrt(1.0-sqrSum):0.0;
+	
+	/* Re-normalize the quaternion to absorb quantization error: */
+	double norm=sqrt(sqrSum+q[largest]*q[largest]);
+	return Rotation(Scalar(q[0]/norm),Scalar(q[1]/norm),Scalar(q[2]/norm),Scalar(q[3]/norm));
+	}
+
+PoseCodec::PoseCodec(void)
+	:positionBits(0),rotationBits(0)
+	{
+	}
+
+PoseCodec::PoseCodec(unsigned int sPositionBits,unsigned int sRotationBits)
+	:positionBits(sPositionBits),rotationBits(sRotationBits)
+	{
+	/* Check that the packed position and rotation each fit into 64 bits, and that rotations are precise enough for the error bound to hold: */
+	if(positionBits>21)
+		Misc::throwStdErr("PoseCodec::PoseCodec: Position precision of %u bits exceeds maximum of 21 bits",positionBits);
+	if(rotationBits!=0&&(rotationBits<3||rotationBits>20))
+		Misc::throwStdErr("PoseCodec::PoseCodec: Rotation precision of %u bits is outside valid range of 3 to 20 bits",rotationBits);
+	}
+
+PoseCodec::Scalar PoseCodec::getMaxPositionError(PoseCodec::Scalar frameSize) const
+	{
+	if(positionBits==0)
+		return Scalar(0);
+	
+	/* Each component is off by at most half a quantization step: */
+	double halfStep=double(positionRange)*double(frameSize)/double((Misc::UInt64(1)<<positionBits)-1);
+	return Scalar(sqrt(3.0)*halfStep);
+	}
+
+PoseCodec::Scalar PoseCodec::getMaxRotationError(void) const
+	{
+	if(rotationBits==0)
+		return Scalar(0);
+	
+	/* Each of the three transmitted components is off by at most half a quantization step: */
+	double halfStep=M_SQRT1_2/double((Misc::UInt64(1)<<rotationBits)-1);
+	
+	/* The reconstructed largest component is at least 1/2, which bounds its error by three half steps; the angle between two rotations is at most four times the arcsine of half the distance between their quaternions: */
+	double quatDist=sqrt(12.0)*halfStep;
+	return Scalar(4.0*asin(quatDist<2.0?quatDist*0.5:1.0));
+	}
+
+void PoseCodec::write(const PoseCodec::ONTransform& transform,const PoseCodec::Point& frameCenter,PoseCodec::Scalar frameSize,IO::File& sink) const
+	{
+	if(!isQuantized())
+		{
+		/* Write the transformation as raw scalars: */
+		Protocol::write(transform,sink);
+		return;
+		}
+	
+	if(positionBits!=0)
+		{
+		/* Quantize the translation relative to the frame; a frame of non-positive size puts every position out of range: */
+		double maxValue=double((Misc::UInt64(1)<<positionBits)-1);
+		double scale=frameSize>Scalar(0)?maxValue/(2.0*double(positionRange)*double(frameSize)):0.0;
+		const Vector& t=transform.getTranslation();
+		Misc::UInt64 bits=scale>0.0?1:0;
+		for(int i=0;i<3&&bits!=0;++i)
+			{
+			double v=(double(t[i])-double(frameCenter[i]))*scale+0.5*maxValue;
+			if(v>=0.0&&v<=maxValue)
+				bits|=Misc::UInt64(v+0.5)<<(1+i*positionBits);
+			else
+				bits=0;
+			}
+		
+		if(bits!=0)
+			writeBits(bits,1+positionBits*3,sink);
+		else
+			{
+			/* Write an escape byte followed by the raw translation: */
+			sink.write<Misc::UInt8>(0);
+			Protocol::write(t,sink);
+			}
+		}
+	else
+		Protocol::write(transform.getTranslation(),sink);
+	
+	if(rotationBits!=0)
+		writeRotation(transform.getRotation(),sink);
+	else
+		Protocol::write(transform.getRotation(),sink);
+	}
+
+void PoseCodec::read(PoseCodec::ONTransform& transform,const PoseCodec::Point& frameCenter,PoseCodec::Scalar frameSize,IO::File& source) const
+	{
+	if(!isQuantized())
+		{
+		/* Read the transformation as raw scalars: */
+		Protocol::read(transform,source);
+		return;
+		}
+	
+	Vector translation;
+	if(positionBits!=0)
+		{
+		/* Check the escape bit in the first byte: */
+		Misc::UInt64 bits=source.read<Misc::UInt8>();
+		if(bits&0x1U)
+			{
+			/* Dequantize the translation relative to the frame: */
+			bits=readBits(bits,1+positionBits*3,8,source)>>1;
+			double maxValue=double((Misc::UInt64(1)<<positionBits)-1);
+			double scale=2.0*double(positionRange)*double(frameSize)/maxValue;
+			Misc::UInt64 mask=(Misc::UInt64(1)<<positionBits)-1;
+			for(int i=0;i<3;++i,bits>>=positionBits)
+				translation[i]=Scalar(double(frameCenter[i])+(double(bits&mask)-0.5*maxValue)*scale);
+			}
+		else
+			Protocol::read(translation,source);
+		}
+	else
+		Protocol::read(translation,source);
+	
+	Rotation rotation;
+	if(rotationBits!=0)
+		rotation=readRotation(source);
+	else
+		Protocol::read(rotation,source);
+	
+	transform=ONTransform(translation,rotation);
+	}
+
+void PoseCodec::write(const PoseCodec::OGTransform& transform,IO::File& sink) const
+	{
+	if(rotationBits==0)
+		{
+		/* Write the transformation as raw scalars: */
+		Protocol::write(transform,sink);
+		return;
+		}
+	
+	/* Navigation transformations are unbounded; only quantize their rotations: */
+	Protocol::write(transform.getTranslation(),sink);
+	writeRotation(transform.getRotation(),sink);
+	Protocol::write(transform.getScaling(),sink);
+	}
+
+void PoseCodec::read(PoseCodec::OGTransform& transform,IO::File& source) const
+	{
+	if(rotationBits==0)
+		{
+		/* Read the transformation as raw scalars: */
+		Protocol::read(transform,source);
+		return;
+		}
+	
+	Vector translation;
+	Protocol::read(translation,source);
+	Rotation rotation=readRotation(source);
+	Scalar scaling;
+	Protocol::read(scaling,source);
+	transform=OGTransform(translation,rotation,scaling);
+	}
+
+}
@@ -0,0 +1,77 @@
+/***********************************************************************
+PoseCodec - Class to write rigid body and navigation transformations in
+quantized form, with positions in fixed point relative to an environment
+frame and rotations in smallest-three quaternion form.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_POSECODEC_INCLUDED
+#define COLLABORATION_POSECODEC_INCLUDED
+
+#include <Collaboration/Protocol.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Collaboration {
+
+class PoseCodec:private Protocol
+	{
+	/* Elements: */
+	private:
+	static const Scalar positionRange; // Extent of the quantized position range around the environment frame's center in multiples of the frame's size
+	unsigned int positionBits; // Number of bits per quantized position component, or 0 to write positions as raw scalars
+	unsigned int rotationBits; // Number of bits per quantized rotation component (at least 3), or 0 to write rotations as raw scalars
+	
+	/* Private methods: */
+	void writeRotation(const Rotation& rotation,IO::File& sink) const; // Writes a rotation in smallest-three form
+	Rotation readRotation(IO::File& source) const; // Reads a rotation written in smallest-three form
+	
+	/* Constructors and destructors: */
+	public:
+	PoseCodec(void); // Creates a codec writing all transformations as raw scalars
+	PoseCodec(unsigned int sPositionBits,unsigned int sRotationBits); // Creates a codec with the given precisions; throws exception if precisions are out of range
+	
+	/* Methods: */
+	bool isQuantized(void) const // Returns true if the codec quantizes any transformation components
+		{
+		return positionBits!=0||rotationBits!=0;
+		}
+	unsigned int getPositionBits(void) const // Returns the number of bits per position component
+		{
+		return positionBits;
+		}
+	unsigned int getRotationBits(void) const // Returns the number of bits per rotation component
+		{
+		return rotationBits;
+		}
+	Scalar getMaxPositionError(Scalar frameSize) const; // Returns the maximum distance between a quantized and an original position inside the quantized range of a frame of the given size
+	Scalar getMaxRotationError(void) const; // Returns the maximum rotation angle in radians between a quantized and an original rotation
+	void write(const ONTransform& transform,const Point& frameCenter,Scalar frameSize,IO::File& sink) const; // Writes a rigid body transformation relative to the given environment frame
+	void read(ONTransform& transform,const Point& frameCenter,Scalar frameSize,IO::File& source) const; // Reads a rigid body transformation relative to the given environment frame
+	void write(const OGTransform& transform,IO::File& sink) const; // Writes a navigation transformation; only its rotation is quantized
+	void read(OGTransform& transform,IO::File& source) const; // Reads a navigation transformation
+	};
+
+}
+
+#endif
@@ -25,8 +25,10 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Collaboration/ProtocolClient.h>
 
+#include <IO/FixedMemoryFile.h>
 #include <Comm/NetPipe.h>
 #include <Collaboration/Protocol.h>
+#include <Collaboration/PayloadCompressor.h>
 
 namespace Collaboration {
 
@@ -47,7 +49,7 @@ Methods of class ProtocolClient:
 *******************************/
 
 ProtocolClient::ProtocolClient(void)
-	:client(0),messageIdBase(0)
+	:client(0),messageIdBase(0),compressPayloads(false)
 	{
 	}
 
@@ -55,6 +57,20 @@ ProtocolClient::~ProtocolClient(void)
 	{
 	}
 
+IO::FilePtr ProtocolClient::readBulkPayload(Comm::NetPipe& pipe)
+	{
+	if(compressPayloads)
+		{
+		/* Unpack the payload envelope into a memory file: */
+		return PayloadCompressor::readPayload(pipe);
+		}
+	else
+		{
+		/* Read the payload directly from the pipe: */
+		return IO::FilePtr(&pipe);
+		}
+	}
+
 unsigned int ProtocolClient::getNumMessages(void) const
 	{
 	/* Default is not to have protocol messages: */
@@ -26,6 +26,8 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef COLLABORATION_PROTOCOLCLIENT_INCLUDED
 #define COLLABORATION_PROTOCOLCLIENT_INCLUDED
 
+#include <IO/File.h>
+
 /* Forward declarations: */
 namespace Misc {
 class ConfigurationFileSection;
@@ -53,7 +55,7 @@ class ProtocolClient
 	friend class CollaborationClient;
 	
 	/* Embedded classes: */
-	protected:
+	public:
 	class RemoteClientState // Class representing client-side state of a remote client
 		{
 		/* Constructors and destructors: */
@@ -67,6 +69,11 @@ class ProtocolClient
 	CollaborationClient* client; // Pointer to the main client object
 	private:
 	unsigned int messageIdBase; // Base value for message IDs reserved for this protocol
+	bool compressPayloads; // Flag whether the server sends bulk payloads in compression envelopes
+	
+	/* Protected methods: */
+	protected:
+	IO::FilePtr readBulkPayload(Comm::NetPipe& pipe); // Returns a file from which to read a bulk payload written by ProtocolServer::writeBulkPayload
 	
 	/* Constructors and destructors: */
 	public:
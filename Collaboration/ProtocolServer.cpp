@@ -25,6 +25,10 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 
 #include <Collaboration/ProtocolServer.h>
 
+#include <IO/VariableMemoryFile.h>
+#include <Collaboration/PayloadCompressor.h>
+#include <Collaboration/CollaborationServer.h>
+
 namespace Collaboration {
 
 /********************************************
@@ -32,6 +36,7 @@ Methods of class ProtocolServer::ClientState:
 ********************************************/
 
 ProtocolServer::ClientState::ClientState(void)
+	:compressPayloads(false)
 	{
 	}
 
@@ -39,6 +44,123 @@ ProtocolServer::ClientState::~ClientState(void)
 	{
 	}
 
+/**************************************************
+Methods of class ProtocolServer::ServerUpdateBatch:
+**************************************************/
+
+ProtocolServer::ServerUpdateBatch::ServerUpdateBatch(void)
+	{
+	/* Create the shared payloads in both endiannesses: */
+	for(int i=0;i<2;++i)
+		{
+		sharedPayloads[i]=new IO::VariableMemoryFile;
+		sharedPayloads[i]->setSwapOnWrite(i!=0);
+		sharedWritten[i]=false;
+		}
+	}
+
+ProtocolServer::ServerUpdateBatch::~ServerUpdateBatch(void)
+	{
+	clear();
+	for(std::vector<IO::VariableMemoryFile*>::iterator fpIt=freePayloads.begin();fpIt!=freePayloads.end();++fpIt)
+		delete *fpIt;
+	for(int i=0;i<2;++i)
+		delete sharedPayloads[i];
+	}
+
+void ProtocolServer::ServerUpdateBatch::clear(void)
+	{
+	/* Clear all per-destination payloads and keep them for the next server update: */
+	for(std::vector<Destination>::iterator dIt=destinations.begin();dIt!=destinations.end();++dIt)
+		if(dIt->payload!=0)
+			{
+			dIt->payload->clear();
+			freePayloads.push_back(dIt->payload);
+			}
+	destinations.clear();
+	
+	/* Reset the shared payloads: */
+	for(int i=0;i<2;++i)
+		if(sharedWritten[i])
+			{
+			sharedPayloads[i]->clear();
+			sharedWritten[i]=false;
+			}
+	}
+
+void ProtocolServer::ServerUpdateBatch::addDestination(ProtocolServer::ClientState* destCs,bool swapOnWrite,unsigned int order)
+	{
+	Destination dest;
+	dest.destCs=destCs;
+	dest.swapOnWrite=swapOnWrite;
+	dest.payload=0;
+	dest.order=order;
+	destinations.push_back(dest);
+	}
+
+bool ProtocolServer::ServerUpdateBatch::findPayload(ProtocolServer::ClientState* destCs,unsigned int order,const IO::VariableMemoryFile*& payload) const
+	{
+	/* Find the destination client by binary search, as destinations were added in update order: */
+	size_t l=0;
+	size_t r=destinations.size();
+	while(l<r)
+		{
+		size_t m=(l+r)>>1;
+		if(destinations[m].order<order)
+			l=m+1;
+		else
+			r=m;
+		}
+	
+	/* Check whether the client is in the batch at all: */
+	if(l==destinations.size()||destinations[l].destCs!=destCs)
+		return false;
+	
+	/* Return the destination client's own payload, or the shared payload of its endianness: */
+	const Destination& dest=destinations[l];
+	int variant=dest.swapOnWrite?1:0;
+	if(dest.payload!=0)
+		payload=dest.payload;
+	else if(sharedWritten[variant])
+		payload=sharedPayloads[variant];
+	else
+		payload=0;
+	return true;
+	}
+
+IO::File& ProtocolServer::ServerUpdateBatch::getPayload(unsigned int index)
+	{
+	Destination& dest=destinations[index];
+	if(dest.payload==0)
+		{
+		/* Reuse a payload from a previous server update, or create a new one: */
+		if(!freePayloads.empty())
+			{
+			dest.payload=freePayloads.back();
+			freePayloads.pop_back();
+			}
+		else
+			dest.payload=new IO::VariableMemoryFile;
+		dest.payload->setSwapOnWrite(dest.swapOnWrite);
+		}
+	return *dest.payload;
+	}
+
+bool ProtocolServer::ServerUpdateBatch::needsSharedPayload(bool swapOnWrite) const
+	{
+	for(std::vector<Destination>::const_iterator dIt=destinations.begin();dIt!=destinations.end();++dIt)
+		if(dIt->swapOnWrite==swapOnWrite&&dIt->payload==0)
+			return true;
+	return false;
+	}
+
+IO::File& ProtocolServer::ServerUpdateBatch::getSharedPayload(bool swapOnWrite)
+	{
+	int variant=swapOnWrite?1:0;
+	sharedWritten[variant]=true;
+	return *sharedPayloads[variant];
+	}
+
 /*******************************
 Methods of class ProtocolServer:
 *******************************/
@@ -52,6 +174,20 @@ ProtocolServer::~ProtocolServer(void)
 	{
 	}
 
+void ProtocolServer::writeBulkPayload(ProtocolServer::ClientState* destCs,const IO::VariableMemoryFile& payload,IO::File& pipe)
+	{
+	if(destCs->compressPayloads)
+		{
+		/* Write the payload in an envelope, compressed if it is large enough: */
+		PayloadCompressor::writePayload(payload,server->getCompressionThreshold(),pipe);
+		}
+	else
+		{
+		/* Write the payload verbatim: */
+		payload.writeToSink(pipe);
+		}
+	}
+
 unsigned int ProtocolServer::getNumMessages(void) const
 	{
 	/* Default is not to have protocol messages: */
@@ -64,6 +200,24 @@ void ProtocolServer::initialize(CollaborationServer* sServer,Misc::Configuration
 	server=sServer;
 	}
 
+bool ProtocolServer::hasDestinationIndependentConnect(void) const
+	{
+	/* Default is to let the protocol write each destination client's connect payload: */
+	return false;
+	}
+
+bool ProtocolServer::hasThreadSafeClientHooks(void) const
+	{
+	/* Default is to run all per-client hooks from a single thread: */
+	return false;
+	}
+
+bool ProtocolServer::hasBatchedServerUpdates(void) const
+	{
+	/* Default is to write each destination client's payload while assembling its update message: */
+	return false;
+	}
+
 ProtocolServer::ClientState* ProtocolServer::receiveConnectRequest(unsigned int protocolMessageLength,Comm::NetPipe& pipe)
 	{
 	/* Reject the connection: */
@@ -90,16 +244,29 @@ void ProtocolServer::receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::N
 	{
 	}
 
-void ProtocolServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void ProtocolServer::sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
+	{
+	}
+
+void ProtocolServer::sendServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
+	{
+	}
+
+void ProtocolServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	}
 
-void ProtocolServer::sendServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void ProtocolServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ServerUpdateBatch& batch)
 	{
+	/* Default is to write a separate payload for each destination client: */
+	for(unsigned int i=0;i<batch.getNumDestinations();++i)
+		sendServerUpdate(sourceCs,batch.getDestination(i),batch.getPayload(i));
 	}
 
-void ProtocolServer::sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+bool ProtocolServer::sendReducedServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
+	/* Default is to always send the full update: */
+	return false;
 	}
 
 bool ProtocolServer::handleMessage(ProtocolServer::ClientState* cs,unsigned int messageId,Comm::NetPipe& pipe)
@@ -124,7 +291,7 @@ void ProtocolServer::beforeServerUpdate(ProtocolServer::ClientState* cs)
 	{
 	}
 
-void ProtocolServer::beforeServerUpdate(ProtocolServer::ClientState* destCs,Comm::NetPipe& pipe)
+void ProtocolServer::beforeServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
 	{
 	}
 
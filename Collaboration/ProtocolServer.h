@@ -26,6 +26,10 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #ifndef COLLABORATION_PROTOCOLSERVER_INCLUDED
 #define COLLABORATION_PROTOCOLSERVER_INCLUDED
 
+#include <vector>
+#include <Collaboration/ServerMetrics.h>
+#include <Collaboration/TickProfiler.h>
+
 /* Forward declarations: */
 namespace Misc {
 class ConfigurationFileSection;
@@ -34,6 +38,10 @@ namespace Plugins {
 template <class ManagedClassParam>
 class ObjectLoader;
 }
+namespace IO {
+class File;
+class VariableMemoryFile;
+}
 namespace Comm {
 class NetPipe;
 }
@@ -48,19 +56,87 @@ class ProtocolServer
 	friend class CollaborationServer;
 	
 	/* Embedded classes: */
-	protected:
+	public:
 	class ClientState // Class representing server-side state of a connected client
 		{
+		friend class ProtocolServer;
+		friend class CollaborationServer;
+		
+		/* Elements: */
+		private:
+		bool compressPayloads; // Flag whether the client accepts bulk payloads in compression envelopes
+		
 		/* Constructors and destructors: */
 		public:
 		ClientState(void);
 		virtual ~ClientState(void);
 		};
 	
+	protected:
+	class ServerUpdateBatch // Class collecting the SERVER_UPDATE payloads a protocol writes for one source client to all destination clients sharing the protocol
+		{
+		friend class CollaborationServer;
+		
+		/* Embedded classes: */
+		private:
+		struct Destination // Structure describing one destination client in a batch
+			{
+			/* Elements: */
+			public:
+			ClientState* destCs; // The destination client's protocol state
+			bool swapOnWrite; // Flag whether the destination client's pipe swaps endianness on writing
+			IO::VariableMemoryFile* payload; // Payload written specifically for the destination client, or 0 if it receives the shared payload of its endianness
+			unsigned int order; // Position of the destination client in the server's update order
+			};
+		
+		/* Elements: */
+		std::vector<Destination> destinations; // List of destination clients sharing the protocol with the source client, in the order in which the server sends updates
+		IO::VariableMemoryFile* sharedPayloads[2]; // Payloads shared by all destination clients in native and swapped endianness without their own payloads
+		bool sharedWritten[2]; // Flags whether the shared payloads were requested during the current server update
+		std::vector<IO::VariableMemoryFile*> freePayloads; // Cleared per-destination payloads of previous server updates, to be reused
+		
+		/* Constructors and destructors: */
+		public:
+		ServerUpdateBatch(void); // Creates an empty batch
+		private:
+		ServerUpdateBatch(const ServerUpdateBatch& source); // Prohibit copy constructor
+		ServerUpdateBatch& operator=(const ServerUpdateBatch& source); // Prohibit assignment operator
+		public:
+		~ServerUpdateBatch(void);
+		
+		/* Private methods: */
+		private:
+		void clear(void); // Removes all destination clients and payloads from the batch
+		void addDestination(ClientState* destCs,bool swapOnWrite,unsigned int order); // Adds a destination client at the given position in the server's update order, which must be larger than those of all destination clients added before
+		bool findPayload(ClientState* destCs,unsigned int order,const IO::VariableMemoryFile*& payload) const; // Looks up the payload for the given destination client at the given position in the update order; can be called concurrently for different destination clients; returns false if the client is not in the batch, and sets payload to 0 if the protocol did not write a payload for it
+		
+		/* Methods: */
+		public:
+		unsigned int getNumDestinations(void) const // Returns the number of destination clients in the batch
+			{
+			return destinations.size();
+			}
+		ClientState* getDestination(unsigned int index) const // Returns the protocol state of the destination client of the given index
+			{
+			return destinations[index].destCs;
+			}
+		IO::File& getPayload(unsigned int index); // Returns a sink for a payload written only for the destination client of the given index, in its endianness
+		bool needsSharedPayload(bool swapOnWrite) const; // Returns true if any destination client of the given endianness does not have its own payload
+		IO::File& getSharedPayload(bool swapOnWrite); // Returns a sink for the payload shared by all destination clients of the given endianness without their own payloads
+		};
+	
 	/* Elements: */
 	protected:
 	CollaborationServer* server; // Pointer to the server object
 	unsigned int messageIdBase; // Base value for message IDs reserved for this protocol
+	private:
+	ServerMetrics::Counter sentBytes; // Number of payload bytes the protocol wrote into messages to clients
+	std::vector<ServerMetrics::Counter> receivedMessages; // Numbers of received protocol messages, indexed relative to the message ID base
+	TickProfiler::HookTotals hookTotals; // Times the protocol spent in per-client hooks, if the server profiles its updates
+	
+	/* Protected methods: */
+	protected:
+	void writeBulkPayload(ClientState* destCs,const IO::VariableMemoryFile& payload,IO::File& pipe); // Writes a bulk payload to the given client, in a compression envelope if the client negotiated compression
 	
 	/* Constructors and destructors: */
 	public:
@@ -75,6 +151,9 @@ class ProtocolServer
 	virtual const char* getName(void) const =0; // Returns the protocol's (hopefully unique) name
 	virtual unsigned int getNumMessages(void) const; // Returns the number of protocol messages used by this protocol
 	virtual void initialize(CollaborationServer* sServer,Misc::ConfigurationFileSection& configFileSection); // Called when the protocol server is registered with a collaboration server
+	virtual bool hasDestinationIndependentConnect(void) const; // Returns true if the protocol's sendClientConnect payload only depends on the source client's state and the destination's endianness and payload compression, so that the server can cache it per server update; default returns false
+	virtual bool hasThreadSafeClientHooks(void) const; // Returns true if the server may call the protocol's per-client server update hooks concurrently for different clients, i.e., if each call only modifies the states of the client it is for and of the destination client whose message it writes; default returns false
+	virtual bool hasBatchedServerUpdates(void) const; // Returns true if the server writes the protocol's SERVER_UPDATE payloads by calling sendServerUpdate(sourceCs,batch) for each client before assembling any update messages, instead of calling sendServerUpdate(sourceCs,destCs,pipe) while assembling each destination client's message; default returns false
 	
 	/***********************************
 	Server protocol engine hook methods:
@@ -87,17 +166,19 @@ class ProtocolServer
 	virtual void receiveDisconnectRequest(ClientState* cs,Comm::NetPipe& pipe); // Hook called when the server receives a disconnection request
 	virtual void sendDisconnectReply(ClientState* cs,Comm::NetPipe& pipe); // Hook called when the server sends a disconnect reply to a client
 	virtual void receiveClientUpdate(ClientState* cs,Comm::NetPipe& pipe); // Hook called when the server receives a client's state update packet
-	virtual void sendClientConnect(ClientState* sourceCs,ClientState* destCs,Comm::NetPipe& pipe); // Hook called when the server sends a connection message for client sourceClient to client destClient
-	virtual void sendServerUpdate(ClientState* destCs,Comm::NetPipe& pipe); // Hook called when the server sends a state update to a client
-	virtual void sendServerUpdate(ClientState* sourceCs,ClientState* destCs,Comm::NetPipe& pipe); // Hook called when the server sends a state update for client sourceClient to client destClient
+	virtual void sendClientConnect(ClientState* sourceCs,ClientState* destCs,IO::File& pipe); // Hook called when the server sends a connection message for client sourceClient to client destClient; the payload is cached and copied to all destinations with the same endianness and payload compression joining during the same server update if the protocol declares destination-independent connect payloads, and written separately for each destination otherwise
+	virtual void sendServerUpdate(ClientState* destCs,IO::File& pipe); // Hook called when the server sends a state update to a client
+	virtual void sendServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe); // Hook called when the server sends a state update for client sourceClient to client destClient
+	virtual void sendServerUpdate(ClientState* sourceCs,ServerUpdateBatch& batch); // Hook called once per server update for each client with all destination clients sharing the protocol if the protocol declares batched server updates, before any destination client's beforeServerUpdate(destCs,pipe) and sendServerUpdate(destCs,pipe); writes shared or per-destination payloads into the batch; default calls sendServerUpdate(sourceCs,destCs,pipe) for each destination
+	virtual bool sendReducedServerUpdate(ClientState* sourceCs,ClientState* destCs,IO::File& pipe); // Hook called instead of sendServerUpdate(sourceCs,destCs,pipe) when destClient cannot keep up; writes a payload without bulk media data and returns true, or writes nothing and returns false if the protocol cannot reduce its payload
 	
 	/* Hooks to insert processing into the lower-level protocol state machine: */
 	virtual bool handleMessage(ClientState* cs,unsigned int messageId,Comm::NetPipe& pipe); // Hook called when server receives unknown message from client; returns false to signal protocol error
 	virtual void connectClient(ClientState* cs); // Hook called when connection to a new client has been fully established
 	virtual void disconnectClient(ClientState* cs); // Hook called after a client has been disconnected (voluntarily or involuntarily)
 	virtual void beforeServerUpdate(void); // Hook called before the server sends state update messages
-	virtual void beforeServerUpdate(ClientState* cs); // Hook called for each client before the server sends state update messages
-	virtual void beforeServerUpdate(ClientState* destCs,Comm::NetPipe& pipe); // Hook called right before the server sends a state update message to the given client
+	virtual void beforeServerUpdate(ClientState* cs); // Hook called for each client before the server sends state update messages; this is the only server update hook that excludes the client's receiving hooks, so protocols must snapshot any state shared with them here
+	virtual void beforeServerUpdate(ClientState* destCs,IO::File& pipe); // Hook called right before the server sends a state update message to the given client
 	virtual void afterServerUpdate(ClientState* cs); // Hook called for each client after the server sent state update messages
 	virtual void afterServerUpdate(void); // Hook called after the server sent state update messages
 	};
@@ -0,0 +1,159 @@
+/***********************************************************************
+ProtocolSet - Class for sets of protocol plug-in indices stored as bit
+masks, to intersect the protocol lists of two clients word by word.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_PROTOCOLSET_INCLUDED
+#define COLLABORATION_PROTOCOLSET_INCLUDED
+
+#include <vector>
+
+namespace Collaboration {
+
+class ProtocolSet
+	{
+	/* Embedded classes: */
+	public:
+	typedef unsigned int Word; // Type for words of the bit mask
+	
+	enum
+		{
+		WORD_BITS=sizeof(Word)*8 // Number of bits in a bit mask word
+		};
+	
+	class SharedIterator // Class to iterate through the indices contained in both of two sets in ascending order
+		{
+		/* Elements: */
+		private:
+		const ProtocolSet& set1; // First set
+		const ProtocolSet& set2; // Second set
+		unsigned int numWords; // Number of bit mask words present in both sets
+		unsigned int wordIndex; // Index of the current bit mask word
+		Word shared; // Remaining bits of the current word shared by both sets
+		unsigned int index; // Current shared index
+		
+		/* Private methods: */
+		void advance(void) // Moves to the next shared index
+			{
+			/* Skip words without shared bits: */
+			while(shared==0U)
+				{
+				if(++wordIndex>=numWords)
+					return;
+				shared=set1.words[wordIndex]&set2.words[wordIndex];
+				}
+			
+			/* Extract the lowest shared bit: */
+			index=wordIndex*WORD_BITS+findLowestBit(shared);
+			shared&=shared-1U;
+			}
+		
+		/* Constructors and destructors: */
+		public:
+		SharedIterator(const ProtocolSet& sSet1,const ProtocolSet& sSet2)
+			:set1(sSet1),set2(sSet2),
+			 numWords((unsigned int)(set1.words.size()<set2.words.size()?set1.words.size():set2.words.size())),
+			 wordIndex(0),shared(numWords>0?set1.words[0]&set2.words[0]:0U),index(0)
+			{
+			if(numWords>0)
+				advance();
+			}
+		
+		/* Methods: */
+		bool isFinished(void) const // Returns true if all shared indices have been visited
+			{
+			return wordIndex>=numWords;
+			}
+		unsigned int operator*(void) const // Returns the current shared index
+			{
+			return index;
+			}
+		SharedIterator& operator++(void) // Moves to the next shared index
+			{
+			advance();
+			return *this;
+			}
+		};
+	
+	friend class SharedIterator;
+	
+	/* Elements: */
+	private:
+	std::vector<Word> words; // Bit mask words, with bit i of word w set if index w*WORD_BITS+i is in the set
+	
+	/* Private methods: */
+	static unsigned int findLowestBit(Word word) // Returns the index of the lowest set bit in a non-zero word
+		{
+		#ifdef __GNUC__
+		return (unsigned int)(__builtin_ctz(word));
+		#else
+		unsigned int result=0;
+		while((word&1U)==0U)
+			{
+			word>>=1;
+			++result;
+			}
+		return result;
+		#endif
+		}
+	static unsigned int countBits(Word word) // Returns the number of set bits in a word
+		{
+		#ifdef __GNUC__
+		return (unsigned int)(__builtin_popcount(word));
+		#else
+		unsigned int result=0;
+		for(;word!=0U;word&=word-1U)
+			++result;
+		return result;
+		#endif
+		}
+	
+	/* Methods: */
+	public:
+	void clear(void) // Removes all indices from the set
+		{
+		words.clear();
+		}
+	void add(unsigned int index) // Adds the given index to the set
+		{
+		unsigned int wordIndex=index/WORD_BITS;
+		if(wordIndex>=words.size())
+			words.resize(wordIndex+1,0U);
+		words[wordIndex]|=Word(1U)<<(index%WORD_BITS);
+		}
+	bool contains(unsigned int index) const // Returns true if the given index is in the set
+		{
+		unsigned int wordIndex=index/WORD_BITS;
+		return wordIndex<words.size()&&(words[wordIndex]&(Word(1U)<<(index%WORD_BITS)))!=0U;
+		}
+	unsigned int countShared(const ProtocolSet& other) const // Returns the number of indices contained in both this and the other set
+		{
+		unsigned int numWords=(unsigned int)(words.size()<other.words.size()?words.size():other.words.size());
+		unsigned int result=0;
+		for(unsigned int i=0;i<numWords;++i)
+			result+=countBits(words[i]&other.words[i]);
+		return result;
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,195 @@
+/***********************************************************************
+RelayCodec - Classes to remove redundancy from the data multiplexed over
+a relay link, by replacing byte runs that were already sent over the
+link with references into a shared history window.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/RelayCodec.h>
+
+#include <string.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/File.h>
+#include <Collaboration/Protocol.h>
+
+namespace Collaboration {
+
+/***************************
+Methods of class RelayCodec:
+***************************/
+
+void RelayCodec::append(const RelayCodec::Byte* data,size_t dataSize)
+	{
+	for(size_t i=0;i<dataSize;++i,++historyEnd)
+		history[historyEnd&(HISTORY_SIZE-1)]=data[i];
+	}
+
+RelayCodec::RelayCodec(void)
+	:history(new Byte[HISTORY_SIZE]),
+	 historyEnd(0)
+	{
+	/* Initialize the history window identically on both ends of the link: */
+	memset(history,0,HISTORY_SIZE);
+	}
+
+RelayCodec::~RelayCodec(void)
+	{
+	delete[] history;
+	}
+
+/*****************************
+Methods of class RelayEncoder:
+*****************************/
+
+unsigned int RelayEncoder::hash(const RelayCodec::Byte* data)
+	{
+	unsigned int result=2166136261U;
+	for(int i=0;i<MIN_MATCH;++i)
+		result=(result^data[i])*16777619U;
+	return (result^(result>>16))&(HASHTABLE_SIZE-1);
+	}
+
+void RelayEncoder::appendAndHash(const RelayCodec::Byte* data,size_t dataSize)
+	{
+	append(data,dataSize);
+	
+	/* Enter all byte runs that are now complete into the hash table: */
+	Byte run[MIN_MATCH];
+	for(;historyEnd-hashedEnd>=(unsigned int)(MIN_MATCH);++hashedEnd)
+		{
+		for(int i=0;i<MIN_MATCH;++i)
+			run[i]=getHistory(hashedEnd+i);
+		hashTable[hash(run)]=hashedEnd;
+		}
+	}
+
+RelayEncoder::RelayEncoder(void)
+	:hashTable(new unsigned int[HASHTABLE_SIZE]),
+	 hashedEnd(0)
+	{
+	/* Point all hash table slots at the start of the (zero-initialized) history window: */
+	for(unsigned int i=0;i<HASHTABLE_SIZE;++i)
+		hashTable[i]=0;
+	}
+
+RelayEncoder::~RelayEncoder(void)
+	{
+	delete[] hashTable;
+	}
+
+void RelayEncoder::encode(const void* data,size_t dataSize,IO::File& sink)
+	{
+	const Byte* bytes=static_cast<const Byte*>(data);
+	size_t literalStart=0;
+	size_t pos=0;
+	while(pos+MIN_MATCH<=dataSize)
+		{
+		/* Look for the byte run starting at the current position in the history window: */
+		unsigned int candidate=hashTable[hash(bytes+pos)];
+		
+		/* Check that the candidate run is still in the history window once the pending literal bytes are appended: */
+		unsigned int available=historyEnd-candidate;
+		unsigned int distance=available+(unsigned int)(pos-literalStart);
+		size_t matchLength=0;
+		if(available>=(unsigned int)(MIN_MATCH)&&distance<(unsigned int)(HISTORY_SIZE))
+			{
+			/* Compare the byte runs, and extend the match as far as possible without reaching beyond the current history window: */
+			size_t maxLength=dataSize-pos;
+			if(maxLength>available)
+				maxLength=available;
+			while(matchLength<maxLength&&getHistory(candidate+(unsigned int)(matchLength))==bytes[pos+matchLength])
+				++matchLength;
+			}
+		
+		if(matchLength>=size_t(MIN_MATCH))
+			{
+			/* Write the pending literal bytes: */
+			if(pos>literalStart)
+				{
+				sink.write<Protocol::Byte>(LITERAL);
+				sink.write<Protocol::Card>(pos-literalStart);
+				sink.write<Byte>(bytes+literalStart,pos-literalStart);
+				appendAndHash(bytes+literalStart,pos-literalStart);
+				}
+			
+			/* Write the match: */
+			sink.write<Protocol::Byte>(MATCH);
+			sink.write<Protocol::Card>(matchLength);
+			sink.write<Protocol::Card>(historyEnd-candidate);
+			appendAndHash(bytes+pos,matchLength);
+			
+			pos+=matchLength;
+			literalStart=pos;
+			}
+		else
+			++pos;
+		}
+	
+	/* Write the remaining literal bytes: */
+	if(dataSize>literalStart)
+		{
+		sink.write<Protocol::Byte>(LITERAL);
+		sink.write<Protocol::Card>(dataSize-literalStart);
+		sink.write<Byte>(bytes+literalStart,dataSize-literalStart);
+		appendAndHash(bytes+literalStart,dataSize-literalStart);
+		}
+	
+	sink.write<Protocol::Byte>(END);
+	}
+
+/*****************************
+Methods of class RelayDecoder:
+*****************************/
+
+void RelayDecoder::decode(IO::File& source,std::vector<RelayCodec::Byte>& data)
+	{
+	while(true)
+		{
+		int tokenType=source.read<Protocol::Byte>();
+		if(tokenType==END)
+			break;
+		
+		size_t length=source.read<Protocol::Card>();
+		size_t dataStart=data.size();
+		if(tokenType==LITERAL)
+			{
+			/* Read the literal bytes: */
+			data.resize(dataStart+length);
+			source.read<Byte>(&data[dataStart],length);
+			}
+		else if(tokenType==MATCH)
+			{
+			/* Copy the matched bytes from the history window: */
+			unsigned int distance=source.read<Protocol::Card>();
+			if(distance<length||distance>=(unsigned int)(HISTORY_SIZE))
+				Misc::throwStdErr("RelayDecoder::decode: Invalid match distance %u",distance);
+			data.reserve(dataStart+length);
+			for(size_t i=0;i<length;++i)
+				data.push_back(getHistory(historyEnd-distance+(unsigned int)(i)));
+			}
+		else
+			Misc::throwStdErr("RelayDecoder::decode: Invalid token type %d",tokenType);
+		
+		/* Append the decoded bytes to the history window: */
+		append(&data[dataStart],length);
+		}
+	}
+
+}
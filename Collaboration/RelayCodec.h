@@ -0,0 +1,115 @@
+/***********************************************************************
+RelayCodec - Classes to remove redundancy from the data multiplexed over
+a relay link, by replacing byte runs that were already sent over the
+link with references into a shared history window.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_RELAYCODEC_INCLUDED
+#define COLLABORATION_RELAYCODEC_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+#include <Misc/SizedTypes.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Collaboration {
+
+class RelayCodec // Base class for relay link encoders and decoders
+	{
+	/* Embedded classes: */
+	public:
+	typedef Misc::UInt8 Byte; // Type for raw data
+	
+	enum TokenType // Enumerated type for tokens in encoded data
+		{
+		END=0, // End of encoded data
+		LITERAL, // Run of bytes that follow the token
+		MATCH // Run of bytes copied from the history window
+		};
+	
+	enum
+		{
+		HISTORY_SIZE=1<<20, // Size of the history window shared by the encoder and decoder
+		MIN_MATCH=32 // Minimum length of matched byte runs
+		};
+	
+	/* Elements: */
+	protected:
+	Byte* history; // Ring buffer containing the most recent decoded data
+	unsigned int historyEnd; // Number of bytes ever appended to the history window, modulo 2^32
+	
+	/* Protected methods: */
+	void append(const Byte* data,size_t dataSize); // Appends data to the history window
+	Byte getHistory(unsigned int position) const // Returns the byte at the given absolute position in the history window
+		{
+		return history[position&(HISTORY_SIZE-1)];
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	RelayCodec(void); // Creates a codec with an empty history window
+	private:
+	RelayCodec(const RelayCodec& source); // Prohibit copy constructor
+	RelayCodec& operator=(const RelayCodec& source); // Prohibit assignment operator
+	public:
+	~RelayCodec(void);
+	};
+
+class RelayEncoder:public RelayCodec
+	{
+	/* Embedded classes: */
+	private:
+	enum
+		{
+		HASHTABLE_SIZE=1<<16 // Number of slots in the table of recently seen byte runs
+		};
+	
+	/* Elements: */
+	unsigned int* hashTable; // Table mapping hash values of byte runs to their most recent positions in the history window
+	unsigned int hashedEnd; // Position up to which byte runs in the history window have been entered into the hash table
+	
+	/* Private methods: */
+	static unsigned int hash(const Byte* data); // Returns the hash table slot for the byte run starting at the given position
+	void appendAndHash(const Byte* data,size_t dataSize); // Appends data to the history window and enters all complete byte runs into the hash table
+	
+	/* Constructors and destructors: */
+	public:
+	RelayEncoder(void);
+	~RelayEncoder(void);
+	
+	/* Methods: */
+	void encode(const void* data,size_t dataSize,IO::File& sink); // Writes the given data to the given sink in encoded form
+	};
+
+class RelayDecoder:public RelayCodec
+	{
+	/* Methods: */
+	public:
+	void decode(IO::File& source,std::vector<Byte>& data); // Reads encoded data from the given source and appends the decoded data to the given buffer
+	};
+
+}
+
+#endif
@@ -0,0 +1,461 @@
+/***********************************************************************
+RelayLink - Class to multiplex any number of client connections over a
+single TCP connection between a relay and an upstream collaboration
+server.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/RelayLink.h>
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include <Misc/ThrowStdErr.h>
+#include <Comm/TCPPipe.h>
+#include <Collaboration/Protocol.h>
+
+namespace Collaboration {
+
+/**************************
+Methods of class RelayLink:
+**************************/
+
+void RelayLink::init(void)
+	{
+	/* Create the sending thread's wake-up pipe: */
+	if(pipe(wakeupPipe)!=0)
+		Misc::throwStdErr("RelayLink::RelayLink: Unable to create wake-up pipe");
+	fcntl(wakeupPipe[0],F_SETFL,O_NONBLOCK);
+	
+	/* Start the link's threads: */
+	receiveThread.start(this,&RelayLink::receiveThreadMethod);
+	sendThread.start(this,&RelayLink::sendThreadMethod);
+	}
+
+void RelayLink::wakeup(void)
+	{
+	char token=0;
+	if(write(wakeupPipe[1],&token,1)<0)
+		std::cerr<<"RelayLink: Unable to wake up sending thread"<<std::endl;
+	}
+
+void RelayLink::writeOutput(RelayLink::Channel* channel)
+	{
+	while(channel->hasOutput())
+		{
+		ssize_t written=send(channel->pipe->getFd(),&channel->output[channel->outputOffset],channel->output.size()-channel->outputOffset,MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(written>0)
+			{
+			/* Give the pipe more time for the rest: */
+			channel->outputOffset+=size_t(written);
+			channel->outputDeadline=Misc::Time::now();
+			channel->outputDeadline+=Misc::Time(sendTimeout);
+			}
+		else if(written<0&&(errno==EAGAIN||errno==EWOULDBLOCK))
+			return;
+		else if(written<0&&errno!=EINTR)
+			{
+			/* Let the sending thread close the channel: */
+			std::cerr<<"RelayLink: Closing channel "<<channel->channelId<<" due to error "<<strerror(errno)<<std::endl;
+			channel->failed=true;
+			return;
+			}
+		}
+	
+	/* Reset the output buffer: */
+	channel->output.clear();
+	channel->outputOffset=0;
+	}
+
+void* RelayLink::receiveThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	std::vector<RelayCodec::Byte> data;
+	try
+		{
+		while(true)
+			{
+			/* Read the next frame header: */
+			unsigned int channelId=linkPipe->read<Protocol::Card>();
+			int frameType=linkPipe->read<Protocol::Byte>();
+			
+			switch(frameType)
+				{
+				case OPEN_CHANNEL:
+					{
+					if(channelPortId<0)
+						Misc::throwStdErr("Peer opened a channel on the relay side");
+					
+					/* Connect the new channel to the collaboration server: */
+					Comm::NetPipePtr channelPipe;
+					try
+						{
+						channelPipe=new Comm::TCPPipe(channelHostName.c_str(),channelPortId);
+						}
+					catch(std::runtime_error err)
+						{
+						/* The sending thread will close the channel: */
+						std::cerr<<"RelayLink: Unable to connect channel due to exception "<<err.what()<<std::endl;
+						}
+					
+					/* Add the channel and let the sending thread watch it: */
+					{
+					Threads::Mutex::Lock channelLock(channelMutex);
+					channels.setEntry(ChannelMap::Entry(channelId,new Channel(channelId,channelPipe,true)));
+					}
+					wakeup();
+					
+					break;
+					}
+				
+				case CHANNEL_DATA:
+					{
+					/* Decode the channel data; must be done even for channels that were already closed, to keep the history windows synchronized: */
+					data.clear();
+					decoder.decode(*linkPipe,data);
+					
+					if(data.empty())
+						break;
+					
+					/* Append the data to the channel's output buffer without writing to the channel, so that a slow channel cannot stall the link: */
+					bool mustWakeup=false;
+					{
+					Threads::Mutex::Lock channelLock(channelMutex);
+					ChannelMap::Iterator cIt=channels.findEntry(channelId);
+					if(!cIt.isFinished()&&cIt->getDest()->pipe!=0&&!cIt->getDest()->closedByPeer&&!cIt->getDest()->failed)
+						{
+						Channel* channel=cIt->getDest();
+						if(!channel->hasOutput())
+							{
+							/* Start the channel's output from scratch, and let the sending thread watch for the pipe to accept it: */
+							channel->output.clear();
+							channel->outputOffset=0;
+							channel->outputDeadline=Misc::Time::now();
+							channel->outputDeadline+=Misc::Time(sendTimeout);
+							mustWakeup=true;
+							}
+						else if(channel->outputOffset>=channel->output.size()/2)
+							{
+							/* Discard the already written part of the output buffer: */
+							channel->output.erase(channel->output.begin(),channel->output.begin()+channel->outputOffset);
+							channel->outputOffset=0;
+							}
+						
+						if(channel->output.size()-channel->outputOffset+data.size()<=MAX_CHANNEL_BACKLOG)
+							channel->output.insert(channel->output.end(),data.begin(),data.end());
+						else
+							{
+							/* Let the sending thread close the channel: */
+							std::cerr<<"RelayLink: Closing channel "<<channelId<<" due to backlog of more than "<<MAX_CHANNEL_BACKLOG<<" bytes"<<std::endl;
+							channel->failed=true;
+							mustWakeup=true;
+							}
+						}
+					}
+					if(mustWakeup)
+						wakeup();
+					
+					break;
+					}
+				
+				case CLOSE_CHANNEL:
+					{
+					/* Mark the channel; the sending thread will write its remaining output and remove it without notifying the peer: */
+					{
+					Threads::Mutex::Lock channelLock(channelMutex);
+					ChannelMap::Iterator cIt=channels.findEntry(channelId);
+					if(!cIt.isFinished())
+						cIt->getDest()->closedByPeer=true;
+					}
+					wakeup();
+					
+					break;
+					}
+				
+				default:
+					Misc::throwStdErr("Invalid frame type %d",frameType);
+				}
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"RelayLink: Closing link due to exception "<<err.what()<<std::endl;
+		}
+	
+	/* Shut down the link and let the sending thread close all channels: */
+	finished=true;
+	linkPipe->shutdown(true,true);
+	wakeup();
+	
+	return 0;
+	}
+
+void* RelayLink::sendThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	std::vector<RelayCodec::Byte> buffer(65536);
+	std::vector<struct pollfd> pollFds;
+	std::vector<Channel*> pollChannels;
+	std::vector<Frame> frames;
+	try
+		{
+		while(!finished)
+			{
+			/* Announce new channels, close failed and finished channels, and find the earliest output deadline: */
+			pollFds.clear();
+			pollChannels.clear();
+			frames.clear();
+			int pollTimeout=-1;
+			{
+			Threads::Mutex::Lock channelLock(channelMutex);
+			Misc::Time now=Misc::Time::now();
+			std::vector<Channel*> closedChannels;
+			for(ChannelMap::Iterator cIt=channels.begin();!cIt.isFinished();++cIt)
+				{
+				Channel* channel=cIt->getDest();
+				
+				/* Fail channels whose pipes did not accept pending output for too long: */
+				if(channel->pipe!=0&&channel->hasOutput()&&sendTimeout>0.0)
+					{
+					Misc::Time remaining=channel->outputDeadline-now;
+					if(remaining.tv_sec<0)
+						{
+						std::cerr<<"RelayLink: Closing channel "<<channel->channelId<<" due to send timeout"<<std::endl;
+						channel->failed=true;
+						}
+					else
+						{
+						int remainingMs=int(remaining.tv_sec*1000+remaining.tv_nsec/1000000)+1;
+						if(pollTimeout<0||pollTimeout>remainingMs)
+							pollTimeout=remainingMs;
+						}
+					}
+				
+				if(channel->pipe==0||channel->failed)
+					{
+					/* Close the channel, and tell the peer unless the peer closed it: */
+					if(!channel->closedByPeer)
+						frames.push_back(Frame(channel->channelId,CLOSE_CHANNEL));
+					closedChannels.push_back(channel);
+					}
+				else if(channel->closedByPeer&&!channel->hasOutput())
+					{
+					/* Remove a channel closed by the peer once its output was written: */
+					channel->pipe->shutdown(true,true);
+					closedChannels.push_back(channel);
+					}
+				else
+					{
+					if(!channel->announced)
+						{
+						frames.push_back(Frame(channel->channelId,OPEN_CHANNEL));
+						channel->announced=true;
+						}
+					
+					/* Watch the channel for incoming data, and for room for pending output: */
+					struct pollfd pfd;
+					pfd.fd=channel->pipe->getFd();
+					pfd.events=POLLIN;
+					if(channel->hasOutput())
+						pfd.events|=POLLOUT;
+					pfd.revents=0;
+					pollFds.push_back(pfd);
+					pollChannels.push_back(channel);
+					}
+				}
+			for(std::vector<Channel*>::iterator ccIt=closedChannels.begin();ccIt!=closedChannels.end();++ccIt)
+				{
+				channels.removeEntry((*ccIt)->channelId);
+				delete *ccIt;
+				}
+			}
+			
+			/* Send the collected control frames after unlocking the channel map, so that the receiving thread never waits for the link: */
+			for(std::vector<Frame>::iterator fIt=frames.begin();fIt!=frames.end();++fIt)
+				{
+				linkPipe->write<Protocol::Card>(fIt->channelId);
+				linkPipe->write<Protocol::Byte>(fIt->frameType);
+				}
+			if(!frames.empty())
+				linkPipe->flush();
+			
+			/* Watch the wake-up pipe: */
+			struct pollfd pfd;
+			pfd.fd=wakeupPipe[0];
+			pfd.events=POLLIN;
+			pfd.revents=0;
+			pollFds.push_back(pfd);
+			
+			/* Wait for data on any channel, room on any channel with pending output, or the earliest output deadline: */
+			if(poll(&pollFds[0],pollFds.size(),pollTimeout)<0)
+				continue;
+			
+			/* Drain the wake-up pipe: */
+			if(pollFds.back().revents!=0)
+				{
+				char tokens[64];
+				while(read(wakeupPipe[0],tokens,sizeof(tokens))>0)
+					;
+				}
+			
+			/* Write pending output to all channels that have room: */
+			{
+			Threads::Mutex::Lock channelLock(channelMutex);
+			for(size_t i=0;i<pollChannels.size();++i)
+				if((pollFds[i].revents&(POLLOUT|POLLERR|POLLHUP))!=0&&!pollChannels[i]->failed)
+					writeOutput(pollChannels[i]);
+			}
+			
+			/* Forward data from all readable channels: */
+			bool mustFlush=false;
+			for(size_t i=0;i<pollChannels.size();++i)
+				if((pollFds[i].revents&(POLLIN|POLLERR|POLLHUP))!=0)
+					{
+					Channel* channel=pollChannels[i];
+					bool closed=false;
+					try
+						{
+						/* Read everything that is available without blocking: */
+						do
+							{
+							size_t dataSize=channel->pipe->readUpTo(&buffer[0],buffer.size());
+							if(dataSize==0)
+								{
+								closed=true;
+								break;
+								}
+							
+							/* Discard data from channels the peer already closed: */
+							if(!channel->closedByPeer)
+								{
+								linkPipe->write<Protocol::Card>(channel->channelId);
+								linkPipe->write<Protocol::Byte>(CHANNEL_DATA);
+								encoder.encode(&buffer[0],dataSize,*linkPipe);
+								mustFlush=true;
+								}
+							}
+						while(channel->pipe->canReadImmediately());
+						}
+					catch(std::runtime_error err)
+						{
+						closed=true;
+						}
+					
+					if(closed)
+						{
+						/* Remove the channel, and tell the peer unless the peer closed it: */
+						unsigned int channelId=channel->channelId;
+						bool notifyPeer;
+						{
+						Threads::Mutex::Lock channelLock(channelMutex);
+						notifyPeer=!channel->closedByPeer;
+						channels.removeEntry(channelId);
+						delete channel;
+						}
+						if(notifyPeer)
+							{
+							linkPipe->write<Protocol::Card>(channelId);
+							linkPipe->write<Protocol::Byte>(CLOSE_CHANNEL);
+							mustFlush=true;
+							}
+						}
+					}
+			if(mustFlush)
+				linkPipe->flush();
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"RelayLink: Closing link due to exception "<<err.what()<<std::endl;
+		finished=true;
+		linkPipe->shutdown(true,true);
+		}
+	
+	/* Close all channels: */
+	{
+	Threads::Mutex::Lock channelLock(channelMutex);
+	for(ChannelMap::Iterator cIt=channels.begin();!cIt.isFinished();++cIt)
+		delete cIt->getDest();
+	channels.clear();
+	}
+	
+	return 0;
+	}
+
+RelayLink::RelayLink(Comm::NetPipePtr sLinkPipe,double sSendTimeout)
+	:linkPipe(sLinkPipe),
+	 channelPortId(-1),
+	 sendTimeout(sSendTimeout),
+	 channels(17),
+	 nextChannelId(0),
+	 finished(false)
+	{
+	init();
+	}
+
+RelayLink::RelayLink(Comm::NetPipePtr sLinkPipe,const std::string& sChannelHostName,int sChannelPortId,double sSendTimeout)
+	:linkPipe(sLinkPipe),
+	 channelHostName(sChannelHostName),channelPortId(sChannelPortId),
+	 sendTimeout(sSendTimeout),
+	 channels(17),
+	 nextChannelId(0),
+	 finished(false)
+	{
+	init();
+	}
+
+RelayLink::~RelayLink(void)
+	{
+	/* Stop the link's threads: */
+	receiveThread.cancel();
+	receiveThread.join();
+	sendThread.cancel();
+	sendThread.join();
+	close(wakeupPipe[0]);
+	close(wakeupPipe[1]);
+	
+	/* Close all remaining channels: */
+	for(ChannelMap::Iterator cIt=channels.begin();!cIt.isFinished();++cIt)
+		delete cIt->getDest();
+	}
+
+void RelayLink::openChannel(Comm::NetPipePtr channelPipe)
+	{
+	/* Add a new channel and let the sending thread announce it to the peer: */
+	{
+	Threads::Mutex::Lock channelLock(channelMutex);
+	unsigned int channelId=nextChannelId++;
+	channels.setEntry(ChannelMap::Entry(channelId,new Channel(channelId,channelPipe,false)));
+	}
+	wakeup();
+	}
+
+}
@@ -0,0 +1,138 @@
+/***********************************************************************
+RelayLink - Class to multiplex any number of client connections over a
+single TCP connection between a relay and an upstream collaboration
+server.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_RELAYLINK_INCLUDED
+#define COLLABORATION_RELAYLINK_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <Misc/HashTable.h>
+#include <Misc/Time.h>
+#include <Threads/Thread.h>
+#include <Threads/Mutex.h>
+#include <Comm/NetPipe.h>
+#include <Collaboration/RelayCodec.h>
+
+namespace Collaboration {
+
+class RelayLink
+	{
+	/* Embedded classes: */
+	public:
+	enum FrameType // Enumerated type for frames sent over a relay link
+		{
+		OPEN_CHANNEL=0, // A new client connected to the relay
+		CHANNEL_DATA, // Encoded data for a client connection
+		CLOSE_CHANNEL // A client connection was closed on either side of the link
+		};
+	
+	enum
+		{
+		MAX_CHANNEL_BACKLOG=16*1024*1024 // Maximum amount of data in bytes received for a channel and not yet written to its pipe before the channel is closed
+		};
+	
+	private:
+	struct Channel // Structure for client connections multiplexed over the link
+		{
+		/* Elements: */
+		public:
+		unsigned int channelId; // Link-wide unique channel ID
+		Comm::NetPipePtr pipe; // Pipe to the client on the relay side, or to the collaboration server on the upstream side; 0 if the connection failed
+		bool announced; // Flag whether the peer was told about the channel
+		bool closedByPeer; // Flag whether the peer closed the channel
+		bool failed; // Flag whether writing to the channel's pipe failed, or its backlog grew too large or stalled for too long
+		std::vector<RelayCodec::Byte> output; // Data received for the channel from the peer; the part after the output offset was not yet written to the channel's pipe
+		size_t outputOffset; // Number of bytes at the beginning of the output buffer that were already written to the channel's pipe
+		Misc::Time outputDeadline; // Time at which the channel fails if its pipe did not accept any of the pending output
+		
+		/* Constructors and destructors: */
+		Channel(unsigned int sChannelId,Comm::NetPipePtr sPipe,bool sAnnounced)
+			:channelId(sChannelId),pipe(sPipe),announced(sAnnounced),closedByPeer(false),failed(false),
+			 outputOffset(0)
+			{
+			}
+		
+		/* Methods: */
+		bool hasOutput(void) const // Returns true if the channel has data that was not yet written to its pipe
+			{
+			return outputOffset<output.size();
+			}
+		};
+	
+	struct Frame // Structure for control frames collected while the channel map is locked, and sent after it is unlocked
+		{
+		/* Elements: */
+		public:
+		unsigned int channelId; // ID of the channel
+		FrameType frameType; // Type of the frame
+		
+		/* Constructors and destructors: */
+		Frame(unsigned int sChannelId,FrameType sFrameType)
+			:channelId(sChannelId),frameType(sFrameType)
+			{
+			}
+		};
+	
+	typedef Misc::HashTable<unsigned int,Channel*> ChannelMap; // Type for hash tables mapping channel IDs to channels
+	
+	/* Elements: */
+	Comm::NetPipePtr linkPipe; // Pipe connecting the relay and the upstream server
+	std::string channelHostName; // Host name of the collaboration server to which channels opened by the peer are connected
+	int channelPortId; // Port ID of the collaboration server to which channels opened by the peer are connected; -1 on the relay side
+	double sendTimeout; // Maximum time in seconds a channel's pipe may not accept any pending data before the channel is closed
+	Threads::Mutex channelMutex; // Mutex protecting the channel map and the channels' output buffers; never held while writing to the link
+	ChannelMap channels; // Map of currently open channels
+	unsigned int nextChannelId; // ID to assign to the next channel opened on this side of the link
+	int wakeupPipe[2]; // Self-pipe to wake up the sending thread when the set of channels changes
+	RelayEncoder encoder; // Encoder for data sent over the link; only accessed by the sending thread
+	RelayDecoder decoder; // Decoder for data received over the link; only accessed by the receiving thread
+	volatile bool finished; // Flag whether the link has failed or was closed
+	Threads::Thread receiveThread; // Thread receiving frames from the link and distributing them to channels
+	Threads::Thread sendThread; // Thread reading from all channels and sending frames over the link
+	
+	/* Private methods: */
+	void init(void); // Starts the link's threads
+	void wakeup(void); // Wakes up the sending thread
+	void writeOutput(Channel* channel); // Writes as much of a channel's pending output as its pipe accepts without blocking; must be called with the channel mutex locked
+	void* receiveThreadMethod(void);
+	void* sendThreadMethod(void);
+	
+	/* Constructors and destructors: */
+	public:
+	RelayLink(Comm::NetPipePtr sLinkPipe,double sSendTimeout); // Creates the relay side of a link, on which channels are opened locally
+	RelayLink(Comm::NetPipePtr sLinkPipe,const std::string& sChannelHostName,int sChannelPortId,double sSendTimeout); // Creates the upstream side of a link, connecting channels opened by the peer to the given server
+	~RelayLink(void); // Closes the link and all its channels
+	
+	/* Methods: */
+	bool isFinished(void) const // Returns true if the link has failed or was closed
+		{
+		return finished;
+		}
+	void openChannel(Comm::NetPipePtr channelPipe); // Opens a new channel for the given client connection on the relay side
+	};
+
+}
+
+#endif
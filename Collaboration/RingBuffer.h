@@ -0,0 +1,119 @@
+/***********************************************************************
+RingBuffer - Class template for first-in, first-out queues in a circular
+array that only allocates memory when it grows beyond its largest size.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_RINGBUFFER_INCLUDED
+#define COLLABORATION_RINGBUFFER_INCLUDED
+
+#include <stddef.h>
+#include <vector>
+
+namespace Collaboration {
+
+template <class ValueParam>
+class RingBuffer
+	{
+	/* Embedded classes: */
+	public:
+	typedef ValueParam Value; // Type of values stored in the queue
+	
+	/* Elements: */
+	private:
+	std::vector<Value> slots; // Circular array of slots, whose size is zero or a power of two
+	size_t head; // Index of the slot holding the front of the queue
+	size_t numValues; // Number of values currently in the queue
+	
+	/* Private methods: */
+	void grow(void) // Doubles the number of slots, moving the queue's values to the beginning of the new array
+		{
+		std::vector<Value> newSlots(slots.empty()?size_t(16):slots.size()*2);
+		for(size_t i=0;i<numValues;++i)
+			newSlots[i]=slots[(head+i)&(slots.size()-1)];
+		slots.swap(newSlots);
+		head=0;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	RingBuffer(void) // Creates an empty queue
+		:head(0),numValues(0)
+		{
+		}
+	
+	/* Methods: */
+	bool empty(void) const // Returns true if the queue is empty
+		{
+		return numValues==0;
+		}
+	size_t size(void) const // Returns the number of values in the queue
+		{
+		return numValues;
+		}
+	const Value& front(void) const // Returns the value at the front of the queue
+		{
+		return slots[head];
+		}
+	const Value& back(void) const // Returns the value at the end of the queue
+		{
+		return slots[(head+numValues-1)&(slots.size()-1)];
+		}
+	void push_back(const Value& value) // Appends a value to the end of the queue
+		{
+		if(numValues==slots.size())
+			grow();
+		slots[(head+numValues)&(slots.size()-1)]=value;
+		++numValues;
+		}
+	void pop_front(void) // Removes the value at the front of the queue
+		{
+		/* Reset the slot to release any resources held by the value: */
+		slots[head]=Value();
+		head=(head+1)&(slots.size()-1);
+		--numValues;
+		}
+	bool remove(const Value& value) // Removes the first occurrence of the given value from the queue, keeping the order of the remaining values; returns false if the value was not found
+		{
+		/* Find the value: */
+		size_t index;
+		for(index=0;index<numValues&&!(slots[(head+index)&(slots.size()-1)]==value);++index)
+			;
+		if(index==numValues)
+			return false;
+		
+		/* Close the gap by moving all following values forward: */
+		for(++index;index<numValues;++index)
+			slots[(head+index-1)&(slots.size()-1)]=slots[(head+index)&(slots.size()-1)];
+		slots[(head+numValues-1)&(slots.size()-1)]=Value();
+		--numValues;
+		return true;
+		}
+	void clear(void) // Removes all values from the queue without releasing its slots
+		{
+		while(numValues>0)
+			pop_front();
+		head=0;
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,134 @@
+/***********************************************************************
+ServerMetrics - Lock-free counters and histograms describing the
+operation of a collaboration server, and helpers to export them in
+Prometheus text format.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/ServerMetrics.h>
+
+#include <stddef.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <linux/tcp.h>
+#include <iostream>
+
+namespace Collaboration {
+
+/*************************************************
+Static elements of class ServerMetrics::Histogram:
+*************************************************/
+
+const double ServerMetrics::Histogram::bucketBounds[ServerMetrics::Histogram::NUM_BUCKETS]=
+	{
+	0.0001,0.00025,0.0005,0.001,0.0025,0.005,0.01,0.02,0.05,0.1,0.25,1.0
+	};
+
+/*****************************************
+Methods of class ServerMetrics::Histogram:
+*****************************************/
+
+void ServerMetrics::Histogram::observe(double duration)
+	{
+	/* Find the first bucket whose upper bound is not less than the observation: */
+	int bucket;
+	for(bucket=0;bucket<NUM_BUCKETS&&duration>bucketBounds[bucket];++bucket)
+		;
+	buckets[bucket].add(1);
+	sum.add(Misc::UInt64(duration>0.0?duration*1.0e9+0.5:0.0));
+	}
+
+void ServerMetrics::Histogram::write(std::ostream& os,const char* name,const char* help) const
+	{
+	writeHeader(os,name,"histogram",help);
+	
+	/* Write the cumulative bucket counts: */
+	Misc::UInt64 count=0;
+	for(int bucket=0;bucket<NUM_BUCKETS;++bucket)
+		{
+		count+=buckets[bucket].get();
+		os<<name<<"_bucket{le=\""<<bucketBounds[bucket]<<"\"} "<<count<<'\n';
+		}
+	count+=buckets[NUM_BUCKETS].get();
+	os<<name<<"_bucket{le=\"+Inf\"} "<<count<<'\n';
+	
+	/* Write the sum and count of all observations: */
+	os<<name<<"_sum "<<double(sum.get())*1.0e-9<<'\n';
+	os<<name<<"_count "<<count<<'\n';
+	}
+
+/**************************************
+Static elements of class ServerMetrics:
+**************************************/
+
+const char* ServerMetrics::messageNames[CollaborationProtocol::MESSAGES_END]=
+	{
+	"CONNECT_REQUEST","CONNECT_REPLY","CONNECT_REJECT","DISCONNECT_REQUEST","DISCONNECT_REPLY",
+	"CLIENT_UPDATE","CLIENT_CONNECT","CLIENT_DISCONNECT","SERVER_UPDATE"
+	};
+
+/******************************
+Methods of class ServerMetrics:
+******************************/
+
+double ServerMetrics::now(void)
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)*1.0e-9;
+	}
+
+std::string ServerMetrics::escapeLabel(const std::string& value)
+	{
+	std::string result;
+	for(std::string::const_iterator vIt=value.begin();vIt!=value.end();++vIt)
+		{
+		if(*vIt=='\\'||*vIt=='"')
+			result.push_back('\\');
+		if(*vIt=='\n')
+			result.append("\\n");
+		else
+			result.push_back(*vIt);
+		}
+	return result;
+	}
+
+void ServerMetrics::writeHeader(std::ostream& os,const char* name,const char* type,const char* help)
+	{
+	os<<"# HELP "<<name<<' '<<help<<'\n';
+	os<<"# TYPE "<<name<<' '<<type<<'\n';
+	}
+
+bool ServerMetrics::getSocketBytes(int socketFd,Misc::UInt64& receivedBytes,Misc::UInt64& sentBytes)
+	{
+	/* Query the socket's TCP state, which kernels before 4.1 return without byte counts: */
+	struct tcp_info info;
+	socklen_t infoLen=sizeof(struct tcp_info);
+	if(getsockopt(socketFd,IPPROTO_TCP,TCP_INFO,&info,&infoLen)!=0||infoLen<offsetof(struct tcp_info,tcpi_bytes_received)+sizeof(info.tcpi_bytes_received))
+		return false;
+	
+	receivedBytes=info.tcpi_bytes_received;
+	sentBytes=info.tcpi_bytes_acked;
+	return true;
+	}
+
+}
@@ -0,0 +1,102 @@
+/***********************************************************************
+ServerMetrics - Lock-free counters and histograms describing the
+operation of a collaboration server, and helpers to export them in
+Prometheus text format.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_SERVERMETRICS_INCLUDED
+#define COLLABORATION_SERVERMETRICS_INCLUDED
+
+#include <string>
+#include <iosfwd>
+#include <Misc/SizedTypes.h>
+#include <Collaboration/CollaborationProtocol.h>
+
+namespace Collaboration {
+
+class ServerMetrics
+	{
+	/* Embedded classes: */
+	public:
+	class Counter // Class for monotonically increasing counters that several threads can update without locking
+		{
+		/* Elements: */
+		private:
+		Misc::UInt64 value; // Current counter value
+		
+		/* Constructors and destructors: */
+		public:
+		Counter(void) // Creates a zero counter
+			:value(0)
+			{
+			}
+		
+		/* Methods: */
+		void add(Misc::UInt64 amount) // Atomically adds the given amount to the counter
+			{
+			__sync_fetch_and_add(&value,amount);
+			}
+		Misc::UInt64 get(void) const // Returns the current counter value
+			{
+			return __sync_fetch_and_add(const_cast<Misc::UInt64*>(&value),Misc::UInt64(0));
+			}
+		};
+	
+	class Histogram // Class for distributions of durations over fixed buckets that several threads can update without locking
+		{
+		/* Embedded classes: */
+		public:
+		enum
+			{
+			NUM_BUCKETS=12 // Number of buckets with finite upper bounds
+			};
+		
+		/* Elements: */
+		static const double bucketBounds[NUM_BUCKETS]; // Upper bounds of the buckets in seconds, in ascending order
+		private:
+		Counter buckets[NUM_BUCKETS+1]; // Numbers of observations in each bucket, and above the last bound
+		Counter sum; // Sum of all observations in nanoseconds
+		
+		/* Methods: */
+		public:
+		void observe(double duration); // Adds an observation in seconds
+		void write(std::ostream& os,const char* name,const char* help) const; // Writes the histogram's cumulative buckets, sum, and count in Prometheus text format
+		};
+	
+	/* Elements: */
+	static const char* messageNames[CollaborationProtocol::MESSAGES_END]; // Names of the base protocol's messages, used as metric labels
+	Counter clientConnects; // Number of clients that completed connecting
+	Counter clientRejects; // Number of rejected connection requests
+	Counter clientDisconnects; // Number of connected clients that disconnected, voluntarily or not
+	Counter receivedMessages[CollaborationProtocol::MESSAGES_END]; // Numbers of received base protocol messages by message ID
+	Histogram tickDuration; // Durations of complete server updates
+	Histogram sessionUpdateDuration; // Durations of encoding and queueing one session's updates for all its clients
+	
+	/* Methods: */
+	static double now(void); // Returns the current monotonic time in seconds
+	static std::string escapeLabel(const std::string& value); // Returns the given string escaped for use as a label value
+	static void writeHeader(std::ostream& os,const char* name,const char* type,const char* help); // Writes the help and type lines of a metric
+	static bool getSocketBytes(int socketFd,Misc::UInt64& receivedBytes,Misc::UInt64& sentBytes); // Queries the kernel's byte counts of the given TCP socket; returns false if the kernel does not provide them
+	};
+
+}
+
+#endif
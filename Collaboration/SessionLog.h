@@ -0,0 +1,86 @@
+/***********************************************************************
+SessionLog - Definitions for the file format of recorded inbound
+collaboration server traffic.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_SESSIONLOG_INCLUDED
+#define COLLABORATION_SESSIONLOG_INCLUDED
+
+#include <stddef.h>
+#include <Misc/SizedTypes.h>
+
+namespace Collaboration {
+
+class SessionLog
+	{
+	/* Embedded classes: */
+	public:
+	enum Constants // Enumerated type for file format constants
+		{
+		ENDIANNESS_MARKER=0x01020304U, // Marker to detect files written in a different endianness
+		VERSION=1, // Version number of the file format
+		ALIGNMENT=8 // Alignment of all records in bytes
+		};
+	
+	enum RecordType // Enumerated type for log records
+		{
+		END=0, // Marks the end of the log; unused space at the end of a log file that was not closed reads as an end record
+		OPEN_STREAM, // A client connected to the server; payload is the client's address
+		CLIENT_ID, // The server assigned a client ID to a stream; payload is the ID as a 32-bit unsigned integer
+		DATA, // The server received raw data on a stream; payload is the data
+		MESSAGE, // The server started reading a message from a stream; payload is the message ID as a 32-bit unsigned integer, followed by the name of the protocol owning the message
+		CLOSE_STREAM // The server closed a stream; no payload
+		};
+	
+	struct FileHeader // Structure at the beginning of log files
+		{
+		/* Elements: */
+		public:
+		char magic[8]; // File magic, always "VRCOLLOG"
+		Misc::UInt32 endiannessMarker; // Always ENDIANNESS_MARKER in the writer's byte order
+		Misc::UInt32 version; // File format version number
+		};
+	
+	struct RecordHeader // Structure preceding each record's payload
+		{
+		/* Elements: */
+		public:
+		Misc::UInt64 time; // Time at which the record was written in nanoseconds since recording started
+		Misc::UInt32 streamId; // ID of the stream to which the record belongs
+		Misc::UInt32 type; // Type of the record
+		Misc::UInt32 size; // Size of the record's payload in bytes, not including padding
+		Misc::UInt32 padding; // Unused; keeps the payload aligned
+		};
+	
+	/* Methods: */
+	static const char* getMagic(void) // Returns the file magic
+		{
+		return "VRCOLLOG";
+		}
+	static size_t getPaddedSize(size_t size) // Returns the given payload size rounded up to the record alignment
+		{
+		return (size+ALIGNMENT-1)&~size_t(ALIGNMENT-1);
+		}
+	};
+
+}
+
+#endif
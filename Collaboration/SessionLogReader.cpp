@@ -0,0 +1,111 @@
+/***********************************************************************
+SessionLogReader - Class to read logs of inbound collaboration server
+traffic written by SessionRecorder.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/SessionLogReader.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <Misc/ThrowStdErr.h>
+
+namespace Collaboration {
+
+/*********************************
+Methods of class SessionLogReader:
+*********************************/
+
+SessionLogReader::SessionLogReader(const std::string& fileName)
+	:mappedSize(0),log(0),
+	 readPos(SessionLog::getPaddedSize(sizeof(SessionLog::FileHeader)))
+	{
+	/* Map the log file: */
+	int fd=open(fileName.c_str(),O_RDONLY);
+	if(fd<0)
+		Misc::throwStdErr("SessionLogReader::SessionLogReader: Unable to open log file %s",fileName.c_str());
+	struct stat fileStats;
+	if(fstat(fd,&fileStats)!=0||size_t(fileStats.st_size)<sizeof(SessionLog::FileHeader))
+		{
+		close(fd);
+		Misc::throwStdErr("SessionLogReader::SessionLogReader: %s is not a session log",fileName.c_str());
+		}
+	mappedSize=fileStats.st_size;
+	void* newLog=mmap(0,mappedSize,PROT_READ,MAP_SHARED,fd,0);
+	close(fd);
+	if(newLog==MAP_FAILED)
+		Misc::throwStdErr("SessionLogReader::SessionLogReader: Unable to map log file %s",fileName.c_str());
+	log=static_cast<const Misc::UInt8*>(newLog);
+	
+	/* Check the file header: */
+	SessionLog::FileHeader header;
+	memcpy(&header,log,sizeof(SessionLog::FileHeader));
+	if(memcmp(header.magic,SessionLog::getMagic(),sizeof(header.magic))!=0)
+		{
+		munmap(const_cast<Misc::UInt8*>(log),mappedSize);
+		Misc::throwStdErr("SessionLogReader::SessionLogReader: %s is not a session log",fileName.c_str());
+		}
+	if(header.endiannessMarker!=SessionLog::ENDIANNESS_MARKER||header.version!=SessionLog::VERSION)
+		{
+		munmap(const_cast<Misc::UInt8*>(log),mappedSize);
+		Misc::throwStdErr("SessionLogReader::SessionLogReader: Session log %s was written in an unsupported byte order or format version",fileName.c_str());
+		}
+	}
+
+SessionLogReader::~SessionLogReader(void)
+	{
+	munmap(const_cast<Misc::UInt8*>(log),mappedSize);
+	}
+
+bool SessionLogReader::readRecord(SessionLogReader::Record& record)
+	{
+	/* Check for the end of the log, explicit or implicit: */
+	if(readPos+sizeof(SessionLog::RecordHeader)>mappedSize)
+		return false;
+	SessionLog::RecordHeader header;
+	memcpy(&header,log+readPos,sizeof(SessionLog::RecordHeader));
+	if(header.type==SessionLog::END)
+		return false;
+	
+	/* Check for truncated records: */
+	size_t payloadPos=readPos+sizeof(SessionLog::RecordHeader);
+	if(header.type>SessionLog::CLOSE_STREAM||payloadPos+header.size>mappedSize)
+		Misc::throwStdErr("SessionLogReader::readRecord: Corrupted record at offset %u",(unsigned int)readPos);
+	
+	/* Return the record: */
+	record.time=double(header.time)*1.0e-9;
+	record.streamId=header.streamId;
+	record.type=SessionLog::RecordType(header.type);
+	record.payload=log+payloadPos;
+	record.payloadSize=header.size;
+	readPos=payloadPos+SessionLog::getPaddedSize(header.size);
+	
+	return true;
+	}
+
+void SessionLogReader::rewind(void)
+	{
+	readPos=SessionLog::getPaddedSize(sizeof(SessionLog::FileHeader));
+	}
+
+}
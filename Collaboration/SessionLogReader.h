@@ -0,0 +1,71 @@
+/***********************************************************************
+SessionLogReader - Class to read logs of inbound collaboration server
+traffic written by SessionRecorder.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_SESSIONLOGREADER_INCLUDED
+#define COLLABORATION_SESSIONLOGREADER_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <Misc/SizedTypes.h>
+#include <Collaboration/SessionLog.h>
+
+namespace Collaboration {
+
+class SessionLogReader
+	{
+	/* Embedded classes: */
+	public:
+	struct Record // Structure describing a log record
+		{
+		/* Elements: */
+		public:
+		double time; // Time at which the record was written in seconds since recording started
+		unsigned int streamId; // ID of the stream to which the record belongs
+		SessionLog::RecordType type; // Type of the record
+		const Misc::UInt8* payload; // Pointer to the record's payload inside the log's memory mapping
+		size_t payloadSize; // Size of the record's payload in bytes
+		};
+	
+	/* Elements: */
+	private:
+	size_t mappedSize; // Size of the log file's memory mapping
+	const Misc::UInt8* log; // Memory mapping of the log file
+	size_t readPos; // Position of the next record in the log
+	
+	/* Constructors and destructors: */
+	public:
+	SessionLogReader(const std::string& fileName); // Opens the log file of the given name
+	private:
+	SessionLogReader(const SessionLogReader& source); // Prohibit copy constructor
+	SessionLogReader& operator=(const SessionLogReader& source); // Prohibit assignment operator
+	public:
+	~SessionLogReader(void);
+	
+	/* Methods: */
+	bool readRecord(Record& record); // Reads the next record; returns false at the end of the log
+	void rewind(void); // Restarts reading at the first record
+	};
+
+}
+
+#endif
@@ -0,0 +1,190 @@
+/***********************************************************************
+SessionRecorder - Class to record all inbound traffic of a collaboration
+server into an append-only memory-mapped log file.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/SessionRecorder.h>
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <iostream>
+#include <Misc/ThrowStdErr.h>
+#include <Collaboration/ServerMetrics.h>
+
+namespace Collaboration {
+
+/**************************************
+Methods of class SessionRecorder::Pipe:
+**************************************/
+
+size_t SessionRecorder::Pipe::readData(IO::File::Byte* buffer,size_t bufferSize)
+	{
+	/* Read from the socket and record what was read: */
+	size_t readSize=Comm::TCPPipe::readData(buffer,bufferSize);
+	if(readSize>0)
+		recorder.recordData(streamId,buffer,readSize);
+	return readSize;
+	}
+
+SessionRecorder::Pipe::Pipe(SessionRecorder& sRecorder,Comm::ListeningTCPSocket& listenSocket)
+	:Comm::TCPPipe(listenSocket),
+	 recorder(sRecorder),streamId(recorder.openStream(getPeerAddress()))
+	{
+	}
+
+SessionRecorder::Pipe::~Pipe(void)
+	{
+	recorder.closeStream(streamId);
+	}
+
+/********************************
+Methods of class SessionRecorder:
+********************************/
+
+void SessionRecorder::writeRecord(unsigned int streamId,SessionLog::RecordType type,const void* payload1,size_t payload1Size,const void* payload2,size_t payload2Size)
+	{
+	SessionLog::RecordHeader header;
+	header.streamId=streamId;
+	header.type=type;
+	header.size=Misc::UInt32(payload1Size+payload2Size);
+	header.padding=0;
+	size_t recordSize=sizeof(SessionLog::RecordHeader)+SessionLog::getPaddedSize(header.size);
+	
+	Threads::Mutex::Lock logLock(logMutex);
+	
+	if(log==0)
+		return;
+	
+	/* Take the time stamp while holding the lock, so that records appear in time order: */
+	header.time=Misc::UInt64((ServerMetrics::now()-startTime)*1.0e9);
+	
+	/* Extend the log file if the record does not fit: */
+	if(logSize+recordSize+sizeof(SessionLog::RecordHeader)>mappedSize)
+		{
+		size_t newMappedSize=mappedSize;
+		while(logSize+recordSize+sizeof(SessionLog::RecordHeader)>newMappedSize)
+			newMappedSize+=growSize;
+		munmap(log,mappedSize);
+		void* newLog=MAP_FAILED;
+		if(ftruncate(fd,newMappedSize)==0)
+			newLog=mmap(0,newMappedSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+		if(newLog==MAP_FAILED)
+			{
+			/* Stop recording, but keep the server running: */
+			log=0;
+			return;
+			}
+		log=static_cast<Misc::UInt8*>(newLog);
+		mappedSize=newMappedSize;
+		}
+	
+	/* Append the record; the zero-filled space after it marks the end of the log: */
+	Misc::UInt8* recordPtr=log+logSize;
+	memcpy(recordPtr,&header,sizeof(SessionLog::RecordHeader));
+	recordPtr+=sizeof(SessionLog::RecordHeader);
+	if(payload1Size>0)
+		memcpy(recordPtr,payload1,payload1Size);
+	if(payload2Size>0)
+		memcpy(recordPtr+payload1Size,payload2,payload2Size);
+	logSize+=recordSize;
+	}
+
+SessionRecorder::SessionRecorder(const std::string& fileName,size_t sGrowSize)
+	:fd(open(fileName.c_str(),O_RDWR|O_CREAT|O_TRUNC,0644)),
+	 growSize(SessionLog::getPaddedSize(sGrowSize>0?sGrowSize:1)),
+	 mappedSize(0),log(0),logSize(0),
+	 startTime(ServerMetrics::now()),
+	 nextStreamId(0)
+	{
+	if(fd<0)
+		Misc::throwStdErr("SessionRecorder::SessionRecorder: Unable to create log file %s",fileName.c_str());
+	
+	/* Create the initial memory mapping: */
+	void* newLog=MAP_FAILED;
+	if(ftruncate(fd,growSize)==0)
+		newLog=mmap(0,growSize,PROT_READ|PROT_WRITE,MAP_SHARED,fd,0);
+	if(newLog==MAP_FAILED)
+		{
+		close(fd);
+		Misc::throwStdErr("SessionRecorder::SessionRecorder: Unable to map log file %s",fileName.c_str());
+		}
+	log=static_cast<Misc::UInt8*>(newLog);
+	mappedSize=growSize;
+	
+	/* Write the file header: */
+	SessionLog::FileHeader header;
+	memcpy(header.magic,SessionLog::getMagic(),sizeof(header.magic));
+	header.endiannessMarker=SessionLog::ENDIANNESS_MARKER;
+	header.version=SessionLog::VERSION;
+	memcpy(log,&header,sizeof(SessionLog::FileHeader));
+	logSize=SessionLog::getPaddedSize(sizeof(SessionLog::FileHeader));
+	}
+
+SessionRecorder::~SessionRecorder(void)
+	{
+	/* Unmap the log, and cut off the unused space: */
+	if(log!=0)
+		{
+		msync(log,logSize,MS_SYNC);
+		munmap(log,mappedSize);
+		if(ftruncate(fd,logSize)!=0)
+			std::cerr<<"SessionRecorder: Unable to truncate log file; the unused space at its end will be ignored"<<std::endl;
+		}
+	close(fd);
+	}
+
+unsigned int SessionRecorder::openStream(const std::string& address)
+	{
+	unsigned int streamId;
+	{
+	Threads::Mutex::Lock logLock(logMutex);
+	streamId=nextStreamId;
+	++nextStreamId;
+	}
+	writeRecord(streamId,SessionLog::OPEN_STREAM,address.data(),address.size());
+	return streamId;
+	}
+
+void SessionRecorder::recordClientId(unsigned int streamId,unsigned int clientId)
+	{
+	Misc::UInt32 id=clientId;
+	writeRecord(streamId,SessionLog::CLIENT_ID,&id,sizeof(Misc::UInt32));
+	}
+
+void SessionRecorder::recordData(unsigned int streamId,const void* data,size_t dataSize)
+	{
+	writeRecord(streamId,SessionLog::DATA,data,dataSize);
+	}
+
+void SessionRecorder::recordMessage(unsigned int streamId,unsigned int messageId,const char* protocolName)
+	{
+	Misc::UInt32 id=messageId;
+	writeRecord(streamId,SessionLog::MESSAGE,&id,sizeof(Misc::UInt32),protocolName,strlen(protocolName));
+	}
+
+void SessionRecorder::closeStream(unsigned int streamId)
+	{
+	writeRecord(streamId,SessionLog::CLOSE_STREAM,0,0);
+	}
+
+}
@@ -0,0 +1,101 @@
+/***********************************************************************
+SessionRecorder - Class to record all inbound traffic of a collaboration
+server into an append-only memory-mapped log file.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_SESSIONRECORDER_INCLUDED
+#define COLLABORATION_SESSIONRECORDER_INCLUDED
+
+#include <stddef.h>
+#include <string>
+#include <Misc/SizedTypes.h>
+#include <Threads/Mutex.h>
+#include <Comm/TCPPipe.h>
+#include <Collaboration/SessionLog.h>
+
+/* Forward declarations: */
+namespace Comm {
+class ListeningTCPSocket;
+}
+
+namespace Collaboration {
+
+class SessionRecorder
+	{
+	/* Embedded classes: */
+	public:
+	class Pipe:public Comm::TCPPipe // Class for TCP pipes that record all data read from them
+		{
+		/* Elements: */
+		private:
+		SessionRecorder& recorder; // Recorder receiving the pipe's data
+		unsigned int streamId; // ID of the pipe's stream in the log
+		
+		/* Protected methods from IO::File: */
+		protected:
+		virtual size_t readData(IO::File::Byte* buffer,size_t bufferSize);
+		
+		/* Constructors and destructors: */
+		public:
+		Pipe(SessionRecorder& sRecorder,Comm::ListeningTCPSocket& listenSocket); // Accepts the next incoming connection on the given listening socket and opens a stream for it
+		virtual ~Pipe(void); // Closes the pipe's stream
+		
+		/* Methods: */
+		unsigned int getStreamId(void) const // Returns the ID of the pipe's stream in the log
+			{
+			return streamId;
+			}
+		};
+	
+	/* Elements: */
+	private:
+	Threads::Mutex logMutex; // Mutex serializing appends to the log
+	int fd; // File descriptor of the log file
+	size_t growSize; // Amount by which the log file is extended when it runs out of space
+	size_t mappedSize; // Size of the log file and its memory mapping
+	Misc::UInt8* log; // Memory mapping of the log file
+	size_t logSize; // Number of bytes written to the log
+	double startTime; // Monotonic time at which recording started
+	unsigned int nextStreamId; // ID to assign to the next opened stream
+	
+	/* Private methods: */
+	void writeRecord(unsigned int streamId,SessionLog::RecordType type,const void* payload1,size_t payload1Size,const void* payload2 =0,size_t payload2Size =0); // Appends a record with a payload concatenated from two parts
+	
+	/* Constructors and destructors: */
+	public:
+	SessionRecorder(const std::string& fileName,size_t sGrowSize =64*1024*1024); // Creates a new log file of the given name
+	private:
+	SessionRecorder(const SessionRecorder& source); // Prohibit copy constructor
+	SessionRecorder& operator=(const SessionRecorder& source); // Prohibit assignment operator
+	public:
+	~SessionRecorder(void); // Closes the log file, and truncates it to its used size
+	
+	/* Methods: */
+	unsigned int openStream(const std::string& address); // Opens a new stream for a client connecting from the given address; returns the stream's ID
+	void recordClientId(unsigned int streamId,unsigned int clientId); // Records the client ID the server assigned to the given stream
+	void recordData(unsigned int streamId,const void* data,size_t dataSize); // Records data received on the given stream
+	void recordMessage(unsigned int streamId,unsigned int messageId,const char* protocolName); // Records the ID and owning protocol of a message about to be read from the given stream
+	void closeStream(unsigned int streamId); // Closes the given stream
+	};
+
+}
+
+#endif
@@ -0,0 +1,138 @@
+/***********************************************************************
+SlotTable - Class template to map densely allocated identification
+numbers to objects, with generation counters to detect stale numbers.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_SLOTTABLE_INCLUDED
+#define COLLABORATION_SLOTTABLE_INCLUDED
+
+#include <vector>
+#include <stdexcept>
+
+namespace Collaboration {
+
+template <class ValueParam>
+class SlotTable
+	{
+	/* Embedded classes: */
+	public:
+	typedef ValueParam Value; // Type of objects stored in the table
+	
+	enum
+		{
+		INDEX_BITS=16, // Number of low-order bits of an identification number holding its slot index
+		MAX_SLOTS=(1U<<INDEX_BITS)-1U // Maximum number of simultaneously allocated slots
+		};
+	
+	private:
+	struct Slot // Structure for table slots
+		{
+		/* Elements: */
+		public:
+		unsigned int generation; // Generation counter of the slot, incremented whenever the slot is released
+		Value* value; // Pointer to the object stored in the slot, or 0 if the slot is free
+		unsigned int nextFree; // Index of the next slot in the free list if the slot is free
+		};
+	
+	/* Elements: */
+	std::vector<Slot> slots; // Densely packed array of slots
+	unsigned int firstFree; // Index of the first slot in the free list, or MAX_SLOTS if the free list is empty
+	size_t numEntries; // Number of currently allocated slots
+	
+	/* Private methods: */
+	static unsigned int getIndex(unsigned int id) // Returns the slot index encoded in an identification number
+		{
+		return id&((1U<<INDEX_BITS)-1U);
+		}
+	static unsigned int getGeneration(unsigned int id) // Returns the generation encoded in an identification number
+		{
+		return id>>INDEX_BITS;
+		}
+	
+	/* Constructors and destructors: */
+	public:
+	SlotTable(void)
+		:firstFree(MAX_SLOTS),numEntries(0)
+		{
+		}
+	
+	/* Methods: */
+	size_t getNumEntries(void) const // Returns the number of currently allocated slots
+		{
+		return numEntries;
+		}
+	unsigned int insert(Value* value) // Stores the given object in a free slot and returns its identification number, which is never zero
+		{
+		unsigned int index;
+		if(firstFree!=MAX_SLOTS)
+			{
+			/* Reuse the first slot from the free list: */
+			index=firstFree;
+			firstFree=slots[index].nextFree;
+			}
+		else
+			{
+			/* Append a new slot: */
+			if(slots.size()>=size_t(MAX_SLOTS))
+				throw std::runtime_error("SlotTable::insert: Table is full");
+			index=(unsigned int)(slots.size());
+			Slot newSlot;
+			newSlot.generation=1U;
+			newSlot.nextFree=MAX_SLOTS;
+			slots.push_back(newSlot);
+			}
+		slots[index].value=value;
+		++numEntries;
+		
+		return (slots[index].generation<<INDEX_BITS)|index;
+		}
+	Value* find(unsigned int id) const // Returns the object of the given identification number, or 0 if the number is stale or invalid
+		{
+		unsigned int index=getIndex(id);
+		if(index>=slots.size()||slots[index].generation!=getGeneration(id))
+			return 0;
+		return slots[index].value;
+		}
+	bool remove(unsigned int id) // Releases the slot of the given identification number; returns false if the number is stale or invalid
+		{
+		unsigned int index=getIndex(id);
+		if(index>=slots.size()||slots[index].generation!=getGeneration(id)||slots[index].value==0)
+			return false;
+		
+		/* Advance the slot's generation to invalidate all outstanding copies of the number, skipping generation zero to keep numbers non-zero: */
+		Slot& slot=slots[index];
+		slot.generation=(slot.generation+1U)&((1U<<(32-INDEX_BITS))-1U);
+		if(slot.generation==0U)
+			slot.generation=1U;
+		
+		/* Put the slot into the free list: */
+		slot.value=0;
+		slot.nextFree=firstFree;
+		firstFree=index;
+		--numEntries;
+		
+		return true;
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,278 @@
+/***********************************************************************
+StateDeltaCodec - Class to encode client state updates as differences
+against the state a destination already received, sending only changed
+components with their unchanged high-order bytes stripped.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/StateDeltaCodec.h>
+
+#include <string.h>
+#include <Misc/SizedTypes.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/StringMarshaller.h>
+#include <IO/File.h>
+
+namespace Collaboration {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+inline Misc::UInt32 getBits(Protocol::Scalar value) // Returns the bit pattern of a scalar
+	{
+	Misc::UInt32 result;
+	memcpy(&result,&value,sizeof(Misc::UInt32));
+	return result;
+	}
+
+inline Protocol::Scalar getScalar(Misc::UInt32 bits) // Returns the scalar with the given bit pattern
+	{
+	Protocol::Scalar result;
+	memcpy(&result,&bits,sizeof(Misc::UInt32));
+	return result;
+	}
+
+inline unsigned int getNumBytes(Misc::UInt32 bits) // Returns the number of low-order bytes needed to represent the given bit pattern
+	{
+	unsigned int result=0;
+	for(;bits!=0;bits>>=8)
+		++result;
+	return result;
+	}
+
+}
+
+/******************************************
+Methods of class StateDeltaCodec::Baseline:
+******************************************/
+
+StateDeltaCodec::Baseline::Baseline(void)
+	{
+	for(int i=0;i<NUM_ENVIRONMENT_SCALARS;++i)
+		environment[i]=Scalar(0);
+	for(int i=0;i<NUM_NAVTRANSFORM_SCALARS;++i)
+		navTransform[i]=Scalar(0);
+	}
+
+/********************************
+Methods of class StateDeltaCodec:
+********************************/
+
+void StateDeltaCodec::writeScalars(unsigned int numScalars,const Scalar* scalars,Scalar* baseline,IO::File& sink)
+	{
+	/* Write the scalars in pairs, each with a header byte holding the numbers of bytes that differ from the baseline: */
+	for(unsigned int i=0;i<numScalars;i+=2)
+		{
+		/* XOR the scalars' bit patterns with their baselines, so that bytes that did not change become zero: */
+		Misc::UInt32 deltas[2]={0,0};
+		unsigned int numBytes[2]={0,0};
+		unsigned int pairSize=numScalars-i>=2?2:1;
+		for(unsigned int j=0;j<pairSize;++j)
+			{
+			deltas[j]=getBits(scalars[i+j])^getBits(baseline[i+j]);
+			numBytes[j]=getNumBytes(deltas[j]);
+			baseline[i+j]=scalars[i+j];
+			}
+		
+		/* Write the header byte and the significant low-order bytes of both differences: */
+		sink.write<Byte>(Byte(numBytes[0]|(numBytes[1]<<4)));
+		for(unsigned int j=0;j<pairSize;++j)
+			for(unsigned int k=0;k<numBytes[j];++k,deltas[j]>>=8)
+				sink.write<Byte>(Byte(deltas[j]&0xffU));
+		}
+	}
+
+void StateDeltaCodec::readScalars(unsigned int numScalars,Scalar* baseline,IO::File& source)
+	{
+	for(unsigned int i=0;i<numScalars;i+=2)
+		{
+		/* Read the header byte: */
+		unsigned int header=source.read<Byte>();
+		unsigned int numBytes[2]={header&0x0fU,header>>4};
+		unsigned int pairSize=numScalars-i>=2?2:1;
+		if(numBytes[0]>4||numBytes[1]>4||(pairSize<2&&numBytes[1]!=0))
+			Misc::throwStdErr("StateDeltaCodec::readScalars: Invalid header byte %u",header);
+		
+		/* Read the differences and apply them to the baseline: */
+		for(unsigned int j=0;j<pairSize;++j)
+			{
+			Misc::UInt32 delta=0;
+			for(unsigned int k=0;k<numBytes[j];++k)
+				delta|=Misc::UInt32(source.read<Byte>())<<(k*8);
+			baseline[i+j]=getScalar(getBits(baseline[i+j])^delta);
+			}
+		}
+	}
+
+void StateDeltaCodec::writeClientState(unsigned int updateMask,const StateDeltaCodec::ClientState& clientState,StateDeltaCodec::Baseline& baseline,IO::File& sink)
+	{
+	/* Send the number of viewers and all viewer states if the baseline has a different number of viewers: */
+	if(baseline.viewers.size()!=clientState.numViewers*NUM_VIEWER_SCALARS)
+		updateMask|=ClientState::NUM_VIEWERS;
+	if(updateMask&ClientState::NUM_VIEWERS)
+		updateMask|=ClientState::VIEWER;
+	
+	/* Write the update mask: */
+	sink.write<Byte>(updateMask);
+	
+	if(updateMask&ClientState::ENVIRONMENT)
+		{
+		/* Flatten the client's physical environment definition: */
+		Scalar environment[NUM_ENVIRONMENT_SCALARS];
+		Scalar* ePtr=environment;
+		*(ePtr++)=clientState.inchFactor;
+		for(int i=0;i<3;++i)
+			*(ePtr++)=clientState.displayCenter[i];
+		*(ePtr++)=clientState.displaySize;
+		for(int i=0;i<3;++i)
+			*(ePtr++)=clientState.forward[i];
+		for(int i=0;i<3;++i)
+			*(ePtr++)=clientState.up[i];
+		for(int i=0;i<3;++i)
+			*(ePtr++)=clientState.floorPlane.getNormal()[i];
+		*(ePtr++)=clientState.floorPlane.getOffset();
+		
+		/* Write the environment definition: */
+		writeScalars(NUM_ENVIRONMENT_SCALARS,environment,baseline.environment,sink);
+		}
+	
+	if(updateMask&ClientState::CLIENTNAME)
+		{
+		/* Write the client's display name: */
+		write(clientState.clientName,sink);
+		}
+	
+	if(updateMask&ClientState::NUM_VIEWERS)
+		{
+		/* Write the new number of viewers and reset the viewer baseline: */
+		sink.write<Card>(clientState.numViewers);
+		baseline.viewers.assign(clientState.numViewers*NUM_VIEWER_SCALARS,Scalar(0));
+		}
+	
+	if(updateMask&ClientState::VIEWER)
+		{
+		/* Flatten and write the client's viewer states two at a time, so that scalars are paired exactly as in one flattened array: */
+		Scalar viewers[2*NUM_VIEWER_SCALARS];
+		for(unsigned int firstViewer=0;firstViewer<clientState.numViewers;firstViewer+=2)
+			{
+			unsigned int numChunkViewers=clientState.numViewers-firstViewer>=2?2:1;
+			Scalar* vPtr=viewers;
+			for(unsigned int viewerIndex=firstViewer;viewerIndex<firstViewer+numChunkViewers;++viewerIndex)
+				{
+				const ONTransform& vs=clientState.viewerStates[viewerIndex];
+				for(int i=0;i<3;++i)
+					*(vPtr++)=vs.getTranslation()[i];
+				for(int i=0;i<4;++i)
+					*(vPtr++)=vs.getRotation().getQuaternion()[i];
+				}
+			writeScalars(numChunkViewers*NUM_VIEWER_SCALARS,viewers,&baseline.viewers[firstViewer*NUM_VIEWER_SCALARS],sink);
+			}
+		}
+	
+	if(updateMask&ClientState::NAVTRANSFORM)
+		{
+		/* Flatten the navigation transformation: */
+		Scalar navTransform[NUM_NAVTRANSFORM_SCALARS];
+		for(int i=0;i<3;++i)
+			navTransform[i]=clientState.navTransform.getTranslation()[i];
+		for(int i=0;i<4;++i)
+			navTransform[3+i]=clientState.navTransform.getRotation().getQuaternion()[i];
+		navTransform[7]=clientState.navTransform.getScaling();
+		
+		/* Write the navigation transformation: */
+		writeScalars(NUM_NAVTRANSFORM_SCALARS,navTransform,baseline.navTransform,sink);
+		}
+	}
+
+void StateDeltaCodec::readClientState(StateDeltaCodec::ClientState& clientState,StateDeltaCodec::Baseline& baseline,IO::File& source)
+	{
+	/* Read this update's update mask: */
+	unsigned int newUpdateMask=source.read<Byte>();
+	
+	if(newUpdateMask&ClientState::ENVIRONMENT)
+		{
+		/* Read the client's physical environment definition: */
+		readScalars(NUM_ENVIRONMENT_SCALARS,baseline.environment,source);
+		
+		/* Unflatten the environment definition: */
+		const Scalar* ePtr=baseline.environment;
+		clientState.inchFactor=*(ePtr++);
+		for(int i=0;i<3;++i)
+			clientState.displayCenter[i]=*(ePtr++);
+		clientState.displaySize=*(ePtr++);
+		for(int i=0;i<3;++i)
+			clientState.forward[i]=*(ePtr++);
+		for(int i=0;i<3;++i)
+			clientState.up[i]=*(ePtr++);
+		Vector floorNormal;
+		for(int i=0;i<3;++i)
+			floorNormal[i]=*(ePtr++);
+		clientState.floorPlane=Plane(floorNormal,*ePtr);
+		}
+	
+	if(newUpdateMask&ClientState::CLIENTNAME)
+		{
+		/* Read the client's display name: */
+		read(clientState.clientName,source);
+		}
+	
+	if(newUpdateMask&ClientState::NUM_VIEWERS)
+		{
+		/* Read the new number of viewers, resize the state array, and reset the viewer baseline: */
+		unsigned int newNumViewers=source.read<Card>();
+		clientState.resize(newNumViewers);
+		baseline.viewers.assign(newNumViewers*NUM_VIEWER_SCALARS,Scalar(0));
+		}
+	
+	if(newUpdateMask&ClientState::VIEWER)
+		{
+		if(baseline.viewers.size()!=clientState.numViewers*NUM_VIEWER_SCALARS)
+			Misc::throwStdErr("StateDeltaCodec::readClientState: Viewer update without baseline");
+		
+		if(!baseline.viewers.empty())
+			{
+			/* Read the client's viewer states: */
+			readScalars(baseline.viewers.size(),&baseline.viewers[0],source);
+			
+			/* Unflatten the viewer states: */
+			const Scalar* vPtr=&baseline.viewers[0];
+			for(unsigned int viewerIndex=0;viewerIndex<clientState.numViewers;++viewerIndex,vPtr+=NUM_VIEWER_SCALARS)
+				clientState.viewerStates[viewerIndex]=ONTransform(Vector(vPtr[0],vPtr[1],vPtr[2]),Rotation(vPtr+3));
+			}
+		}
+	
+	if(newUpdateMask&ClientState::NAVTRANSFORM)
+		{
+		/* Read the navigation transformation: */
+		readScalars(NUM_NAVTRANSFORM_SCALARS,baseline.navTransform,source);
+		
+		/* Unflatten the navigation transformation: */
+		const Scalar* nPtr=baseline.navTransform;
+		clientState.navTransform=OGTransform(Vector(nPtr[0],nPtr[1],nPtr[2]),Rotation(nPtr+3),nPtr[7]);
+		}
+	
+	/* Update the client state's update mask: */
+	clientState.updateMask|=newUpdateMask;
+	}
+
+}
@@ -0,0 +1,79 @@
+/***********************************************************************
+StateDeltaCodec - Class to encode client state updates as differences
+against the state a destination already received, sending only changed
+components with their unchanged high-order bytes stripped.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_STATEDELTACODEC_INCLUDED
+#define COLLABORATION_STATEDELTACODEC_INCLUDED
+
+#include <vector>
+#include <Collaboration/CollaborationProtocol.h>
+
+/* Forward declarations: */
+namespace IO {
+class File;
+}
+
+namespace Collaboration {
+
+class StateDeltaCodec:private CollaborationProtocol
+	{
+	/* Embedded classes: */
+	public:
+	enum
+		{
+		NUM_ENVIRONMENT_SCALARS=15, // Number of scalar components of a client's physical environment
+		NUM_VIEWER_SCALARS=7, // Number of scalar components of a viewer state
+		NUM_NAVTRANSFORM_SCALARS=8 // Number of scalar components of a navigation transformation
+		};
+	
+	class Baseline // Class for the most recent client state received by a destination, flattened into scalar components
+		{
+		friend class StateDeltaCodec;
+		
+		/* Elements: */
+		private:
+		Scalar environment[NUM_ENVIRONMENT_SCALARS]; // Physical environment definition
+		std::vector<Scalar> viewers; // States of all viewers
+		Scalar navTransform[NUM_NAVTRANSFORM_SCALARS]; // Navigation transformation
+		
+		/* Constructors and destructors: */
+		public:
+		Baseline(void); // Creates an all-zero baseline with no viewers
+		};
+	
+	typedef CollaborationProtocol::ClientState ClientState;
+	
+	/* Private methods: */
+	private:
+	static void writeScalars(unsigned int numScalars,const Scalar* scalars,Scalar* baseline,IO::File& sink); // Writes an array of scalars as differences against the baseline and updates the baseline
+	static void readScalars(unsigned int numScalars,Scalar* baseline,IO::File& source); // Reads an array of scalars as differences against the baseline into the baseline
+	
+	/* Methods: */
+	public:
+	static void writeClientState(unsigned int updateMask,const ClientState& clientState,Baseline& baseline,IO::File& sink); // Writes a client state update using the given update mask as differences against the baseline, and updates the baseline
+	static void readClientState(ClientState& clientState,Baseline& baseline,IO::File& source); // Reads a client state update written as differences against the baseline, and updates the baseline
+	};
+
+}
+
+#endif
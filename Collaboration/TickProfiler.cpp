@@ -0,0 +1,293 @@
+/***********************************************************************
+TickProfiler - Flight recorder keeping per-phase and per-plug-in timings
+of a collaboration server's most recent updates, and dumping them as
+Chrome trace files.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/TickProfiler.h>
+
+#include <pthread.h>
+#include <unistd.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <Misc/ThrowStdErr.h>
+
+namespace Collaboration {
+
+namespace {
+
+/****************
+Helper functions:
+****************/
+
+void writeJsonString(std::ostream& os,const char* string) // Writes a string as a JSON string literal
+	{
+	os<<'"';
+	for(const char* sPtr=string;*sPtr!='\0';++sPtr)
+		{
+		if(*sPtr=='"'||*sPtr=='\\')
+			os<<'\\';
+		os<<*sPtr;
+		}
+	os<<'"';
+	}
+
+const char* hookNames[TickProfiler::NUM_HOOKS]= // Names of per-client hooks used as event names
+	{
+	"connectClient","disconnectClient","beforeServerUpdate","sendClientConnect","sendServerUpdate","afterServerUpdate"
+	};
+
+}
+
+/*****************************************
+Methods of class TickProfiler::HookTotals:
+*****************************************/
+
+TickProfiler::HookTotals::HookTotals(void)
+	{
+	for(int hook=0;hook<NUM_HOOKS;++hook)
+		{
+		reportedNanoseconds[hook]=0;
+		reportedCalls[hook]=0;
+		}
+	}
+
+/*****************************
+Methods of class TickProfiler:
+*****************************/
+
+unsigned long TickProfiler::getThreadId(void)
+	{
+	return (unsigned long)(pthread_self());
+	}
+
+TickProfiler::TickProfiler(unsigned int sNumTicks,unsigned int sMaxEvents,double sDumpThreshold,const std::string& sDumpFileNamePrefix)
+	:numTicks(sNumTicks>0?sNumTicks:1),maxEvents(sMaxEvents),
+	 ticks(new Tick[numTicks]),events(new Event[numTicks*maxEvents]),
+	 currentTick(0),tickCounter(0),
+	 dumpThreshold(sDumpThreshold),dumpFileNamePrefix(sDumpFileNamePrefix),
+	 numDumps(0),nextAutoDumpTick(0)
+	{
+	/* Initialize the ring: */
+	for(unsigned int i=0;i<numTicks;++i)
+		{
+		ticks[i].index=0;
+		ticks[i].threadId=0;
+		ticks[i].start=0.0;
+		ticks[i].duration=-1.0;
+		ticks[i].numEvents=0;
+		ticks[i].events=events+i*maxEvents;
+		}
+	for(unsigned int i=0;i<numTicks*maxEvents;++i)
+		events[i].name=0;
+	}
+
+TickProfiler::~TickProfiler(void)
+	{
+	delete[] ticks;
+	delete[] events;
+	}
+
+void TickProfiler::startTick(void)
+	{
+	/* Clear the oldest tick in the ring: */
+	unsigned int nextTick=(currentTick+1)%numTicks;
+	Tick& tick=ticks[nextTick];
+	unsigned int numEvents=tick.numEvents<maxEvents?tick.numEvents:maxEvents;
+	for(unsigned int i=0;i<numEvents;++i)
+		tick.events[i].name=0;
+	tick.numEvents=0;
+	tick.index=tickCounter;
+	++tickCounter;
+	tick.threadId=getThreadId();
+	tick.duration=-1.0;
+	tick.start=ServerMetrics::now();
+	
+	/* Direct all new events to the cleared tick: */
+	__sync_synchronize();
+	currentTick=nextTick;
+	}
+
+void TickProfiler::record(const char* name,const char* category,double start,double end)
+	{
+	/* Claim the next event slot in the current tick: */
+	Tick& tick=ticks[currentTick];
+	unsigned int eventIndex=__sync_fetch_and_add(&tick.numEvents,1U);
+	if(eventIndex>=maxEvents)
+		{
+		numDroppedEvents.add(1);
+		return;
+		}
+	
+	/* Fill in the event, and publish it by setting its name: */
+	Event& event=tick.events[eventIndex];
+	event.category=category;
+	event.threadId=getThreadId();
+	event.start=start;
+	event.duration=end-start;
+	event.numCalls=0;
+	__sync_synchronize();
+	event.name=name;
+	}
+
+void TickProfiler::recordHooks(unsigned int lane,const char* category,TickProfiler::HookTotals& totals)
+	{
+	/* Lay out the hooks' accumulated times back-to-back from the start of the tick: */
+	Tick& tick=ticks[currentTick];
+	double start=tick.start;
+	for(int hook=0;hook<NUM_HOOKS;++hook)
+		{
+		Misc::UInt64 nanoseconds=totals.nanoseconds[hook].get();
+		Misc::UInt64 calls=totals.calls[hook].get();
+		if(calls==totals.reportedCalls[hook])
+			continue;
+		
+		double duration=double(nanoseconds-totals.reportedNanoseconds[hook])*1.0e-9;
+		unsigned int eventIndex=__sync_fetch_and_add(&tick.numEvents,1U);
+		if(eventIndex<maxEvents)
+			{
+			Event& event=tick.events[eventIndex];
+			event.category=category;
+			event.threadId=lane;
+			event.start=start;
+			event.duration=duration;
+			event.numCalls=(unsigned int)(calls-totals.reportedCalls[hook]);
+			__sync_synchronize();
+			event.name=hookNames[hook];
+			}
+		else
+			numDroppedEvents.add(1);
+		start+=duration;
+		
+		totals.reportedNanoseconds[hook]=nanoseconds;
+		totals.reportedCalls[hook]=calls;
+		}
+	}
+
+void TickProfiler::finishTick(void)
+	{
+	Tick& tick=ticks[currentTick];
+	tick.duration=ServerMetrics::now()-tick.start;
+	
+	/* Dump the ring if the tick ran long, but not again until the ring holds a fresh set of ticks: */
+	if(dumpThreshold>0.0&&tick.duration>dumpThreshold&&tick.index>=nextAutoDumpTick)
+		{
+		try
+			{
+			std::string fileName=dump();
+			std::cerr<<"TickProfiler: Tick "<<tick.index<<" took "<<tick.duration*1000.0<<" ms; wrote profile to "<<fileName<<std::endl;
+			}
+		catch(std::runtime_error err)
+			{
+			std::cerr<<"TickProfiler: Unable to dump profile due to exception "<<err.what()<<std::endl;
+			}
+		nextAutoDumpTick=tick.index+numTicks;
+		}
+	}
+
+void TickProfiler::write(std::ostream& os) const
+	{
+	/* Find the oldest recorded tick to use as the time origin: */
+	unsigned int oldest=(currentTick+1)%numTicks;
+	while(ticks[oldest].duration<0.0&&oldest!=currentTick)
+		oldest=(oldest+1)%numTicks;
+	double origin=ticks[oldest].start;
+	
+	std::ios::fmtflags oldFlags=os.flags();
+	std::streamsize oldPrecision=os.precision(3);
+	os.setf(std::ios::fixed,std::ios::floatfield);
+	os<<"{\"traceEvents\":[\n";
+	bool first=true;
+	std::map<unsigned long,const char*> laneNames;
+	for(unsigned int i=0;i<numTicks;++i)
+		{
+		const Tick& tick=ticks[(oldest+i)%numTicks];
+		if(tick.duration<0.0)
+			continue;
+		
+		/* Write the tick itself: */
+		if(!first)
+			os<<",\n";
+		first=false;
+		os<<"{\"name\":\"tick\",\"cat\":\"tick\",\"ph\":\"X\",\"pid\":"<<getpid()<<",\"tid\":"<<tick.threadId;
+		os<<",\"ts\":"<<(tick.start-origin)*1.0e6<<",\"dur\":"<<tick.duration*1.0e6;
+		os<<",\"args\":{\"tick\":"<<tick.index<<"}}";
+		
+		/* Write the tick's completely recorded events: */
+		unsigned int numEvents=tick.numEvents<maxEvents?tick.numEvents:maxEvents;
+		for(unsigned int eventIndex=0;eventIndex<numEvents;++eventIndex)
+			{
+			const Event& event=tick.events[eventIndex];
+			const char* name=event.name;
+			if(name==0)
+				continue;
+			os<<",\n{\"name\":";
+			writeJsonString(os,name);
+			os<<",\"cat\":";
+			writeJsonString(os,event.category);
+			os<<",\"ph\":\"X\",\"pid\":"<<getpid()<<",\"tid\":"<<event.threadId;
+			os<<",\"ts\":"<<(event.start-origin)*1.0e6<<",\"dur\":"<<event.duration*1.0e6;
+			if(event.numCalls>0)
+				{
+				os<<",\"args\":{\"calls\":"<<event.numCalls<<"}";
+				laneNames[event.threadId]=event.category;
+				}
+			os<<"}";
+			}
+		}
+	
+	/* Name the lanes holding accumulated hook times after their protocol plug-ins: */
+	for(std::map<unsigned long,const char*>::iterator lnIt=laneNames.begin();lnIt!=laneNames.end();++lnIt)
+		{
+		if(!first)
+			os<<",\n";
+		first=false;
+		os<<"{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":"<<getpid()<<",\"tid\":"<<lnIt->first<<",\"args\":{\"name\":";
+		writeJsonString(os,lnIt->second);
+		os<<"}}";
+		}
+	
+	os<<"\n],\"displayTimeUnit\":\"ms\",\"otherData\":{\"droppedEvents\":\""<<numDroppedEvents.get()<<"\"}}\n";
+	os.flags(oldFlags);
+	os.precision(oldPrecision);
+	}
+
+std::string TickProfiler::dump(void)
+	{
+	/* Create a new dump file: */
+	std::ostringstream fileName;
+	fileName<<dumpFileNamePrefix<<'-'<<getpid()<<'-'<<numDumps<<".json";
+	++numDumps;
+	std::ofstream file(fileName.str().c_str());
+	if(!file)
+		Misc::throwStdErr("TickProfiler::dump: Unable to create dump file %s",fileName.str().c_str());
+	
+	/* Write the ring: */
+	write(file);
+	if(!file)
+		Misc::throwStdErr("TickProfiler::dump: Unable to write dump file %s",fileName.str().c_str());
+	
+	return fileName.str();
+	}
+
+}
@@ -0,0 +1,203 @@
+/***********************************************************************
+TickProfiler - Flight recorder keeping per-phase and per-plug-in timings
+of a collaboration server's most recent updates, and dumping them as
+Chrome trace files.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_TICKPROFILER_INCLUDED
+#define COLLABORATION_TICKPROFILER_INCLUDED
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <Misc/SizedTypes.h>
+#include <Collaboration/ServerMetrics.h>
+
+namespace Collaboration {
+
+class TickProfiler
+	{
+	/* Embedded classes: */
+	public:
+	enum Hook // Enumerated type for per-client protocol plug-in hooks whose times are accumulated over a tick
+		{
+		CONNECT_CLIENT,DISCONNECT_CLIENT,BEFORE_SERVER_UPDATE,SEND_CLIENT_CONNECT,SEND_SERVER_UPDATE,AFTER_SERVER_UPDATE,
+		NUM_HOOKS
+		};
+	
+	class HookTotals // Class accumulating the times a protocol plug-in spent in per-client hooks
+		{
+		friend class TickProfiler;
+		
+		/* Elements: */
+		private:
+		ServerMetrics::Counter nanoseconds[NUM_HOOKS]; // Total time spent in each hook in nanoseconds
+		ServerMetrics::Counter calls[NUM_HOOKS]; // Total number of calls to each hook
+		Misc::UInt64 reportedNanoseconds[NUM_HOOKS]; // Total times at the end of the previous tick
+		Misc::UInt64 reportedCalls[NUM_HOOKS]; // Total numbers of calls at the end of the previous tick
+		
+		/* Constructors and destructors: */
+		public:
+		HookTotals(void);
+		
+		/* Methods: */
+		void add(Hook hook,double duration) // Adds one call of the given duration in seconds to the given hook
+			{
+			nanoseconds[hook].add(Misc::UInt64(duration*1.0e9));
+			calls[hook].add(1);
+			}
+		};
+	
+	class Scope // Class to record the time between its creation and destruction as an event
+		{
+		/* Elements: */
+		private:
+		TickProfiler* profiler; // Profiler recording the event, or 0 if profiling is disabled
+		const char* name; // Name of the event
+		const char* category; // Category of the event
+		double start; // Time at which the scope was entered
+		
+		/* Constructors and destructors: */
+		public:
+		Scope(TickProfiler* sProfiler,const char* sName,const char* sCategory)
+			:profiler(sProfiler),name(sName),category(sCategory),
+			 start(profiler!=0?ServerMetrics::now():0.0)
+			{
+			}
+		~Scope(void)
+			{
+			if(profiler!=0)
+				profiler->record(name,category,start,ServerMetrics::now());
+			}
+		};
+	
+	class PhaseTimer // Class to record a sequence of back-to-back phases as events
+		{
+		/* Elements: */
+		private:
+		TickProfiler* profiler; // Profiler recording the events, or 0 if profiling is disabled
+		const char* category; // Category of the events
+		double phaseStart; // Time at which the current phase started
+		
+		/* Constructors and destructors: */
+		public:
+		PhaseTimer(TickProfiler* sProfiler,const char* sCategory) // Starts the first phase
+			:profiler(sProfiler),category(sCategory),
+			 phaseStart(profiler!=0?ServerMetrics::now():0.0)
+			{
+			}
+		
+		/* Methods: */
+		void endPhase(const char* phaseName) // Records the current phase under the given name and starts the next one
+			{
+			if(profiler!=0)
+				{
+				double now=ServerMetrics::now();
+				profiler->record(phaseName,category,phaseStart,now);
+				phaseStart=now;
+				}
+			}
+		};
+	
+	class HookTimer // Class to add the time between its creation and destruction to a protocol plug-in's hook totals
+		{
+		/* Elements: */
+		private:
+		HookTotals* totals; // Totals receiving the time, or 0 if profiling is disabled
+		Hook hook; // Hook being timed
+		double start; // Time at which the hook was called
+		
+		/* Constructors and destructors: */
+		public:
+		HookTimer(TickProfiler* profiler,HookTotals& sTotals,Hook sHook)
+			:totals(profiler!=0?&sTotals:0),hook(sHook),
+			 start(profiler!=0?ServerMetrics::now():0.0)
+			{
+			}
+		~HookTimer(void)
+			{
+			if(totals!=0)
+				totals->add(hook,ServerMetrics::now()-start);
+			}
+		};
+	
+	private:
+	struct Event // Structure for recorded events
+		{
+		/* Elements: */
+		public:
+		const char* volatile name; // Name of the event; set last, so that events still being recorded have a null name
+		const char* category; // Category of the event
+		unsigned long threadId; // ID of the thread that recorded the event, or lane index for accumulated hook times
+		double start; // Start time of the event
+		double duration; // Duration of the event in seconds
+		unsigned int numCalls; // Number of hook calls accumulated into the event, or 0 for regular events
+		};
+	
+	struct Tick // Structure for recorded ticks
+		{
+		/* Elements: */
+		public:
+		unsigned int index; // Running index of the tick
+		unsigned long threadId; // ID of the thread that ran the tick
+		double start; // Start time of the tick
+		double duration; // Duration of the tick in seconds, or a negative value if the tick is still running
+		unsigned int numEvents; // Number of event slots claimed during the tick; can exceed the number of slots
+		Event* events; // Array of event slots
+		};
+	
+	/* Elements: */
+	unsigned int numTicks; // Number of ticks kept in the ring
+	unsigned int maxEvents; // Number of event slots per tick
+	Tick* ticks; // Ring of recently recorded ticks
+	Event* events; // Array of event slots for all ticks
+	volatile unsigned int currentTick; // Index of the ring slot receiving events
+	unsigned int tickCounter; // Running index of the next tick
+	ServerMetrics::Counter numDroppedEvents; // Number of events dropped because their tick ran out of slots
+	double dumpThreshold; // Tick duration in seconds above which the ring is dumped automatically; 0 disables automatic dumps
+	std::string dumpFileNamePrefix; // Prefix for names of dump files
+	unsigned int numDumps; // Number of dump files written so far
+	unsigned int nextAutoDumpTick; // Running index of the first tick that can trigger an automatic dump
+	
+	/* Private methods: */
+	static unsigned long getThreadId(void); // Returns an ID for the calling thread
+	
+	/* Constructors and destructors: */
+	public:
+	TickProfiler(unsigned int sNumTicks,unsigned int sMaxEvents,double sDumpThreshold,const std::string& sDumpFileNamePrefix); // Creates a profiler keeping the given number of ticks with the given number of events each
+	private:
+	TickProfiler(const TickProfiler& source); // Prohibit copy constructor
+	TickProfiler& operator=(const TickProfiler& source); // Prohibit assignment operator
+	public:
+	~TickProfiler(void);
+	
+	/* Methods: */
+	void startTick(void); // Starts recording a new tick, overwriting the oldest tick in the ring
+	void record(const char* name,const char* category,double start,double end); // Records an event into the current tick; can be called from any thread
+	void recordHooks(unsigned int lane,const char* category,HookTotals& totals); // Records the hook times accumulated since the previous tick as events in the given lane; must be called from the thread running ticks
+	void finishTick(void); // Finishes the current tick, and dumps the ring if the tick exceeded the dump threshold
+	void write(std::ostream& os) const; // Writes all recorded ticks in Chrome trace format
+	std::string dump(void); // Writes all recorded ticks to a new dump file and returns its name
+	};
+
+}
+
+#endif
@@ -0,0 +1,188 @@
+/***********************************************************************
+TickScheduler - Class to run a server loop at a fixed tick interval
+based on a monotonic clock, with tick jitter and overrun accounting.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/TickScheduler.h>
+
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/timerfd.h>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/ThrowStdErr.h>
+
+namespace Collaboration {
+
+/******************************************
+Methods of class TickScheduler::Statistics:
+******************************************/
+
+void TickScheduler::Statistics::reset(void)
+	{
+	numTicks=0;
+	numOverruns=0;
+	numSkippedTicks=0;
+	latenessSum=0.0;
+	latenessMax=0.0;
+	durationSum=0.0;
+	durationMax=0.0;
+	}
+
+void TickScheduler::Statistics::print(std::ostream& os) const
+	{
+	os<<numTicks<<" ticks";
+	if(numTicks>0)
+		{
+		os<<", lateness mean "<<latenessSum*1000.0/double(numTicks)<<" ms max "<<latenessMax*1000.0<<" ms";
+		os<<", duration mean "<<durationSum*1000.0/double(numTicks)<<" ms max "<<durationMax*1000.0<<" ms";
+		}
+	os<<", "<<numOverruns<<" overruns, "<<numSkippedTicks<<" skipped ticks";
+	}
+
+/******************************
+Methods of class TickScheduler:
+******************************/
+
+double TickScheduler::now(void)
+	{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC,&ts);
+	return double(ts.tv_sec)+double(ts.tv_nsec)/1.0e9;
+	}
+
+void TickScheduler::armTimer(void)
+	{
+	/* Set the timer to expire once at the absolute due time of the next tick: */
+	struct itimerspec timerSpec;
+	timerSpec.it_interval.tv_sec=0;
+	timerSpec.it_interval.tv_nsec=0;
+	timerSpec.it_value.tv_sec=time_t(nextTick);
+	timerSpec.it_value.tv_nsec=long((nextTick-double(timerSpec.it_value.tv_sec))*1.0e9);
+	if(timerSpec.it_value.tv_sec==0&&timerSpec.it_value.tv_nsec==0)
+		timerSpec.it_value.tv_nsec=1; // A zero expiration time would disarm the timer
+	if(timerfd_settime(timerFd,TFD_TIMER_ABSTIME,&timerSpec,0)!=0)
+		Misc::throwStdErr("TickScheduler: Unable to arm tick timer");
+	}
+
+TickScheduler::TickScheduler(double sTickTime,TickScheduler::OverrunPolicy sOverrunPolicy)
+	:tickTime(sTickTime),overrunPolicy(sOverrunPolicy),
+	 timerFd(timerfd_create(CLOCK_MONOTONIC,0)),
+	 nextTick(0.0),tickStart(0.0)
+	{
+	if(tickTime<=0.0)
+		{
+		if(timerFd>=0)
+			close(timerFd);
+		Misc::throwStdErr("TickScheduler::TickScheduler: Invalid tick interval %f",tickTime);
+		}
+	if(timerFd<0)
+		Misc::throwStdErr("TickScheduler::TickScheduler: Unable to create tick timer");
+	
+	/* Schedule the first tick: */
+	restart();
+	}
+
+TickScheduler::~TickScheduler(void)
+	{
+	close(timerFd);
+	}
+
+void TickScheduler::restart(void)
+	{
+	nextTick=now()+tickTime;
+	armTimer();
+	}
+
+bool TickScheduler::waitForTick(void)
+	{
+	/* Wait for the timer to expire: */
+	Misc::UInt64 numExpirations;
+	if(read(timerFd,&numExpirations,sizeof(Misc::UInt64))!=sizeof(Misc::UInt64))
+		{
+		if(errno==EINTR)
+			return false;
+		Misc::throwStdErr("TickScheduler::waitForTick: Unable to wait for tick timer");
+		}
+	
+	/* Start the tick and record how late it started: */
+	tickStart=now();
+	double lateness=tickStart-nextTick;
+	if(lateness<0.0)
+		lateness=0.0;
+	statistics.latenessSum+=lateness;
+	if(statistics.latenessMax<lateness)
+		statistics.latenessMax=lateness;
+	
+	return true;
+	}
+
+void TickScheduler::finishTick(void)
+	{
+	/* Record the tick's duration: */
+	double tickEnd=now();
+	double duration=tickEnd-tickStart;
+	++statistics.numTicks;
+	statistics.durationSum+=duration;
+	if(statistics.durationMax<duration)
+		statistics.durationMax=duration;
+	
+	/* Schedule the next tick: */
+	nextTick+=tickTime;
+	if(nextTick<=tickEnd)
+		{
+		/* The tick overran the next tick's due time: */
+		++statistics.numOverruns;
+		if(overrunPolicy==SKIP)
+			{
+			/* Skip all ticks that are already overdue: */
+			unsigned int numSkipped=(unsigned int)((tickEnd-nextTick)/tickTime)+1U;
+			nextTick+=double(numSkipped)*tickTime;
+			statistics.numSkippedTicks+=numSkipped;
+			}
+		}
+	armTimer();
+	}
+
+bool TickScheduler::waitForEvent(int fd)
+	{
+	/* Wait for the file descriptor without a timeout: */
+	struct pollfd pfd;
+	pfd.fd=fd;
+	pfd.events=POLLIN;
+	pfd.revents=0;
+	int result=poll(&pfd,1,-1);
+	if(result<0)
+		{
+		if(errno==EINTR)
+			return false;
+		Misc::throwStdErr("TickScheduler::waitForEvent: Unable to wait for event");
+		}
+	
+	/* Restart the schedule; any ticks missed while waiting are not counted as overruns: */
+	restart();
+	
+	return true;
+	}
+
+}
@@ -0,0 +1,105 @@
+/***********************************************************************
+TickScheduler - Class to run a server loop at a fixed tick interval
+based on a monotonic clock, with tick jitter and overrun accounting.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_TICKSCHEDULER_INCLUDED
+#define COLLABORATION_TICKSCHEDULER_INCLUDED
+
+#include <iosfwd>
+
+namespace Collaboration {
+
+class TickScheduler
+	{
+	/* Embedded classes: */
+	public:
+	enum OverrunPolicy // Enumerated type for ways to treat ticks that are missed because a tick ran too long
+		{
+		SKIP, // Drop missed ticks and continue with the next tick that lies in the future
+		CATCH_UP // Run missed ticks back-to-back until the schedule is met again
+		};
+	
+	struct Statistics // Structure to accumulate tick timing statistics
+		{
+		/* Elements: */
+		public:
+		unsigned int numTicks; // Number of ticks run
+		unsigned int numOverruns; // Number of ticks that ended after the next tick was due
+		unsigned int numSkippedTicks; // Number of ticks dropped under the SKIP policy
+		double latenessSum,latenessMax; // Sum and maximum of the delays between ticks' due times and their actual start times in seconds
+		double durationSum,durationMax; // Sum and maximum of the times between ticks' start and end in seconds
+		
+		/* Constructors and destructors: */
+		Statistics(void) // Creates empty statistics
+			{
+			reset();
+			}
+		
+		/* Methods: */
+		void reset(void); // Resets the statistics
+		void print(std::ostream& os) const; // Prints a one-line summary of the statistics
+		};
+	
+	/* Elements: */
+	private:
+	double tickTime; // Tick interval in seconds
+	OverrunPolicy overrunPolicy; // Treatment of missed ticks
+	int timerFd; // File descriptor of the timer signalling due ticks
+	double nextTick; // Monotonic time at which the next tick is due
+	double tickStart; // Monotonic time at which the current tick started
+	Statistics statistics; // Statistics accumulated since the last reset
+	
+	/* Private methods: */
+	static double now(void); // Returns the current monotonic time in seconds
+	void armTimer(void); // Arms the timer to expire at the due time of the next tick
+	
+	/* Constructors and destructors: */
+	public:
+	TickScheduler(double sTickTime,OverrunPolicy sOverrunPolicy); // Creates a scheduler with the given tick interval and overrun policy; the first tick is due one interval from now
+	~TickScheduler(void);
+	
+	/* Methods: */
+	double getTickTime(void) const // Returns the tick interval in seconds
+		{
+		return tickTime;
+		}
+	OverrunPolicy getOverrunPolicy(void) const // Returns the overrun policy
+		{
+		return overrunPolicy;
+		}
+	void restart(void); // Restarts the schedule with the next tick due one interval from now
+	bool waitForTick(void); // Blocks until the next tick is due and starts it; returns false if the wait was interrupted by a signal
+	void finishTick(void); // Ends the current tick and schedules the next one according to the overrun policy
+	bool waitForEvent(int fd); // Suspends ticking until the given file descriptor becomes readable, then restarts the schedule; returns false if the wait was interrupted by a signal
+	const Statistics& getStatistics(void) const // Returns the statistics accumulated since the last reset
+		{
+		return statistics;
+		}
+	void resetStatistics(void) // Resets the accumulated statistics
+		{
+		statistics.reset();
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,96 @@
+/***********************************************************************
+TypedProtocolClient - Class template for protocol clients with a single
+remote client state type, to dispatch hooks with statically typed remote
+client states instead of casting them in each hook.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_TYPEDPROTOCOLCLIENT_INCLUDED
+#define COLLABORATION_TYPEDPROTOCOLCLIENT_INCLUDED
+
+#include <Collaboration/ProtocolClient.h>
+
+namespace Collaboration {
+
+template <class RemoteClientStateParam>
+class TypedProtocolClient:public ProtocolClient
+	{
+	/* Embedded classes: */
+	public:
+	typedef RemoteClientStateParam TypedRemoteClientState; // Type of remote client states created by the protocol; must be derived from ProtocolClient::RemoteClientState
+	
+	/*********************************************************************
+	Methods from ProtocolClient, to adapt the generic hooks called by the
+	collaboration client to the typed hooks below. The client only passes
+	remote client states to the protocol that created them in
+	receiveClientConnect, so their type is fixed when the client registers
+	the remote client, and the adapters can cast them without checking:
+	*********************************************************************/
+	
+	virtual bool receiveServerUpdate(ProtocolClient::RemoteClientState* rcs,Comm::NetPipe& pipe)
+		{
+		return receiveServerUpdate(static_cast<TypedRemoteClientState*>(rcs),pipe);
+		}
+	virtual void connectClient(ProtocolClient::RemoteClientState* rcs)
+		{
+		connectClient(static_cast<TypedRemoteClientState*>(rcs));
+		}
+	virtual void disconnectClient(ProtocolClient::RemoteClientState* rcs)
+		{
+		disconnectClient(static_cast<TypedRemoteClientState*>(rcs));
+		}
+	virtual void frame(ProtocolClient::RemoteClientState* rcs)
+		{
+		frame(static_cast<TypedRemoteClientState*>(rcs));
+		}
+	virtual void glRenderAction(const ProtocolClient::RemoteClientState* rcs,GLContextData& contextData) const
+		{
+		glRenderAction(static_cast<const TypedRemoteClientState*>(rcs),contextData);
+		}
+	virtual void alRenderAction(const ProtocolClient::RemoteClientState* rcs,ALContextData& contextData) const
+		{
+		alRenderAction(static_cast<const TypedRemoteClientState*>(rcs),contextData);
+		}
+	
+	/* New methods: */
+	virtual bool receiveServerUpdate(TypedRemoteClientState* rcs,Comm::NetPipe& pipe) // Typed version of receiveServerUpdate
+		{
+		return false;
+		}
+	virtual void connectClient(TypedRemoteClientState* rcs) // Typed version of connectClient
+		{
+		}
+	virtual void disconnectClient(TypedRemoteClientState* rcs) // Typed version of disconnectClient
+		{
+		}
+	virtual void frame(TypedRemoteClientState* rcs) // Typed version of frame
+		{
+		}
+	virtual void glRenderAction(const TypedRemoteClientState* rcs,GLContextData& contextData) const // Typed version of glRenderAction
+		{
+		}
+	virtual void alRenderAction(const TypedRemoteClientState* rcs,ALContextData& contextData) const // Typed version of alRenderAction
+		{
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,172 @@
+/***********************************************************************
+TypedProtocolServer - Class template for protocol servers with a single
+client state type, to dispatch hooks with statically typed client states
+instead of casting them in each hook.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_TYPEDPROTOCOLSERVER_INCLUDED
+#define COLLABORATION_TYPEDPROTOCOLSERVER_INCLUDED
+
+#include <Collaboration/ProtocolServer.h>
+
+namespace Collaboration {
+
+template <class ClientStateParam>
+class TypedProtocolServer:public ProtocolServer
+	{
+	/* Embedded classes: */
+	public:
+	typedef ClientStateParam TypedClientState; // Type of client states created by the protocol; must be derived from ProtocolServer::ClientState
+	
+	/*********************************************************************
+	Methods from ProtocolServer, to adapt the generic hooks called by the
+	collaboration server to the typed hooks below. The server only passes
+	client states to the protocol that created them in
+	receiveConnectRequest, so their type is fixed when the server registers
+	the client, and the adapters can cast them without checking:
+	*********************************************************************/
+	
+	virtual void sendConnectReply(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+		{
+		sendConnectReply(static_cast<TypedClientState*>(cs),pipe);
+		}
+	virtual void sendConnectReject(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+		{
+		sendConnectReject(static_cast<TypedClientState*>(cs),pipe);
+		}
+	virtual void receiveDisconnectRequest(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+		{
+		receiveDisconnectRequest(static_cast<TypedClientState*>(cs),pipe);
+		}
+	virtual void sendDisconnectReply(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+		{
+		sendDisconnectReply(static_cast<TypedClientState*>(cs),pipe);
+		}
+	virtual void receiveClientUpdate(ProtocolServer::ClientState* cs,Comm::NetPipe& pipe)
+		{
+		receiveClientUpdate(static_cast<TypedClientState*>(cs),pipe);
+		}
+	virtual void sendClientConnect(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
+		{
+		sendClientConnect(static_cast<TypedClientState*>(sourceCs),static_cast<TypedClientState*>(destCs),pipe);
+		}
+	virtual void sendServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
+		{
+		sendServerUpdate(static_cast<TypedClientState*>(destCs),pipe);
+		}
+	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
+		{
+		sendServerUpdate(static_cast<TypedClientState*>(sourceCs),static_cast<TypedClientState*>(destCs),pipe);
+		}
+	virtual void sendServerUpdate(ProtocolServer::ClientState* sourceCs,ServerUpdateBatch& batch)
+		{
+		sendServerUpdate(static_cast<TypedClientState*>(sourceCs),batch);
+		}
+	virtual bool sendReducedServerUpdate(ProtocolServer::ClientState* sourceCs,ProtocolServer::ClientState* destCs,IO::File& pipe)
+		{
+		return sendReducedServerUpdate(static_cast<TypedClientState*>(sourceCs),static_cast<TypedClientState*>(destCs),pipe);
+		}
+	virtual bool handleMessage(ProtocolServer::ClientState* cs,unsigned int messageId,Comm::NetPipe& pipe)
+		{
+		return handleMessage(static_cast<TypedClientState*>(cs),messageId,pipe);
+		}
+	virtual void connectClient(ProtocolServer::ClientState* cs)
+		{
+		connectClient(static_cast<TypedClientState*>(cs));
+		}
+	virtual void disconnectClient(ProtocolServer::ClientState* cs)
+		{
+		disconnectClient(static_cast<TypedClientState*>(cs));
+		}
+	virtual void beforeServerUpdate(ProtocolServer::ClientState* cs)
+		{
+		beforeServerUpdate(static_cast<TypedClientState*>(cs));
+		}
+	virtual void beforeServerUpdate(ProtocolServer::ClientState* destCs,IO::File& pipe)
+		{
+		beforeServerUpdate(static_cast<TypedClientState*>(destCs),pipe);
+		}
+	virtual void afterServerUpdate(ProtocolServer::ClientState* cs)
+		{
+		afterServerUpdate(static_cast<TypedClientState*>(cs));
+		}
+	
+	/* New methods: */
+	static TypedClientState* getClientState(ProtocolServer::ClientState* cs) // Returns the typed state of a client handed out by a server update batch
+		{
+		return static_cast<TypedClientState*>(cs);
+		}
+	virtual void sendConnectReply(TypedClientState* cs,Comm::NetPipe& pipe) // Typed version of sendConnectReply
+		{
+		}
+	virtual void sendConnectReject(TypedClientState* cs,Comm::NetPipe& pipe) // Typed version of sendConnectReject
+		{
+		}
+	virtual void receiveDisconnectRequest(TypedClientState* cs,Comm::NetPipe& pipe) // Typed version of receiveDisconnectRequest
+		{
+		}
+	virtual void sendDisconnectReply(TypedClientState* cs,Comm::NetPipe& pipe) // Typed version of sendDisconnectReply
+		{
+		}
+	virtual void receiveClientUpdate(TypedClientState* cs,Comm::NetPipe& pipe) // Typed version of receiveClientUpdate
+		{
+		}
+	virtual void sendClientConnect(TypedClientState* sourceCs,TypedClientState* destCs,IO::File& pipe) // Typed version of sendClientConnect
+		{
+		}
+	virtual void sendServerUpdate(TypedClientState* destCs,IO::File& pipe) // Typed version of sendServerUpdate
+		{
+		}
+	virtual void sendServerUpdate(TypedClientState* sourceCs,TypedClientState* destCs,IO::File& pipe) // Typed version of sendServerUpdate
+		{
+		}
+	virtual void sendServerUpdate(TypedClientState* sourceCs,ServerUpdateBatch& batch) // Typed version of sendServerUpdate; default calls sendServerUpdate(sourceCs,destCs,pipe) for each destination
+		{
+		ProtocolServer::sendServerUpdate(sourceCs,batch);
+		}
+	virtual bool sendReducedServerUpdate(TypedClientState* sourceCs,TypedClientState* destCs,IO::File& pipe) // Typed version of sendReducedServerUpdate; default always sends the full update
+		{
+		return false;
+		}
+	virtual bool handleMessage(TypedClientState* cs,unsigned int messageId,Comm::NetPipe& pipe) // Typed version of handleMessage; default rejects all messages
+		{
+		return false;
+		}
+	virtual void connectClient(TypedClientState* cs) // Typed version of connectClient
+		{
+		}
+	virtual void disconnectClient(TypedClientState* cs) // Typed version of disconnectClient
+		{
+		}
+	virtual void beforeServerUpdate(TypedClientState* cs) // Typed version of beforeServerUpdate
+		{
+		}
+	virtual void beforeServerUpdate(TypedClientState* destCs,IO::File& pipe) // Typed version of beforeServerUpdate
+		{
+		}
+	virtual void afterServerUpdate(TypedClientState* cs) // Typed version of afterServerUpdate
+		{
+		}
+	};
+
+}
+
+#endif
@@ -0,0 +1,116 @@
+/***********************************************************************
+WorkerPool - Class for a fixed set of threads executing jobs submitted
+in batches, with a way to wait until all submitted jobs are finished.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <Collaboration/WorkerPool.h>
+
+#include <iostream>
+#include <stdexcept>
+
+namespace Collaboration {
+
+/***************************
+Methods of class WorkerPool:
+***************************/
+
+void* WorkerPool::workerThreadMethod(void)
+	{
+	/* Enable immediate cancellation of this thread: */
+	Threads::Thread::setCancelState(Threads::Thread::CANCEL_ENABLE);
+	
+	while(true)
+		{
+		/* Wait for the next job: */
+		Job* job;
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		while(jobs.empty())
+			jobCond.wait(jobLock);
+		job=jobs.front();
+		jobs.pop_front();
+		}
+		
+		/* Execute the job: */
+		try
+			{
+			job->run();
+			}
+		catch(std::runtime_error err)
+			{
+			/* Print an error message and carry on: */
+			std::cerr<<"WorkerPool: Caught exception "<<err.what()<<" while executing job"<<std::endl;
+			}
+		
+		/* Wake up anybody waiting for the last job to finish: */
+		{
+		Threads::MutexCond::Lock jobLock(jobCond);
+		--numUnfinishedJobs;
+		if(numUnfinishedJobs==0)
+			jobCond.broadcast();
+		}
+		}
+	
+	return 0;
+	}
+
+WorkerPool::WorkerPool(unsigned int sNumThreads)
+	:numUnfinishedJobs(0),
+	 numThreads(sNumThreads),
+	 threads(0)
+	{
+	/* Start the worker threads: */
+	if(numThreads<1)
+		numThreads=1;
+	threads=new Threads::Thread[numThreads];
+	for(unsigned int i=0;i<numThreads;++i)
+		threads[i].start(this,&WorkerPool::workerThreadMethod);
+	}
+
+WorkerPool::~WorkerPool(void)
+	{
+	/* Stop all worker threads: */
+	for(unsigned int i=0;i<numThreads;++i)
+		{
+		threads[i].cancel();
+		threads[i].join();
+		}
+	delete[] threads;
+	}
+
+void WorkerPool::submit(WorkerPool::Job* job)
+	{
+	/* Append the job to the list and wake up an idle worker thread: */
+	Threads::MutexCond::Lock jobLock(jobCond);
+	jobs.push_back(job);
+	++numUnfinishedJobs;
+	jobCond.broadcast();
+	}
+
+void WorkerPool::wait(void)
+	{
+	/* Wait until the last submitted job is finished: */
+	Threads::MutexCond::Lock jobLock(jobCond);
+	while(numUnfinishedJobs>0)
+		jobCond.wait(jobLock);
+	}
+
+}
@@ -0,0 +1,78 @@
+/***********************************************************************
+WorkerPool - Class for a fixed set of threads executing jobs submitted
+in batches, with a way to wait until all submitted jobs are finished.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#ifndef COLLABORATION_WORKERPOOL_INCLUDED
+#define COLLABORATION_WORKERPOOL_INCLUDED
+
+#include <Threads/Thread.h>
+#include <Threads/MutexCond.h>
+#include <Collaboration/RingBuffer.h>
+
+namespace Collaboration {
+
+class WorkerPool
+	{
+	/* Embedded classes: */
+	public:
+	class Job // Base class for jobs executed by worker threads
+		{
+		/* Constructors and destructors: */
+		public:
+		virtual ~Job(void)
+			{
+			}
+		
+		/* Methods: */
+		virtual void run(void) =0; // Executes the job
+		};
+	
+	private:
+	typedef RingBuffer<Job*> JobList; // Type for lists of pending jobs
+	
+	/* Elements: */
+	Threads::MutexCond jobCond; // Condition variable protecting the job list and signalling new and finished jobs
+	JobList jobs; // List of submitted jobs not yet picked up by a worker thread
+	unsigned int numUnfinishedJobs; // Number of submitted jobs that are not yet finished
+	unsigned int numThreads; // Number of worker threads
+	Threads::Thread* threads; // Array of worker threads
+	
+	/* Private methods: */
+	void* workerThreadMethod(void); // Method for worker threads
+	
+	/* Constructors and destructors: */
+	public:
+	WorkerPool(unsigned int sNumThreads); // Creates a pool with the given number of worker threads
+	~WorkerPool(void); // Stops all worker threads; unfinished jobs are abandoned
+	
+	/* Methods: */
+	unsigned int getNumThreads(void) const // Returns the number of worker threads
+		{
+		return numThreads;
+		}
+	void submit(Job* job); // Submits a job for execution; the pool does not inherit the job object
+	void wait(void); // Blocks until all submitted jobs are finished
+	};
+
+}
+
+#endif
@@ -0,0 +1,111 @@
+/***********************************************************************
+Main program for a relay connecting the clients at one site to a remote
+VR collaboration server over a single connection.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <iostream>
+#include <Misc/Time.h>
+
+#include <Collaboration/CollaborationRelay.h>
+
+volatile bool runRelayLoop=true;
+
+void termSignalHandler(int)
+	{
+	runRelayLoop=false;
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		int listenPortId=26000;
+		double sendTimeout=5.0;
+		const char* upstreamHostName=0;
+		int upstreamPortId=-1;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"port")==0)
+					{
+					++i;
+					if(i<argc)
+						listenPortId=atoi(argv[i]);
+					else
+						std::cerr<<"CollaborationRelayMain: ignored dangling -port option"<<std::endl;
+					}
+				else if(strcasecmp(argv[i]+1,"sendTimeout")==0)
+					{
+					++i;
+					if(i<argc)
+						sendTimeout=atof(argv[i]);
+					else
+						std::cerr<<"CollaborationRelayMain: ignored dangling -sendTimeout option"<<std::endl;
+					}
+				}
+			else if(upstreamHostName==0)
+				upstreamHostName=argv[i];
+			else if(upstreamPortId<0)
+				upstreamPortId=atoi(argv[i]);
+			}
+		if(upstreamHostName==0||upstreamPortId<0)
+			{
+			std::cerr<<"Usage: "<<argv[0]<<" [-port <local port ID>] [-sendTimeout <seconds>] <upstream server host name> <upstream server port ID>"<<std::endl;
+			return 1;
+			}
+		
+		/* Ignore SIGPIPE and leave handling of pipe errors to TCP sockets: */
+		struct sigaction sigPipeAction;
+		sigPipeAction.sa_handler=SIG_IGN;
+		sigemptyset(&sigPipeAction.sa_mask);
+		sigPipeAction.sa_flags=0x0;
+		sigaction(SIGPIPE,&sigPipeAction,0);
+		
+		/* Create the relay object: */
+		Collaboration::CollaborationRelay relay(listenPortId,upstreamHostName,upstreamPortId,sendTimeout);
+		std::cout<<"CollaborationRelayMain: Relaying clients on port "<<relay.getListenPortId()<<" to server "<<upstreamHostName<<", port "<<upstreamPortId<<std::endl;
+		
+		/* Reroute SIG_INT signals to cleanly shut down the relay: */
+		struct sigaction sigIntAction;
+		memset(&sigIntAction,0,sizeof(struct sigaction));
+		sigIntAction.sa_handler=termSignalHandler;
+		if(sigaction(SIGINT,&sigIntAction,0)!=0)
+			std::cerr<<"CollaborationRelayMain: Cannot intercept SIG_INT signals. Relay won't shut down cleanly."<<std::endl;
+		
+		/* Run until interrupted or until the upstream server goes away: */
+		while(runRelayLoop&&relay.isConnected())
+			Misc::sleep(Misc::Time(0.5));
+		if(!relay.isConnected())
+			std::cerr<<"CollaborationRelayMain: Lost connection to upstream server"<<std::endl;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
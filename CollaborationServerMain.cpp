@@ -23,19 +23,44 @@ Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
 #include <string.h>
 #include <stdlib.h>
 #include <signal.h>
+#include <pthread.h>
 #include <iostream>
 #include <Misc/SelfDestructPointer.h>
-#include <Misc/Time.h>
 
+#include <Collaboration/TickScheduler.h>
 #include <Collaboration/CollaborationServer.h>
 
+class StandaloneServer:public Collaboration::CollaborationServer // Collaboration server without a higher-level protocol layered over it
+	{
+	/* Constructors and destructors: */
+	public:
+	StandaloneServer(Configuration* sConfiguration)
+		:Collaboration::CollaborationServer(sConfiguration)
+		{
+		}
+	
+	/* Methods from CollaborationServer: */
+	virtual bool hasThreadSafeClientHooks(void) const
+		{
+		/* The server's update message hooks do nothing, and can run concurrently: */
+		return true;
+		}
+	};
+
 volatile bool runServerLoop=true;
 
+volatile bool dumpTickProfile=false;
+
 void termSignalHandler(int)
 	{
 	runServerLoop=false;
 	}
 
+void dumpSignalHandler(int)
+	{
+	dumpTickProfile=true;
+	}
+
 int main(int argc,char* argv[])
 	{
 	try
@@ -44,7 +69,10 @@ int main(int argc,char* argv[])
 		Misc::SelfDestructPointer<Collaboration::CollaborationServer::Configuration> cfg(new Collaboration::CollaborationServer::Configuration);
 		
 		/* Parse the command line: */
-		Misc::Time tickTime(cfg->getTickTime()); // Server update time interval in seconds
+		double tickTime=cfg->getTickTime(); // Server update time interval in seconds
+		Collaboration::TickScheduler::OverrunPolicy overrunPolicy=cfg->getOverrunPolicy(); // Treatment of ticks missed due to long server updates
+		bool idleWhenEmpty=cfg->getIdleWhenEmpty(); // Flag whether to stop ticking while no clients are connected
+		double statisticsInterval=cfg->getStatisticsInterval(); // Interval in seconds between tick statistics reports
 		for(int i=1;i<argc;++i)
 			{
 			if(argv[i][0]=='-')
@@ -64,10 +92,35 @@ int main(int argc,char* argv[])
 					{
 					++i;
 					if(i<argc)
-						tickTime=Misc::Time(atof(argv[i]));
+						tickTime=atof(argv[i]);
 					else
 						std::cerr<<"CollaborationServerMain: ignored dangling -tick option"<<std::endl;
 					}
+				else if(strcasecmp(argv[i]+1,"overrun")==0)
+					{
+					++i;
+					if(i<argc)
+						{
+						if(strcasecmp(argv[i],"skip")==0)
+							overrunPolicy=Collaboration::TickScheduler::SKIP;
+						else if(strcasecmp(argv[i],"catchup")==0)
+							overrunPolicy=Collaboration::TickScheduler::CATCH_UP;
+						else
+							std::cerr<<"CollaborationServerMain: ignored unknown overrun policy "<<argv[i]<<std::endl;
+						}
+					else
+						std::cerr<<"CollaborationServerMain: ignored dangling -overrun option"<<std::endl;
+					}
+				else if(strcasecmp(argv[i]+1,"noIdle")==0)
+					idleWhenEmpty=false;
+				else if(strcasecmp(argv[i]+1,"stats")==0)
+					{
+					++i;
+					if(i<argc)
+						statisticsInterval=atof(argv[i]);
+					else
+						std::cerr<<"CollaborationServerMain: ignored dangling -stats option"<<std::endl;
+					}
 				}
 			}
 		
@@ -78,9 +131,17 @@ int main(int argc,char* argv[])
 		sigPipeAction.sa_flags=0x0;
 		sigaction(SIGPIPE,&sigPipeAction,0);
 		
+		/* Block SIG_INT and SIG_USR1 signals in all server threads, so they interrupt the server loop's waits in the main thread: */
+		sigset_t sigIntSet;
+		sigemptyset(&sigIntSet);
+		sigaddset(&sigIntSet,SIGINT);
+		sigaddset(&sigIntSet,SIGUSR1);
+		pthread_sigmask(SIG_BLOCK,&sigIntSet,0);
+		
 		/* Create the collaboration server object: */
-		Collaboration::CollaborationServer server(cfg.getTarget());
+		StandaloneServer server(cfg.getTarget());
 		cfg.releaseTarget();
+		pthread_sigmask(SIG_UNBLOCK,&sigIntSet,0);
 		std::cout<<"CollaborationServerMain: Started server on port "<<server.getListenPortId()<<std::endl;
 		
 		/* Reroute SIG_INT signals to cleanly shut down multiplexer: */
@@ -90,21 +151,56 @@ int main(int argc,char* argv[])
 		if(sigaction(SIGINT,&sigIntAction,0)!=0)
 			std::cerr<<"CollaborationServerMain: Cannot intercept SIG_INT signals. Server won't shut down cleanly."<<std::endl;
 		
+		/* Dump the profiles of recent server updates on SIG_USR1 signals: */
+		struct sigaction sigUsr1Action;
+		memset(&sigUsr1Action,0,sizeof(struct sigaction));
+		sigUsr1Action.sa_handler=dumpSignalHandler;
+		if(sigaction(SIGUSR1,&sigUsr1Action,0)!=0)
+			std::cerr<<"CollaborationServerMain: Cannot intercept SIG_USR1 signals."<<std::endl;
+		
 		/* Run the server loop at the specified time interval: */
-		Misc::Time nextTick=Misc::Time::now();
-		int i=0;
+		Collaboration::TickScheduler scheduler(tickTime,overrunPolicy);
+		unsigned int statisticsTicks=statisticsInterval>0.0?(unsigned int)(statisticsInterval/tickTime+0.5):0U;
 		while(runServerLoop)
 			{
-			/* Sleep for the tick time: */
-			nextTick+=tickTime;
-			Misc::Time sleepTime=nextTick-Misc::Time::now();
-			if(sleepTime.tv_sec>=0)
-				Misc::sleep(sleepTime);
+			if(dumpTickProfile)
+				{
+				/* Dump the profiles of recent server updates on request: */
+				dumpTickProfile=false;
+				try
+					{
+					if(!server.dumpTickProfile())
+						std::cerr<<"CollaborationServerMain: Server updates are not profiled; set profileTicks to enable profiling"<<std::endl;
+					}
+				catch(std::runtime_error err)
+					{
+					std::cerr<<"CollaborationServerMain: Unable to dump profile due to exception "<<err.what()<<std::endl;
+					}
+				}
+			
+			/* Wait without ticking while no clients are connected: */
+			if(idleWhenEmpty&&server.isIdle())
+				{
+				if(!scheduler.waitForEvent(server.getClientArrivalFd()))
+					continue;
+				}
+			
+			/* Wait for the next tick: */
+			if(!scheduler.waitForTick())
+				continue;
 			
 			/* Update the server state: */
 			server.update();
-			std::cout<<'\r'<<char('0'+i%10)<<std::flush;
-			++i;
+			scheduler.finishTick();
+			
+			/* Report tick statistics periodically: */
+			if(statisticsTicks>0&&scheduler.getStatistics().numTicks>=statisticsTicks)
+				{
+				std::cout<<"CollaborationServerMain: ";
+				scheduler.getStatistics().print(std::cout);
+				std::cout<<std::endl;
+				scheduler.resetStatistics();
+				}
 			}
 		}
 	catch(std::runtime_error err)
@@ -0,0 +1,186 @@
+/***********************************************************************
+JoinCompressionBenchmark - Utility to measure the bandwidth and latency
+saved by compressing the session snapshot a client receives when
+joining a session with many Graphein annotation strokes.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <iostream>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Time.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
+#include <Math/Random.h>
+
+#include <Collaboration/GrapheinProtocol.h>
+#include <Collaboration/PayloadCompressor.h>
+
+typedef Collaboration::GrapheinProtocol::Card Card;
+typedef Collaboration::GrapheinProtocol::Scalar Scalar;
+typedef Collaboration::GrapheinProtocol::Point Point;
+typedef Collaboration::GrapheinProtocol::Curve Curve;
+typedef std::vector<Curve> CurveList;
+
+void synthesizeCurves(unsigned int numCurves,unsigned int numPoints,CurveList& curves) // Creates hand-drawn strokes as smooth random walks with a small palette of colors and line widths
+	{
+	static const GLubyte palette[4][3]={{255,0,0},{0,255,0},{0,0,255},{255,255,0}};
+	curves.resize(numCurves);
+	for(unsigned int i=0;i<numCurves;++i)
+		{
+		Curve& c=curves[i];
+		c.lineWidth=GLfloat(1+int(Math::randUniformCO()*3.0));
+		c.color=Curve::Color(palette[int(Math::randUniformCO()*4.0)]);
+		
+		/* Start each stroke somewhere in a room-sized environment, in inches, and move in small steps like a tracked pen sampled every frame: */
+		Point p(Scalar(Math::randUniformCO()*120.0-60.0),Scalar(Math::randUniformCO()*120.0-60.0),Scalar(Math::randUniformCO()*96.0));
+		Scalar v[3]={Scalar(0),Scalar(0),Scalar(0)};
+		c.vertices.reserve(numPoints);
+		for(unsigned int j=0;j<numPoints;++j)
+			{
+			c.vertices.push_back(p);
+			for(int k=0;k<3;++k)
+				{
+				/* Let the pen's velocity drift smoothly: */
+				v[k]=v[k]*Scalar(0.9)+Scalar(Math::randNormal(0.0,0.005));
+				p[k]+=v[k];
+				}
+			}
+		}
+	}
+
+void writeCurves(const CurveList& curves,IO::File& sink) // Writes a list of curves like GrapheinServer::sendClientConnect
+	{
+	sink.write<Card>(Card(curves.size()));
+	for(unsigned int i=0;i<curves.size();++i)
+		{
+		sink.write<Card>(i+1);
+		curves[i].write(sink);
+		}
+	}
+
+bool readCurves(IO::File& source,const CurveList& curves) // Reads a list of curves like GrapheinClient::receiveClientConnect, and compares it to the original list
+	{
+	if(source.read<Card>()!=curves.size())
+		return false;
+	for(unsigned int i=0;i<curves.size();++i)
+		{
+		if(source.read<Card>()!=i+1)
+			return false;
+		Curve c;
+		c.read(source);
+		if(c.lineWidth!=curves[i].lineWidth||memcmp(c.color.getRgba(),curves[i].color.getRgba(),3)!=0||c.vertices.size()!=curves[i].vertices.size())
+			return false;
+		if(!c.vertices.empty()&&memcmp(&c.vertices[0],&curves[i].vertices[0],c.vertices.size()*sizeof(Point))!=0)
+			return false;
+		}
+	return true;
+	}
+
+IO::FixedMemoryFile* readBack(const IO::VariableMemoryFile& message) // Copies an encoded message into contiguous memory to be read like a receiving client
+	{
+	size_t messageSize=message.getDataSize();
+	IO::FixedMemoryFile packet(messageSize);
+	message.writeToSink(packet);
+	packet.flush();
+	IO::FixedMemoryFile* reader=new IO::FixedMemoryFile(messageSize);
+	memcpy(reader->getMemory(),packet.getMemory(),messageSize);
+	return reader;
+	}
+
+double getElapsed(const Misc::Time& start) // Returns the time since the given start time in milliseconds
+	{
+	Misc::Time elapsed=Misc::Time::now()-start;
+	return double(elapsed.tv_sec)*1000.0+double(elapsed.tv_nsec)/1.0e6;
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		unsigned int numCurves=5000;
+		unsigned int numPoints=200;
+		double bandwidth=10.0;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"curves")==0&&i+1<argc)
+					numCurves=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"points")==0&&i+1<argc)
+					numPoints=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"bandwidth")==0&&i+1<argc)
+					bandwidth=atof(argv[++i]);
+				else
+					std::cerr<<"JoinCompressionBenchmark: ignored option "<<argv[i]<<std::endl;
+				}
+			else
+				std::cerr<<"JoinCompressionBenchmark: ignored argument "<<argv[i]<<std::endl;
+			}
+		
+		/* Create the session's annotations and serialize them like a client connect message: */
+		CurveList curves;
+		synthesizeCurves(numCurves,numPoints,curves);
+		IO::VariableMemoryFile payload;
+		writeCurves(curves,payload);
+		size_t rawSize=payload.getDataSize();
+		
+		/* Compress the payload like the server: */
+		IO::VariableMemoryFile envelope;
+		Misc::Time compressStart=Misc::Time::now();
+		Collaboration::PayloadCompressor::writePayload(payload,1,envelope);
+		double compressTime=getElapsed(compressStart);
+		size_t compressedSize=envelope.getDataSize();
+		
+		/* Decompress the payload like a joining client and check that it reproduces all curves exactly: */
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> reader(readBack(envelope));
+		Misc::Time decompressStart=Misc::Time::now();
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> unpacked(Collaboration::PayloadCompressor::readPayload(*reader));
+		double decompressTime=getElapsed(decompressStart);
+		bool ok=readCurves(*unpacked,curves);
+		
+		/* Calculate the time to transmit the snapshot at the given bandwidth in Mbit/s, in milliseconds: */
+		double rawTransmitTime=double(rawSize)*8.0/(bandwidth*1000.0);
+		double compressedTransmitTime=double(compressedSize)*8.0/(bandwidth*1000.0);
+		
+		/* Print the results: */
+		std::cout<<"JoinCompressionBenchmark: "<<numCurves<<" curves of "<<numPoints<<" points each"<<std::endl;
+		std::cout<<"Raw snapshot:        "<<rawSize<<" bytes, "<<rawTransmitTime<<" ms at "<<bandwidth<<" Mbit/s"<<std::endl;
+		std::cout<<"Compressed snapshot: "<<compressedSize<<" bytes, "<<compressedTransmitTime<<" ms at "<<bandwidth<<" Mbit/s"<<std::endl;
+		std::cout<<"Compression ratio: "<<double(rawSize)/double(compressedSize)<<", compression "<<compressTime<<" ms ("<<double(rawSize)/(compressTime*1000.0)<<" MB/s), decompression "<<decompressTime<<" ms ("<<double(rawSize)/(decompressTime*1000.0)<<" MB/s)"<<std::endl;
+		std::cout<<"Join latency: "<<rawTransmitTime<<" ms raw, "<<compressTime+compressedTransmitTime+decompressTime<<" ms compressed"<<std::endl;
+		if(!ok)
+			{
+			std::cerr<<"JoinCompressionBenchmark: Decompressed snapshot does not match the original curves"<<std::endl;
+			return 1;
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
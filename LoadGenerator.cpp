@@ -0,0 +1,1158 @@
+/***********************************************************************
+LoadGenerator - Program to simulate a large number of headless clients
+that connect to a collaboration server and generate synthetic viewer,
+input device, sketching, and audio/video traffic.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#include <pthread.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <iostream>
+#include <Misc/SizedTypes.h>
+#include <Misc/HashTable.h>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Time.h>
+#include <Threads/Mutex.h>
+#include <Threads/Thread.h>
+#include <Math/Random.h>
+#include <Comm/TCPPipe.h>
+
+#include <Collaboration/PoseCodec.h>
+#include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/CheriaProtocol.h>
+#include <Collaboration/GrapheinProtocol.h>
+#include <Collaboration/AgoraProtocol.h>
+
+volatile bool runLoadGenerator=true;
+
+void termSignalHandler(int)
+	{
+	runLoadGenerator=false;
+	}
+
+double getElapsed(const Misc::Time& start,const Misc::Time& end) // Returns the time between the given start and end times in seconds
+	{
+	Misc::Time elapsed=end-start;
+	return double(elapsed.tv_sec)+double(elapsed.tv_nsec)/1.0e9;
+	}
+
+struct LoadConfiguration // Structure describing the synthetic traffic generated by each simulated client
+	{
+	/* Elements: */
+	public:
+	std::string sessionName; // Name of the session to join, or empty to join the default session
+	unsigned int numViewers; // Number of viewers per client
+	double motionRadius; // Radius of the circles on which viewers move around the display center in inches
+	double motionSpeed; // Angular speed of viewer and input device motion in radians per second
+	unsigned int numDevices; // Number of input devices per client; zero to not emulate Cheria
+	double toolRate; // Number of tool creations or destructions per second
+	double strokeRate; // Number of curves started per second; zero to not emulate Graphein
+	unsigned int strokePoints; // Number of vertices per curve, one added with each client update
+	unsigned int maxCurves; // Number of curves per client after which the oldest curve is deleted when a new one is started
+	bool audio; // Flag whether to send SPEEX-sized audio packets through Agora
+	size_t videoPacketSize; // Size of Theora-sized video packets in bytes; zero to not send video
+	double videoRate; // Number of video packets per second
+	std::vector<Misc::UInt8> noise; // Incompressible data used as media payloads
+	
+	/* Constructors and destructors: */
+	LoadConfiguration(void)
+		:numViewers(1),motionRadius(24.0),motionSpeed(1.0),
+		 numDevices(2),toolRate(0.5),
+		 strokeRate(0.2),strokePoints(100),maxCurves(20),
+		 audio(true),videoPacketSize(0),videoRate(15.0)
+		{
+		}
+	};
+
+struct LoadStatistics // Structure to accumulate what a simulated client observed
+	{
+	/* Elements: */
+	public:
+	size_t receivedBytes; // Number of bytes received from the server
+	unsigned int numServerUpdates; // Number of received server update messages
+	unsigned int numLatencies; // Number of measured update latencies
+	double latencySum; // Sum of measured update latencies in seconds
+	double latencyMax; // Maximum measured update latency in seconds
+	
+	/* Constructors and destructors: */
+	LoadStatistics(void)
+		:receivedBytes(0),numServerUpdates(0),
+		 numLatencies(0),latencySum(0.0),latencyMax(0.0)
+		{
+		}
+	
+	/* Methods: */
+	void add(const LoadStatistics& other) // Accumulates another set of statistics
+		{
+		receivedBytes+=other.receivedBytes;
+		numServerUpdates+=other.numServerUpdates;
+		numLatencies+=other.numLatencies;
+		latencySum+=other.latencySum;
+		if(latencyMax<other.latencyMax)
+			latencyMax=other.latencyMax;
+		}
+	};
+
+class LoadClient;
+
+typedef std::vector<LoadClient*> LoadClientList;
+
+class LoadClient:public Collaboration::CollaborationProtocol // Class for headless clients that emulate protocol plug-ins and respond to every server update with synthetic traffic
+	{
+	/* Embedded classes: */
+	private:
+	class Pipe:public Comm::TCPPipe // Class for TCP pipes that count all data read from them
+		{
+		/* Elements: */
+		private:
+		LoadClient& client; // Client owning the pipe
+		
+		/* Protected methods from IO::File: */
+		protected:
+		virtual size_t readData(IO::File::Byte* buffer,size_t bufferSize);
+		
+		/* Constructors and destructors: */
+		public:
+		Pipe(LoadClient& sClient,const char* hostName,int portId) // Connects to the server on the given host and port
+			:Comm::TCPPipe(hostName,portId),
+			 client(sClient)
+			{
+			}
+		};
+	
+	friend class Pipe;
+	
+	enum ProtocolKind // Enumerated type for emulated protocol plug-ins
+		{
+		CHERIA,GRAPHEIN,AGORA
+		};
+	
+	struct RemoteProtocol // Structure describing a protocol plug-in shared with a remote client
+		{
+		/* Elements: */
+		public:
+		ProtocolKind kind; // Kind of the shared protocol plug-in
+		bool hasSpeex; // Flag whether the remote client sends audio packets
+		unsigned int speexPacketSize; // Size of the remote client's audio packets
+		bool hasTheora; // Flag whether the remote client sends video packets
+		};
+	
+	struct RemoteClient // Structure for other clients connected to the server
+		{
+		/* Elements: */
+		public:
+		ClientState state; // Remote client's most recent state
+		LoadClient* source; // Simulated client in this process sending the remote client's updates, or null for other clients
+		std::vector<RemoteProtocol> protocols; // Protocol plug-ins shared with the remote client, in server order
+		};
+	
+	typedef Misc::HashTable<unsigned int,RemoteClient*> RemoteClientMap; // Hash table to map client IDs to remote clients
+	
+	struct SentUpdate // Structure remembering when a client update was sent
+		{
+		/* Elements: */
+		public:
+		unsigned int sequence; // Sequence number of the client update
+		Misc::Time time; // Time at which the client update was sent
+		};
+	
+	/* Elements: */
+	static const unsigned int numSentUpdates=256; // Number of recent client updates whose send times are remembered
+	static const unsigned int speexFrameSize=160; // Number of audio samples per SPEEX frame in narrowband mode
+	static const unsigned int speexPacketSize=42; // Size of a SPEEX packet, as hard-coded in SpeexEncoder
+	static const unsigned int speexQueueSize=8; // Number of SPEEX packets the emulated encoder queues between client updates
+	static const unsigned int theoraHeadersSize=3072; // Size of the emulated Theora stream headers
+	
+	const LoadConfiguration& config; // Description of the generated traffic
+	const LoadClientList& clients; // List of all simulated clients, to find the senders of received updates
+	unsigned int index; // Index of this client in the list
+	Comm::NetPipePtr pipe; // Pipe connected to the server
+	std::vector<ProtocolKind> protocols; // Protocol plug-ins negotiated with the server, in server order
+	Collaboration::PoseCodec cheriaPoseCodec; // Codec the server's Cheria protocol uses for device positions and orientations
+	Threads::Thread communicationThread; // Thread receiving server messages and sending client updates
+	bool connected; // Flag whether the client connected and started its communication thread
+	volatile bool disconnectRequested; // Flag to send a disconnect request instead of the next client update
+	Misc::Time connectTime; // Time at which the server accepted the client
+	
+	/* Synthetic client state: */
+	ClientState state; // Client's environment, viewers, and navigation transformation
+	Misc::Time lastUpdateTime; // Time at which the last client update was sent
+	unsigned int updateSequence; // Sequence number of the last client update, sent in the navigation transformation
+	double motionAngle; // Current angle of viewer and input device motion
+	std::vector<Collaboration::CheriaProtocol::DeviceState*> devices; // Emulated input devices; device IDs are indices plus one
+	bool devicesCreated; // Flag whether the input devices were announced to the server
+	double pendingToolChanges; // Number of tool creations or destructions owed since the last client update
+	unsigned int nextToolId; // ID to assign to the next created tool
+	std::deque<unsigned int> toolIds; // IDs of current tools in order of creation
+	double pendingStrokes; // Number of curves owed since the last client update
+	unsigned int nextCurveId; // ID to assign to the next created curve
+	unsigned int strokeCurveId; // ID of the curve currently being drawn, or zero
+	unsigned int strokeLength; // Number of vertices in the curve currently being drawn
+	Point penPosition; // Position of the last vertex of the curve currently being drawn
+	std::deque<unsigned int> curveIds; // IDs of current curves in order of creation
+	double pendingSpeexPackets; // Number of SPEEX packets owed since the last client update
+	double pendingVideoPackets; // Number of video packets owed since the last client update
+	Misc::SInt64 videoPacketNo; // Sequence number of the next video packet
+	Misc::SInt64 keyframePacketNo; // Sequence number of the most recent video keyframe
+	
+	/* Received server traffic: */
+	RemoteClientMap remoteClients; // Map of other clients connected to the server
+	Collaboration::GrapheinProtocol::Curve curve; // Buffer to read curves sent with client connect messages
+	Collaboration::AgoraProtocol::VideoPacket videoPacket; // Buffer to read video packets sent with server updates
+	
+	/* State shared with other threads: */
+	Threads::Mutex statisticsMutex; // Mutex protecting the following state
+	SentUpdate sentUpdates[numSentUpdates]; // Ring buffer of recent client update send times
+	LoadStatistics intervalStatistics; // Statistics since the last report
+	LoadStatistics totalStatistics; // Statistics since the client connected
+	bool finished; // Flag whether the communication thread has terminated
+	std::string errorMessage; // Reason why the communication thread terminated, if it terminated due to an error
+	
+	/* Private methods: */
+	ONTransform getViewerTransform(unsigned int viewerIndex) const; // Returns the current transformation of the given viewer
+	ONTransform getDeviceTransform(unsigned int deviceIndex) const; // Returns the current transformation of the given input device
+	bool getSentTime(unsigned int sequence,Misc::Time& time); // Returns the send time of the client update of the given sequence number if it is still remembered
+	void writeCheriaRequest(void); // Writes the Cheria connect request payload
+	void writeGrapheinRequest(void); // Writes the Graphein connect request payload
+	void writeAgoraRequest(void); // Writes the Agora connect request payload
+	void writeCheriaUpdate(double dt); // Writes input device and tool changes for the given time step
+	void writeGrapheinUpdate(double dt); // Writes curve changes for the given time step
+	void writeAgoraUpdate(double dt); // Writes audio and video packets for the given time step
+	void sendClientUpdate(void); // Sends a client update message
+	void receiveClientConnect(void); // Reads a client connect message
+	void receiveServerUpdate(const Misc::Time& receiveTime); // Reads a server update message received at the given time
+	void* communicationThreadMethod(void); // Method receiving server messages and sending client updates
+	
+	/* Constructors and destructors: */
+	public:
+	LoadClient(const LoadConfiguration& sConfig,const LoadClientList& sClients,unsigned int sIndex); // Creates an unconnected client
+	~LoadClient(void); // Disconnects the client
+	
+	/* Methods: */
+	const std::string& getName(void) const // Returns the client's name
+		{
+		return state.clientName;
+		}
+	const Misc::Time& getConnectTime(void) const // Returns the time at which the server accepted the client
+		{
+		return connectTime;
+		}
+	void connect(const char* hostName,int portId); // Connects to the server on the given host and port and starts generating traffic
+	void requestDisconnect(void); // Asks the client to disconnect after the next server update
+	bool isActive(void); // Returns true if the client is connected and its communication thread is still running
+	LoadStatistics takeIntervalStatistics(void); // Returns the statistics since the last call and resets them
+	LoadStatistics getTotalStatistics(void); // Returns the statistics since the client connected
+	std::string getErrorMessage(void); // Returns the reason why the client stopped communicating, or an empty string
+	};
+
+/***********************************
+Static elements of class LoadClient:
+***********************************/
+
+const unsigned int LoadClient::numSentUpdates;
+const unsigned int LoadClient::speexFrameSize;
+const unsigned int LoadClient::speexPacketSize;
+const unsigned int LoadClient::speexQueueSize;
+const unsigned int LoadClient::theoraHeadersSize;
+
+/*********************************
+Methods of class LoadClient::Pipe:
+*********************************/
+
+size_t LoadClient::Pipe::readData(IO::File::Byte* buffer,size_t bufferSize)
+	{
+	/* Read from the socket and count what was read: */
+	size_t readSize=Comm::TCPPipe::readData(buffer,bufferSize);
+	
+	Threads::Mutex::Lock statisticsLock(client.statisticsMutex);
+	client.intervalStatistics.receivedBytes+=readSize;
+	client.totalStatistics.receivedBytes+=readSize;
+	
+	return readSize;
+	}
+
+/***************************
+Methods of class LoadClient:
+***************************/
+
+LoadClient::ONTransform LoadClient::getViewerTransform(unsigned int viewerIndex) const
+	{
+	/* Move viewers on a horizontal circle around the display center, facing along the circle: */
+	double angle=motionAngle+double(viewerIndex)*2.0*M_PI/double(state.numViewers);
+	Vector translation(Scalar(cos(angle)*config.motionRadius),Scalar(sin(angle)*config.motionRadius),Scalar(0));
+	return ONTransform(translation,Rotation::rotateZ(Scalar(angle)));
+	}
+
+LoadClient::ONTransform LoadClient::getDeviceTransform(unsigned int deviceIndex) const
+	{
+	/* Move input devices on a smaller, lower circle, spinning twice as fast as the viewers: */
+	double angle=motionAngle+double(deviceIndex)*2.0*M_PI/double(devices.size());
+	Vector translation(Scalar(cos(angle)*config.motionRadius*0.5),Scalar(sin(angle)*config.motionRadius*0.5),Scalar(-12));
+	return ONTransform(translation,Rotation::rotateZ(Scalar(angle*2.0)));
+	}
+
+bool LoadClient::getSentTime(unsigned int sequence,Misc::Time& time)
+	{
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	
+	/* Check whether the client update is still remembered: */
+	const SentUpdate& su=sentUpdates[sequence%numSentUpdates];
+	if(su.sequence!=sequence)
+		return false;
+	
+	time=su.time;
+	return true;
+	}
+
+void LoadClient::writeCheriaRequest(void)
+	{
+	/* Send the length of the following message and the protocol version: */
+	pipe->write<Card>(sizeof(Card));
+	pipe->write<Card>(Collaboration::CheriaProtocol::protocolVersion);
+	}
+
+void LoadClient::writeGrapheinRequest(void)
+	{
+	/* Send the length of the following message and the protocol version: */
+	pipe->write<Card>(sizeof(Card));
+	pipe->write<Card>(Collaboration::GrapheinProtocol::protocolVersion);
+	}
+
+void LoadClient::writeAgoraRequest(void)
+	{
+	bool video=config.videoPacketSize>0;
+	
+	/* Calculate and send the length of the following message: */
+	unsigned int messageLength=sizeof(Card)+sizeof(Scalar)*3+sizeof(Card)*3+sizeof(Byte);
+	if(video)
+		messageLength+=Misc::Marshaller<ONTransform>::getSize(ONTransform::identity)+sizeof(Scalar)*2+sizeof(Card)+theoraHeadersSize;
+	pipe->write<Card>(messageLength);
+	
+	/* Send the protocol version and mouth position: */
+	pipe->write<Card>(Collaboration::AgoraProtocol::protocolVersion);
+	write(Point::origin,*pipe);
+	
+	/* Send the SPEEX frame size, packet size, and queue size of the emulated encoder: */
+	pipe->write<Card>(config.audio?speexFrameSize:0);
+	pipe->write<Card>(config.audio?speexPacketSize:0);
+	pipe->write<Card>(config.audio?speexQueueSize:0);
+	
+	/* Send the video streaming flag: */
+	pipe->write<Byte>(video?1:0);
+	if(video)
+		{
+		/* Send the virtual video transformation and size, and the emulated Theora stream headers: */
+		write(ONTransform::identity,*pipe);
+		Scalar videoSize[2]={Scalar(16),Scalar(12)};
+		pipe->write(videoSize,2);
+		pipe->write<Card>(theoraHeadersSize);
+		pipe->write(&config.noise[0],theoraHeadersSize);
+		}
+	}
+
+void LoadClient::writeCheriaUpdate(double dt)
+	{
+	typedef Collaboration::CheriaProtocol CheriaProtocol;
+	typedef CheriaProtocol::DeviceState DeviceState;
+	
+	/* Announce all input devices with the first update: */
+	bool announce=!devicesCreated;
+	if(announce)
+		{
+		for(unsigned int i=0;i<devices.size();++i)
+			{
+			writeMessage(CheriaProtocol::CREATE_DEVICE,*pipe);
+			pipe->write<Card>(i+1);
+			devices[i]->writeLayout(*pipe);
+			}
+		devicesCreated=true;
+		}
+	
+	/* Create or destroy tools at the configured rate, keeping between one and two tools per input device: */
+	pendingToolChanges+=config.toolRate*dt;
+	for(;pendingToolChanges>=1.0;pendingToolChanges-=1.0)
+		{
+		if(toolIds.size()<devices.size()||(toolIds.size()<devices.size()*2&&Math::randUniformCO()<0.5))
+			{
+			/* Create a tool bound to the first button of a random input device: */
+			CheriaProtocol::ToolState tool("SyntheticTool",1,0);
+			tool.buttonSlots[0].deviceId=Math::randUniformCO(0,int(devices.size()))+1;
+			tool.buttonSlots[0].index=0;
+			writeMessage(CheriaProtocol::CREATE_TOOL,*pipe);
+			pipe->write<Card>(nextToolId);
+			tool.write(*pipe);
+			toolIds.push_back(nextToolId);
+			++nextToolId;
+			}
+		else
+			{
+			/* Destroy the oldest tool: */
+			writeMessage(CheriaProtocol::DESTROY_TOOL,*pipe);
+			pipe->write<Card>(toolIds.front());
+			toolIds.pop_front();
+			}
+		}
+	
+	/* Send the states of all input devices, which move continuously and occasionally toggle a button: */
+	writeMessage(CheriaProtocol::DEVICE_STATES,*pipe);
+	for(unsigned int i=0;i<devices.size();++i)
+		{
+		DeviceState& ds=*devices[i];
+		unsigned int updateMask=announce?DeviceState::FULL_UPDATE:DeviceState::TRANSFORM|DeviceState::VALUATOR;
+		ds.transform=getDeviceTransform(i);
+		ds.valuatorStates[0]=Scalar(sin(motionAngle*3.0));
+		if(Math::randUniformCO()<dt)
+			{
+			ds.buttonStates[0]^=0x1U;
+			updateMask|=DeviceState::BUTTON;
+			}
+		pipe->write<Card>(i+1);
+		ds.write(updateMask,cheriaPoseCodec,*pipe);
+		}
+	pipe->write<Card>(0);
+	}
+
+void LoadClient::writeGrapheinUpdate(double dt)
+	{
+	typedef Collaboration::GrapheinProtocol GrapheinProtocol;
+	
+	if(strokeCurveId==0)
+		{
+		/* Start new curves at the configured rate: */
+		pendingStrokes+=config.strokeRate*dt;
+		if(pendingStrokes>=1.0)
+			{
+			pendingStrokes-=floor(pendingStrokes);
+			
+			/* Delete the oldest curves if the client has too many: */
+			while(!curveIds.empty()&&curveIds.size()>=config.maxCurves)
+				{
+				writeMessage(GrapheinProtocol::DELETE_CURVE,*pipe);
+				pipe->write<Card>(curveIds.front());
+				curveIds.pop_front();
+				}
+			
+			/* Start a curve at a random position in front of the display: */
+			static const GLubyte palette[4][3]={{255,0,0},{0,255,0},{0,0,255},{255,255,0}};
+			GrapheinProtocol::Curve newCurve;
+			newCurve.lineWidth=GLfloat(1+Math::randUniformCO(0,3));
+			newCurve.color=GrapheinProtocol::Curve::Color(palette[Math::randUniformCO(0,4)]);
+			for(int i=0;i<3;++i)
+				penPosition[i]=Scalar((Math::randUniformCO()*2.0-1.0)*config.motionRadius);
+			newCurve.vertices.push_back(penPosition);
+			strokeCurveId=nextCurveId;
+			++nextCurveId;
+			strokeLength=1;
+			writeMessage(GrapheinProtocol::ADD_CURVE,*pipe);
+			pipe->write<Card>(strokeCurveId);
+			newCurve.write(*pipe);
+			curveIds.push_back(strokeCurveId);
+			}
+		}
+	else
+		{
+		/* Extend the current curve by one vertex, moving the pen in a small random step: */
+		for(int i=0;i<3;++i)
+			penPosition[i]+=Scalar(Math::randNormal(0.0,0.1));
+		writeMessage(GrapheinProtocol::APPEND_POINT,*pipe);
+		pipe->write<Card>(strokeCurveId);
+		write(penPosition,*pipe);
+		
+		/* Finish the curve once it has enough vertices: */
+		if(++strokeLength>=config.strokePoints)
+			strokeCurveId=0;
+		}
+	
+	/* Finish the message list: */
+	writeMessage(GrapheinProtocol::UPDATE_END,*pipe);
+	}
+
+void LoadClient::writeAgoraUpdate(double dt)
+	{
+	if(config.audio)
+		{
+		/* Send the SPEEX packets encoded since the last update at 50 packets per second, dropping what overflowed the encoder's queue: */
+		pendingSpeexPackets+=50.0*dt;
+		unsigned int numSpeexPackets=(unsigned int)(pendingSpeexPackets);
+		pendingSpeexPackets-=double(numSpeexPackets);
+		if(numSpeexPackets>speexQueueSize)
+			numSpeexPackets=speexQueueSize;
+		pipe->write<Misc::UInt16>(numSpeexPackets);
+		for(unsigned int i=0;i<numSpeexPackets;++i)
+			pipe->write(&config.noise[Math::randUniformCO(0,int(config.noise.size()-speexPacketSize))],speexPacketSize);
+		}
+	
+	if(config.videoPacketSize>0)
+		{
+		/* Check whether the emulated video encoder produced a new packet since the last update: */
+		pendingVideoPackets+=config.videoRate*dt;
+		if(pendingVideoPackets>=1.0)
+			{
+			/* Send only the most recent packet, like the video encoder's triple buffer, with a four times larger keyframe once per second: */
+			pendingVideoPackets-=floor(pendingVideoPackets);
+			Misc::SInt64 keyframeInterval=config.videoRate>=1.0?Misc::SInt64(config.videoRate):1;
+			if(videoPacketNo%keyframeInterval==0)
+				keyframePacketNo=videoPacketNo;
+			size_t packetSize=keyframePacketNo==videoPacketNo?config.videoPacketSize*4:config.videoPacketSize;
+			
+			/* Write the packet in the format of AgoraProtocol::VideoPacket: */
+			pipe->write<Byte>(1);
+			pipe->write<Misc::SInt8>(videoPacketNo==0?1:0);
+			pipe->write<Misc::SInt64>(keyframePacketNo);
+			pipe->write<Misc::SInt64>(videoPacketNo);
+			pipe->write<Card>(Card(packetSize));
+			pipe->write(&config.noise[Math::randUniformCO(0,int(config.noise.size()-packetSize)+1)],packetSize);
+			++videoPacketNo;
+			}
+		else
+			pipe->write<Byte>(0);
+		}
+	}
+
+void LoadClient::sendClientUpdate(void)
+	{
+	/* Advance the synthetic motion by the time since the last update: */
+	Misc::Time now=Misc::Time::now();
+	double dt=getElapsed(lastUpdateTime,now);
+	lastUpdateTime=now;
+	motionAngle+=config.motionSpeed*dt;
+	
+	/* Move the viewers: */
+	unsigned int updateMask=ClientState::NAVTRANSFORM;
+	if(config.motionSpeed!=0.0)
+		{
+		for(unsigned int i=0;i<state.numViewers;++i)
+			state.viewerStates[i]=getViewerTransform(i);
+		updateMask|=ClientState::VIEWER;
+		}
+	
+	/* Send the update's sequence number in the navigation transformation's translation, keeping it exactly representable as a scalar: */
+	if(++updateSequence>=0x1000000U)
+		updateSequence=1;
+	state.navTransform=OGTransform(Vector(Scalar(updateSequence),Scalar(0),Scalar(0)),Rotation::identity,Scalar(1));
+	
+	/* Send the client update message: */
+	writeMessage(CLIENT_UPDATE,*pipe);
+	writeClientState(updateMask,state,*pipe);
+	
+	/* Let the emulated protocol plug-ins send their updates: */
+	for(std::vector<ProtocolKind>::iterator pIt=protocols.begin();pIt!=protocols.end();++pIt)
+		switch(*pIt)
+			{
+			case CHERIA:
+				writeCheriaUpdate(dt);
+				break;
+			
+			case GRAPHEIN:
+				writeGrapheinUpdate(dt);
+				break;
+			
+			case AGORA:
+				writeAgoraUpdate(dt);
+				break;
+			}
+	
+	{
+	/* Remember when the update was sent, so other clients can measure its latency: */
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	SentUpdate& su=sentUpdates[updateSequence%numSentUpdates];
+	su.sequence=updateSequence;
+	su.time=Misc::Time::now();
+	}
+	
+	/* Finish the message: */
+	pipe->flush();
+	}
+
+void LoadClient::receiveClientConnect(void)
+	{
+	/* Read the new client's ID and full state: */
+	unsigned int clientId=pipe->read<Card>();
+	Misc::SelfDestructPointer<RemoteClient> newClient(new RemoteClient);
+	readClientState(newClient->state,*pipe);
+	
+	/* Check whether the new client is simulated by this process: */
+	newClient->source=0;
+	int pid;
+	unsigned int sourceIndex;
+	if(sscanf(newClient->state.clientName.c_str(),"LoadGenerator-%d-%u",&pid,&sourceIndex)==2&&pid==int(getpid())&&sourceIndex<clients.size())
+		newClient->source=clients[sourceIndex];
+	
+	/* Read the payloads of the protocol plug-ins shared with the new client: */
+	unsigned int numProtocols=pipe->read<Card>();
+	for(unsigned int i=0;i<numProtocols;++i)
+		{
+		unsigned int protocolIndex=pipe->read<Card>();
+		if(protocolIndex>=protocols.size())
+			Misc::throwStdErr("LoadClient::receiveClientConnect: Invalid protocol index %u",protocolIndex);
+		RemoteProtocol rp;
+		rp.kind=protocols[protocolIndex];
+		rp.hasSpeex=false;
+		rp.speexPacketSize=0;
+		rp.hasTheora=false;
+		switch(rp.kind)
+			{
+			case CHERIA:
+				/* Skip the size-prefixed device and tool creation messages: */
+				pipe->skip<Byte>(pipe->read<Card>());
+				break;
+			
+			case GRAPHEIN:
+				{
+				/* Skip the new client's curves: */
+				unsigned int numCurves=pipe->read<Card>();
+				for(unsigned int j=0;j<numCurves;++j)
+					{
+					pipe->read<Card>();
+					curve.read(*pipe);
+					}
+				break;
+				}
+			
+			case AGORA:
+				/* Read the new client's audio format, skipping its mouth position: */
+				read<Point>(*pipe);
+				rp.hasSpeex=pipe->read<Card>()>0;
+				rp.speexPacketSize=pipe->read<Card>();
+				
+				/* Read the new client's video streaming flag, and skip its video transformation, video size, and Theora stream headers: */
+				rp.hasTheora=pipe->read<Byte>()!=0;
+				if(rp.hasTheora)
+					{
+					read<ONTransform>(*pipe);
+					pipe->skip<Scalar>(2);
+					pipe->skip<Byte>(pipe->read<Card>());
+					}
+				break;
+			}
+		newClient->protocols.push_back(rp);
+		}
+	
+	/* Add the new client to the map, replacing a stale entry: */
+	RemoteClientMap::Iterator rcIt=remoteClients.findEntry(clientId);
+	if(!rcIt.isFinished())
+		{
+		delete rcIt->getDest();
+		remoteClients.removeEntry(rcIt);
+		}
+	remoteClients.setEntry(RemoteClientMap::Entry(clientId,newClient.releaseTarget()));
+	}
+
+void LoadClient::receiveServerUpdate(const Misc::Time& receiveTime)
+	{
+	LoadStatistics update;
+	update.numServerUpdates=1;
+	
+	/* Read the new states of all other clients: */
+	unsigned int numClients=pipe->read<Card>();
+	for(unsigned int clientIndex=0;clientIndex<numClients;++clientIndex)
+		{
+		unsigned int clientId=pipe->read<Card>();
+		RemoteClientMap::Iterator rcIt=remoteClients.findEntry(clientId);
+		if(rcIt.isFinished())
+			Misc::throwStdErr("LoadClient::receiveServerUpdate: Received update for unknown client %u",clientId);
+		RemoteClient* rc=rcIt->getDest();
+		rc->state.updateMask=ClientState::NO_CHANGE;
+		readClientState(rc->state,*pipe);
+		
+		/* Measure the latency of updates from simulated clients by the sequence numbers in their navigation transformations: */
+		Misc::Time sentTime;
+		if(rc->source!=0&&(rc->state.updateMask&ClientState::NAVTRANSFORM)!=0&&rc->source->getSentTime((unsigned int)(rc->state.navTransform.getTranslation()[0]),sentTime))
+			{
+			double latency=getElapsed(sentTime,receiveTime);
+			++update.numLatencies;
+			update.latencySum+=latency;
+			if(update.latencyMax<latency)
+				update.latencyMax=latency;
+			}
+		
+		/* Skip the payloads of the protocol plug-ins shared with the client: */
+		for(std::vector<RemoteProtocol>::iterator rpIt=rc->protocols.begin();rpIt!=rc->protocols.end();++rpIt)
+			switch(rpIt->kind)
+				{
+				case CHERIA:
+				case GRAPHEIN:
+					/* Skip the size-prefixed message list: */
+					pipe->skip<Byte>(pipe->read<Card>());
+					break;
+				
+				case AGORA:
+					/* Skip the audio packets and read a video packet: */
+					if(rpIt->hasSpeex)
+						{
+						size_t numSpeexPackets=pipe->read<Misc::UInt16>();
+						pipe->skip<Byte>(numSpeexPackets*rpIt->speexPacketSize);
+						}
+					if(rpIt->hasTheora&&pipe->read<Byte>()!=0)
+						videoPacket.read(*pipe);
+					break;
+				}
+		}
+	
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	intervalStatistics.add(update);
+	totalStatistics.add(update);
+	}
+
+void* LoadClient::communicationThreadMethod(void)
+	{
+	try
+		{
+		bool disconnectSent=false;
+		bool goOn=true;
+		while(goOn)
+			{
+			/* Wait for the next message: */
+			MessageIdType message=readMessage(*pipe);
+			Misc::Time receiveTime=Misc::Time::now();
+			
+			switch(message)
+				{
+				case DISCONNECT_REPLY:
+					goOn=false;
+					break;
+				
+				case CLIENT_CONNECT:
+					receiveClientConnect();
+					break;
+				
+				case CLIENT_DISCONNECT:
+					{
+					/* Remove the client from the map: */
+					RemoteClientMap::Iterator rcIt=remoteClients.findEntry(pipe->read<Card>());
+					if(!rcIt.isFinished())
+						{
+						delete rcIt->getDest();
+						remoteClients.removeEntry(rcIt);
+						}
+					break;
+					}
+				
+				case SERVER_UPDATE:
+					receiveServerUpdate(receiveTime);
+					
+					/* Respond with a client update like a real client, or ask to disconnect: */
+					if(disconnectRequested)
+						{
+						if(!disconnectSent)
+							{
+							writeMessage(DISCONNECT_REQUEST,*pipe);
+							pipe->flush();
+							disconnectSent=true;
+							}
+						}
+					else
+						sendClientUpdate();
+					break;
+				
+				default:
+					Misc::throwStdErr("LoadClient: Protocol error, received message %d",int(message));
+				}
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		Threads::Mutex::Lock statisticsLock(statisticsMutex);
+		errorMessage=err.what();
+		}
+	
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	finished=true;
+	
+	return 0;
+	}
+
+LoadClient::LoadClient(const LoadConfiguration& sConfig,const LoadClientList& sClients,unsigned int sIndex)
+	:config(sConfig),clients(sClients),index(sIndex),
+	 connected(false),disconnectRequested(false),
+	 updateSequence(0),motionAngle(Math::randUniformCO()*2.0*M_PI),
+	 devicesCreated(false),pendingToolChanges(0.0),nextToolId(1),
+	 pendingStrokes(0.0),nextCurveId(1),strokeCurveId(0),strokeLength(0),
+	 pendingSpeexPackets(0.0),pendingVideoPackets(0.0),videoPacketNo(0),keyframePacketNo(0),
+	 remoteClients(17),
+	 finished(false)
+	{
+	/* Initialize the client's environment in inches, with a name by which other simulated clients recognize it: */
+	char clientName[64];
+	snprintf(clientName,sizeof(clientName),"LoadGenerator-%d-%u",int(getpid()),index);
+	state.clientName=clientName;
+	state.displaySize=Scalar(60);
+	state.resize(config.numViewers);
+	for(unsigned int i=0;i<state.numViewers;++i)
+		state.viewerStates[i]=getViewerTransform(i);
+	
+	/* Create the emulated input devices, tracked in position and orientation with two buttons and one valuator each: */
+	for(unsigned int i=0;i<config.numDevices;++i)
+		{
+		Collaboration::CheriaProtocol::DeviceState* device=new Collaboration::CheriaProtocol::DeviceState(0x7,2,1);
+		device->frameCenter=state.displayCenter;
+		device->frameSize=state.displaySize;
+		devices.push_back(device);
+		}
+	
+	/* Mark all remembered client updates as invalid: */
+	for(unsigned int i=0;i<numSentUpdates;++i)
+		sentUpdates[i].sequence=0;
+	}
+
+LoadClient::~LoadClient(void)
+	{
+	if(connected)
+		{
+		if(isActive())
+			{
+			/* Unblock the communication thread if the server did not reply to the disconnect request: */
+			try
+				{
+				pipe->shutdown(true,true);
+				}
+			catch(std::runtime_error err)
+				{
+				}
+			}
+		communicationThread.join();
+		}
+	
+	/* Delete all remote clients and input devices: */
+	for(RemoteClientMap::Iterator rcIt=remoteClients.begin();!rcIt.isFinished();++rcIt)
+		delete rcIt->getDest();
+	for(std::vector<Collaboration::CheriaProtocol::DeviceState*>::iterator dIt=devices.begin();dIt!=devices.end();++dIt)
+		delete *dIt;
+	}
+
+void LoadClient::connect(const char* hostName,int portId)
+	{
+	/* Connect to the server: */
+	pipe=new Pipe(*this,hostName,portId);
+	pipe->negotiateEndianness();
+	
+	/* Send a connect request with the client's full state: */
+	writeMessage(CONNECT_REQUEST,*pipe);
+	writeClientState(ClientState::FULL_UPDATE,state,*pipe);
+	
+	/* Offer the protocol plug-ins needed for the configured traffic: */
+	std::vector<ProtocolKind> offeredProtocols;
+	if(!devices.empty())
+		offeredProtocols.push_back(CHERIA);
+	if(config.strokeRate>0.0)
+		offeredProtocols.push_back(GRAPHEIN);
+	if(config.audio||config.videoPacketSize>0)
+		offeredProtocols.push_back(AGORA);
+	pipe->write<Card>(offeredProtocols.size()+(config.sessionName.empty()?0:1));
+	for(std::vector<ProtocolKind>::iterator opIt=offeredProtocols.begin();opIt!=offeredProtocols.end();++opIt)
+		switch(*opIt)
+			{
+			case CHERIA:
+				write(std::string(Collaboration::CheriaProtocol::protocolName),*pipe);
+				writeCheriaRequest();
+				break;
+			
+			case GRAPHEIN:
+				write(std::string(Collaboration::GrapheinProtocol::protocolName),*pipe);
+				writeGrapheinRequest();
+				break;
+			
+			case AGORA:
+				write(std::string(Collaboration::AgoraProtocol::protocolName),*pipe);
+				writeAgoraRequest();
+				break;
+			}
+	if(!config.sessionName.empty())
+		{
+		/* Request to join a named session in a reserved entry: */
+		write(std::string(sessionProtocolName),*pipe);
+		pipe->write<Card>(config.sessionName.size());
+		pipe->write<char>(config.sessionName.data(),config.sessionName.size());
+		}
+	pipe->flush();
+	
+	/* Wait for the server's reply: */
+	if(readMessage(*pipe)!=CONNECT_REPLY)
+		Misc::throwStdErr("LoadClient::connect: Connection refused by server");
+	
+	/* Read the negotiated protocol plug-ins in server order: */
+	unsigned int numNegotiatedProtocols=pipe->read<Card>();
+	for(unsigned int i=0;i<numNegotiatedProtocols;++i)
+		{
+		unsigned int protocolIndex=pipe->read<Card>();
+		if(protocolIndex>=offeredProtocols.size())
+			Misc::throwStdErr("LoadClient::connect: Server accepted unknown protocol %u",protocolIndex);
+		
+		/* Skip the message ID base; none of the emulated protocol plug-ins receive protocol messages outside of server updates: */
+		pipe->read<Card>();
+		
+		if(offeredProtocols[protocolIndex]==CHERIA)
+			{
+			/* Read the precision of the server's pose codec: */
+			unsigned int positionBits=pipe->read<Card>();
+			unsigned int rotationBits=pipe->read<Card>();
+			cheriaPoseCodec=Collaboration::PoseCodec(positionBits,rotationBits);
+			}
+		
+		protocols.push_back(offeredProtocols[protocolIndex]);
+		}
+	
+	/* Start responding to server updates: */
+	connectTime=Misc::Time::now();
+	lastUpdateTime=connectTime;
+	communicationThread.start(this,&LoadClient::communicationThreadMethod);
+	connected=true;
+	}
+
+void LoadClient::requestDisconnect(void)
+	{
+	disconnectRequested=true;
+	}
+
+bool LoadClient::isActive(void)
+	{
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	return connected&&!finished;
+	}
+
+LoadStatistics LoadClient::takeIntervalStatistics(void)
+	{
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	LoadStatistics result=intervalStatistics;
+	intervalStatistics=LoadStatistics();
+	return result;
+	}
+
+LoadStatistics LoadClient::getTotalStatistics(void)
+	{
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	return totalStatistics;
+	}
+
+std::string LoadClient::getErrorMessage(void)
+	{
+	Threads::Mutex::Lock statisticsLock(statisticsMutex);
+	return errorMessage;
+	}
+
+void printReport(const LoadClientList& clients,double interval) // Prints the statistics of all clients over the last report interval
+	{
+	/* Accumulate the statistics of all clients: */
+	LoadStatistics sum;
+	unsigned int numActive=0;
+	for(LoadClientList::const_iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		{
+		if((*cIt)->isActive())
+			++numActive;
+		sum.add((*cIt)->takeIntervalStatistics());
+		}
+	
+	/* Print per-client averages: */
+	std::cout<<"LoadGenerator: "<<numActive<<" clients";
+	if(numActive>0)
+		{
+		std::cout<<", "<<double(sum.numServerUpdates)/(double(numActive)*interval)<<" server updates/s";
+		if(sum.numLatencies>0)
+			std::cout<<", latency mean "<<sum.latencySum*1000.0/double(sum.numLatencies)<<" ms, max "<<sum.latencyMax*1000.0<<" ms";
+		std::cout<<", "<<double(sum.receivedBytes)/(double(numActive)*interval*1024.0)<<" KB/s received per client";
+		}
+	std::cout<<std::endl;
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		std::string serverHostName="localhost";
+		int serverPortId=26000;
+		unsigned int numClients=10;
+		double connectInterval=0.0;
+		double duration=0.0;
+		double reportInterval=1.0;
+		LoadConfiguration config;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"host")==0&&i+1<argc)
+					serverHostName=argv[++i];
+				else if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+					serverPortId=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"clients")==0&&i+1<argc)
+					numClients=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"connectInterval")==0&&i+1<argc)
+					connectInterval=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"duration")==0&&i+1<argc)
+					duration=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"report")==0&&i+1<argc)
+					reportInterval=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"session")==0&&i+1<argc)
+					config.sessionName=argv[++i];
+				else if(strcasecmp(argv[i]+1,"viewers")==0&&i+1<argc)
+					config.numViewers=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"motionRadius")==0&&i+1<argc)
+					config.motionRadius=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"motionSpeed")==0&&i+1<argc)
+					config.motionSpeed=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"devices")==0&&i+1<argc)
+					config.numDevices=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"toolRate")==0&&i+1<argc)
+					config.toolRate=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"strokeRate")==0&&i+1<argc)
+					config.strokeRate=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"strokePoints")==0&&i+1<argc)
+					config.strokePoints=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"maxCurves")==0&&i+1<argc)
+					config.maxCurves=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"noAudio")==0)
+					config.audio=false;
+				else if(strcasecmp(argv[i]+1,"videoSize")==0&&i+1<argc)
+					config.videoPacketSize=size_t(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"videoRate")==0&&i+1<argc)
+					config.videoRate=atof(argv[++i]);
+				else
+					std::cerr<<"LoadGenerator: ignored option "<<argv[i]<<std::endl;
+				}
+			else
+				std::cerr<<"LoadGenerator: ignored argument "<<argv[i]<<std::endl;
+			}
+		if(config.strokePoints<1)
+			config.strokePoints=1;
+		if(config.maxCurves<1)
+			config.maxCurves=1;
+		if(reportInterval<=0.0)
+			reportInterval=1.0;
+		
+		/* Create incompressible media payloads large enough for Theora headers and video keyframes: */
+		size_t noiseSize=config.videoPacketSize*4+4096;
+		config.noise.reserve(noiseSize);
+		for(size_t i=0;i<noiseSize;++i)
+			config.noise.push_back(Misc::UInt8(Math::randUniformCO(0,256)));
+		
+		/* Ignore SIGPIPE and leave handling of pipe errors to TCP sockets: */
+		struct sigaction sigPipeAction;
+		sigPipeAction.sa_handler=SIG_IGN;
+		sigemptyset(&sigPipeAction.sa_mask);
+		sigPipeAction.sa_flags=0x0;
+		sigaction(SIGPIPE,&sigPipeAction,0);
+		
+		/* Stop generating load on SIG_INT: */
+		struct sigaction sigIntAction;
+		memset(&sigIntAction,0,sizeof(struct sigaction));
+		sigIntAction.sa_handler=termSignalHandler;
+		if(sigaction(SIGINT,&sigIntAction,0)!=0)
+			std::cerr<<"LoadGenerator: Cannot intercept SIG_INT signals. Clients won't disconnect cleanly."<<std::endl;
+		sigset_t sigIntSet;
+		sigemptyset(&sigIntSet);
+		sigaddset(&sigIntSet,SIGINT);
+		
+		/* Create all clients before connecting any, so that every client can find the senders of the updates it receives: */
+		LoadClientList clients;
+		clients.reserve(numClients);
+		for(unsigned int i=0;i<numClients;++i)
+			clients.push_back(new LoadClient(config,clients,i));
+		
+		/* Connect the clients: */
+		Misc::Time start=Misc::Time::now();
+		unsigned int numConnected=0;
+		for(LoadClientList::iterator cIt=clients.begin();cIt!=clients.end()&&runLoadGenerator;++cIt)
+			{
+			/* Block SIG_INT in the client's communication thread, so it interrupts the main thread: */
+			pthread_sigmask(SIG_BLOCK,&sigIntSet,0);
+			try
+				{
+				(*cIt)->connect(serverHostName.c_str(),serverPortId);
+				++numConnected;
+				}
+			catch(std::runtime_error err)
+				{
+				std::cerr<<"LoadGenerator: Unable to connect "<<(*cIt)->getName()<<" due to exception "<<err.what()<<std::endl;
+				}
+			pthread_sigmask(SIG_UNBLOCK,&sigIntSet,0);
+			
+			if(connectInterval>0.0)
+				Misc::sleep(connectInterval);
+			}
+		std::cout<<"LoadGenerator: Connected "<<numConnected<<" of "<<numClients<<" clients to "<<serverHostName<<':'<<serverPortId<<" in "<<getElapsed(start,Misc::Time::now())<<" s"<<std::endl;
+		
+		/* Generate load until interrupted or the requested duration has passed, and report periodically: */
+		Misc::Time lastReport=Misc::Time::now();
+		while(runLoadGenerator&&(duration<=0.0||getElapsed(start,lastReport)<duration))
+			{
+			Misc::sleep(0.05);
+			Misc::Time now=Misc::Time::now();
+			double interval=getElapsed(lastReport,now);
+			if(interval>=reportInterval)
+				{
+				printReport(clients,interval);
+				lastReport=now;
+				}
+			}
+		
+		/* Ask all clients to disconnect after their next server update, and give the server time to reply: */
+		for(LoadClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+			(*cIt)->requestDisconnect();
+		Misc::Time disconnectStart=Misc::Time::now();
+		bool anyActive=true;
+		while(anyActive&&getElapsed(disconnectStart,Misc::Time::now())<5.0)
+			{
+			Misc::sleep(0.05);
+			anyActive=false;
+			for(LoadClientList::iterator cIt=clients.begin();cIt!=clients.end()&&!anyActive;++cIt)
+				anyActive=(*cIt)->isActive();
+			}
+		
+		/* Print a summary for every client: */
+		Misc::Time end=Misc::Time::now();
+		for(LoadClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+			{
+			LoadStatistics s=(*cIt)->getTotalStatistics();
+			double connectedTime=getElapsed((*cIt)->getConnectTime(),end);
+			std::cout<<(*cIt)->getName()<<": "<<s.numServerUpdates<<" server updates";
+			if(s.numServerUpdates>0)
+				std::cout<<" ("<<double(s.numServerUpdates)/connectedTime<<"/s)";
+			if(s.numLatencies>0)
+				std::cout<<", latency mean "<<s.latencySum*1000.0/double(s.numLatencies)<<" ms, max "<<s.latencyMax*1000.0<<" ms";
+			std::cout<<", received "<<s.receivedBytes<<" bytes";
+			if(s.numServerUpdates>0)
+				std::cout<<" ("<<double(s.receivedBytes)/(connectedTime*1024.0)<<" KB/s)";
+			std::string error=(*cIt)->getErrorMessage();
+			if(!error.empty())
+				std::cout<<", stopped due to exception "<<error;
+			std::cout<<std::endl;
+			}
+		
+		/* Disconnect all clients: */
+		for(LoadClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+			delete *cIt;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,498 @@
+/***********************************************************************
+MarshallingBenchmark - Utility to measure the throughput of the protocol
+encoders and decoders on memory files, in native and swapped byte order.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <Misc/SizedTypes.h>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Time.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
+
+#include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/PoseCodec.h>
+#include <Collaboration/CheriaProtocol.h>
+#include <Collaboration/GrapheinProtocol.h>
+#include <Collaboration/AgoraProtocol.h>
+
+typedef Collaboration::CollaborationProtocol::ClientState ClientState;
+typedef Collaboration::CheriaProtocol::DeviceState DeviceState;
+typedef Collaboration::CheriaProtocol::ToolState ToolState;
+typedef Collaboration::GrapheinProtocol::Curve Curve;
+typedef Collaboration::AgoraProtocol::VideoPacket VideoPacket;
+typedef Collaboration::Protocol::Byte Byte;
+typedef Collaboration::Protocol::Card Card;
+typedef Collaboration::Protocol::Scalar Scalar;
+typedef Collaboration::Protocol::Point Point;
+typedef Collaboration::Protocol::Vector Vector;
+typedef Collaboration::Protocol::Rotation Rotation;
+typedef Collaboration::Protocol::ONTransform ONTransform;
+typedef Collaboration::Protocol::OGTransform OGTransform;
+
+double getElapsed(const Misc::Time& start,const Misc::Time& end) // Returns the time between the given start and end times in seconds
+	{
+	Misc::Time elapsed=end-start;
+	return double(elapsed.tv_sec)+double(elapsed.tv_nsec)/1.0e9;
+	}
+
+IO::FixedMemoryFile* readBack(const IO::VariableMemoryFile& message) // Copies encoded messages into contiguous memory to be read like a receiving client
+	{
+	size_t messageSize=message.getDataSize();
+	IO::FixedMemoryFile packet(messageSize);
+	message.writeToSink(packet);
+	packet.flush();
+	IO::FixedMemoryFile* reader=new IO::FixedMemoryFile(messageSize);
+	memcpy(reader->getMemory(),packet.getMemory(),messageSize);
+	return reader;
+	}
+
+class MarshallingCase // Base class for messages whose encoding and decoding are timed
+	{
+	/* Elements: */
+	private:
+	std::string name; // Name of the message type for reporting
+	
+	/* Constructors and destructors: */
+	public:
+	MarshallingCase(const char* sName)
+		:name(sName)
+		{
+		}
+	virtual ~MarshallingCase(void)
+		{
+		}
+	
+	/* Methods: */
+	const std::string& getName(void) const // Returns the message type's name
+		{
+		return name;
+		}
+	virtual void write(IO::File& sink) =0; // Writes one message to the given sink
+	virtual void read(IO::File& source) =0; // Reads one message from the given source
+	};
+
+class ClientStateCase:public MarshallingCase // Client state updates as sent in server updates
+	{
+	/* Elements: */
+	private:
+	unsigned int updateMask; // Update mask selecting the parts of the client state to send
+	const Collaboration::PoseCodec& poseCodec; // Codec writing the viewer states and navigation transformation
+	ClientState state; // Sent client state
+	ClientState received; // Received client state
+	
+	/* Constructors and destructors: */
+	public:
+	ClientStateCase(const char* sName,unsigned int sUpdateMask,const Collaboration::PoseCodec& sPoseCodec)
+		:MarshallingCase(sName),
+		 updateMask(sUpdateMask),poseCodec(sPoseCodec)
+		{
+		/* Create a client with two viewers in an environment the size of a CAVE, in inches: */
+		state.resize(2);
+		state.clientName="MarshallingBenchmark";
+		state.displayCenter=Point(0,0,60);
+		state.displaySize=Scalar(60);
+		state.viewerStates[0]=ONTransform(Vector(2,-1,66),Rotation::rotateZ(Scalar(0.3)));
+		state.viewerStates[1]=ONTransform(Vector(-3,2,64),Rotation::rotateZ(Scalar(-0.2)));
+		state.navTransform=OGTransform(Vector(120,-35,0),Rotation::rotateZ(Scalar(1.1)),Scalar(0.5));
+		
+		/* Prepare the receiver for pose-only updates: */
+		received=state;
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		Collaboration::CollaborationProtocol::writeClientState(updateMask,state,poseCodec,sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		Collaboration::CollaborationProtocol::readClientState(received,poseCodec,source);
+		}
+	};
+
+const int deviceTrackType=0x7; // Tracking type of a fully tracked six-degree-of-freedom device
+
+void initDevice(DeviceState& device) // Sets a device state to a typical wand pose and input state
+	{
+	device.frameCenter=Point(0,0,60);
+	device.frameSize=Scalar(60);
+	device.rayDirection=Vector(0,1,0);
+	device.rayStart=Scalar(-2);
+	device.transform=ONTransform(Vector(8,12,42),Rotation::rotateZ(Scalar(0.4)));
+	device.linearVelocity=Vector(Scalar(0.5),Scalar(-1.25),Scalar(0.1));
+	device.angularVelocity=Vector(Scalar(0.01),Scalar(0.2),Scalar(-0.05));
+	for(unsigned int i=0;i<(device.numButtons+7)/8;++i)
+		device.buttonStates[i]=Byte(0x5aU+i);
+	for(unsigned int i=0;i<device.numValuators;++i)
+		device.valuatorStates[i]=Scalar(i+1)*Scalar(0.25);
+	}
+
+class DeviceLayoutCase:public MarshallingCase // Device layouts as sent when a device is created
+	{
+	/* Elements: */
+	private:
+	DeviceState device; // Sent device state
+	
+	/* Constructors and destructors: */
+	public:
+	DeviceLayoutCase(unsigned int numButtons,unsigned int numValuators)
+		:MarshallingCase("DeviceState layout"),
+		 device(deviceTrackType,numButtons,numValuators)
+		{
+		initDevice(device);
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		device.writeLayout(sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		/* Create a device from the layout like a receiving client: */
+		DeviceState received(source);
+		}
+	};
+
+class DeviceStateCase:public MarshallingCase // Device states as sent in server updates
+	{
+	/* Elements: */
+	private:
+	unsigned int updateMask; // Update mask selecting the parts of the device state to send
+	const Collaboration::PoseCodec& poseCodec; // Codec writing the device's position and orientation
+	DeviceState device; // Sent device state
+	DeviceState received; // Received device state
+	
+	/* Constructors and destructors: */
+	public:
+	DeviceStateCase(const char* sName,unsigned int sUpdateMask,const Collaboration::PoseCodec& sPoseCodec,unsigned int numButtons,unsigned int numValuators)
+		:MarshallingCase(sName),
+		 updateMask(sUpdateMask),poseCodec(sPoseCodec),
+		 device(deviceTrackType,numButtons,numValuators),
+		 received(deviceTrackType,numButtons,numValuators)
+		{
+		initDevice(device);
+		received.frameCenter=device.frameCenter;
+		received.frameSize=device.frameSize;
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		device.write(updateMask,poseCodec,sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		received.read(poseCodec,source);
+		}
+	};
+
+class ToolStateCase:public MarshallingCase // Tool states as sent when a tool is created
+	{
+	/* Elements: */
+	private:
+	ToolState tool; // Sent tool state
+	
+	/* Constructors and destructors: */
+	public:
+	ToolStateCase(void)
+		:MarshallingCase("ToolState"),
+		 tool("RayMenuTool",2,1)
+		{
+		for(unsigned int i=0;i<tool.numButtonSlots;++i)
+			{
+			tool.buttonSlots[i].deviceId=1;
+			tool.buttonSlots[i].index=i;
+			}
+		for(unsigned int i=0;i<tool.numValuatorSlots;++i)
+			{
+			tool.valuatorSlots[i].deviceId=1;
+			tool.valuatorSlots[i].index=i;
+			}
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		tool.write(sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		/* Create a tool like a receiving client: */
+		ToolState received(source);
+		}
+	};
+
+class CurveCase:public MarshallingCase // Graphein curves as sent when a curve is finished
+	{
+	/* Elements: */
+	private:
+	Curve curve; // Sent curve
+	Curve received; // Received curve
+	
+	/* Constructors and destructors: */
+	public:
+	CurveCase(unsigned int numVertices)
+		:MarshallingCase("Graphein Curve")
+		{
+		/* Create a spiral stroke: */
+		curve.lineWidth=3.0f;
+		curve.color=Curve::Color(255,128,0);
+		curve.vertices.reserve(numVertices);
+		for(unsigned int i=0;i<numVertices;++i)
+			{
+			double angle=double(i)*0.1;
+			double radius=2.0+double(i)*0.05;
+			curve.vertices.push_back(Point(Scalar(radius*cos(angle)),Scalar(radius*sin(angle)),Scalar(48.0+double(i)*0.01)));
+			}
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		curve.write(sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		received.read(source);
+		}
+	};
+
+class VideoPacketCase:public MarshallingCase // Agora Theora packets as forwarded in server updates
+	{
+	/* Elements: */
+	private:
+	VideoPacket packet; // Sent video packet
+	VideoPacket received; // Received video packet
+	
+	/* Constructors and destructors: */
+	public:
+	VideoPacketCase(size_t packetSize)
+		:MarshallingCase("Agora VideoPacket")
+		{
+		/* Create the packet by reading it from a hand-made message, as packets have no other public setters: */
+		IO::VariableMemoryFile message;
+		message.write<Misc::SInt8>(0);
+		message.write<Misc::SInt64>(1200);
+		message.write<Misc::SInt64>(1234);
+		message.write<Card>(Card(packetSize));
+		for(size_t i=0;i<packetSize;++i)
+			message.write<Misc::UInt8>(Misc::UInt8(i*37U+11U));
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> reader(readBack(message));
+		packet.read(*reader);
+		}
+	
+	/* Methods from MarshallingCase: */
+	virtual void write(IO::File& sink)
+		{
+		packet.write(sink);
+		}
+	virtual void read(IO::File& source)
+		{
+		received.read(source);
+		}
+	};
+
+struct Result // Structure for the best timings of one message type in one byte order
+	{
+	/* Elements: */
+	public:
+	size_t messageSize; // Size of one encoded message in bytes
+	unsigned int numMessages; // Number of messages encoded and decoded per pass
+	double writeTime; // Shortest time to encode all messages in seconds
+	double readTime; // Shortest time to decode all messages in seconds
+	};
+
+Result runCase(MarshallingCase& mc,bool swap,size_t passSize,unsigned int numPasses) // Times encoding and decoding of one message type in the given byte order
+	{
+	Result result;
+	
+	/* Determine the size of one message and the number of messages to fill one pass: */
+	IO::VariableMemoryFile probe;
+	mc.write(probe);
+	result.messageSize=probe.getDataSize();
+	result.numMessages=(unsigned int)(passSize/result.messageSize);
+	if(result.numMessages<1000)
+		result.numMessages=1000;
+	
+	result.writeTime=result.readTime=HUGE_VAL;
+	for(unsigned int pass=0;pass<numPasses;++pass)
+		{
+		/* Encode all messages into a growing memory file, like a server update message buffer: */
+		IO::VariableMemoryFile sink;
+		sink.setSwapOnWrite(swap);
+		Misc::Time writeStart=Misc::Time::now();
+		for(unsigned int i=0;i<result.numMessages;++i)
+			mc.write(sink);
+		double writeTime=getElapsed(writeStart,Misc::Time::now());
+		if(result.writeTime>writeTime)
+			result.writeTime=writeTime;
+		
+		if(sink.getDataSize()!=result.messageSize*result.numMessages)
+			Misc::throwStdErr("MarshallingBenchmark: %s messages do not have constant size",mc.getName().c_str());
+		
+		/* Decode all messages from contiguous memory, like a receiving client: */
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> source(readBack(sink));
+		source->setSwapOnRead(swap);
+		Misc::Time readStart=Misc::Time::now();
+		for(unsigned int i=0;i<result.numMessages;++i)
+			mc.read(*source);
+		double readTime=getElapsed(readStart,Misc::Time::now());
+		if(result.readTime>readTime)
+			result.readTime=readTime;
+		
+		/* Check that the decoder consumed exactly what the encoder produced: */
+		if(!source->eof())
+			Misc::throwStdErr("MarshallingBenchmark: %s decoder did not consume all encoded data",mc.getName().c_str());
+		}
+	
+	return result;
+	}
+
+void printResult(const MarshallingCase& mc,bool swap,const Result& result) // Prints the timings of one message type in one byte order
+	{
+	double totalBytes=double(result.messageSize)*double(result.numMessages);
+	std::cout<<std::left<<std::setw(28)<<mc.getName()<<std::setw(8)<<(swap?"swapped":"native")<<std::right;
+	std::cout<<std::setw(8)<<result.messageSize<<" B";
+	std::cout<<std::fixed<<std::setprecision(1);
+	std::cout<<std::setw(10)<<result.writeTime*1.0e9/double(result.numMessages)<<" ns";
+	std::cout<<std::setprecision(3);
+	std::cout<<std::setw(8)<<totalBytes/result.writeTime*1.0e-9<<" GB/s";
+	std::cout<<std::setprecision(1);
+	std::cout<<std::setw(10)<<result.readTime*1.0e9/double(result.numMessages)<<" ns";
+	std::cout<<std::setprecision(3);
+	std::cout<<std::setw(8)<<totalBytes/result.readTime*1.0e-9<<" GB/s";
+	std::cout.unsetf(std::ios::floatfield);
+	std::cout<<std::setprecision(6)<<std::endl;
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		size_t passSize=16*1024*1024;
+		unsigned int numPasses=5;
+		unsigned int positionBits=16;
+		unsigned int rotationBits=12;
+		unsigned int numButtons=8;
+		unsigned int numValuators=2;
+		unsigned int curveVertices=100;
+		size_t videoPacketSize=1500;
+		bool runNative=true;
+		bool runSwapped=true;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"passSize")==0&&i+1<argc)
+					passSize=size_t(atof(argv[++i])*1024.0*1024.0);
+				else if(strcasecmp(argv[i]+1,"passes")==0&&i+1<argc)
+					numPasses=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"positionBits")==0&&i+1<argc)
+					positionBits=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"rotationBits")==0&&i+1<argc)
+					rotationBits=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"buttons")==0&&i+1<argc)
+					numButtons=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"valuators")==0&&i+1<argc)
+					numValuators=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"curveVertices")==0&&i+1<argc)
+					curveVertices=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"videoSize")==0&&i+1<argc)
+					videoPacketSize=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"nativeOnly")==0)
+					runSwapped=false;
+				else if(strcasecmp(argv[i]+1,"swappedOnly")==0)
+					runNative=false;
+				else
+					std::cerr<<"MarshallingBenchmark: ignored option "<<argv[i]<<std::endl;
+				}
+			else
+				std::cerr<<"MarshallingBenchmark: ignored argument "<<argv[i]<<std::endl;
+			}
+		if(numPasses<1)
+			numPasses=1;
+		
+		/* Create the pose codecs: */
+		Collaboration::PoseCodec rawCodec;
+		Collaboration::PoseCodec quantizedCodec(positionBits,rotationBits);
+		
+		/* Create the message types to measure: */
+		std::vector<MarshallingCase*> cases;
+		cases.push_back(new ClientStateCase("ClientState full",ClientState::FULL_UPDATE,rawCodec));
+		cases.push_back(new ClientStateCase("ClientState pose",ClientState::VIEWER|ClientState::NAVTRANSFORM,rawCodec));
+		cases.push_back(new ClientStateCase("ClientState pose quantized",ClientState::VIEWER|ClientState::NAVTRANSFORM,quantizedCodec));
+		cases.push_back(new DeviceLayoutCase(numButtons,numValuators));
+		cases.push_back(new DeviceStateCase("DeviceState full",DeviceState::FULL_UPDATE,rawCodec,numButtons,numValuators));
+		cases.push_back(new DeviceStateCase("DeviceState transform",DeviceState::TRANSFORM,rawCodec,numButtons,numValuators));
+		cases.push_back(new DeviceStateCase("DeviceState full quantized",DeviceState::FULL_UPDATE,quantizedCodec,numButtons,numValuators));
+		cases.push_back(new ToolStateCase);
+		cases.push_back(new CurveCase(curveVertices));
+		cases.push_back(new VideoPacketCase(videoPacketSize));
+		
+		/* Time all message types in the requested byte orders: */
+		std::cout<<"MarshallingBenchmark: best of "<<numPasses<<" passes of "<<double(passSize)/(1024.0*1024.0)<<" MB each"<<std::endl;
+		std::cout<<std::left<<std::setw(28)<<"Message"<<std::setw(8)<<"Order"<<std::right<<std::setw(10)<<"Size"<<std::setw(21)<<"Write"<<std::setw(21)<<"Read"<<std::endl;
+		bool ok=true;
+		for(std::vector<MarshallingCase*>::iterator cIt=cases.begin();cIt!=cases.end();++cIt)
+			{
+			for(int order=0;order<2;++order)
+				{
+				bool swap=order!=0;
+				if(swap?!runSwapped:!runNative)
+					continue;
+				try
+					{
+					Result result=runCase(**cIt,swap,passSize,numPasses);
+					printResult(**cIt,swap,result);
+					}
+				catch(std::runtime_error err)
+					{
+					std::cerr<<"Caught exception "<<err.what()<<" while timing "<<(*cIt)->getName()<<std::endl;
+					ok=false;
+					}
+				}
+			}
+		
+		/* Clean up: */
+		for(std::vector<MarshallingCase*>::iterator cIt=cases.begin();cIt!=cases.end();++cIt)
+			delete *cIt;
+		
+		if(!ok)
+			return 1;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,156 @@
+/***********************************************************************
+MassJoinBenchmark - Program to measure the cost of collaboration server
+updates while a large number of clients connect or disconnect at once.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <vector>
+#include <iostream>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/Time.h>
+
+#include <Collaboration/FakeClient.h>
+#include <Collaboration/CollaborationServer.h>
+
+typedef std::vector<Collaboration::FakeClient*> FakeClientList;
+
+double getElapsed(const Misc::Time& start) // Returns the time since the given start time in milliseconds
+	{
+	Misc::Time elapsed=Misc::Time::now()-start;
+	return double(elapsed.tv_sec)*1000.0+double(elapsed.tv_nsec)/1.0e6;
+	}
+
+double runTick(Collaboration::CollaborationServer& server,const FakeClientList& clients) // Runs and times one server update, and lets all clients discard what they received
+	{
+	for(FakeClientList::const_iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		(*cIt)->drain();
+	Misc::Time start=Misc::Time::now();
+	server.update();
+	return getElapsed(start);
+	}
+
+void runTicks(const char* phase,Collaboration::CollaborationServer& server,const FakeClientList& clients,unsigned int numTicks,Misc::Time tickTime) // Runs and times a number of server updates at the given interval
+	{
+	double sum=0.0;
+	double max=0.0;
+	for(unsigned int i=0;i<numTicks;++i)
+		{
+		Misc::sleep(tickTime);
+		double t=runTick(server,clients);
+		sum+=t;
+		if(max<t)
+			max=t;
+		}
+	if(numTicks>0)
+		std::cout<<phase<<": "<<clients.size()<<" clients, mean tick "<<sum/double(numTicks)<<" ms, max tick "<<max<<" ms"<<std::endl;
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Create a new configuration object: */
+		Misc::SelfDestructPointer<Collaboration::CollaborationServer::Configuration> cfg(new Collaboration::CollaborationServer::Configuration);
+		
+		/* Parse the command line: */
+		int listenPortId=-1;
+		unsigned int numResidents=0;
+		unsigned int numJoiners=100;
+		unsigned int numTicks=50;
+		Misc::Time tickTime(cfg->getTickTime());
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+					listenPortId=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"residents")==0&&i+1<argc)
+					numResidents=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"joiners")==0&&i+1<argc)
+					numJoiners=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"ticks")==0&&i+1<argc)
+					numTicks=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"tick")==0&&i+1<argc)
+					tickTime=Misc::Time(atof(argv[++i]));
+				else
+					std::cerr<<"MassJoinBenchmark: ignored option "<<argv[i]<<std::endl;
+				}
+			}
+		
+		/* Ignore SIGPIPE and leave handling of pipe errors to TCP sockets: */
+		struct sigaction sigPipeAction;
+		sigPipeAction.sa_handler=SIG_IGN;
+		sigemptyset(&sigPipeAction.sa_mask);
+		sigPipeAction.sa_flags=0x0;
+		sigaction(SIGPIPE,&sigPipeAction,0);
+		
+		/* Create the collaboration server object on the requested or any free port: */
+		cfg->setListenPortId(listenPortId);
+		Collaboration::CollaborationServer server(cfg.getTarget());
+		cfg.releaseTarget();
+		int serverPortId=server.getListenPortId();
+		std::cout<<"MassJoinBenchmark: Started server on port "<<serverPortId<<std::endl;
+		
+		/* Connect the resident clients one at a time, and let the server settle: */
+		FakeClientList clients;
+		for(unsigned int i=0;i<numResidents;++i)
+			{
+			clients.push_back(new Collaboration::FakeClient("localhost",serverPortId,i));
+			runTick(server,clients);
+			}
+		runTicks("Before join",server,clients,numTicks,tickTime);
+		
+		/* Connect all joining clients between two server updates: */
+		Misc::Time joinStart=Misc::Time::now();
+		for(unsigned int i=0;i<numJoiners;++i)
+			clients.push_back(new Collaboration::FakeClient("localhost",serverPortId,numResidents+i));
+		double joinTime=getElapsed(joinStart);
+		double joinTickTime=runTick(server,clients);
+		std::cout<<"Mass join: "<<numJoiners<<" clients connected in "<<joinTime<<" ms, join tick "<<joinTickTime<<" ms"<<std::endl;
+		runTicks("After join",server,clients,numTicks,tickTime);
+		
+		/* Disconnect all joining clients at once: */
+		for(unsigned int i=0;i<numJoiners;++i)
+			{
+			delete clients.back();
+			clients.pop_back();
+			}
+		
+		/* Give the server's communication threads time to notice the closed connections: */
+		Misc::sleep(0.5);
+		double leaveTickTime=runTick(server,clients);
+		std::cout<<"Mass leave: "<<numJoiners<<" clients disconnected, leave tick "<<leaveTickTime<<" ms"<<std::endl;
+		runTicks("After leave",server,clients,numTicks,tickTime);
+		
+		/* Disconnect the resident clients: */
+		for(FakeClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+			delete *cIt;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
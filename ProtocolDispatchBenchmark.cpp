@@ -0,0 +1,234 @@
+/***********************************************************************
+ProtocolDispatchBenchmark - Utility to compare the cost of finding the
+protocol plug-ins shared by all pairs of clients by merging sorted
+protocol lists against intersecting protocol bit masks.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <Misc/Time.h>
+
+#include <Collaboration/ProtocolSet.h>
+
+double getElapsed(const Misc::Time& start,const Misc::Time& end) // Returns the time between the given start and end times in seconds
+	{
+	Misc::Time elapsed=end-start;
+	return double(elapsed.tv_sec)+double(elapsed.tv_nsec)/1.0e9;
+	}
+
+struct ProtocolListEntry // Structure mirroring a client's negotiated protocol list entry in the collaboration server
+	{
+	/* Elements: */
+	public:
+	unsigned int index; // Index of protocol in server's main list
+	size_t protocolClientState; // Stand-in for the protocol's state object for this client
+	};
+
+struct Client // Structure for the protocol state of a simulated client
+	{
+	/* Elements: */
+	public:
+	std::vector<ProtocolListEntry> protocols; // Negotiated protocols sorted by ascending index
+	Collaboration::ProtocolSet protocolSet; // Set of main list indices of negotiated protocols
+	std::vector<unsigned int> protocolSlots; // Dense array mapping main list indices to positions in the negotiated protocol list
+	};
+
+size_t dispatch(const ProtocolListEntry& ple1,const ProtocolListEntry& ple2,unsigned int destIndex) // Stand-in for a plug-in hook call; returns a checksum to keep the loops from being optimized away
+	{
+	return ple1.protocolClientState^(ple2.protocolClientState>>4)^destIndex;
+	}
+
+size_t mergeJoin(const std::vector<Client>& clients) // Dispatches all shared protocols of all client pairs by merging their sorted protocol lists, counting first like a CLIENT_CONNECT message
+	{
+	size_t checksum=0;
+	for(std::vector<Client>::const_iterator c1It=clients.begin();c1It!=clients.end();++c1It)
+		for(std::vector<Client>::const_iterator c2It=clients.begin();c2It!=clients.end();++c2It)
+			{
+			if(c1It==c2It)
+				continue;
+			const std::vector<ProtocolListEntry>& cpl1=c1It->protocols;
+			const std::vector<ProtocolListEntry>& cpl2=c2It->protocols;
+			
+			/* Count the shared protocols: */
+			unsigned int numShared=0;
+			unsigned int i1=0;
+			unsigned int i2=0;
+			while(i1<cpl1.size()&&i2<cpl2.size())
+				{
+				if(cpl1[i1].index<cpl2[i2].index)
+					++i1;
+				else if(cpl1[i1].index>cpl2[i2].index)
+					++i2;
+				else
+					{
+					++numShared;
+					++i1;
+					++i2;
+					}
+				}
+			checksum+=numShared;
+			
+			/* Dispatch the shared protocols: */
+			i1=0;
+			i2=0;
+			while(i1<cpl1.size()&&i2<cpl2.size())
+				{
+				if(cpl1[i1].index<cpl2[i2].index)
+					++i1;
+				else if(cpl1[i1].index>cpl2[i2].index)
+					++i2;
+				else
+					{
+					checksum+=dispatch(cpl1[i1],cpl2[i2],i2);
+					++i1;
+					++i2;
+					}
+				}
+			}
+	return checksum;
+	}
+
+size_t intersect(const std::vector<Client>& clients) // Ditto, by intersecting protocol sets and looking up both clients' entries in their slot arrays
+	{
+	size_t checksum=0;
+	for(std::vector<Client>::const_iterator c1It=clients.begin();c1It!=clients.end();++c1It)
+		for(std::vector<Client>::const_iterator c2It=clients.begin();c2It!=clients.end();++c2It)
+			{
+			if(c1It==c2It)
+				continue;
+			
+			/* Count the shared protocols: */
+			checksum+=c1It->protocolSet.countShared(c2It->protocolSet);
+			
+			/* Dispatch the shared protocols: */
+			for(Collaboration::ProtocolSet::SharedIterator psIt(c1It->protocolSet,c2It->protocolSet);!psIt.isFinished();++psIt)
+				{
+				unsigned int i2=c2It->protocolSlots[*psIt];
+				checksum+=dispatch(c1It->protocols[c1It->protocolSlots[*psIt]],c2It->protocols[i2],i2);
+				}
+			}
+	return checksum;
+	}
+
+void createClients(unsigned int numClients,unsigned int numProtocols,double negotiateProbability,std::vector<Client>& clients) // Creates clients negotiating each registered protocol with the given probability
+	{
+	clients.clear();
+	clients.resize(numClients);
+	for(std::vector<Client>::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+		for(unsigned int index=0;index<numProtocols;++index)
+			if(double(rand())<negotiateProbability*double(RAND_MAX))
+				{
+				/* Add the protocol to the client's list, set, and slot array in ascending index order: */
+				ProtocolListEntry ple;
+				ple.index=index;
+				ple.protocolClientState=size_t(cIt-clients.begin())*numProtocols+index;
+				cIt->protocols.push_back(ple);
+				cIt->protocolSet.add(index);
+				if(index>=cIt->protocolSlots.size())
+					cIt->protocolSlots.resize(index+1,~0x0U);
+				cIt->protocolSlots[index]=(unsigned int)(cIt->protocols.size()-1);
+				}
+	}
+
+int main(int argc,char* argv[])
+	{
+	/* Parse the command line: */
+	unsigned int numClients=128;
+	unsigned int minProtocols=4;
+	unsigned int maxProtocols=8;
+	double negotiateProbability=0.75;
+	unsigned int numPasses=20;
+	for(int i=1;i<argc;++i)
+		{
+		if(argv[i][0]=='-')
+			{
+			if(strcasecmp(argv[i]+1,"clients")==0&&i+1<argc)
+				numClients=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"minProtocols")==0&&i+1<argc)
+				minProtocols=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"maxProtocols")==0&&i+1<argc)
+				maxProtocols=atoi(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"probability")==0&&i+1<argc)
+				negotiateProbability=atof(argv[++i]);
+			else if(strcasecmp(argv[i]+1,"passes")==0&&i+1<argc)
+				numPasses=atoi(argv[++i]);
+			else
+				std::cerr<<"ProtocolDispatchBenchmark: ignored option "<<argv[i]<<std::endl;
+			}
+		else
+			std::cerr<<"ProtocolDispatchBenchmark: ignored argument "<<argv[i]<<std::endl;
+		}
+	if(numClients<2)
+		numClients=2;
+	if(numPasses<1)
+		numPasses=1;
+	
+	std::cout<<"ProtocolDispatchBenchmark: best of "<<numPasses<<" passes over all pairs of "<<numClients<<" clients"<<std::endl;
+	std::cout<<std::setw(10)<<"Protocols"<<std::setw(14)<<"Merge-join"<<std::setw(14)<<"Bit mask"<<std::setw(10)<<"Speedup"<<std::endl;
+	bool ok=true;
+	for(unsigned int numProtocols=minProtocols;numProtocols<=maxProtocols;++numProtocols)
+		{
+		/* Create a population of clients: */
+		std::vector<Client> clients;
+		createClients(numClients,numProtocols,negotiateProbability,clients);
+		
+		/* Time both intersection methods and check that they dispatch the same protocol pairs: */
+		double mergeTime=1.0e30;
+		double intersectTime=1.0e30;
+		for(unsigned int pass=0;pass<numPasses;++pass)
+			{
+			Misc::Time mergeStart=Misc::Time::now();
+			size_t mergeChecksum=mergeJoin(clients);
+			double time=getElapsed(mergeStart,Misc::Time::now());
+			if(mergeTime>time)
+				mergeTime=time;
+			
+			Misc::Time intersectStart=Misc::Time::now();
+			size_t intersectChecksum=intersect(clients);
+			time=getElapsed(intersectStart,Misc::Time::now());
+			if(intersectTime>time)
+				intersectTime=time;
+			
+			if(mergeChecksum!=intersectChecksum)
+				ok=false;
+			}
+		
+		/* Print the per-pair timings: */
+		double numPairs=double(numClients)*double(numClients-1);
+		std::cout<<std::setw(10)<<numProtocols<<std::fixed<<std::setprecision(1);
+		std::cout<<std::setw(11)<<mergeTime*1.0e9/numPairs<<" ns";
+		std::cout<<std::setw(11)<<intersectTime*1.0e9/numPairs<<" ns";
+		std::cout<<std::setprecision(2)<<std::setw(9)<<mergeTime/intersectTime<<"x";
+		std::cout.unsetf(std::ios::floatfield);
+		std::cout<<std::setprecision(6)<<std::endl;
+		}
+	
+	if(!ok)
+		{
+		std::cerr<<"ProtocolDispatchBenchmark: Merge-join and bit mask dispatched different protocol pairs"<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,296 @@
+/***********************************************************************
+SessionReplay - Program to feed a session log recorded by a
+collaboration server back into a server, as if the recorded clients were
+connected live.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <iostream>
+#include <Misc/ThrowStdErr.h>
+#include <Misc/Time.h>
+#include <Comm/TCPPipe.h>
+
+#include <Collaboration/FakeClient.h>
+#include <Collaboration/SessionLog.h>
+#include <Collaboration/SessionLogReader.h>
+
+struct ReplayStream // Structure for a recorded client connection being replayed
+	{
+	/* Elements: */
+	public:
+	Comm::NetPipePtr pipe; // Pipe connected to the server, or null if the connection failed
+	unsigned int clientId; // Client ID the server assigned to the recorded connection
+	size_t sentBytes; // Number of bytes sent to the server
+	size_t receivedBytes; // Number of bytes received from the server and discarded
+	};
+
+typedef std::map<unsigned int,ReplayStream> ReplayStreamMap;
+
+struct MessageCount // Structure counting recorded messages of one message ID
+	{
+	/* Elements: */
+	public:
+	std::string protocolName; // Name of the protocol owning the message
+	size_t numMessages; // Number of recorded messages
+	};
+
+double getElapsed(const Misc::Time& start) // Returns the time since the given start time in seconds
+	{
+	Misc::Time elapsed=Misc::Time::now()-start;
+	return double(elapsed.tv_sec)+double(elapsed.tv_nsec)/1.0e9;
+	}
+
+void drainStreams(ReplayStreamMap& streams,double timeout) // Discards all data the server sent to any replayed connection, waiting up to the given time in seconds for data to arrive
+	{
+	/* Wait for data on any connected stream: */
+	std::vector<struct pollfd> pollFds;
+	for(ReplayStreamMap::iterator sIt=streams.begin();sIt!=streams.end();++sIt)
+		if(sIt->second.pipe.getPointer()!=0)
+			{
+			struct pollfd pfd;
+			pfd.fd=sIt->second.pipe->getFd();
+			pfd.events=POLLIN;
+			pfd.revents=0;
+			pollFds.push_back(pfd);
+			}
+	if(pollFds.empty()||poll(&pollFds[0],pollFds.size(),int(timeout*1000.0+0.5))<=0)
+		return;
+	
+	/* Discard the data: */
+	for(ReplayStreamMap::iterator sIt=streams.begin();sIt!=streams.end();++sIt)
+		if(sIt->second.pipe.getPointer()!=0)
+			sIt->second.receivedBytes+=Collaboration::discardReceivedData(sIt->second.pipe->getFd());
+	}
+
+void sendData(ReplayStreamMap& streams,ReplayStream& stream,const Misc::UInt8* data,size_t dataSize) // Sends recorded data on a replayed connection, discarding server data while the connection is blocked
+	{
+	while(dataSize>0)
+		{
+		ssize_t writeSize=send(stream.pipe->getFd(),data,dataSize,MSG_DONTWAIT|MSG_NOSIGNAL);
+		if(writeSize>0)
+			{
+			data+=writeSize;
+			dataSize-=writeSize;
+			stream.sentBytes+=writeSize;
+			}
+		else if(writeSize<0&&(errno==EAGAIN||errno==EWOULDBLOCK||errno==EINTR))
+			{
+			/* The server might be blocked writing to us; make room: */
+			drainStreams(streams,0.001);
+			}
+		else
+			Misc::throwStdErr("Server closed connection of client %u",stream.clientId);
+		}
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		const char* logFileName=0;
+		std::string serverHostName="localhost";
+		int serverPortId=26000;
+		double speed=1.0;
+		bool statsOnly=false;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"host")==0&&i+1<argc)
+					serverHostName=argv[++i];
+				else if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+					serverPortId=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"speed")==0&&i+1<argc)
+					speed=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"fast")==0)
+					speed=0.0;
+				else if(strcasecmp(argv[i]+1,"stats")==0)
+					statsOnly=true;
+				else
+					std::cerr<<"SessionReplay: ignored option "<<argv[i]<<std::endl;
+				}
+			else if(logFileName==0)
+				logFileName=argv[i];
+			else
+				std::cerr<<"SessionReplay: ignored argument "<<argv[i]<<std::endl;
+			}
+		if(logFileName==0)
+			{
+			std::cerr<<"Usage: "<<argv[0]<<" <session log file name> [-host <server host name>] [-port <server port>] [-speed <time scale> | -fast] [-stats]"<<std::endl;
+			return 1;
+			}
+		
+		Collaboration::SessionLogReader log(logFileName);
+		
+		if(statsOnly)
+			{
+			/* Summarize the log without replaying it: */
+			std::map<unsigned int,MessageCount> messageCounts;
+			size_t numStreams=0;
+			size_t numDataBytes=0;
+			double duration=0.0;
+			Collaboration::SessionLogReader::Record record;
+			while(log.readRecord(record))
+				{
+				duration=record.time;
+				if(record.type==Collaboration::SessionLog::OPEN_STREAM)
+					++numStreams;
+				else if(record.type==Collaboration::SessionLog::DATA)
+					numDataBytes+=record.payloadSize;
+				else if(record.type==Collaboration::SessionLog::MESSAGE&&record.payloadSize>=sizeof(Misc::UInt32))
+					{
+					Misc::UInt32 messageId;
+					memcpy(&messageId,record.payload,sizeof(Misc::UInt32));
+					MessageCount& mc=messageCounts[messageId];
+					mc.protocolName=std::string(record.payload+sizeof(Misc::UInt32),record.payload+record.payloadSize);
+					++mc.numMessages;
+					}
+				}
+			
+			std::cout<<numStreams<<" client connections, "<<numDataBytes<<" bytes received over "<<duration<<" s"<<std::endl;
+			for(std::map<unsigned int,MessageCount>::iterator mcIt=messageCounts.begin();mcIt!=messageCounts.end();++mcIt)
+				std::cout<<"Message "<<mcIt->first<<" ("<<(mcIt->second.protocolName.empty()?"unknown":mcIt->second.protocolName)<<"): "<<mcIt->second.numMessages<<std::endl;
+			
+			return 0;
+			}
+		
+		/* Replay all recorded records in order: */
+		ReplayStreamMap streams;
+		Misc::Time start=Misc::Time::now();
+		Collaboration::SessionLogReader::Record record;
+		size_t numRecords=0;
+		double recordedTime=0.0;
+		while(log.readRecord(record))
+			{
+			recordedTime=record.time;
+			
+			/* Wait until the record is due, discarding server data in the meantime: */
+			if(speed>0.0)
+				{
+				double wait;
+				while((wait=record.time/speed-getElapsed(start))>0.0)
+					drainStreams(streams,wait);
+				}
+			++numRecords;
+			
+			switch(record.type)
+				{
+				case Collaboration::SessionLog::OPEN_STREAM:
+					{
+					/* Connect a new client to the server: */
+					ReplayStream& stream=streams[record.streamId];
+					stream.clientId=0;
+					stream.sentBytes=0;
+					stream.receivedBytes=0;
+					try
+						{
+						stream.pipe=new Comm::TCPPipe(serverHostName.c_str(),serverPortId);
+						}
+					catch(std::runtime_error err)
+						{
+						std::cerr<<"SessionReplay: Unable to replay recorded connection from "<<std::string(record.payload,record.payload+record.payloadSize)<<" due to exception "<<err.what()<<std::endl;
+						}
+					break;
+					}
+				
+				case Collaboration::SessionLog::CLIENT_ID:
+					{
+					ReplayStreamMap::iterator sIt=streams.find(record.streamId);
+					if(sIt!=streams.end()&&record.payloadSize>=sizeof(Misc::UInt32))
+						{
+						Misc::UInt32 clientId;
+						memcpy(&clientId,record.payload,sizeof(Misc::UInt32));
+						sIt->second.clientId=clientId;
+						}
+					break;
+					}
+				
+				case Collaboration::SessionLog::DATA:
+					{
+					/* Send the recorded data to the server: */
+					ReplayStreamMap::iterator sIt=streams.find(record.streamId);
+					if(sIt!=streams.end()&&sIt->second.pipe.getPointer()!=0)
+						{
+						try
+							{
+							sendData(streams,sIt->second,record.payload,record.payloadSize);
+							}
+						catch(std::runtime_error err)
+							{
+							std::cerr<<"SessionReplay: "<<err.what()<<std::endl;
+							sIt->second.pipe=0;
+							}
+						}
+					break;
+					}
+				
+				case Collaboration::SessionLog::CLOSE_STREAM:
+					{
+					/* Disconnect the client: */
+					ReplayStreamMap::iterator sIt=streams.find(record.streamId);
+					if(sIt!=streams.end())
+						sIt->second.pipe=0;
+					break;
+					}
+				
+				default:
+					/* Message tags are not needed for replay: */
+					;
+				}
+			
+			/* Keep the server from blocking on full connections during fast replay: */
+			if(speed==0.0&&numRecords%64==0)
+				drainStreams(streams,0.0);
+			}
+		double replayTime=getElapsed(start);
+		
+		/* Give the server time to process the replayed traffic before disconnecting the remaining clients: */
+		for(int i=0;i<10;++i)
+			drainStreams(streams,0.05);
+		
+		/* Print a summary: */
+		size_t sentBytes=0;
+		size_t receivedBytes=0;
+		for(ReplayStreamMap::iterator sIt=streams.begin();sIt!=streams.end();++sIt)
+			{
+			sentBytes+=sIt->second.sentBytes;
+			receivedBytes+=sIt->second.receivedBytes;
+			}
+		std::cout<<"Replayed "<<numRecords<<" records of "<<streams.size()<<" client connections in "<<replayTime<<" s (recorded "<<recordedTime<<" s)"<<std::endl;
+		std::cout<<"Sent "<<sentBytes<<" bytes, received "<<receivedBytes<<" bytes"<<std::endl;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,375 @@
+/***********************************************************************
+StateCodecBenchmark - Utility to compare the bandwidth of full,
+delta-encoded, and quantized client state updates on recorded
+head-tracking traces, and to measure the error of quantized poses.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/ThrowStdErr.h>
+#include <IO/FixedMemoryFile.h>
+#include <IO/VariableMemoryFile.h>
+#include <Math/Random.h>
+
+#include <Collaboration/CollaborationProtocol.h>
+#include <Collaboration/StateDeltaCodec.h>
+#include <Collaboration/PoseCodec.h>
+
+typedef Collaboration::CollaborationProtocol::ClientState ClientState;
+typedef Collaboration::Protocol::Scalar Scalar;
+typedef Collaboration::Protocol::Point Point;
+typedef Collaboration::Protocol::Vector Vector;
+typedef Collaboration::Protocol::Rotation Rotation;
+typedef Collaboration::Protocol::ONTransform ONTransform;
+typedef Collaboration::Protocol::OGTransform OGTransform;
+
+struct Sample // Structure for one sample of a head-tracking trace
+	{
+	/* Elements: */
+	public:
+	double time; // Sample time in seconds
+	ONTransform head; // Head position and orientation
+	OGTransform navTransform; // Navigation transformation
+	};
+
+typedef std::vector<Sample> Trace;
+
+void readTrace(const char* fileName,Trace& trace) // Reads a trace from a text file with one sample per line
+	{
+	std::ifstream file(fileName);
+	if(!file)
+		Misc::throwStdErr("StateCodecBenchmark: Unable to open trace file %s",fileName);
+	
+	std::string line;
+	while(std::getline(file,line))
+		{
+		/* Skip empty lines and comments: */
+		if(line.empty()||line[0]=='#')
+			continue;
+		
+		/* Read the sample time and the head position and orientation quaternion: */
+		std::istringstream ls(line);
+		Sample s;
+		double v[15];
+		int numValues;
+		for(numValues=0;numValues<15&&(ls>>v[numValues]);++numValues)
+			;
+		if(numValues!=8&&numValues!=15)
+			Misc::throwStdErr("StateCodecBenchmark: Malformed sample in line %u of trace file %s",(unsigned int)(trace.size()+1),fileName);
+		s.time=v[0];
+		s.head=ONTransform(Vector(v[1],v[2],v[3]),Rotation(v[4],v[5],v[6],v[7]));
+		
+		/* Read the optional navigation transformation: */
+		if(numValues==15)
+			s.navTransform=OGTransform(Vector(v[8],v[9],v[10]),Rotation(v[11],v[12],v[13],v[14]),Scalar(1));
+		else
+			s.navTransform=OGTransform::identity;
+		
+		trace.push_back(s);
+		}
+	}
+
+void synthesizeTrace(double duration,double rate,Trace& trace) // Creates a trace of a standing user slowly looking around, with tracker noise
+	{
+	unsigned int numSamples=(unsigned int)(duration*rate);
+	for(unsigned int i=0;i<numSamples;++i)
+		{
+		Sample s;
+		s.time=double(i)/rate;
+		
+		/* Sway around a standing eye position, in inches, with tracker jitter of a few thousandths of an inch: */
+		Vector position(Scalar(2.0*sin(s.time*0.7)+Math::randNormal(0.0,0.002)),
+		                Scalar(1.5*sin(s.time*0.45)+Math::randNormal(0.0,0.002)),
+		                Scalar(66.0+0.5*sin(s.time*0.3)+Math::randNormal(0.0,0.002)));
+		
+		/* Look left and right around the vertical axis, with slight nodding: */
+		double yaw=0.6*sin(s.time*0.25)+Math::randNormal(0.0,0.0002);
+		double pitch=0.1*sin(s.time*0.6);
+		Rotation orientation(Scalar(sin(pitch*0.5)*cos(yaw*0.5)),Scalar(-sin(pitch*0.5)*sin(yaw*0.5)),Scalar(cos(pitch*0.5)*sin(yaw*0.5)),Scalar(cos(pitch*0.5)*cos(yaw*0.5)));
+		s.head=ONTransform(position,orientation);
+		
+		/* Navigate in bursts, holding still in between: */
+		double navTime=fmod(s.time,10.0)<3.0?s.time:floor(s.time/10.0)*10.0+3.0;
+		s.navTransform=OGTransform(Vector(Scalar(navTime*5.0),Scalar(0),Scalar(0)),Rotation::identity,Scalar(1));
+		
+		trace.push_back(s);
+		}
+	}
+
+bool equal(const ONTransform& t1,const ONTransform& t2) // Compares two transformations component-wise for bit-exact equality
+	{
+	return memcmp(&t1.getTranslation()[0],&t2.getTranslation()[0],3*sizeof(Scalar))==0&&memcmp(t1.getRotation().getQuaternion(),t2.getRotation().getQuaternion(),4*sizeof(Scalar))==0;
+	}
+
+bool equal(const OGTransform& t1,const OGTransform& t2) // Ditto, for transformations with scaling
+	{
+	return memcmp(&t1.getTranslation()[0],&t2.getTranslation()[0],3*sizeof(Scalar))==0&&memcmp(t1.getRotation().getQuaternion(),t2.getRotation().getQuaternion(),4*sizeof(Scalar))==0&&t1.getScaling()==t2.getScaling();
+	}
+
+IO::FixedMemoryFile* readBack(const IO::VariableMemoryFile& message) // Copies an encoded message into contiguous memory to be read like a receiving client
+	{
+	size_t messageSize=message.getDataSize();
+	IO::FixedMemoryFile packet(messageSize);
+	message.writeToSink(packet);
+	packet.flush();
+	IO::FixedMemoryFile* reader=new IO::FixedMemoryFile(messageSize);
+	memcpy(reader->getMemory(),packet.getMemory(),messageSize);
+	return reader;
+	}
+
+size_t decode(const IO::VariableMemoryFile& message,ClientState& state,Collaboration::StateDeltaCodec::Baseline& baseline) // Decodes a delta-encoded state update like a receiving client; returns the message size
+	{
+	Misc::SelfDestructPointer<IO::FixedMemoryFile> reader(readBack(message));
+	Collaboration::StateDeltaCodec::readClientState(state,baseline,*reader);
+	return message.getDataSize();
+	}
+
+size_t decode(const IO::VariableMemoryFile& message,ClientState& state,const Collaboration::PoseCodec& poseCodec) // Decodes a quantized state update like a receiving client; returns the message size
+	{
+	Misc::SelfDestructPointer<IO::FixedMemoryFile> reader(readBack(message));
+	Collaboration::CollaborationProtocol::readClientState(state,poseCodec,*reader);
+	return message.getDataSize();
+	}
+
+double positionError(const ONTransform& t1,const ONTransform& t2) // Returns the distance between the positions of two transformations
+	{
+	return double(Geometry::mag(t1.getTranslation()-t2.getTranslation()));
+	}
+
+double rotationError(const Rotation& r1,const Rotation& r2) // Returns the angle in radians of the rotation between two rotations
+	{
+	/* Normalize both quaternions to remove single-precision rounding: */
+	const Scalar* q1=r1.getQuaternion();
+	const Scalar* q2=r2.getQuaternion();
+	double len1=0.0,len2=0.0;
+	for(int i=0;i<4;++i)
+		{
+		len1+=double(q1[i])*double(q1[i]);
+		len2+=double(q2[i])*double(q2[i]);
+		}
+	len1=sqrt(len1);
+	len2=sqrt(len2);
+	
+	/* Calculate the chordal distance between the quaternions, which is better conditioned than their dot product for small angles: */
+	double sqrDistMinus=0.0,sqrDistPlus=0.0;
+	for(int i=0;i<4;++i)
+		{
+		double c1=double(q1[i])/len1;
+		double c2=double(q2[i])/len2;
+		sqrDistMinus+=(c1-c2)*(c1-c2);
+		sqrDistPlus+=(c1+c2)*(c1+c2);
+		}
+	double dist=sqrt(sqrDistMinus<sqrDistPlus?sqrDistMinus:sqrDistPlus);
+	return 4.0*asin(dist<2.0?dist*0.5:1.0);
+	}
+
+void measureErrors(const Collaboration::PoseCodec& poseCodec,const Point& frameCenter,Scalar frameSize,unsigned int numSamples,double& maxPositionError,double& maxRotationError) // Measures the maximum errors of quantizing random poses inside the codec's position range
+	{
+	for(unsigned int i=0;i<numSamples;++i)
+		{
+		/* Create a random position inside the quantized range and a uniformly distributed random orientation: */
+		Vector position;
+		for(int j=0;j<3;++j)
+			position[j]=Scalar(double(frameCenter[j])+(Math::randUniformCO()*2.0-1.0)*8.0*double(frameSize));
+		double q[4];
+		double qLen=0.0;
+		for(int j=0;j<4;++j)
+			{
+			q[j]=Math::randNormal(0.0,1.0);
+			qLen+=q[j]*q[j];
+			}
+		qLen=sqrt(qLen);
+		ONTransform pose(position,Rotation(Scalar(q[0]/qLen),Scalar(q[1]/qLen),Scalar(q[2]/qLen),Scalar(q[3]/qLen)));
+		
+		/* Quantize the pose and read it back: */
+		IO::VariableMemoryFile message;
+		poseCodec.write(pose,frameCenter,frameSize,message);
+		Misc::SelfDestructPointer<IO::FixedMemoryFile> reader(readBack(message));
+		ONTransform quantized;
+		poseCodec.read(quantized,frameCenter,frameSize,*reader);
+		
+		/* Update the maximum errors: */
+		double pe=positionError(pose,quantized);
+		if(maxPositionError<pe)
+			maxPositionError=pe;
+		double re=rotationError(pose.getRotation(),quantized.getRotation());
+		if(maxRotationError<re)
+			maxRotationError=re;
+		}
+	}
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Parse the command line: */
+		const char* traceFileName=0;
+		double duration=60.0;
+		double rate=90.0;
+		double tickTime=0.02;
+		unsigned int positionBits=16;
+		unsigned int rotationBits=12;
+		unsigned int numErrorSamples=1000000;
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"synth")==0&&i+1<argc)
+					duration=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"rate")==0&&i+1<argc)
+					rate=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"tick")==0&&i+1<argc)
+					tickTime=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"positionBits")==0&&i+1<argc)
+					positionBits=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"rotationBits")==0&&i+1<argc)
+					rotationBits=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"errorSamples")==0&&i+1<argc)
+					numErrorSamples=atoi(argv[++i]);
+				else
+					std::cerr<<"StateCodecBenchmark: ignored option "<<argv[i]<<std::endl;
+				}
+			else
+				traceFileName=argv[i];
+			}
+		
+		/* Read or create a trace: */
+		Trace trace;
+		if(traceFileName!=0)
+			readTrace(traceFileName,trace);
+		else
+			synthesizeTrace(duration,rate,trace);
+		if(trace.empty())
+			Misc::throwStdErr("StateCodecBenchmark: Empty trace");
+		
+		/* Initialize the sending client's state, with an environment of the size of a CAVE centered at eye height, in inches: */
+		ClientState state;
+		state.resize(1);
+		state.clientName="StateCodecBenchmark";
+		state.displayCenter=Point(0,0,60);
+		state.displaySize=Scalar(60);
+		
+		/* Initialize the receiving client's states and both sides' baselines: */
+		ClientState received,quantizedReceived;
+		Collaboration::StateDeltaCodec::Baseline sendBaseline,receiveBaseline;
+		Collaboration::PoseCodec poseCodec(positionBits,rotationBits);
+		
+		/* Run server updates at the tick interval, each sending the most recent sample: */
+		size_t fullSize=0;
+		size_t deltaSize=0;
+		size_t quantizedSize=0;
+		unsigned int numUpdates=0;
+		unsigned int numMismatches=0;
+		double maxPositionError=0.0;
+		double maxRotationError=0.0;
+		Trace::const_iterator tIt=trace.begin();
+		for(double tickTime0=trace.front().time;tIt!=trace.end();tickTime0+=tickTime)
+			{
+			/* Find the most recent sample before the tick: */
+			Trace::const_iterator sIt=tIt;
+			while(tIt!=trace.end()&&tIt->time<=tickTime0)
+				sIt=tIt++;
+			
+			/* Update the client state from the sample: */
+			unsigned int updateMask=numUpdates==0?ClientState::FULL_UPDATE:ClientState::NO_CHANGE;
+			if(!equal(state.viewerStates[0],sIt->head))
+				updateMask|=ClientState::VIEWER;
+			state.viewerStates[0]=sIt->head;
+			if(!equal(state.navTransform,sIt->navTransform))
+				updateMask|=ClientState::NAVTRANSFORM;
+			state.navTransform=sIt->navTransform;
+			
+			/* Encode the state update in full: */
+			IO::VariableMemoryFile fullMessage;
+			Collaboration::CollaborationProtocol::writeClientState(updateMask,state,fullMessage);
+			fullSize+=fullMessage.getDataSize();
+			
+			/* Encode the state update as differences and decode it on the receiving side: */
+			IO::VariableMemoryFile deltaMessage;
+			Collaboration::StateDeltaCodec::writeClientState(updateMask,state,sendBaseline,deltaMessage);
+			deltaSize+=decode(deltaMessage,received,receiveBaseline);
+			
+			/* Check that the receiver reconstructed the sender's state exactly: */
+			if(received.numViewers!=1||!equal(received.viewerStates[0],state.viewerStates[0])||!equal(received.navTransform,state.navTransform))
+				++numMismatches;
+			
+			/* Encode the state update with quantized poses and decode it on the receiving side: */
+			IO::VariableMemoryFile quantizedMessage;
+			Collaboration::CollaborationProtocol::writeClientState(updateMask,state,poseCodec,quantizedMessage);
+			quantizedSize+=decode(quantizedMessage,quantizedReceived,poseCodec);
+			
+			/* Measure the quantization error of the reconstructed head pose and navigation rotation: */
+			double pe=positionError(quantizedReceived.viewerStates[0],state.viewerStates[0]);
+			if(maxPositionError<pe)
+				maxPositionError=pe;
+			double re=rotationError(quantizedReceived.viewerStates[0].getRotation(),state.viewerStates[0].getRotation());
+			if(maxRotationError<re)
+				maxRotationError=re;
+			re=rotationError(quantizedReceived.navTransform.getRotation(),state.navTransform.getRotation());
+			if(maxRotationError<re)
+				maxRotationError=re;
+			
+			++numUpdates;
+			}
+		
+		/* Print the results: */
+		double traceDuration=double(numUpdates)*tickTime;
+		std::cout<<"StateCodecBenchmark: "<<trace.size()<<" samples, "<<numUpdates<<" server updates at "<<tickTime*1000.0<<" ms"<<std::endl;
+		std::cout<<"Full updates:  "<<fullSize<<" bytes, "<<double(fullSize)/double(numUpdates)<<" bytes/update, "<<double(fullSize)/traceDuration<<" bytes/s per destination"<<std::endl;
+		std::cout<<"Delta updates: "<<deltaSize<<" bytes, "<<double(deltaSize)/double(numUpdates)<<" bytes/update, "<<double(deltaSize)/traceDuration<<" bytes/s per destination"<<std::endl;
+		std::cout<<"Quantized updates: "<<quantizedSize<<" bytes, "<<double(quantizedSize)/double(numUpdates)<<" bytes/update, "<<double(quantizedSize)/traceDuration<<" bytes/s per destination"<<std::endl;
+		std::cout<<"Delta/full ratio: "<<double(deltaSize)/double(fullSize)<<", quantized/full ratio: "<<double(quantizedSize)/double(fullSize)<<std::endl;
+		
+		/* Measure the quantization errors over random poses covering the codec's whole range: */
+		measureErrors(poseCodec,state.displayCenter,state.displaySize,numErrorSamples,maxPositionError,maxRotationError);
+		double positionBound=double(poseCodec.getMaxPositionError(state.displaySize));
+		double rotationBound=double(poseCodec.getMaxRotationError());
+		std::cout<<"Quantization with "<<positionBits<<" position bits and "<<rotationBits<<" rotation bits over trace and "<<numErrorSamples<<" random poses:"<<std::endl;
+		std::cout<<"Maximum position error: "<<maxPositionError<<" (bound "<<positionBound<<"), "<<maxPositionError/double(state.displaySize)<<" display sizes"<<std::endl;
+		std::cout<<"Maximum rotation error: "<<maxRotationError*180.0/M_PI<<" degrees (bound "<<rotationBound*180.0/M_PI<<" degrees)"<<std::endl;
+		if(numMismatches>0)
+			{
+			std::cerr<<"StateCodecBenchmark: "<<numMismatches<<" updates were not reconstructed exactly"<<std::endl;
+			return 1;
+			}
+		
+		/* Allow for single-precision rounding of the reconstructed positions: */
+		if(maxPositionError>positionBound*1.01+1.0e-6*double(state.displaySize)||maxRotationError>rotationBound*1.01+1.0e-6)
+			{
+			std::cerr<<"StateCodecBenchmark: Quantization error exceeds the codec's bound"<<std::endl;
+			return 1;
+			}
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}
@@ -0,0 +1,210 @@
+/***********************************************************************
+TickAllocationCounter - Program to count the heap allocations of each
+collaboration server update, to check that updates without joining or
+leaving clients run without allocating memory.
+Copyright (c) 2011 Oliver Kreylos
+
+This file is part of the Vrui remote collaboration infrastructure.
+
+The Vrui remote collaboration infrastructure is free software; you can
+redistribute it and/or modify it under the terms of the GNU General
+Public License as published by the Free Software Foundation; either
+version 2 of the License, or (at your option) any later version.
+
+The Vrui remote collaboration infrastructure is distributed in the hope
+that it will be useful, but WITHOUT ANY WARRANTY; without even the
+implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along
+with the Vrui remote collaboration infrastructure; if not, write to the
+Free Software Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA
+02111-1307 USA
+***********************************************************************/
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <new>
+#include <vector>
+#include <iostream>
+#include <Misc/SelfDestructPointer.h>
+#include <Misc/Time.h>
+
+#include <Collaboration/FakeClient.h>
+#include <Collaboration/CollaborationServer.h>
+
+/*************************
+Global allocation counter:
+*************************/
+
+static volatile bool countAllocations=false; // Flag whether all threads count their allocations; set while a server update runs, so that allocations on the server's update and hook pool threads are counted as well
+static size_t numAllocations=0; // Number of allocations counted so far; updated atomically
+
+void* operator new(size_t size)
+	{
+	if(countAllocations)
+		__sync_fetch_and_add(&numAllocations,size_t(1));
+	void* result=malloc(size>0?size:1);
+	if(result==0)
+		throw std::bad_alloc();
+	return result;
+	}
+
+void* operator new[](size_t size)
+	{
+	if(countAllocations)
+		__sync_fetch_and_add(&numAllocations,size_t(1));
+	void* result=malloc(size>0?size:1);
+	if(result==0)
+		throw std::bad_alloc();
+	return result;
+	}
+
+void operator delete(void* pointer)
+	{
+	free(pointer);
+	}
+
+void operator delete[](void* pointer)
+	{
+	free(pointer);
+	}
+
+typedef std::vector<Collaboration::FakeClient*> FakeClientList;
+
+int main(int argc,char* argv[])
+	{
+	try
+		{
+		/* Create a new configuration object: */
+		Misc::SelfDestructPointer<Collaboration::CollaborationServer::Configuration> cfg(new Collaboration::CollaborationServer::Configuration);
+		
+		/* Parse the command line: */
+		int listenPortId=-1;
+		int datagramPortId=0;
+		unsigned int positionBits=16;
+		unsigned int rotationBits=12;
+		unsigned int numClients=100;
+		unsigned int numSettleTicks=50;
+		unsigned int numTicks=500;
+		double waitTime=0.0;
+		Misc::Time tickTime(cfg->getTickTime());
+		for(int i=1;i<argc;++i)
+			{
+			if(argv[i][0]=='-')
+				{
+				if(strcasecmp(argv[i]+1,"port")==0&&i+1<argc)
+					listenPortId=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"datagramPort")==0&&i+1<argc)
+					datagramPortId=atoi(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"poseBits")==0&&i+2<argc)
+					{
+					positionBits=(unsigned int)(atoi(argv[++i]));
+					rotationBits=(unsigned int)(atoi(argv[++i]));
+					}
+				else if(strcasecmp(argv[i]+1,"clients")==0&&i+1<argc)
+					numClients=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"settle")==0&&i+1<argc)
+					numSettleTicks=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"ticks")==0&&i+1<argc)
+					numTicks=(unsigned int)(atoi(argv[++i]));
+				else if(strcasecmp(argv[i]+1,"wait")==0&&i+1<argc)
+					waitTime=atof(argv[++i]);
+				else if(strcasecmp(argv[i]+1,"tick")==0&&i+1<argc)
+					tickTime=Misc::Time(atof(argv[++i]));
+				else
+					std::cerr<<"TickAllocationCounter: ignored option "<<argv[i]<<std::endl;
+				}
+			}
+		
+		/* Ignore SIGPIPE and leave handling of pipe errors to TCP sockets: */
+		struct sigaction sigPipeAction;
+		sigPipeAction.sa_handler=SIG_IGN;
+		sigemptyset(&sigPipeAction.sa_mask);
+		sigPipeAction.sa_flags=0x0;
+		sigaction(SIGPIPE,&sigPipeAction,0);
+		
+		/* Create the collaboration server object on the requested or any free ports, with delta-encoded state updates and quantized poses: */
+		cfg->setListenPortId(listenPortId);
+		cfg->setDatagramPortId(datagramPortId);
+		cfg->setDeltaStates(true);
+		cfg->setPoseBits(positionBits,rotationBits);
+		Collaboration::CollaborationServer server(cfg.getTarget());
+		cfg.releaseTarget();
+		int serverPortId=server.getListenPortId();
+		std::cout<<"TickAllocationCounter: Started server on port "<<serverPortId<<std::endl;
+		
+		/* Connect the built-in clients, cycling through all kinds of reserved entries: */
+		FakeClientList clients;
+		for(unsigned int i=0;i<numClients;++i)
+			clients.push_back(new Collaboration::FakeClient("localhost",serverPortId,i,Collaboration::FakeClient::Kind(i%Collaboration::FakeClient::NUM_KINDS)));
+		
+		/* Give external clients, e.g., load generators emulating protocol plug-ins, time to connect while the server runs: */
+		Misc::Time waitStart=Misc::Time::now();
+		while(true)
+			{
+			Misc::Time waited=Misc::Time::now()-waitStart;
+			if(double(waited.tv_sec)+double(waited.tv_nsec)/1.0e9>=waitTime)
+				break;
+			Misc::sleep(tickTime);
+			for(FakeClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+				(*cIt)->drain();
+			server.update();
+			}
+		
+		/* Run server updates, and count the allocations of those during which no clients joined or left: */
+		unsigned int numSteadyTicks=0;
+		unsigned int numAllocatingTicks=0;
+		size_t totalAllocations=0;
+		size_t maxAllocations=0;
+		for(unsigned int tick=0;tick<numSettleTicks+numTicks;++tick)
+			{
+			/* Let the built-in clients discard what they received, and send new states while the server's communication threads have a full tick to receive them: */
+			for(FakeClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+				{
+				(*cIt)->drain();
+				(*cIt)->sendUpdate();
+				}
+			Misc::sleep(tickTime);
+			
+			/* Run one server update, counting the allocations made by all threads, including the server's thread pools, while it runs: */
+			size_t numClientsBefore=server.getOutboundQueueStatus().size();
+			numAllocations=0;
+			__sync_synchronize();
+			countAllocations=true;
+			server.update();
+			countAllocations=false;
+			size_t tickAllocations=__sync_fetch_and_add(&numAllocations,size_t(0));
+			size_t numClientsAfter=server.getOutboundQueueStatus().size();
+			
+			/* Skip settling ticks, and ticks processing joining or leaving clients: */
+			if(tick<numSettleTicks||numClientsBefore!=numClientsAfter)
+				continue;
+			
+			++numSteadyTicks;
+			totalAllocations+=tickAllocations;
+			if(tickAllocations>0)
+				++numAllocatingTicks;
+			if(maxAllocations<tickAllocations)
+				maxAllocations=tickAllocations;
+			}
+		
+		std::cout<<"TickAllocationCounter: "<<server.getOutboundQueueStatus().size()<<" clients, "<<numSteadyTicks<<" steady ticks, "<<numAllocatingTicks<<" of them allocating, ";
+		std::cout<<totalAllocations<<" allocations in total, at most "<<maxAllocations<<" per tick"<<std::endl;
+		
+		/* Disconnect the built-in clients: */
+		for(FakeClientList::iterator cIt=clients.begin();cIt!=clients.end();++cIt)
+			delete *cIt;
+		
+		if(numAllocatingTicks>0)
+			return 1;
+		}
+	catch(std::runtime_error err)
+		{
+		std::cerr<<"Caught exception "<<err.what()<<std::endl;
+		return 1;
+		}
+	
+	return 0;
+	}